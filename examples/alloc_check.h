@@ -0,0 +1,117 @@
+/*
+ *  Heap allocation counter for the zero allocation steady state check
+ *
+ *  Built with WITH_ALLOCATION_CHECK, this replaces the global operator
+ *  new/delete and, on glibc, malloc and friends (OpenCV allocates matrix
+ *  data through malloc) with counting versions. Every thread counts its
+ *  own allocations, so a pipeline thread can be checked while others run.
+ *  Allocations inside libraries count as well: libusb's Linux backend
+ *  allocates the URBs of every libusb_submit_transfer, so only a grab from
+ *  a RawFrameSource (replay, tests) can be held to zero allocations.
+ *  Include in exactly one translation unit of a program.
+ */
+
+#ifndef ALLOC_CHECK_H
+#define ALLOC_CHECK_H
+
+#ifdef SEEK_ALLOCATION_CHECK
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace alloc_check {
+
+static thread_local size_t allocation_count = 0;
+
+/*
+ *  Number of heap allocations by the calling thread since it started
+ */
+inline size_t allocations()
+{
+    return allocation_count;
+}
+
+} /* alloc_check */
+
+#if defined(__GLIBC__)
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size)
+{
+    alloc_check::allocation_count++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size)
+{
+    alloc_check::allocation_count++;
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    alloc_check::allocation_count++;
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    alloc_check::allocation_count++;
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    *ptr = memalign(alignment, size);
+    return *ptr ? 0 : 12; /* ENOMEM */
+}
+
+void free(void* ptr)
+{
+    __libc_free(ptr);
+}
+
+} /* extern "C" */
+
+/* operator new ends up in the counting malloc above */
+#else
+void* operator new(std::size_t size)
+{
+    alloc_check::allocation_count++;
+    void* p = std::malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+#endif /* __GLIBC__ */
+
+#endif /* SEEK_ALLOCATION_CHECK */
+
+#endif /* ALLOC_CHECK_H */
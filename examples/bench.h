@@ -0,0 +1,241 @@
+/*
+ *  Shared parts of the benchmark programs
+ *
+ *  Replays stored or synthetic raw frames into a camera without usb, times
+ *  stages and writes / compares results as JSON with one result per line,
+ *  so a baseline is read back without a JSON library. The tests replay the
+ *  same synthetic frames.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "SeekCamCore.h"
+
+namespace bench {
+
+typedef std::chrono::steady_clock Clock;
+typedef std::vector<std::vector<uint16_t> > FrameList;
+
+struct StageResult {
+    std::string model;
+    std::string stage;
+    double ns_per_frame;
+    double bytes_per_frame;     /* read + written, estimated from the data layout */
+};
+
+/*
+ *  Delivers stored raw frames to a camera in a loop. The first frame is
+ *  only delivered once, for the dead pixel detection in open()
+ */
+class LoopSource: public LibSeek::RawFrameSource
+{
+public:
+    explicit LoopSource(const FrameList& frames) :
+        m_frames(frames),
+        m_next(0),
+        m_sequence(0)
+    { }
+
+    virtual bool next_raw_frame(uint16_t* raw, LibSeek::FrameMeta& meta)
+    {
+        const std::vector<uint16_t>& frame = m_frames[m_next];
+
+        std::copy(frame.begin(), frame.end(), raw);
+        meta.timestamp_ns = m_sequence * 111000000;
+        meta.sequence = m_sequence++;
+        m_next = m_next + 1 < m_frames.size() ? m_next + 1 : 1;
+
+        return true;
+    }
+
+private:
+    const FrameList& m_frames;
+    size_t m_next;
+    uint64_t m_sequence;
+};
+
+inline uint32_t hash(uint32_t v)
+{
+    v ^= v >> 16;
+    v *= 0x7feb352d;
+    v ^= v >> 15;
+    v *= 0x846ca68b;
+    v ^= v >> 16;
+    return v;
+}
+
+/*
+ *  A first frame, then image frames of a moving scene on top of a fixed
+ *  pixel pattern, with a shutter frame every 50 frames and 0.1% dead pixels
+ *  (the pixels with hash(raw index) % 1000 == 0)
+ */
+template<class Traits>
+inline FrameList synthetic_frames(int count)
+{
+    int n, x, y;
+    FrameList frames(count, std::vector<uint16_t>(Traits::raw_width * Traits::raw_height));
+
+    for (n=0; n<count; n++) {
+        uint16_t* raw = frames[n].data();
+        const int id = n == 0 ? LibSeek::FrameType::FIRST :
+                       (n % 50 == 1 ? LibSeek::FrameType::SHUTTER : LibSeek::FrameType::IMAGE);
+        const int hot_x = Traits::width / 4 + (n * 3) % (Traits::width / 2);
+        const int hot_y = Traits::height / 2;
+
+        for (y=0; y<Traits::raw_height; y++) {
+            for (x=0; x<Traits::raw_width; x++) {
+                const uint32_t h = hash(y * Traits::raw_width + x);
+                const int pattern = h % 64;
+                int value;
+
+                if (h % 1000 == 0) {
+                    value = 40;         /* dead */
+                } else if (id == LibSeek::FrameType::FIRST) {
+                    value = 8000 + (h % 8 == 0 ? pattern : pattern % 4);
+                } else if (id == LibSeek::FrameType::SHUTTER) {
+                    value = 8000 + pattern;
+                } else {
+                    const int dx = x - hot_x, dy = y - hot_y;
+                    value = 8000 + pattern + (x * 7 + y * 11 + n * 13) % 900 + hash(h + n) % 16;
+                    if (dx * dx + dy * dy < 400)
+                        value += 2500;
+                }
+                raw[y * Traits::raw_width + x] = value;
+            }
+        }
+
+        raw[Traits::frame_id_word] = id;
+        raw[Traits::frame_counter_word] = n;
+    }
+
+    return frames;
+}
+
+/*
+ *  Best ns per call out of 3 runs of about min_ms / 3 each,
+ *  fn is called with a running call count
+ */
+template<class Fn>
+inline double ns_per_call(double min_ms, Fn fn)
+{
+    int run;
+    double best = 1e18;
+
+    for (run=0; run<3; run++) {
+        size_t calls = 0;
+        const Clock::time_point start = Clock::now();
+        double elapsed_ns;
+
+        do {
+            fn(calls++);
+            elapsed_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        } while (elapsed_ns < min_ms * 1e6 / 3);
+
+        best = std::min(best, elapsed_ns / calls);
+    }
+
+    return best;
+}
+
+inline void print_results(const std::vector<StageResult>& results)
+{
+    printf("%-8s %-24s %12s %10s %10s\n", "model", "stage", "ns/frame", "frames/s", "MB/s");
+    for (size_t i = 0; i < results.size(); i++) {
+        const StageResult& r = results[i];
+        printf("%-8s %-24s %12.0f %10.0f %10.1f\n", r.model.c_str(), r.stage.c_str(),
+               r.ns_per_frame, 1e9 / r.ns_per_frame, r.bytes_per_frame / r.ns_per_frame * 1e3);
+    }
+}
+
+/*
+ *  fields: extra members, each as "key": value followed by ",\n"
+ */
+inline std::string json_results(const std::string& benchmark, const std::vector<StageResult>& results,
+                                const std::string& fields=std::string())
+{
+    std::ostringstream json;
+
+    json << "{\n";
+    json << "  \"benchmark\": \"" << benchmark << "\",\n";
+#ifdef SEEK_FIXED_POINT
+    json << "  \"fixed_point\": true,\n";
+#else
+    json << "  \"fixed_point\": false,\n";
+#endif
+    if (!fields.empty())
+        json << "  " << fields;
+    json << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const StageResult& r = results[i];
+        json << "    { \"model\": \"" << r.model << "\", \"stage\": \"" << r.stage << "\""
+             << ", \"ns_per_frame\": " << static_cast<uint64_t>(r.ns_per_frame)
+             << ", \"frames_per_s\": " << static_cast<uint64_t>(1e9 / r.ns_per_frame)
+             << ", \"bytes_per_frame\": " << static_cast<uint64_t>(r.bytes_per_frame) << " }"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+
+    return json.str();
+}
+
+/* string value of "key": "value" or number of "key": number in line */
+inline std::string json_field(const std::string& line, const std::string& key)
+{
+    size_t pos = line.find("\"" + key + "\":");
+    if (pos == std::string::npos)
+        return std::string();
+
+    pos = line.find_first_not_of(" \"", pos + key.size() + 3);
+    const size_t end = line.find_first_of("\",}", pos);
+    return pos == std::string::npos ? std::string() : line.substr(pos, end - pos);
+}
+
+/*
+ *  Compare with the results of a previous --json run.
+ *  Returns the number of stages slower than threshold percent
+ */
+inline int compare_baseline(const std::vector<StageResult>& results, const std::string& filename, double threshold)
+{
+    int regressions = 0;
+    std::string line;
+    std::ifstream baseline(filename.c_str());
+
+    if (!baseline) {
+        std::cerr << "Error: can't read baseline " << filename << std::endl;
+        return 1;
+    }
+
+    while (std::getline(baseline, line)) {
+        const std::string model = json_field(line, "model");
+        const std::string stage = json_field(line, "stage");
+        const double ns = atof(json_field(line, "ns_per_frame").c_str());
+
+        for (size_t i = 0; i < results.size() && ns > 0; i++) {
+            if (results[i].model != model || results[i].stage != stage)
+                continue;
+
+            const double change = (results[i].ns_per_frame / ns - 1) * 100;
+            if (change > threshold) {
+                printf("REGRESSION %-8s %-24s %10.0f ns -> %10.0f ns (%+.1f%%)\n",
+                       model.c_str(), stage.c_str(), ns, results[i].ns_per_frame, change);
+                regressions++;
+            }
+        }
+    }
+
+    return regressions;
+}
+
+} /* bench */
+
+#endif /* BENCH_H */
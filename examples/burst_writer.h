@@ -0,0 +1,151 @@
+/*
+ *  Burst writer
+ *  Writes burst frames from a pool of threads. The capture loop takes a
+ *  preallocated buffer, fills it and queues it, it never waits for the
+ *  disk: when all buffers are still queued the frame is dropped.
+ */
+
+#ifndef BURST_WRITER_H
+#define BURST_WRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class BurstWriter
+{
+public:
+    /*
+     *  Writes one frame of width x height pixels, rows not padded, from a
+     *  writer thread. Returns false when it failed
+     */
+    typedef std::function<bool(const uint16_t* frame, int index)> WriteFunction;
+
+    BurstWriter(int width, int height, int buffers, int threads, const WriteFunction& write) :
+        m_write(write),
+        m_buffers(buffers, std::vector<uint16_t>(width * height)),
+        m_stop(false),
+        m_written(0),
+        m_failed(0)
+    {
+        int i;
+
+        for (i = 0; i < buffers; i++)
+            m_free.push_back(m_buffers[i].data());
+        for (i = 0; i < threads; i++)
+            m_threads.push_back(std::thread(&BurstWriter::run, this));
+    }
+
+    ~BurstWriter()
+    {
+        finish();
+    }
+
+    /* a free buffer, nullptr when the writers are behind */
+    uint16_t* acquire()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_free.empty())
+            return nullptr;
+
+        uint16_t* frame = m_free.back();
+        m_free.pop_back();
+        return frame;
+    }
+
+    /* give back a buffer from acquire() without writing it */
+    void release(uint16_t* frame)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(frame);
+    }
+
+    void submit(uint16_t* frame, int index)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(Job { frame, index });
+        }
+        m_wake.notify_one();
+    }
+
+    /* write the queued frames and stop the threads */
+    void finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+
+        for (size_t i = 0; i < m_threads.size(); i++)
+            m_threads[i].join();
+        m_threads.clear();
+    }
+
+    int written() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_written;
+    }
+
+    int failed() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_failed;
+    }
+
+private:
+    BurstWriter(const BurstWriter&);
+    BurstWriter& operator=(const BurstWriter&);
+
+    struct Job {
+        uint16_t* frame;
+        int index;
+    };
+
+    void run()
+    {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while (m_jobs.empty() && !m_stop)
+                    m_wake.wait(lock);
+                if (m_jobs.empty())
+                    return;
+                job = m_jobs.front();
+                m_jobs.pop_front();
+            }
+
+            const bool ok = m_write(job.frame, job.index);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free.push_back(job.frame);
+            if (ok)
+                m_written++;
+            else
+                m_failed++;
+        }
+    }
+
+    const WriteFunction m_write;
+    std::vector<std::vector<uint16_t> > m_buffers;
+    std::vector<std::thread> m_threads;
+
+    /* guards everything below */
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::vector<uint16_t*> m_free;
+    std::deque<Job> m_jobs;
+    bool m_stop;
+    int m_written;
+    int m_failed;
+};
+
+#endif /* BURST_WRITER_H */
@@ -0,0 +1,178 @@
+/*
+ *  Flat field statistics
+ *  Per pixel mean and variance of a series of frames with outlier
+ *  rejection, for seek_create_flat_field. Plain 16-bit buffers, no OpenCV.
+ */
+
+#ifndef FLAT_FIELD_H
+#define FLAT_FIELD_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ *  Streaming per pixel mean and variance (Welford), updated in a single
+ *  pass per frame. Once a pixel has min_samples, samples further than
+ *  reject sigma from its running mean (e.g. a hand passing in front of
+ *  the lens) are left out. Fixed point builds keep the mean and the sum
+ *  of squared differences in Q16 integers.
+ */
+class FlatFieldStatistics
+{
+public:
+    FlatFieldStatistics(int width, int height, double reject) :
+        m_width(width),
+        m_height(height),
+        m_pixels(width * height),
+#ifdef SEEK_FIXED_POINT
+        m_reject_q8(static_cast<int64_t>(reject * reject * 256 + 0.5)),
+#else
+        m_reject2(static_cast<float>(reject * reject)),
+#endif
+        m_samples(0),
+        m_rejected(0)
+    { }
+
+    /* step: distance between rows in bytes */
+    void add(const uint16_t* frame, size_t step)
+    {
+        int x, y;
+        uint64_t rejected = 0;
+
+        for (y = 0; y < m_height; y++) {
+            const uint16_t* src = reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(frame) + y * step);
+            Pixel* p = &m_pixels[y * m_width];
+
+            for (x = 0; x < m_width; x++, p++) {
+#ifdef SEEK_FIXED_POINT
+                const int64_t value = static_cast<int64_t>(src[x]) << 16;
+
+                if (m_reject_q8 > 0 && p->n >= min_samples) {
+                    const int64_t d = (value - p->mean) / 256;
+                    const int64_t variance = std::max<int64_t>(p->m2 / (p->n - 1), variance_floor << 16);
+                    if (d * d > variance / 256 * m_reject_q8) {
+                        rejected++;
+                        continue;
+                    }
+                }
+
+                p->n++;
+                const int64_t delta = value - p->mean;
+                p->mean += delta / p->n;
+                p->m2 += (delta / 256) * ((value - p->mean) / 256);
+#else
+                const float value = src[x];
+
+                if (m_reject2 > 0 && p->n >= min_samples) {
+                    const float d = value - p->mean;
+                    const float variance = std::max(p->m2 / (p->n - 1), static_cast<float>(variance_floor));
+                    if (d * d > m_reject2 * variance) {
+                        rejected++;
+                        continue;
+                    }
+                }
+
+                p->n++;
+                const float delta = value - p->mean;
+                p->mean += delta / p->n;
+                p->m2 += delta * (value - p->mean);
+#endif
+            }
+        }
+
+        m_samples += static_cast<uint64_t>(m_width) * m_height;
+        m_rejected += rejected;
+    }
+
+    /* rounded, step in bytes */
+    void mean(uint16_t* dst, size_t step) const
+    {
+        int x, y;
+
+        for (y = 0; y < m_height; y++) {
+            uint16_t* out = reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(dst) + y * step);
+            const Pixel* p = &m_pixels[y * m_width];
+
+            for (x = 0; x < m_width; x++, p++) {
+#ifdef SEEK_FIXED_POINT
+                out[x] = saturate((p->mean + 0x8000) >> 16);
+#else
+                out[x] = saturate(static_cast<int64_t>(p->mean + 0.5f));
+#endif
+            }
+        }
+    }
+
+    /* sample variance in counts^2, rounded and saturated, step in bytes */
+    void variance(uint16_t* dst, size_t step) const
+    {
+        int x, y;
+
+        for (y = 0; y < m_height; y++) {
+            uint16_t* out = reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(dst) + y * step);
+            const Pixel* p = &m_pixels[y * m_width];
+
+            for (x = 0; x < m_width; x++, p++) {
+                if (p->n < 2) {
+                    out[x] = 0;
+                    continue;
+                }
+#ifdef SEEK_FIXED_POINT
+                out[x] = saturate((p->m2 / (p->n - 1) + 0x8000) >> 16);
+#else
+                out[x] = saturate(static_cast<int64_t>(p->m2 / (p->n - 1) + 0.5f));
+#endif
+            }
+        }
+    }
+
+    uint64_t samples() const
+    {
+        return m_samples;
+    }
+
+    uint64_t rejected() const
+    {
+        return m_rejected;
+    }
+
+private:
+    /* samples a pixel needs before outliers are rejected */
+    static const uint32_t min_samples = 10;
+
+    /* noise floor in counts^2, keeps a very quiet pixel from rejecting everything */
+    static const int variance_floor = 4;
+
+    struct Pixel {
+#ifdef SEEK_FIXED_POINT
+        int64_t mean;           /* Q16 */
+        int64_t m2;             /* Q16 sum of squared differences from the mean */
+#else
+        float mean;
+        float m2;
+#endif
+        uint32_t n;             /* accepted samples */
+
+        Pixel() : mean(0), m2(0), n(0) { }
+    };
+
+    static uint16_t saturate(int64_t v)
+    {
+        return static_cast<uint16_t>(std::min<int64_t>(std::max<int64_t>(v, 0), 0xffff));
+    }
+
+    const int m_width;
+    const int m_height;
+    std::vector<Pixel> m_pixels;
+#ifdef SEEK_FIXED_POINT
+    const int64_t m_reject_q8;  /* reject^2 in Q8 */
+#else
+    const float m_reject2;
+#endif
+    uint64_t m_samples;
+    uint64_t m_rejected;
+};
+
+#endif /* FLAT_FIELD_H */
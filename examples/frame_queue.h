@@ -0,0 +1,123 @@
+/*
+ *  Lossless frame queue
+ *
+ *  Hands values from one producer thread to one consumer thread in order
+ *  through a fixed number of preallocated slots. Unlike the triple buffer
+ *  nothing is ever replaced: the producer waits for a free slot when the
+ *  consumer is behind, so every value published is consumed.
+ */
+
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+template<typename T>
+class FrameQueue
+{
+public:
+    FrameQueue(int size) :
+        m_slots(size),
+        m_head(0),
+        m_count(0)
+    { }
+
+    int size() const
+    {
+        return static_cast<int>(m_slots.size());
+    }
+
+    /*
+     *  Slot i (0..size()-1), to size the values before the threads start
+     */
+    T& slot(int i)
+    {
+        return m_slots[i];
+    }
+
+    /*
+     *  Producer: wait up to timeout for a free slot
+     *  Returns true when back() may be filled
+     */
+    bool reserve(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_count == m_slots.size())
+            m_wake.wait_for(lock, timeout);
+
+        return m_count < m_slots.size();
+    }
+
+    /*
+     *  Producer: the free slot to fill after reserve(), valid until publish()
+     */
+    T& back()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_slots[(m_head + m_count) % m_slots.size()];
+    }
+
+    /*
+     *  Producer: queue the back value
+     */
+    void publish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_count++;
+        }
+        m_wake.notify_all();
+    }
+
+    /*
+     *  Consumer: wait up to timeout for a queued value
+     *  Returns true when front() holds one
+     */
+    bool wait(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_count == 0)
+            m_wake.wait_for(lock, timeout);
+
+        return m_count > 0;
+    }
+
+    /*
+     *  Consumer: the oldest queued value, valid until release()
+     */
+    T& front()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_slots[m_head];
+    }
+
+    /*
+     *  Consumer: give the front slot back to the producer
+     */
+    void release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_head = (m_head + 1) % m_slots.size();
+            m_count--;
+        }
+        m_wake.notify_all();
+    }
+
+private:
+    FrameQueue(const FrameQueue&);
+    FrameQueue& operator=(const FrameQueue&);
+
+    std::vector<T> m_slots;
+
+    /* guards everything below */
+    std::mutex m_mutex;
+    std::condition_variable m_wake;     /* a slot was queued or released */
+    size_t m_head;
+    size_t m_count;
+};
+
+#endif /* FRAME_QUEUE_H */
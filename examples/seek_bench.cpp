@@ -0,0 +1,277 @@
+/*
+ *  Pipeline benchmark
+ *  Times every per frame stage, from the processing of a fetched frame up
+ *  to the encoders, on stored raw frames replayed through the camera
+ *  classes without usb. Uses the frames of seek_record recordings when
+ *  given, otherwise deterministic synthetic frames of both camera models,
+ *  so runs compare between machines and commits.
+ *
+ *  Usage: seek_bench [--json] [-o results.json] [recording.skr ...]
+ *         seek_bench --baseline results.json --threshold 10
+ *  Exits with 2 when a stage got slower than the baseline by more than
+ *  the threshold, with 1 when a consistency check failed.
+ */
+#include <opencv2/highgui/highgui.hpp>
+#include "seek.h"
+#include "SeekRecording.h"
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "args.h"
+#include "bench.h"
+
+using namespace LibSeek;
+using namespace bench;
+
+/* gives the benchmark access to the dead pixel list of a camera */
+template<class Cam>
+class BenchCam: public Cam
+{
+public:
+    const std::vector<PixelPos>& dead_pixels() const
+    {
+        return this->m_dead_pixel_list;
+    }
+};
+
+static bool load_recording(const std::string& filename, int& product_id, FrameList& frames)
+{
+    SeekRecordingReader reader;
+    FrameMeta meta;
+
+    if (!reader.open(filename))
+        return false;
+
+    product_id = reader.product_id();
+    frames.assign(std::min<size_t>(reader.frames(), 256),
+                  std::vector<uint16_t>(reader.raw_width() * reader.raw_height()));
+
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (!reader.decode(i, frames[i].data(), &meta))
+            return false;
+        if (i == 0 && meta.frame_id != FrameType::FIRST) {
+            std::cerr << filename << " doesn't start with the first frame of the camera" << std::endl;
+            return false;
+        }
+    }
+
+    return frames.size() > 2;
+}
+
+template<class Cam>
+static bool bench_model(const std::string& model, const FrameList& raw_frames, double min_ms,
+                        std::vector<StageResult>& results, int& grey_max_diff)
+{
+    size_t i;
+    int x, y;
+    BenchCam<Cam> cam;
+    LoopSource source(raw_frames);
+    FrameList corrected;
+    std::vector<RecordFrameHeader> headers(1);
+    std::vector<uint8_t> encoded;
+    std::vector<int32_t> scratch;
+
+    cam.setRawFrameSource(&source);
+    if (!cam.open()) {
+        std::cerr << model << ": frames rejected by the camera" << std::endl;
+        return false;
+    }
+
+    const int w = cam.width(), h = cam.height();
+    const double raw_bytes = raw_frames[0].size() * sizeof(uint16_t);
+    const double frame_bytes = w * h * sizeof(uint16_t);
+    const int factor = 3;
+    cv::Mat frame(h, w, CV_16UC1), grey(h, w, CV_8UC1), reference(h, w, CV_8UC1);
+    cv::Mat palette(1, 256, CV_8UC3), scaled(h * factor, w * factor, CV_8UC3);
+
+    for (i = 0; i < 256; i++) {
+        palette.ptr<uint8_t>(0)[3 * i] = i;
+        palette.ptr<uint8_t>(0)[3 * i + 1] = 255 - i;
+        palette.ptr<uint8_t>(0)[3 * i + 2] = i / 2;
+    }
+
+    /* corrected image frames once, input of the later stages */
+    for (i = 1; i < raw_frames.size(); i++) {
+        if (!cam.grab() || !cam.retrieveInto(frame)) {
+            std::cerr << model << ": no flat field calibration, the frames need a shutter frame" << std::endl;
+            return false;
+        }
+        corrected.push_back(std::vector<uint16_t>(frame.ptr<uint16_t>(0), frame.ptr<uint16_t>(0) + w * h));
+    }
+    const size_t n = corrected.size();
+    const double dead = cam.dead_pixels().size();
+
+    auto input = [&](size_t call) {
+        return corrected[call % n].data();
+    };
+    auto load = [&](size_t call) {
+        std::copy(corrected[call % n].begin(), corrected[call % n].end(), frame.ptr<uint16_t>(0));
+    };
+    auto add = [&](const char* stage, double bytes, double ns) {
+        StageResult result = { model, stage, ns, bytes };
+        results.push_back(result);
+    };
+
+    /* grab() with the usb transfer replaced by a copy: header parsing, shutter handling */
+    add("fetch", 2 * raw_bytes, ns_per_call(min_ms, [&](size_t) { cam.grab(); }));
+
+    add("ffc", 3 * frame_bytes, ns_per_call(min_ms, [&](size_t) {
+        cam.retrieveInto(frame, ProcessingLevel::OFFSET_CORRECTED);
+    }));
+
+    cam.retrieveInto(frame, ProcessingLevel::OFFSET_CORRECTED);
+    add("dead_pixel", 5 * dead * sizeof(uint16_t), ns_per_call(min_ms, [&](size_t) {
+        dead_pixel_filter(frame.ptr<uint16_t>(0), w, w, h, cam.dead_pixels().data(), cam.dead_pixels().size());
+    }));
+
+    add("retrieve", 3 * frame_bytes, ns_per_call(min_ms, [&](size_t) {
+        cam.retrieveInto(frame, ProcessingLevel::FULLY_CORRECTED);
+    }));
+
+    /* histogram pass and mapping pass */
+    add("grey_scale", 2 * frame_bytes + w * h, ns_per_call(min_ms, [&](size_t call) {
+        cv::Mat src(h, w, CV_16UC1, input(call));
+        cam.convertToGreyScale(src, grey);
+    }));
+    add("grey_scale_reference", 2 * frame_bytes + w * h, ns_per_call(min_ms, [&](size_t call) {
+        grey_scale_reference(input(call), w, reference.ptr<uint8_t>(0), reference.step, w, h);
+    }));
+    add("grey_scale_fixed", 2 * frame_bytes + w * h, ns_per_call(min_ms, [&](size_t call) {
+        grey_scale_fixed(input(call), w, grey.ptr<uint8_t>(0), grey.step, w, h);
+    }));
+
+    /* the integer implementation has to stay within 1 grey level of the reference */
+    for (i = 0; i < n; i++) {
+        grey_scale_reference(input(i), w, reference.ptr<uint8_t>(0), reference.step, w, h);
+        grey_scale_fixed(input(i), w, grey.ptr<uint8_t>(0), grey.step, w, h);
+        for (y=0; y<h; y++)
+            for (x=0; x<w; x++)
+                grey_max_diff = std::max(grey_max_diff, std::abs(grey.at<uint8_t>(y, x) - reference.at<uint8_t>(y, x)));
+    }
+
+    /* seek_viewer process_frame with 3x bilinear upscaling: copy of the frame, normalize, 8-bit, upscale + colorize */
+    const double viewer_bytes = 6 * frame_bytes + 2 * w * h + scaled.total() * 3;
+    add("viewer_frame", viewer_bytes, ns_per_call(min_ms, [&](size_t call) {
+        uint16_t min, max;
+        load(call);
+        min_max(frame.ptr<uint16_t>(0), w, w, h, &min, &max);
+        normalize_fixed(frame.ptr<uint16_t>(0), w, w, h, min, max);
+        convert_to_8bit(frame.ptr<uint16_t>(0), w, grey.ptr<uint8_t>(0), grey.step, w, h);
+        scratch.resize(2 * w * factor);
+        upscale_bilinear_colorize(grey.ptr<uint8_t>(0), grey.step, w, h, palette.ptr<uint8_t>(0), factor,
+                                  scaled.ptr<uint8_t>(0), scaled.step, scratch.data());
+    }));
+
+    std::vector<uint8_t> png;
+    add("encode_png16", frame_bytes, ns_per_call(min_ms, [&](size_t call) {
+        cv::imencode(".png", cv::Mat(h, w, CV_16UC1, input(call)), png);
+    }));
+
+    add("encode_skr", raw_bytes, ns_per_call(min_ms, [&](size_t call) {
+        const std::vector<uint16_t>& raw = raw_frames[1 + call % (raw_frames.size() - 1)];
+        const int raw_width = cam.raw_width();
+        encode_record_frame(raw.data(), raw_width, raw.size() / raw_width, headers[0], encoded);
+    }));
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    size_t i;
+    std::vector<StageResult> results;
+    int grey_max_diff = 0;
+    std::string source = "synthetic";
+
+    args::ArgumentParser parser("Benchmark the frame processing pipeline on stored raw frames");
+    args::HelpFlag help(parser, "help", "Display this help menu", { 'h', "help" });
+    args::Flag _json(parser, "json", "Print the results as JSON", { "json" });
+    args::ValueFlag<std::string> _output(parser, "outfile", "Write the JSON results to a file", { 'o', "outfile" });
+    args::ValueFlag<std::string> _baseline(parser, "baseline", "JSON results of a previous run to compare with", { 'b', "baseline" });
+    args::ValueFlag<double> _threshold(parser, "threshold", "Allowed slowdown against the baseline in percent - default 10", { "threshold" });
+    args::ValueFlag<double> _time(parser, "time", "Measuring time per stage in ms - default 300", { "time" });
+    args::PositionalList<std::string> _recordings(parser, "recordings", "seek_record recordings, synthetic frames of both models when omitted");
+
+    try {
+        parser.ParseCLI(argc, argv);
+    }
+    catch (args::Help) {
+        std::cout << parser;
+        return 0;
+    }
+    catch (args::ParseError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (args::ValidationError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    const double min_ms = _time ? args::get(_time) : 300;
+    const double threshold = _threshold ? args::get(_threshold) : 10;
+
+    if (_recordings) {
+        const std::vector<std::string>& files = args::get(_recordings);
+        source.clear();
+
+        for (i = 0; i < files.size(); i++) {
+            FrameList frames;
+            int product_id;
+            bool ok = false;
+
+            if (!load_recording(files[i], product_id, frames)) {
+                std::cerr << "Error: no usable frames in " << files[i] << std::endl;
+                return -1;
+            }
+
+            const CameraType::Enum type = SeekCamFactory::fromProductId(product_id);
+            if (type == CameraType::SEEK_THERMAL)
+                ok = bench_model<SeekThermal>("seek", frames, min_ms, results, grey_max_diff);
+            else if (type == CameraType::SEEK_THERMAL_PRO)
+                ok = bench_model<SeekThermalPro>("seekpro", frames, min_ms, results, grey_max_diff);
+            if (!ok)
+                return -1;
+
+            source += (i ? " " : "") + files[i];
+        }
+    } else {
+        if (!bench_model<SeekThermal>("seek", synthetic_frames<SeekThermalTraits>(64),
+                                      min_ms, results, grey_max_diff) ||
+                !bench_model<SeekThermalPro>("seekpro", synthetic_frames<SeekThermalProTraits>(64),
+                                             min_ms, results, grey_max_diff))
+            return -1;
+    }
+
+    const std::string json = json_results("seek_bench", results,
+            "\"source\": \"" + source + "\",\n"
+            "  \"checks\": { \"grey_scale_fixed_max_diff\": " + std::to_string(grey_max_diff) + " },\n");
+    if (_json) {
+        std::cout << json;
+    } else {
+        print_results(results);
+        printf("grey_scale_fixed max difference with the reference: %d\n", grey_max_diff);
+    }
+
+    if (_output) {
+        std::ofstream out(args::get(_output).c_str());
+        out << json;
+        if (!out) {
+            std::cerr << "Error: can't write " << args::get(_output) << std::endl;
+            return -1;
+        }
+    }
+
+    if (grey_max_diff > 1) {
+        std::cerr << "Error: grey_scale_fixed differs from the reference by " << grey_max_diff << " levels" << std::endl;
+        return 1;
+    }
+
+    if (_baseline && compare_baseline(results, args::get(_baseline), threshold) > 0)
+        return 2;
+
+    return 0;
+}
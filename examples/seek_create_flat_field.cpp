@@ -5,22 +5,37 @@
 #include <opencv2/highgui/highgui.hpp>
 #include "seek.h"
 #include <iostream>
+#include <chrono>
+#include <vector>
 #include "args.h"
+#include "flat_field.h"
+
+/* flat_field.png -> flat_field_variance.png */
+static std::string variance_filename(const std::string& outfile)
+{
+    const size_t dot = outfile.find_last_of('.');
+    const size_t slash = outfile.find_last_of("/\\");
+
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return outfile + "_variance.png";
+
+    return outfile.substr(0, dot) + "_variance" + outfile.substr(dot);
+}
 
 int main(int argc, char** argv)
 {
     int i;
-    cv::Mat frame_u16, frame, avg_frame;
-    LibSeek::SeekThermalPro seekpro;
-    LibSeek::SeekThermal seek;
-    LibSeek::SeekCam* cam;
+    cv::Mat frame_u16;
+    std::unique_ptr<LibSeek::SeekCam> cam;
 
     args::ArgumentParser parser("Create Flat Frame");
     args::HelpFlag help(parser, "help", "Display this help menu", { 'h', "help" });
     args::ValueFlag<std::string> _output(parser, "outfile", "Name of the file to write to - default flat_field.png", { 'o', "outfile" });
+    args::ValueFlag<std::string> _variance(parser, "variance", "Name of the per pixel variance map to write - default <outfile>_variance.png", { 'v', "variance" });
     args::ValueFlag<int> _smoothing(parser, "smoothing", "Smoothing factor, number of frames to collect and average - default 100", { 's', "smoothing" });
-    args::ValueFlag<std::string> _camtype(parser, "camtype", "Seek Thermal Camera Model - seek or seekpro", { 't', "camtype" });
+    args::ValueFlag<std::string> _camtype(parser, "camtype", "Seek Thermal Camera Model - seek or seekpro, detected when omitted", { 't', "camtype" });
     args::ValueFlag<int> _warmup(parser, "warmup", "Warmup, number of frames to discard before sampling - default 10", { 'w', "warmup" });
+    args::ValueFlag<double> _reject(parser, "reject", "Leave out samples further than this many standard deviations from a pixel's mean - default 3, 0 keeps all", { 'r', "reject" });
 
     // Parse arguments
     try {
@@ -41,7 +56,7 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    // Defaults 
+    // Defaults
     int smoothing = 100;
     if (_smoothing)
         smoothing = args::get(_smoothing);
@@ -54,35 +69,50 @@ int main(int argc, char** argv)
     if (_output)
         outfile = args::get(_output);
 
-    std::string camtype = "seek";
+    std::string variance_file = variance_filename(outfile);
+    if (_variance)
+        variance_file = args::get(_variance);
+
+    double reject = 3.0;
+    if (_reject)
+        reject = args::get(_reject);
+
+    std::string camtype = "";
     if (_camtype)
         camtype = args::get(_camtype);
 
-    // Init correct cam type
-    if (camtype == "seekpro") {
-        cam = &seekpro;
+    if (smoothing < 1 || reject < 0) {
+        std::cerr << "smoothing must be at least 1 and reject not negative" << std::endl;
+        return 1;
     }
-    else {
-        cam = &seek;
+
+    // Init correct cam type
+    LibSeek::CameraType::Enum type = LibSeek::SeekCamFactory::fromName(camtype);
+    if (type == LibSeek::CameraType::UNKNOWN) {
+        std::cerr << "unknown camtype " << camtype << std::endl;
+        return 1;
     }
 
-    if (!cam->open()) {
-        std::cout << "failed to open " << camtype << " cam" << std::endl;
+    cam = LibSeek::SeekCamFactory::create(type);
+    if (!cam || !cam->open()) {
+        std::cout << "failed to open seek cam" << std::endl;
         return -1;
     }
 
+    // Discarded frames only need to be fetched
     for (i = 0; i < warmup; i++) {
         if (!cam->grab()) {
             std::cout << "no more LWIR img" << std::endl;
             return -1;
         }
-        cam->retrieve(frame_u16);
-        cv::waitKey(10);
     }
 
     std::cout << "warmup complete" << std::endl;
 
-    // Aquire frames
+    // Aquire frames at the camera rate
+    FlatFieldStatistics statistics(cam->width(), cam->height(), reject);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
     for (i = 0; i < smoothing; i++) {
         if (!cam->grab()) {
             std::cout << "no more LWIR img" << std::endl;
@@ -90,20 +120,26 @@ int main(int argc, char** argv)
         }
 
         cam->retrieve(frame_u16);
-        frame_u16.convertTo(frame, CV_32FC1);
+        statistics.add(frame_u16.ptr<uint16_t>(0), frame_u16.step);
+    }
 
-        if (avg_frame.rows == 0) {
-            frame.copyTo(avg_frame);
-        } else {
-            avg_frame += frame;
-        }
-        cv::waitKey(10);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << smoothing << " frames in " << seconds << " s (" << smoothing / seconds << " fps), "
+              << 100.0 * statistics.rejected() / statistics.samples() << " % of the samples rejected" << std::endl;
+
+    frame_u16.create(cam->height(), cam->width(), CV_16UC1);
+    statistics.mean(frame_u16.ptr<uint16_t>(0), frame_u16.step);
+    if (!cv::imwrite(outfile, frame_u16)) {
+        std::cerr << "failed to write " << outfile << std::endl;
+        return -1;
     }
 
-    // Average the collected frames
-    avg_frame /= smoothing;
-    avg_frame.convertTo(frame_u16, CV_16UC1);
+    statistics.variance(frame_u16.ptr<uint16_t>(0), frame_u16.step);
+    if (!cv::imwrite(variance_file, frame_u16)) {
+        std::cerr << "failed to write " << variance_file << std::endl;
+        return -1;
+    }
 
-    cv::imwrite(outfile, frame_u16);
+    std::cout << "wrote " << outfile << " and " << variance_file << std::endl;
     return 0;
 }
@@ -0,0 +1,243 @@
+/*
+ *  Dead pixel benchmark
+ *  Cost of building the dead pixel list and of filtering a frame as a
+ *  function of the number of dead pixels and how they cluster: isolated
+ *  pixels, line segments (column / row defects) and round blobs. Uses
+ *  synthetic first frames of both sensor geometries, replayed without usb.
+ *
+ *  Usage: seek_dead_pixel_bench [--json] [-o results.json]
+ *         seek_dead_pixel_bench --baseline results.json --threshold 10
+ *  Exits with 2 when a case got slower than the baseline by more than the
+ *  threshold, with 1 when dead pixels were missed.
+ */
+#include "seek_core.h"
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "args.h"
+#include "bench.h"
+
+using namespace LibSeek;
+using namespace bench;
+
+struct Pattern {
+    enum Enum {
+        ISOLATED,
+        LINES,      /* 16 pixel segments, mostly vertical */
+        BLOBS,      /* discs of radius 3 */
+    };
+};
+
+static const char* pattern_names[] = { "isolated", "lines", "blobs" };
+static const double densities[] = { 0.0001, 0.001, 0.005, 0.01, 0.02, 0.05 };
+
+/* re-runs the dead pixel detection on a given first frame */
+template<class Cam>
+class DeadPixelCam: public Cam
+{
+public:
+    void build(const std::vector<uint16_t>& first)
+    {
+        std::copy(first.begin(), first.end(), this->m_raw_data);
+        this->create_dead_pixel_list();
+    }
+
+    const std::vector<PixelPos>& dead_pixels() const
+    {
+        return this->m_dead_pixel_list;
+    }
+};
+
+static uint32_t next_random(uint32_t& state)
+{
+    state = state * 1664525 + 1013904223;
+    return state >> 8;
+}
+
+/*
+ *  Dead pixel map of the image part, 1 for dead pixels, covering about
+ *  density of the image. Deterministic for a given size and pattern
+ */
+static std::vector<uint8_t> dead_map(int width, int height, Pattern::Enum pattern, double density)
+{
+    int dx, dy;
+    uint32_t state = 12345;
+    size_t count = 0;
+    const size_t target = std::max<size_t>(1, static_cast<size_t>(density * width * height));
+    std::vector<uint8_t> map(width * height, 0);
+
+    auto mark = [&](int x, int y) {
+        if (x >= 0 && x < width && y >= 0 && y < height && !map[y * width + x]) {
+            map[y * width + x] = 1;
+            count++;
+        }
+    };
+
+    while (count < target) {
+        const int x = next_random(state) % width;
+        const int y = next_random(state) % height;
+
+        if (pattern == Pattern::ISOLATED) {
+            mark(x, y);
+        } else if (pattern == Pattern::LINES) {
+            const bool vertical = next_random(state) % 4 != 0;
+            for (int i = 0; i < 16 && count < target; i++)
+                mark(vertical ? x : x + i, vertical ? y + i : y);
+        } else {
+            for (dy = -3; dy <= 3; dy++)
+                for (dx = -3; dx <= 3; dx++)
+                    if (dx * dx + dy * dy <= 9 && count < target)
+                        mark(x + dx, y + dy);
+        }
+    }
+
+    return map;
+}
+
+/*
+ *  First, shutter and image frame with the dead pixels of map
+ */
+template<class Traits>
+static FrameList dead_pixel_frames(const std::vector<uint8_t>& map)
+{
+    int n, x, y;
+    FrameList frames(3, std::vector<uint16_t>(Traits::raw_width * Traits::raw_height, 8000));
+    const int ids[] = { FrameType::FIRST, FrameType::SHUTTER, FrameType::IMAGE };
+
+    for (n=0; n<3; n++) {
+        uint16_t* raw = frames[n].data();
+
+        for (y=0; y<Traits::height; y++) {
+            for (x=0; x<Traits::width; x++) {
+                uint16_t& value = raw[(y + Traits::roi_y) * Traits::raw_width + x + Traits::roi_x];
+
+                if (map[y * Traits::width + x])
+                    value = 40;
+                else if (n == 0)
+                    value = 8000 + ((x * 7 + y * 13) % 16 == 0 ? (x + y) % 64 : (x + y) % 4);
+                else
+                    value = 8000 + (x * 3 + y * 5) % (n == 1 ? 64 : 900);
+            }
+        }
+        raw[Traits::frame_id_word] = ids[n];
+        raw[Traits::frame_counter_word] = n;
+    }
+
+    return frames;
+}
+
+template<class Cam, class Traits>
+static bool bench_model(const std::string& model, double min_ms, std::vector<StageResult>& results)
+{
+    int p;
+    size_t d;
+    bool complete = true;
+
+    for (p=0; p<3; p++) {
+        for (d=0; d<sizeof(densities) / sizeof(densities[0]); d++) {
+            const std::vector<uint8_t> map = dead_map(Traits::width, Traits::height,
+                                                      static_cast<Pattern::Enum>(p), densities[d]);
+            const FrameList frames = dead_pixel_frames<Traits>(map);
+            LoopSource source(frames);
+            DeadPixelCam<Cam> cam;
+            std::vector<uint16_t> frame(Traits::width * Traits::height);
+
+            cam.setRawFrameSource(&source);
+            if (!cam.open() || !cam.retrieveInto(frame.data(), Traits::width * sizeof(uint16_t),
+                                                 ProcessingLevel::OFFSET_CORRECTED)) {
+                std::cerr << model << ": frames rejected by the camera" << std::endl;
+                return false;
+            }
+
+            const size_t dead = std::count(map.begin(), map.end(), 1);
+            if (cam.dead_pixels().size() != dead) {
+                std::cerr << model << " " << pattern_names[p] << " " << densities[d] * 100 << "%: "
+                          << cam.dead_pixels().size() << " of " << dead << " dead pixels listed" << std::endl;
+                complete = false;
+            }
+
+            char name[64];
+            const double frame_bytes = Traits::width * Traits::height * sizeof(uint16_t);
+
+            /* histogram and mask passes, then a pass over the image per layer of a cluster */
+            snprintf(name, sizeof(name), "build_%s_%g%%", pattern_names[p], densities[d] * 100);
+            const double build_ns = ns_per_call(min_ms, [&](size_t) { cam.build(frames[0]); });
+            StageResult build = { model, name, build_ns, 3 * frame_bytes };
+            results.push_back(build);
+
+            /* 4 neighbors read and the pixel written for every dead pixel */
+            snprintf(name, sizeof(name), "filter_%s_%g%%", pattern_names[p], densities[d] * 100);
+            const double filter_ns = ns_per_call(min_ms, [&](size_t) {
+                dead_pixel_filter(frame.data(), Traits::width, Traits::width, Traits::height,
+                                  cam.dead_pixels().data(), cam.dead_pixels().size());
+            });
+            StageResult filter = { model, name, filter_ns, 5.0 * dead * sizeof(uint16_t) };
+            results.push_back(filter);
+        }
+    }
+
+    return complete;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<StageResult> results;
+
+    args::ArgumentParser parser("Benchmark dead pixel list building and filtering against defect density");
+    args::HelpFlag help(parser, "help", "Display this help menu", { 'h', "help" });
+    args::Flag _json(parser, "json", "Print the results as JSON", { "json" });
+    args::ValueFlag<std::string> _output(parser, "outfile", "Write the JSON results to a file", { 'o', "outfile" });
+    args::ValueFlag<std::string> _baseline(parser, "baseline", "JSON results of a previous run to compare with", { 'b', "baseline" });
+    args::ValueFlag<double> _threshold(parser, "threshold", "Allowed slowdown against the baseline in percent - default 10", { "threshold" });
+    args::ValueFlag<double> _time(parser, "time", "Measuring time per case in ms - default 150", { "time" });
+
+    try {
+        parser.ParseCLI(argc, argv);
+    }
+    catch (const args::Help&) {
+        std::cout << parser;
+        return 0;
+    }
+    catch (const args::ParseError& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (const args::ValidationError& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    const double min_ms = _time ? args::get(_time) : 150;
+    const double threshold = _threshold ? args::get(_threshold) : 10;
+
+    const bool complete = bench_model<SeekThermalCore, SeekThermalTraits>("seek", min_ms, results) &
+                          bench_model<SeekThermalProCore, SeekThermalProTraits>("seekpro", min_ms, results);
+    if (results.empty())
+        return -1;
+
+    const std::string json = json_results("seek_dead_pixel_bench", results);
+    if (_json)
+        std::cout << json;
+    else
+        print_results(results);
+
+    if (_output) {
+        std::ofstream out(args::get(_output).c_str());
+        out << json;
+        if (!out) {
+            std::cerr << "Error: can't write " << args::get(_output) << std::endl;
+            return -1;
+        }
+    }
+
+    if (!complete)
+        return 1;
+
+    if (_baseline && compare_baseline(results, args::get(_baseline), threshold) > 0)
+        return 2;
+
+    return 0;
+}
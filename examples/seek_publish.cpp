@@ -0,0 +1,153 @@
+/*
+ *  Frame publisher
+ *  Owns the camera and publishes every frame into a shared memory frame
+ *  ring (read it with seek_subscribe) and/or to network clients (read
+ *  them with seek_stream_client)
+ */
+#include "seek.h"
+#include "SeekFrameRing.h"
+#include "SeekMetricsServer.h"
+#include "SeekStream.h"
+#include "SeekTrace.h"
+#include <iostream>
+#include <signal.h>
+#include "args.h"
+
+static volatile sig_atomic_t sigflag = 0;
+
+static void handle_sig(int sig)
+{
+    (void)sig;
+    sigflag = 1;
+}
+
+int main(int argc, char** argv)
+{
+    std::unique_ptr<LibSeek::SeekCam> cam;
+    LibSeek::SeekFrameRingWriter ring;
+    LibSeek::SeekStreamServer server;
+
+    args::ArgumentParser parser("Publish frames into a shared memory frame ring and/or over the network");
+    args::HelpFlag help(parser, "help", "Display this help menu", { 'h', "help" });
+    args::ValueFlag<std::string> _name(parser, "name", "Shared memory object name - default /seek, no ring when only network ports are given", { 'n', "name" });
+    args::ValueFlag<int> _tcp(parser, "tcp", "Stream to tcp clients connecting to this port", { "tcp" });
+    args::ValueFlag<int> _udp(parser, "udp", "Stream to udp subscribers of this port", { "udp" });
+    args::ValueFlag<std::string> _address(parser, "address", "Address to serve streams and metrics on - default 127.0.0.1, 0.0.0.0 for all interfaces", { 'a', "address" });
+    args::ValueFlag<std::string> _level(parser, "level", "Processing level - raw, offset or full (default)", { 'l', "level" });
+    args::ValueFlag<int> _slots(parser, "slots", "Number of frames kept in the ring - default 8", { 's', "slots" });
+    args::ValueFlag<std::string> _camtype(parser, "camtype", "Seek Thermal Camera Model - seek or seekpro, detected when omitted", { 't', "camtype" });
+    args::ValueFlag<std::string> _ffc(parser, "FFC", "Additional Flat Field calibration - provide ffc file", { 'F', "FFC" });
+    args::ValueFlag<std::string> _trace(parser, "trace", "Record the pipeline stages, written as Chrome trace JSON on exit (needs WITH_TRACING)", { "trace" });
+    args::ValueFlag<int> _metrics(parser, "metrics", "Serve Prometheus metrics at http://<address>:<port>/metrics", { "metrics" });
+
+    try {
+        parser.ParseCLI(argc, argv);
+    }
+    catch (args::Help) {
+        std::cout << parser;
+        return 0;
+    }
+    catch (args::ParseError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (args::ValidationError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    std::string name = "";
+    if (_name || (!_tcp && !_udp))
+        name = _name ? args::get(_name) : "/seek";
+
+    int tcp_port = -1;
+    if (_tcp)
+        tcp_port = args::get(_tcp);
+
+    int udp_port = -1;
+    if (_udp)
+        udp_port = args::get(_udp);
+
+    std::string address = "127.0.0.1";
+    if (_address)
+        address = args::get(_address);
+
+    LibSeek::ProcessingLevel::Enum level = LibSeek::ProcessingLevel::FULLY_CORRECTED;
+    if (_level) {
+        const std::string l = args::get(_level);
+        if (l == "raw")
+            level = LibSeek::ProcessingLevel::RAW;
+        else if (l == "offset")
+            level = LibSeek::ProcessingLevel::OFFSET_CORRECTED;
+        else if (l != "full") {
+            std::cerr << "unknown level " << l << std::endl;
+            return 1;
+        }
+    }
+
+    int slots = 8;
+    if (_slots)
+        slots = args::get(_slots);
+
+    std::string camtype = "";
+    if (_camtype)
+        camtype = args::get(_camtype);
+
+    std::string ffc = "";
+    if (_ffc)
+        ffc = args::get(_ffc);
+
+    LibSeek::CameraType::Enum type = LibSeek::SeekCamFactory::fromName(camtype);
+    if (type == LibSeek::CameraType::UNKNOWN) {
+        std::cerr << "unknown camtype " << camtype << std::endl;
+        return 1;
+    }
+
+    cam = LibSeek::SeekCamFactory::create(type, ffc);
+    if (!cam || !cam->open()) {
+        std::cout << "failed to open seek cam" << std::endl;
+        return -1;
+    }
+
+    if (!name.empty() && !ring.create(name, cam->width(), cam->height(), slots)) {
+        std::cout << "failed to create frame ring " << name << std::endl;
+        return -1;
+    }
+
+    if ((tcp_port >= 0 || udp_port >= 0) && !server.start(tcp_port, udp_port, cam->width(), cam->height(), 8, address)) {
+        std::cout << "failed to start stream server" << std::endl;
+        return -1;
+    }
+
+    LibSeek::SeekMetricsServer metrics;
+    if (_metrics && !metrics.start(args::get(_metrics), address)) {
+        std::cout << "failed to start metrics server" << std::endl;
+        return -1;
+    }
+
+    if (_trace && !LibSeek::trace_start())
+        return 1;
+    LibSeek::trace_thread_name("capture");
+
+    // Stop cleanly so the shared memory object is removed
+    signal(SIGINT, handle_sig);
+    signal(SIGTERM, handle_sig);
+
+    std::cout << "publishing " << cam->width() << "x" << cam->height() << " frames" << std::endl;
+
+    while (!sigflag) {
+        if (!cam->grab() ||
+                (ring.isOpened() && !ring.publish(*cam, level)) ||
+                (server.isRunning() && !server.publish(*cam, level))) {
+            std::cout << "no more LWIR img" << std::endl;
+            break;
+        }
+    }
+
+    if (_trace && LibSeek::trace_export(args::get(_trace)))
+        std::cout << "trace written to " << args::get(_trace) << std::endl;
+
+    return sigflag ? 0 : -1;
+}
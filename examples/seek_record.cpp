@@ -0,0 +1,98 @@
+/*
+ *  Raw recorder
+ *  Records every raw frame fetched from the camera into a lossless
+ *  compressed recording (see SeekRecording.h) until interrupted
+ */
+#include "seek.h"
+#include "SeekRecording.h"
+#include <iostream>
+#include <signal.h>
+#include "args.h"
+
+static volatile sig_atomic_t sigflag = 0;
+
+static void handle_sig(int sig)
+{
+    (void)sig;
+    sigflag = 1;
+}
+
+int main(int argc, char** argv)
+{
+    std::unique_ptr<LibSeek::SeekCam> cam;
+    LibSeek::SeekRecordingWriter recording;
+
+    args::ArgumentParser parser("Record raw frames losslessly");
+    args::HelpFlag help(parser, "help", "Display this help menu", { 'h', "help" });
+    args::ValueFlag<std::string> _output(parser, "outfile", "Name of the recording - default recording.skr", { 'o', "outfile" });
+    args::ValueFlag<int> _frames(parser, "frames", "Number of images to record - default until interrupted", { 'n', "frames" });
+    args::ValueFlag<std::string> _camtype(parser, "camtype", "Seek Thermal Camera Model - seek or seekpro, detected when omitted", { 't', "camtype" });
+
+    try {
+        parser.ParseCLI(argc, argv);
+    }
+    catch (args::Help) {
+        std::cout << parser;
+        return 0;
+    }
+    catch (args::ParseError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (args::ValidationError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    std::string outfile = "recording.skr";
+    if (_output)
+        outfile = args::get(_output);
+
+    int frames = -1;
+    if (_frames)
+        frames = args::get(_frames);
+
+    std::string camtype = "";
+    if (_camtype)
+        camtype = args::get(_camtype);
+
+    LibSeek::CameraType::Enum type = LibSeek::SeekCamFactory::fromName(camtype);
+    if (type == LibSeek::CameraType::UNKNOWN) {
+        std::cerr << "unknown camtype " << camtype << std::endl;
+        return 1;
+    }
+
+    cam = LibSeek::SeekCamFactory::create(type);
+    if (!cam || !recording.open(outfile, *cam)) {
+        std::cout << "failed to create recording " << outfile << std::endl;
+        return -1;
+    }
+
+    // Attach before open() so the frames used for calibration are recorded too
+    cam->setRawFrameSink(&recording);
+    if (!cam->open()) {
+        std::cout << "failed to open seek cam" << std::endl;
+        return -1;
+    }
+
+    signal(SIGINT, handle_sig);
+    signal(SIGTERM, handle_sig);
+
+    for (int i = 0; !sigflag && (frames < 0 || i < frames); i++) {
+        if (!cam->grab() || !recording.good()) {
+            std::cout << "recording stopped" << std::endl;
+            break;
+        }
+    }
+
+    cam->setRawFrameSink(nullptr);
+    recording.close();
+
+    const double raw_bytes = static_cast<double>(recording.frames()) * cam->raw_width() * cam->raw_height() * 2;
+    std::cout << "recorded " << recording.frames() << " raw frames, " << recording.bytes() << " bytes, "
+              << raw_bytes / recording.bytes() << "x smaller than 16-bit raw" << std::endl;
+
+    return recording.good() ? 0 : -1;
+}
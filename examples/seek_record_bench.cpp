@@ -0,0 +1,109 @@
+/*
+ *  Recording codec benchmark
+ *  Compares size and speed of the recording codec with 16-bit raw dumps
+ *  and 16-bit PNG on the frames of a recording made with seek_record
+ *  Usage: seek_record_bench recording.skr
+ */
+#include <opencv2/highgui/highgui.hpp>
+#include "SeekRecording.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void report(const char* name, size_t frames, size_t bytes, size_t raw_bytes, double encode_ms, double decode_ms)
+{
+    printf("%-10s %12zu bytes %6.2fx   encode %7.3f ms/frame   decode %7.3f ms/frame\n",
+           name, bytes, static_cast<double>(raw_bytes) / bytes, encode_ms / frames, decode_ms / frames);
+}
+
+int main(int argc, char** argv)
+{
+    size_t i;
+    double encode_ms, decode_ms;
+    size_t bytes;
+    LibSeek::SeekRecordingReader reader;
+    std::vector<std::vector<uint16_t> > frames;
+
+    if (argc != 2) {
+        printf("usage: %s recording.skr\n", argv[0]);
+        return 1;
+    }
+
+    if (!reader.open(argv[1]))
+        return -1;
+
+    const int width = reader.raw_width();
+    const int height = reader.raw_height();
+    std::vector<uint16_t> frame(width * height);
+    while (reader.read(frame.data()))
+        frames.push_back(frame);
+
+    if (frames.empty()) {
+        printf("no frames in %s\n", argv[1]);
+        return -1;
+    }
+
+    const size_t raw_bytes = frames.size() * width * height * sizeof(uint16_t);
+    printf("%zu frames of %dx%d\n", frames.size(), width, height);
+    report("raw16", frames.size(), raw_bytes, raw_bytes, 0, 0);
+
+    // 16-bit PNG, OpenCV default compression level
+    {
+        std::vector<std::vector<uint8_t> > encoded(frames.size());
+        Clock::time_point start = Clock::now();
+        bytes = 0;
+        for (i = 0; i < frames.size(); i++) {
+            cv::imencode(".png", cv::Mat(height, width, CV_16UC1, frames[i].data()), encoded[i]);
+            bytes += encoded[i].size();
+        }
+        encode_ms = ms_since(start);
+
+        start = Clock::now();
+        for (i = 0; i < frames.size(); i++)
+            cv::imdecode(encoded[i], cv::IMREAD_UNCHANGED);
+        decode_ms = ms_since(start);
+
+        report("png16", frames.size(), bytes, raw_bytes, encode_ms, decode_ms);
+    }
+
+    // recording codec, includes the frame headers
+    {
+        std::vector<LibSeek::RecordFrameHeader> headers(frames.size());
+        std::vector<std::vector<uint8_t> > encoded(frames.size());
+        Clock::time_point start = Clock::now();
+        bytes = 0;
+        for (i = 0; i < frames.size(); i++) {
+            LibSeek::encode_record_frame(frames[i].data(), width, height, headers[i], encoded[i]);
+            bytes += sizeof(LibSeek::RecordFrameHeader) + encoded[i].size();
+        }
+        encode_ms = ms_since(start);
+
+        bool lossless = true;
+        start = Clock::now();
+        for (i = 0; i < frames.size(); i++) {
+            if (!LibSeek::decode_record_frame(headers[i], encoded[i].data(), width, height, frame.data()))
+                lossless = false;
+        }
+        decode_ms = ms_since(start);
+
+        for (i = 0; i < frames.size() && lossless; i++) {
+            LibSeek::decode_record_frame(headers[i], encoded[i].data(), width, height, frame.data());
+            lossless = frame == frames[i];
+        }
+
+        report("skr", frames.size(), bytes, raw_bytes, encode_ms, decode_ms);
+        if (!lossless) {
+            printf("error: decoded frames differ\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -6,27 +6,129 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include "seek.h"
 #include <iostream>
+#include <cstdio>
+#include <chrono>
 #include "args.h"
+#include "burst_writer.h"
 using namespace cv;
 using namespace LibSeek;
 
+static void rotate_frame(Mat& frame, int rotate)
+{
+    if (rotate == 90) {
+        transpose(frame, frame);
+        flip(frame, frame, 1);
+    }
+    else if (rotate == 180) {
+        flip(frame, frame, -1);
+    }
+    else if (rotate == 270) {
+        transpose(frame, frame);
+        flip(frame, frame, 0);
+    }
+}
+
+static bool write_raw(const std::string& filename, const Mat& frame)
+{
+    FILE* file = fopen(filename.c_str(), "wb");
+    bool ok = file != nullptr;
+
+    /* x86 and arm are little endian already */
+    for (int y = 0; ok && y < frame.rows; y++)
+        ok = fwrite(frame.ptr<uint16_t>(y), sizeof(uint16_t), frame.cols, file) == static_cast<size_t>(frame.cols);
+    if (file != nullptr && fclose(file) != 0)
+        ok = false;
+
+    return ok;
+}
+
+/*
+ *  Burst frame to <prefix>_<index>.png or .raw, called from the writer threads
+ *  raw:    write the pixels as little endian uint16 without header instead of PNG-16
+ */
+static bool write_burst_frame(const std::string& prefix, bool raw, int rotate, const Mat& frame, int index)
+{
+    static thread_local Mat rotated;
+    char suffix[32];
+
+    frame.copyTo(rotated);
+    rotate_frame(rotated, rotate);
+
+    snprintf(suffix, sizeof(suffix), "_%06d.%s", index, raw ? "raw" : "png");
+    return raw ? write_raw(prefix + suffix, rotated) : imwrite(prefix + suffix, rotated);
+}
+
+/*
+ *  Capture count frames, or for duration seconds when count is 0, at the
+ *  camera rate and hand them to the writers
+ *  Returns 0 when every frame was written
+ */
+static int burst(SeekCam& cam, BurstWriter& writer, int count, double duration)
+{
+    int captured = 0;
+    int dropped = 0;
+    int unreadable = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::chrono::steady_clock::time_point end = start +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(duration));
+
+    while (count > 0 ? captured + dropped + unreadable < count : std::chrono::steady_clock::now() < end) {
+        if (!cam.grab()) {
+            std::cout << "no more LWIR img" << std::endl;
+            break;
+        }
+
+        uint16_t* frame = writer.acquire();
+        if (frame == nullptr) {
+            dropped++;
+            continue;
+        }
+
+        if (!cam.retrieveInto(frame, cam.width() * sizeof(uint16_t))) {
+            writer.release(frame);
+            unreadable++;
+            continue;
+        }
+        writer.submit(frame, captured + dropped + unreadable);
+        captured++;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    writer.finish();
+
+    std::cout << captured << " frames captured in " << seconds << " s (" << captured / seconds << " fps), "
+              << writer.written() << " written";
+    if (dropped > 0)
+        std::cout << ", " << dropped << " dropped because the writers were behind";
+    if (unreadable > 0)
+        std::cout << ", " << unreadable << " failed to retrieve";
+    if (writer.failed() > 0)
+        std::cout << ", " << writer.failed() << " failed to write";
+    std::cout << std::endl;
+
+    return (count > 0 && captured != count) || dropped > 0 || unreadable > 0 || writer.failed() > 0 ? -1 : 0;
+}
+
 
 int main(int argc, char** argv)
 {
     int i;
     cv::Mat frame_u16, frame, avg_frame;
-    LibSeek::SeekThermalPro seekpro;
-    LibSeek::SeekThermal seek;
-    LibSeek::SeekCam* cam;
+    std::unique_ptr<LibSeek::SeekCam> cam;
 
     args::ArgumentParser parser("Capture a single frame");
     args::HelpFlag help(parser, "help", "Display this help menu", { 'h', "help" });
     args::ValueFlag<std::string> _output(parser, "outfile", "Name of the file to write to - default output.png", { 'o', "outfile" });
     args::ValueFlag<int> _smoothing(parser, "smoothing", "Smoothing factor, number of frames to collect and average - default 1", { 's', "smoothing" });
-    args::ValueFlag<std::string> _camtype(parser, "camtype", "Seek Thermal Camera Model - seek or seekpro", { 't', "camtype" });
+    args::ValueFlag<std::string> _camtype(parser, "camtype", "Seek Thermal Camera Model - seek or seekpro, detected when omitted", { 't', "camtype" });
     args::ValueFlag<int> _warmup(parser, "warmup", "Warmup, number of frames to discard before sampling - default 10", { 'w', "warmup" });
     args::ValueFlag<int> _colormap(parser, "colormap", "Color Map - number between 0 and 21 (see: cv::ColormapTypes for maps available in your version of OpenCV)", { 'c', "colormap" });
     args::ValueFlag<int> _rotate(parser, "rotate", "Rotation - 0, 90, 180 or 270 (default) degrees", { 'r', "rotate" });
+    args::ValueFlag<int> _burst(parser, "burst", "Burst mode: capture this many 16-bit frames at full rate into <outfile>_000000.png ...", { 'b', "burst" });
+    args::ValueFlag<double> _duration(parser, "duration", "Burst mode: capture for this many seconds", { 'd', "duration" });
+    args::ValueFlag<std::string> _format(parser, "format", "Burst file format - png16 (default) or raw (little endian uint16, no header)", { "format" });
+    args::ValueFlag<int> _writers(parser, "writers", "Burst writer threads - default 2", { "writers" });
+    args::ValueFlag<int> _buffers(parser, "buffers", "Burst frames that can wait for a writer - default 64", { "buffers" });
 
     // Parse arguments
     try {
@@ -60,7 +162,7 @@ int main(int argc, char** argv)
     if (_output)
         outfile = args::get(_output);
 
-    std::string camtype = "seek";
+    std::string camtype = "";
     if (_camtype)
         camtype = args::get(_camtype);
 
@@ -74,16 +176,45 @@ int main(int argc, char** argv)
     if (_rotate)
         rotate = args::get(_rotate);
 
-    // Init correct cam type
-    if (camtype == "seekpro") {
-        cam = &seekpro;
+    const bool burst_mode = _burst || _duration;
+    int burst_count = _burst ? args::get(_burst) : 0;
+    double duration = _duration ? args::get(_duration) : 0;
+    if (burst_mode && (burst_count < 0 || duration < 0 || (burst_count == 0 && duration <= 0))) {
+        std::cerr << "burst needs a positive frame count or duration" << std::endl;
+        return 1;
     }
-    else {
-        cam = &seek;
+
+    std::string format = "png16";
+    if (_format)
+        format = args::get(_format);
+    if (format != "png16" && format != "raw") {
+        std::cerr << "unknown format " << format << std::endl;
+        return 1;
     }
 
-    if (!cam->open()) {
-        std::cout << "failed to open " << camtype << " cam" << std::endl;
+    int writers = 2;
+    if (_writers)
+        writers = args::get(_writers);
+
+    int buffers = 64;
+    if (_buffers)
+        buffers = args::get(_buffers);
+
+    if (writers < 1 || buffers < 1) {
+        std::cerr << "need at least one writer and one buffer" << std::endl;
+        return 1;
+    }
+
+    // Init correct cam type
+    LibSeek::CameraType::Enum type = LibSeek::SeekCamFactory::fromName(camtype);
+    if (type == LibSeek::CameraType::UNKNOWN) {
+        std::cerr << "unknown camtype " << camtype << std::endl;
+        return 1;
+    }
+
+    cam = LibSeek::SeekCamFactory::create(type);
+    if (!cam || !cam->open()) {
+        std::cout << "failed to open seek cam" << std::endl;
         return -1;
     }
 
@@ -92,12 +223,26 @@ int main(int argc, char** argv)
             std::cout << "no more LWIR img" << std::endl;
             return -1;
         }
-        cam->retrieve(frame_u16);
-        cv::waitKey(10);
     }
 
     std::cout << "warmup complete" << std::endl;
 
+    if (burst_mode) {
+        // output.png -> output_000000.png, output_000001.png, ...
+        const size_t dot = outfile.find_last_of('.');
+        const size_t slash = outfile.find_last_of("/\\");
+        const std::string prefix = dot == std::string::npos || (slash != std::string::npos && dot < slash) ?
+                                   outfile : outfile.substr(0, dot);
+
+        const int width = cam->width(), height = cam->height();
+        const bool raw = format == "raw";
+
+        BurstWriter writer(width, height, buffers, writers, [&](const uint16_t* frame, int index) {
+            return write_burst_frame(prefix, raw, rotate, Mat(height, width, CV_16UC1, const_cast<uint16_t*>(frame)), index);
+        });
+        return burst(*cam, writer, burst_count, duration);
+    }
+
     // Aquire frames
     for (i = 0; i < smoothing; i++) {
         if (!cam->grab()) {
@@ -106,26 +251,52 @@ int main(int argc, char** argv)
         }
 
         cam->retrieve(frame_u16);
+#ifdef SEEK_FIXED_POINT
+        frame_u16.convertTo(frame, CV_32SC1);
+#else
         frame_u16.convertTo(frame, CV_32FC1);
+#endif
 
         if (avg_frame.rows == 0) {
             frame.copyTo(avg_frame);
         } else {
             avg_frame += frame;
         }
-        cv::waitKey(10);
     }
 
     // Average the collected frames
+#ifdef SEEK_FIXED_POINT
+    frame_u16.create(avg_frame.rows, avg_frame.cols, CV_16UC1);
+    for (int y = 0; y < avg_frame.rows; y++) {
+        const int32_t* sum = avg_frame.ptr<int32_t>(y);
+        uint16_t* out = frame_u16.ptr<uint16_t>(y);
+        for (int x = 0; x < avg_frame.cols; x++) {
+            out[x] = (sum[x] + smoothing / 2) / smoothing;
+        }
+    }
+#else
     avg_frame /= smoothing;
     avg_frame.convertTo(frame_u16, CV_16UC1);
+#endif
 
     Mat frame_g8, outframe; // Transient Mat containers for processing
 
+#ifdef SEEK_FIXED_POINT
+    uint16_t min, max;
+    const size_t stride = frame_u16.step / sizeof(uint16_t);
+    min_max(frame_u16.ptr<uint16_t>(0), stride, frame_u16.cols, frame_u16.rows, &min, &max);
+    normalize_fixed(frame_u16.ptr<uint16_t>(0), stride, frame_u16.cols, frame_u16.rows, min, max);
+
+    // Convert seek CV_16UC1 to CV_8UC1
+    frame_g8.create(frame_u16.rows, frame_u16.cols, CV_8UC1);
+    convert_to_8bit(frame_u16.ptr<uint16_t>(0), stride, frame_g8.ptr<uint8_t>(0), frame_g8.step,
+                    frame_u16.cols, frame_u16.rows);
+#else
     normalize(frame_u16, frame_u16, 0, 65535, NORM_MINMAX);
 
     // Convert seek CV_16UC1 to CV_8UC1
     frame_u16.convertTo(frame_g8, CV_8UC1, 1.0 / 256.0);
+#endif
 
     // Apply colormap: https://docs.opencv.org/master/d3/d50/group__imgproc__colormap.html#ga9a805d8262bcbe273f16be9ea2055a65
     if (colormap != -1) {
@@ -135,18 +306,7 @@ int main(int argc, char** argv)
         cv::cvtColor(frame_g8, outframe, cv::COLOR_GRAY2BGR);
     }
 
-    // Rotate image
-    if (rotate == 90) {
-        transpose(outframe, outframe);
-        flip(outframe, outframe, 1);
-    }
-    else if (rotate == 180) {
-        flip(outframe, outframe, -1);
-    }
-    else if (rotate == 270) {
-        transpose(outframe, outframe);
-        flip(outframe, outframe, 0);
-    }
+    rotate_frame(outframe, rotate);
 
     cv::imwrite(outfile, outframe);
     return 0;
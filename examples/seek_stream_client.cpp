@@ -0,0 +1,45 @@
+/*
+ *  Network stream client
+ *  Prints the sequence numbers and value range of the frames streamed by
+ *  seek_publish --tcp/--udp
+ *  Usage: seek_stream_client host port [udp]
+ */
+#include "seek_core.h"
+#include "SeekStream.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+int main(int argc, char** argv)
+{
+    LibSeek::SeekStreamClient client;
+    LibSeek::StreamHeader header;
+    std::vector<uint16_t> frame;
+    uint16_t min, max;
+
+    if (argc < 3) {
+        std::cout << "usage: " << argv[0] << " host port [udp]" << std::endl;
+        return 1;
+    }
+
+    const std::string host = argv[1];
+    const int port = std::atoi(argv[2]);
+    const bool udp = argc == 4 && std::string(argv[3]) == "udp";
+
+    if (!(udp ? client.subscribe(host, port) : client.connect(host, port))) {
+        std::cout << "failed to connect to " << host << ":" << port << std::endl;
+        return -1;
+    }
+
+    while (client.receive(header, frame)) {
+        LibSeek::min_max(frame.data(), header.width, header.width, header.height, &min, &max);
+        std::cout << "frame " << header.sequence << ": " << min << " - " << max;
+        if (udp)
+            std::cout << " (incomplete " << client.incomplete() << ")";
+        std::cout << std::endl;
+    }
+
+    std::cout << "stream ended" << std::endl;
+    return 0;
+}
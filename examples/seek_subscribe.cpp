@@ -0,0 +1,51 @@
+/*
+ *  Frame ring reader
+ *  Prints the sequence numbers and value range of the frames published
+ *  by seek_publish, and the frames lost because this reader fell behind.
+ *  Follows the ring to a restarted seek_publish
+ */
+#include "seek_core.h"
+#include "SeekFrameRing.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+int main(int argc, char** argv)
+{
+    LibSeek::SeekFrameRingReader ring;
+    LibSeek::FrameMeta meta;
+    uint16_t min, max;
+    const std::string name = argc == 2 ? argv[1] : "/seek";
+
+    if (!ring.open(name)) {
+        std::cout << "failed to open frame ring " << name << std::endl;
+        return -1;
+    }
+
+    std::vector<uint16_t> frame(ring.width() * ring.height());
+
+    while(1) {
+        switch (ring.read_next(frame.data(), ring.width() * sizeof(uint16_t), &meta)) {
+        case LibSeek::RingStatus::OK:
+            LibSeek::min_max(frame.data(), ring.width(), ring.width(), ring.height(), &min, &max);
+            std::cout << "frame " << meta.sequence << ": " << min << " - " << max
+                      << " (dropped " << ring.dropped() << ")" << std::endl;
+            break;
+        case LibSeek::RingStatus::NOT_READY:
+            usleep(1000);
+            break;
+        case LibSeek::RingStatus::OVERRUN:
+            break;
+        case LibSeek::RingStatus::STALE:
+            /* the publisher restarted or exited, wait for its new ring */
+            std::cout << "frame ring " << name << " was replaced, reopening" << std::endl;
+            while (!ring.open(name))
+                sleep(1);
+            frame.resize(ring.width() * ring.height());
+            break;
+        default:
+            return -1;
+        }
+    }
+}
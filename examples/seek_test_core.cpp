@@ -0,0 +1,38 @@
+/*
+ *  Test program for the OpenCV free core library
+ *  Prints the frame counter and value range of each frame, works with
+ *  the Seek Thermal Compact/CompactXR or, with argument "pro", the Compact PRO
+ */
+#include "seek_core.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+
+int main(int argc, char** argv)
+{
+    std::unique_ptr<LibSeek::SeekCamCore> seek;
+    uint16_t min, max;
+
+    if (argc == 2 && std::string(argv[1]) == "pro")
+        seek.reset(new LibSeek::SeekThermalProCore());
+    else
+        seek.reset(new LibSeek::SeekThermalCore());
+
+    std::vector<uint16_t> frame(seek->width() * seek->height());
+
+    if (!seek->open()) {
+        std::cout << "failed to open seek cam" << std::endl;
+        return -1;
+    }
+
+    while(1) {
+        if (!seek->grab() || !seek->retrieveInto(frame.data(), seek->width() * sizeof(uint16_t))) {
+            std::cout << "no more LWIR img" << std::endl;
+            return -1;
+        }
+
+        LibSeek::min_max(frame.data(), seek->width(), seek->width(), seek->height(), &min, &max);
+        std::cout << "frame " << seek->frame_counter() << ": " << min << " - " << max << std::endl;
+    }
+}
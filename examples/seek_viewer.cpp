@@ -5,11 +5,21 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include "seek.h"
 #include "SeekCam.h"
+#include "SeekRecording.h"
+#include "SeekTrace.h"
+#ifndef _WIN32
+#include "SeekMetricsServer.h"
+#endif
 #include <iostream>
 #include <string>
 #include <signal.h>
 #include <memory>
 #include "args.h"
+#include "alloc_check.h"
+#include "triple_buffer.h"
+#include "frame_queue.h"
+#include <atomic>
+#include <thread>
 #include <sstream>
 #include <fcntl.h>
 
@@ -27,8 +37,11 @@ const std::string WINDOW_NAME = "SeekThermal";
 // Setup sig handling
 static volatile sig_atomic_t sigflag = 0;
 
+// Toggled by the display thread, read by the processing thread
+std::atomic<bool> auto_exposure_lock(false);
 
-bool auto_exposure_lock = false;
+// Only the display is frozen, capture and processing go on
+bool paused = false;
 
 void handle_sig(int sig) {
     (void)sig;
@@ -37,6 +50,20 @@ void handle_sig(int sig) {
 
 
 // Normalize the image so that it uses the full color space available for display. 
+#ifdef SEEK_FIXED_POINT
+void normalize(Mat &inframe) {
+    static uint16_t min = 0, max = 0;
+    static bool locked = false;
+    uint16_t *data = inframe.ptr<uint16_t>(0);
+    const size_t stride = inframe.step / sizeof(uint16_t);
+
+    if (!auto_exposure_lock || !locked) {
+        min_max(data, stride, inframe.cols, inframe.rows, &min, &max);
+    }
+    locked = auto_exposure_lock;
+    normalize_fixed(data, stride, inframe.cols, inframe.rows, min, max);
+}
+#else
 void normalize(Mat &inframe) {
     static double min =-1, max = -1;
     static float multiplier = -1;
@@ -64,41 +91,103 @@ void normalize(Mat &inframe) {
         min = -1;
     }
 }
+#endif
+
+// Mat containers reused by process_frame, so processing a frame doesn't allocate once they are sized
+struct FrameBuffers {
+    Mat frame_g8;
+    Mat rotated;
+    Mat scaled;
+    Mat palette;    // 256 entry CV_8UC3 lookup table from grey level to output color
+    std::vector<int32_t> scratch;   // bilinear upscaler row buffers
+};
+
+// Build the grey level to color lookup table once instead of colorizing every frame through OpenCV
+void setup_palette(FrameBuffers &buffers, int colormap, bool rgb) {
+    Mat ramp(1, 256, CV_8UC1);
+    for (int i = 0; i < 256; i++) {
+        ramp.at<uint8_t>(0, i) = i;
+    }
+
+    // Apply colormap: http://docs.opencv.org/3.2.0/d3/d50/group__imgproc__colormap.html#ga9a805d8262bcbe273f16be9ea2055a65
+    if (colormap != -1) {
+        applyColorMap(ramp, buffers.palette, colormap);
+    } else {
+        cv::cvtColor(ramp, buffers.palette, cv::COLOR_GRAY2BGR);
+    }
+
+    // v4l2 clients want RGB, swap the channels in the table rather than in every frame
+    if (rgb) {
+        cvtColor(buffers.palette, buffers.palette, COLOR_BGR2RGB);
+    }
+}
+
+// Map each 8-bit pixel to its palette color, upscaling by an integer factor in the same pass
+void upscale_colorize(const Mat &frame_g8, FrameBuffers &buffers, int factor, bool nearest, Mat &outframe) {
+    outframe.create(frame_g8.rows * factor, frame_g8.cols * factor, CV_8UC3);
+
+    if (nearest || factor == 1) {
+        upscale_nearest_colorize(frame_g8.ptr<uint8_t>(0), frame_g8.step, frame_g8.cols, frame_g8.rows,
+                                 buffers.palette.ptr<uint8_t>(0), factor, outframe.ptr<uint8_t>(0), outframe.step);
+    } else {
+        buffers.scratch.resize(2 * frame_g8.cols * factor);
+        upscale_bilinear_colorize(frame_g8.ptr<uint8_t>(0), frame_g8.step, frame_g8.cols, frame_g8.rows,
+                                  buffers.palette.ptr<uint8_t>(0), factor, outframe.ptr<uint8_t>(0), outframe.step,
+                                  buffers.scratch.data());
+    }
+}
 
 // Function to process a raw (corrected) seek frame
-void process_frame(Mat &inframe, Mat &outframe, float scale, int colormap, int rotate) {
-    Mat frame_g8; // Transient Mat containers for processing
+void process_frame(Mat &inframe, Mat &outframe, FrameBuffers &buffers, float scale, bool nearest, int rotate) {
+    Mat *frame = &buffers.frame_g8;
+    SEEK_TRACE_SCOPE("process_frame");
 
     normalize(inframe);
 
     // Convert seek CV_16UC1 to CV_8UC1
-    inframe.convertTo(frame_g8, CV_8UC1, 1.0/256.0 );
+#ifdef SEEK_FIXED_POINT
+    buffers.frame_g8.create(inframe.rows, inframe.cols, CV_8UC1);
+    convert_to_8bit(inframe.ptr<uint16_t>(0), inframe.step / sizeof(uint16_t),
+                    buffers.frame_g8.ptr<uint8_t>(0), buffers.frame_g8.step, inframe.cols, inframe.rows);
+#else
+    inframe.convertTo(buffers.frame_g8, CV_8UC1, 1.0/256.0 );
+#endif
 
-    // Rotate image
+    // Rotate image, transposing needs a second buffer since the frame isn't square
     if (rotate == 90) {
-        transpose(frame_g8, frame_g8);
-        flip(frame_g8, frame_g8, 1);
+        transpose(buffers.frame_g8, buffers.rotated);
+        flip(buffers.rotated, buffers.rotated, 1);
+        frame = &buffers.rotated;
     } else if (rotate == 180) {
-        flip(frame_g8, frame_g8, -1);
+        flip(buffers.frame_g8, buffers.frame_g8, -1);
     } else if (rotate == 270) {
-        transpose(frame_g8, frame_g8);
-        flip(frame_g8, frame_g8, 0);
+        transpose(buffers.frame_g8, buffers.rotated);
+        flip(buffers.rotated, buffers.rotated, 0);
+        frame = &buffers.rotated;
     }
 
-    // Resize image: http://docs.opencv.org/3.2.0/da/d54/group__imgproc__transform.html#ga5bb5a1fea74ea38e1a5445ca803ff121
-    // Note this is expensive computationally, only do if option set != 1
-    if (scale != 1.0) {
-        resize(frame_g8, frame_g8, Size(), scale, scale, INTER_LINEAR);
+    // Integer scale factors are upscaled while colorizing, straight into the output frame
+    const int factor = static_cast<int>(scale);
+    if (factor >= 1 && factor == scale) {
+        upscale_colorize(*frame, buffers, factor, nearest, outframe);
+        return;
     }
 
-    // Apply colormap: http://docs.opencv.org/3.2.0/d3/d50/group__imgproc__colormap.html#ga9a805d8262bcbe273f16be9ea2055a65
-    if (colormap != -1) {
-        applyColorMap(frame_g8, outframe, colormap);
-    } else {
-        cv::cvtColor(frame_g8, outframe, cv::COLOR_GRAY2BGR);
-    }
+    // Resize image: http://docs.opencv.org/3.2.0/da/d54/group__imgproc__transform.html#ga5bb5a1fea74ea38e1a5445ca803ff121
+    // Note this is expensive computationally, only used for non integer scale factors
+    resize(*frame, buffers.scaled, Size(), scale, scale, nearest ? INTER_NEAREST : INTER_LINEAR);
+    upscale_colorize(buffers.scaled, buffers, 1, true, outframe);
 }
 
+// Writes the trace when main returns, whichever way it exits
+struct TraceExport {
+    std::string filename;
+    ~TraceExport() {
+        if (!filename.empty() && LibSeek::trace_export(filename))
+            std::cout << "Trace written to " << filename << std::endl;
+    }
+};
+
 void key_handler(char scancode) {
     switch (scancode) {
         case 'f': {
@@ -107,7 +196,8 @@ void key_handler(char scancode) {
             break;
         }
         case 's': {
-            waitKey(0);
+            paused = !paused;
+            std::cout << (paused ? "Paused" : "Resumed") << std::endl;
             break;
         }
         case 'a': {
@@ -155,8 +245,7 @@ int setup_v4l2(std::string output, int width,int height) {
 }
 
 void v4l2_out(int v4l2, Mat& outframe) {
-    // Second colorspace conversion done here as applyColorMap only produces BGR. Do it in place.
-    cvtColor(outframe, outframe, COLOR_BGR2RGB);
+    // outframe is already RGB, the palette was built with swapped channels for v4l2
     int framesize = outframe.total() * outframe.elemSize();
     int written = write(v4l2, outframe.data, framesize);
     if (written < 0) {
@@ -184,9 +273,14 @@ int main(int argc, char** argv) {
     args::ValueFlag<std::string> _ffc(parser, "FFC", "Additional Flat Field calibration - provide ffc file", {'F', "FFC"});
     args::ValueFlag<int> _fps(parser, "fps", "Video Output FPS - Kludge factor", {'f', "fps"});
     args::ValueFlag<float> _scale(parser, "scaling", "Output Scaling - multiple of original image", {'s', "scale"});
+    args::ValueFlag<std::string> _interpolation(parser, "interpolation", "Scaling interpolation - linear (default) or nearest", {'i', "interpolation"});
     args::ValueFlag<int> _colormap(parser, "colormap", "Color Map - number between 0 and 21 (see: cv::ColormapTypes for maps available in your version of OpenCV)", { 'c', "colormap" });
     args::ValueFlag<int> _rotate(parser, "rotate", "Rotation - 0, 90, 180 or 270 (default) degrees", {'r', "rotate"});
-    args::ValueFlag<std::string> _camtype(parser, "camtype", "Seek Thermal Camera Model - seek or seekpro", {'t', "camtype"});
+    args::ValueFlag<std::string> _camtype(parser, "camtype", "Seek Thermal Camera Model - seek or seekpro, detected when omitted", {'t', "camtype"});
+    args::ValueFlag<std::string> _replay(parser, "replay", "Replay a raw recording (see seek_record) instead of using a camera", {"replay"});
+    args::Flag _fast(parser, "fast", "Replay as fast as possible instead of at the recorded pace", {"fast"});
+    args::ValueFlag<std::string> _trace(parser, "trace", "Record the pipeline stages, written as Chrome trace JSON on exit (needs WITH_TRACING)", {"trace"});
+    args::ValueFlag<int> _metrics(parser, "metrics", "Serve Prometheus metrics at http://localhost:<port>/metrics (not on Windows)", {"metrics"});
 
     // Parse arguments
     try {
@@ -211,11 +305,20 @@ int main(int argc, char** argv) {
     if (_scale)
         scale = args::get(_scale);
 
+    bool nearest = false;
+    if (_interpolation) {
+        if (args::get(_interpolation) != "linear" && args::get(_interpolation) != "nearest") {
+            std::cerr << "Unknown interpolation " << args::get(_interpolation) << ", use linear or nearest" << std::endl;
+            return 1;
+        }
+        nearest = args::get(_interpolation) == "nearest";
+    }
+
     std::string mode = "window";
     if (_mode)
         mode = args::get(_mode);
 
-    std::string camtype = "seek";
+    std::string camtype = "";
     if (_camtype)
         camtype = args::get(_camtype);
 
@@ -249,27 +352,60 @@ int main(int argc, char** argv) {
         }
     }
 
+    TraceExport trace;
+    if (_trace) {
+        if (!LibSeek::trace_start())
+            return 1;
+        trace.filename = args::get(_trace);
+    }
+
+#ifndef _WIN32
+    LibSeek::SeekMetricsServer metrics;
+    if (_metrics && !metrics.start(args::get(_metrics))) {
+        std::cout << "failed to start metrics server" << std::endl;
+        return 1;
+    }
+#else
+    if (_metrics) {
+        std::cout << "metrics are not supported on Windows" << std::endl;
+        return 1;
+    }
+#endif
+
     // Register signals
     signal(SIGINT, handle_sig);
     signal(SIGTERM, handle_sig);
 
-    // Setup seek camera
-    LibSeek::SeekCam* seek;
-    LibSeek::SeekThermalPro seekpro(args::get(_ffc));
-    LibSeek::SeekThermal seekclassic(args::get(_ffc));
-    if (camtype == "seekpro") {
-        seek = &seekpro;
+    // Setup seek camera, or the model of the recording when replaying
+    LibSeek::SeekRecordingReader recording;
+    LibSeek::CameraType::Enum type;
+    if (_replay) {
+        if (!recording.open(args::get(_replay)))
+            return 1;
+        type = LibSeek::SeekCamFactory::fromProductId(recording.product_id());
     } else {
-        seek = &seekclassic;
+        type = LibSeek::SeekCamFactory::fromName(camtype);
+    }
+    if (type == LibSeek::CameraType::UNKNOWN) {
+        std::cerr << "Unknown camtype " << camtype << std::endl;
+        return 1;
     }
 
-    if (!seek->open()) {
+    std::unique_ptr<LibSeek::SeekCam> seek = LibSeek::SeekCamFactory::create(type, args::get(_ffc));
+    LibSeek::SeekRecordingPlayer player(recording);
+    if (seek && _replay) {
+        player.setRealtime(!_fast);
+        seek->setRawFrameSource(&player);
+    }
+    if (!seek || !seek->open()) {
         std::cout << "Error accessing camera" << std::endl;
         return 1;
     }
 
     // Mat containers for seek frames
     Mat seekframe, outframe;
+    FrameBuffers buffers;
+    setup_palette(buffers, colormap, mode == "v4l2");
 
     // Retrieve a single frame, resize to requested scaling value and then determine size of matrix
     //  so we can size the VideoWriter stream correctly
@@ -278,7 +414,7 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    process_frame(seekframe, outframe, scale, colormap, rotate);
+    process_frame(seekframe, outframe, buffers, scale, nearest, rotate);
 
     // Setup video for linux if that output is chosen
     int v4l2 = -1;
@@ -307,34 +443,156 @@ int main(int argc, char** argv) {
     }
 
 
-    // Main loop to retrieve frames from camera and write them out
-    while (!sigflag) {
+    // Capture, processing and output run on their own threads. The window is joined by triple
+    // buffers that always hold the newest frame, so a slow display never holds back the camera.
+    // A file or v4l2 device must get every frame: those are written by the processing thread,
+    // fed through a lossless queue that holds back the camera instead when it falls behind.
+    const bool lossless = mode != "window";
+    TripleBuffer<Mat> raw_frames;
+    TripleBuffer<Mat> out_frames;
+    FrameQueue<Mat> raw_queue(lossless ? 4 : 0);
+    if (lossless) {
+        for (int i = 0; i < raw_queue.size(); i++)
+            raw_queue.slot(i).create(seekframe.rows, seekframe.cols, CV_16UC1);
+    } else {
+        for (int i = 0; i < 3; i++) {
+            raw_frames.slot(i).create(seekframe.rows, seekframe.cols, CV_16UC1);
+            out_frames.slot(i).create(outframe.rows, outframe.cols, outframe.type());
+        }
+    }
 
-        // If signal for interrupt/termination was received, break out of main loop and exit
-        if (!seek->read(seekframe)) {
-            std::cout << "Failed to read frame from camera, exiting" << std::endl;
-            return 1;
+    std::atomic<bool> stop(false);
+    std::atomic<bool> allocation_failed(false);
+    bool end_of_recording = false;
+    bool capture_failed = false;
+
+    std::thread capture([&]() {
+        LibSeek::trace_thread_name("capture");
+
+        while (!stop) {
+            if (lossless && !raw_queue.reserve(std::chrono::milliseconds(100)))
+                continue;
+            SEEK_TRACE_SCOPE("capture");
+#ifdef SEEK_ALLOCATION_CHECK
+            // All buffers are sized by the initial frame, grab and retrieve must not allocate anymore
+            const size_t allocations = alloc_check::allocations();
+#endif
+
+            if (!seek->grab()) {
+                end_of_recording = _replay && player.position() >= recording.frames();
+                capture_failed = !end_of_recording;
+                break;
+            }
+
+#ifdef SEEK_ALLOCATION_CHECK
+            // libusb's Linux backend allocates the URBs of every submitted transfer, so a camera
+            // grab is left out, only a replayed one is checked
+            const size_t usb_allocations = _replay ? 0 : alloc_check::allocations() - allocations;
+#endif
+
+            // A frame that can't be retrieved is skipped, the slot is filled by the next one
+            if (!seek->retrieveInto(lossless ? raw_queue.back() : raw_frames.back()))
+                continue;
+            if (lossless)
+                raw_queue.publish();
+            else
+                raw_frames.publish();
+
+#ifdef SEEK_ALLOCATION_CHECK
+            if (alloc_check::allocations() - usb_allocations != allocations) {
+                std::cerr << "Allocation check failed: steady state capture performed "
+                          << alloc_check::allocations() - usb_allocations - allocations << " heap allocations" << std::endl;
+                allocation_failed = true;
+                break;
+            }
+#endif
         }
+        stop = true;
+    });
+
+    std::thread processing([&]() {
+        LibSeek::trace_thread_name("process");
+
+        for (;;) {
+            // The queue is drained after capture stopped, everything it published before is there
+            const bool stopping = stop;
+            const bool ready = lossless ? raw_queue.wait(std::chrono::milliseconds(100)) :
+                               !stopping && raw_frames.wait(std::chrono::milliseconds(100));
+            if (!ready) {
+                if (stopping)
+                    break;
+                continue;
+            }
+#ifdef SEEK_ALLOCATION_CHECK
+            const size_t allocations = alloc_check::allocations();
+#endif
 
-        // Retrieve frame from seek and process
-        process_frame(seekframe, outframe, scale, colormap, rotate);
+            if (!lossless) {
+                process_frame(raw_frames.front(), out_frames.back(), buffers, scale, nearest, rotate);
+                out_frames.publish();
+            } else {
+                process_frame(raw_queue.front(), outframe, buffers, scale, nearest, rotate);
+                raw_queue.release();
+                if (mode == "v4l2") {
+                    SEEK_TRACE_SCOPE("v4l2_out");
+                    v4l2_out(v4l2, outframe);
+                } else {
+                    SEEK_TRACE_SCOPE("video_write");
+                    writer << outframe;
+                }
+            }
 
-        if (mode == "v4l2") {
-            v4l2_out(v4l2, outframe);
-        } else if (mode == "window") {
-            imshow(WINDOW_NAME, outframe);
-            char c = waitKey(10);
+#ifdef SEEK_ALLOCATION_CHECK
+            if (alloc_check::allocations() != allocations) {
+                std::cerr << "Allocation check failed: steady state processing performed "
+                          << alloc_check::allocations() - allocations << " heap allocations" << std::endl;
+                allocation_failed = true;
+                stop = true;
+                break;
+            }
+#endif
+        }
+    });
+
+    // The window on the main thread, HighGUI windows only work there
+    LibSeek::trace_thread_name("output");
+    bool window_closed = false;
+    while (!sigflag && !stop) {
+        if (mode == "window") {
+            if (!paused && out_frames.wait(std::chrono::milliseconds(10))) {
+                SEEK_TRACE_SCOPE("display");
+                imshow(WINDOW_NAME, out_frames.front());
+            }
+            char c = waitKey(1);
             key_handler(c);
 
             // If the window is closed by the user all window properties will return -1 and we should terminate
             if (getWindowProperty(WINDOW_NAME, WindowPropertyFlags::WND_PROP_FULLSCREEN) == -1) {
-                std::cout << "Window closed, exiting" << std::endl;
-                return 0;
+                window_closed = true;
+                break;
             }
         } else {
-            writer << outframe;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
         }
+    }
 
+    stop = true;
+    capture.join();
+    processing.join();
+
+    if (allocation_failed)
+        return 1;
+    if (window_closed) {
+        std::cout << "Window closed, exiting" << std::endl;
+        return 0;
+    }
+    if (end_of_recording) {
+        std::cout << "End of recording, exiting" << std::endl;
+        return 0;
+    }
+    if (capture_failed) {
+        std::cout << "Failed to read frame from camera, exiting" << std::endl;
+        return 1;
     }
 
     std::cout << "Break signal detected, exiting" << std::endl;
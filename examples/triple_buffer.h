@@ -0,0 +1,116 @@
+/*
+ *  Latest value triple buffer
+ *
+ *  Hands values from one producer thread to one consumer thread without
+ *  locks or copies: the producer fills its back slot and swaps it with
+ *  the shared middle slot, the consumer swaps the middle slot with its
+ *  front slot when it holds a newer value. Neither side ever waits for
+ *  the other, a value the consumer didn't get to in time is replaced by
+ *  the newer one.
+ */
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() :
+        m_middle(1),
+        m_back(0),
+        m_front(2),
+        m_waiting(false)
+    { }
+
+    /*
+     *  Slot i (0..2), to size the values before the threads start
+     */
+    T& slot(int i)
+    {
+        return m_slots[i];
+    }
+
+    /*
+     *  Producer: the value to fill, valid until publish()
+     */
+    T& back()
+    {
+        return m_slots[m_back];
+    }
+
+    /*
+     *  Producer: make the back value the newest one
+     */
+    void publish()
+    {
+        m_back = m_middle.exchange(m_back | fresh) & index_mask;
+
+        /* the lock only orders the notify with a consumer going to sleep */
+        if (m_waiting.load()) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_wake.notify_one();
+        }
+    }
+
+    /*
+     *  Consumer: move to the newest value if there is one
+     *  Returns true when front() changed
+     */
+    bool update()
+    {
+        if (!(m_middle.load() & fresh))
+            return false;
+
+        m_front = m_middle.exchange(m_front) & index_mask;
+        return true;
+    }
+
+    /*
+     *  Consumer: update(), waiting up to timeout for a new value
+     */
+    bool wait(std::chrono::milliseconds timeout)
+    {
+        if (update())
+            return true;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_waiting.store(true);
+        if (!(m_middle.load() & fresh))
+            m_wake.wait_for(lock, timeout);
+        m_waiting.store(false);
+
+        return update();
+    }
+
+    /*
+     *  Consumer: the newest value seen by update()
+     */
+    T& front()
+    {
+        return m_slots[m_front];
+    }
+
+private:
+    TripleBuffer(const TripleBuffer&);
+    TripleBuffer& operator=(const TripleBuffer&);
+
+    static const uint8_t index_mask = 3;
+    static const uint8_t fresh = 4;     /* the middle slot wasn't consumed yet */
+
+    T m_slots[3];
+    std::atomic<uint8_t> m_middle;      /* index | fresh */
+    uint8_t m_back;                     /* producer only */
+    uint8_t m_front;                    /* consumer only */
+    std::atomic<bool> m_waiting;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+};
+
+#endif /* TRIPLE_BUFFER_H */
@@ -0,0 +1,507 @@
+/*
+ *  Python bindings
+ *  Built on the C API. Frames are written into buffers of a per camera
+ *  pool and exposed through the buffer protocol, so numpy.asarray(frame)
+ *  is a view of the pool buffer, not a copy. A buffer goes back to the
+ *  pool once the frame and every array viewing it are gone.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <vector>
+#include "seek_c.h"
+
+static PyObject* SeekError;
+
+/*
+ *  Camera
+ */
+typedef struct {
+    PyObject_HEAD
+    seek_camera_t* cam;
+    int width;
+    int height;
+    int busy;                                   /* a call released the GIL and isn't done yet */
+    int default_level;                          /* level used by iteration */
+    std::vector<std::vector<uint16_t>*>* pool;  /* free frame buffers */
+} CameraObject;
+
+/*
+ *  Frame, owns a pool buffer and keeps its camera alive
+ */
+typedef struct {
+    PyObject_HEAD
+    CameraObject* camera;
+    std::vector<uint16_t>* buffer;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+    int level;
+    int frame_id;
+    int frame_counter;
+    int frames_skipped;
+    int shutter;
+    unsigned long long timestamp_ns;
+    unsigned long long sequence;
+} FrameObject;
+
+static PyTypeObject FrameType_;
+static PyTypeObject CameraType_;
+
+static PyObject* raise_error(int status)
+{
+    PyErr_SetString(SeekError, seek_strerror(status));
+    return NULL;
+}
+
+static std::vector<uint16_t>* pool_get(CameraObject* self)
+{
+    if (!self->pool->empty()) {
+        std::vector<uint16_t>* buffer = self->pool->back();
+        self->pool->pop_back();
+        return buffer;
+    }
+
+    try {
+        return new std::vector<uint16_t>(self->width * self->height);
+    } catch (const std::bad_alloc&) {
+        return NULL;
+    }
+}
+
+static void pool_put(CameraObject* self, std::vector<uint16_t>* buffer)
+{
+    try {
+        self->pool->push_back(buffer);
+    } catch (const std::bad_alloc&) {
+        delete buffer;
+    }
+}
+
+/* reject calls while another thread is inside a GIL released call */
+static int check_usable(CameraObject* self)
+{
+    if (self->cam == NULL) {
+        PyErr_SetString(SeekError, "camera is closed");
+        return -1;
+    }
+    if (self->busy) {
+        PyErr_SetString(SeekError, "camera is in use by another thread");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ *  Frame methods
+ */
+static void Frame_dealloc(FrameObject* self)
+{
+    if (self->buffer)
+        pool_put(self->camera, self->buffer);
+    Py_XDECREF(self->camera);
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static int Frame_getbuffer(FrameObject* self, Py_buffer* view, int flags)
+{
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "frames are read only");
+        return -1;
+    }
+
+    view->obj = reinterpret_cast<PyObject*>(self);
+    Py_INCREF(self);
+    view->buf = self->buffer->data();
+    view->len = self->buffer->size() * sizeof(uint16_t);
+    view->readonly = 1;
+    view->itemsize = sizeof(uint16_t);
+    view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>("H") : NULL;
+    /* without PyBUF_ND the consumer sees the frame as one dimensional */
+    view->ndim = (flags & PyBUF_ND) ? 2 : 1;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+
+    return 0;
+}
+
+static PyBufferProcs Frame_as_buffer = {
+    reinterpret_cast<getbufferproc>(Frame_getbuffer),
+    NULL,
+};
+
+static PyMemberDef Frame_members[] = {
+    { const_cast<char*>("level"), T_INT, offsetof(FrameObject, level), READONLY,
+      const_cast<char*>("processing level of the frame") },
+    { const_cast<char*>("frame_id"), T_INT, offsetof(FrameObject, frame_id), READONLY,
+      const_cast<char*>("frame type reported by the camera") },
+    { const_cast<char*>("frame_counter"), T_INT, offsetof(FrameObject, frame_counter), READONLY,
+      const_cast<char*>("camera frame counter") },
+    { const_cast<char*>("frames_skipped"), T_INT, offsetof(FrameObject, frames_skipped), READONLY,
+      const_cast<char*>("non image frames skipped before this frame") },
+    { const_cast<char*>("shutter"), T_INT, offsetof(FrameObject, shutter), READONLY,
+      const_cast<char*>("a new flat field calibration frame was taken before this frame") },
+    { const_cast<char*>("timestamp_ns"), T_ULONGLONG, offsetof(FrameObject, timestamp_ns), READONLY,
+      const_cast<char*>("host receive time, steady clock nanoseconds") },
+    { const_cast<char*>("sequence"), T_ULONGLONG, offsetof(FrameObject, sequence), READONLY,
+      const_cast<char*>("number of frames fetched from the camera before this one") },
+    { NULL, 0, 0, 0, NULL }
+};
+
+static PyObject* Frame_get_shape(FrameObject* self, void*)
+{
+    return Py_BuildValue("(nn)", self->shape[0], self->shape[1]);
+}
+
+static PyGetSetDef Frame_getset[] = {
+    { const_cast<char*>("shape"), reinterpret_cast<getter>(Frame_get_shape), NULL,
+      const_cast<char*>("(height, width)"), NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+/*
+ *  Camera methods
+ */
+static int Camera_init(CameraObject* self, PyObject* args, PyObject* kwds)
+{
+    static const char* kwlist[] = { "model", "recording", "realtime", NULL };
+    int model = SEEK_MODEL_AUTO;
+    const char* recording = NULL;
+    int realtime = 0;
+    int status;
+    seek_camera_t* cam;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|izp", const_cast<char**>(kwlist), &model, &recording, &realtime))
+        return -1;
+
+    if (self->cam != NULL) {
+        PyErr_SetString(SeekError, "camera already opened");
+        return -1;
+    }
+
+    /* usb init and the first frames take a while */
+    Py_BEGIN_ALLOW_THREADS
+    if (recording != NULL)
+        status = seek_open_recording(&cam, recording, realtime);
+    else
+        status = seek_open(&cam, model);
+    Py_END_ALLOW_THREADS
+
+    if (status != SEEK_OK) {
+        raise_error(status);
+        return -1;
+    }
+
+    self->cam = cam;
+    self->width = seek_get_width(cam);
+    self->height = seek_get_height(cam);
+    return 0;
+}
+
+static PyObject* Camera_new(PyTypeObject* type, PyObject*, PyObject*)
+{
+    CameraObject* self = reinterpret_cast<CameraObject*>(type->tp_alloc(type, 0));
+
+    if (self == NULL)
+        return NULL;
+
+    self->cam = NULL;
+    self->busy = 0;
+    self->default_level = SEEK_LEVEL_FULLY_CORRECTED;
+    self->pool = new (std::nothrow) std::vector<std::vector<uint16_t>*>();
+    if (self->pool == NULL) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+
+    return reinterpret_cast<PyObject*>(self);
+}
+
+static void close_camera(CameraObject* self)
+{
+    if (self->cam == NULL)
+        return;
+
+    seek_camera_t* cam = self->cam;
+    self->cam = NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    seek_close(cam);
+    Py_END_ALLOW_THREADS
+}
+
+static void Camera_dealloc(CameraObject* self)
+{
+    /* frames hold a reference, so none is left when we get here */
+    close_camera(self);
+    if (self->pool) {
+        for (size_t i = 0; i < self->pool->size(); i++)
+            delete (*self->pool)[i];
+        delete self->pool;
+    }
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static PyObject* Camera_close(CameraObject* self, PyObject*)
+{
+    if (self->busy) {
+        PyErr_SetString(SeekError, "camera is in use by another thread");
+        return NULL;
+    }
+
+    close_camera(self);
+    Py_RETURN_NONE;
+}
+
+/* without the GIL, the camera must be usable */
+static int grab(CameraObject* self)
+{
+    int status;
+
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    status = seek_grab(self->cam);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+
+    return status;
+}
+
+static PyObject* Camera_grab(CameraObject* self, PyObject*)
+{
+    int status;
+
+    if (check_usable(self) < 0)
+        return NULL;
+
+    status = grab(self);
+    if (status != SEEK_OK)
+        return raise_error(status);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject* retrieve_frame(CameraObject* self, int level)
+{
+    int status;
+    seek_frame_meta_t meta = { sizeof(seek_frame_meta_t), 0, 0, 0, 0, 0, 0, 0 };
+    FrameObject* frame = PyObject_New(FrameObject, &FrameType_);
+
+    if (frame == NULL)
+        return NULL;
+
+    frame->camera = self;
+    Py_INCREF(self);
+    frame->buffer = pool_get(self);
+    if (frame->buffer == NULL) {
+        Py_DECREF(frame);
+        return PyErr_NoMemory();
+    }
+
+    /* a memory bound correction pass, not worth a GIL round trip */
+    status = seek_retrieve_into(self->cam, frame->buffer->data(), self->width * sizeof(uint16_t), level, &meta);
+    if (status != SEEK_OK) {
+        Py_DECREF(frame);
+        return raise_error(status);
+    }
+
+    frame->shape[0] = self->height;
+    frame->shape[1] = self->width;
+    frame->strides[0] = self->width * sizeof(uint16_t);
+    frame->strides[1] = sizeof(uint16_t);
+    frame->level = level;
+    frame->frame_id = meta.frame_id;
+    frame->frame_counter = meta.frame_counter;
+    frame->frames_skipped = meta.frames_skipped;
+    frame->shutter = meta.shutter;
+    frame->timestamp_ns = meta.timestamp_ns;
+    frame->sequence = meta.sequence;
+
+    return reinterpret_cast<PyObject*>(frame);
+}
+
+static PyObject* Camera_retrieve(CameraObject* self, PyObject* args, PyObject* kwds)
+{
+    static const char* kwlist[] = { "level", NULL };
+    int level = SEEK_LEVEL_FULLY_CORRECTED;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i", const_cast<char**>(kwlist), &level))
+        return NULL;
+    if (check_usable(self) < 0)
+        return NULL;
+
+    return retrieve_frame(self, level);
+}
+
+static PyObject* Camera_read(CameraObject* self, PyObject* args, PyObject* kwds)
+{
+    PyObject* res = Camera_grab(self, NULL);
+
+    if (res == NULL)
+        return NULL;
+    Py_DECREF(res);
+
+    return Camera_retrieve(self, args, kwds);
+}
+
+static PyObject* Camera_set_flat_field(CameraObject* self, PyObject* arg)
+{
+    int status;
+    Py_buffer view;
+
+    if (check_usable(self) < 0)
+        return NULL;
+
+    if (arg == Py_None) {
+        status = seek_set_additional_flat_field(self->cam, NULL, 0);
+        return status == SEEK_OK ? (Py_INCREF(Py_None), Py_None) : raise_error(status);
+    }
+
+    /* any C contiguous buffer of the right size, e.g. a uint16 array or raw bytes */
+    if (PyObject_GetBuffer(arg, &view, PyBUF_C_CONTIGUOUS) < 0)
+        return NULL;
+
+    if (view.len != static_cast<Py_ssize_t>(self->width * self->height * sizeof(uint16_t))) {
+        PyBuffer_Release(&view);
+        PyErr_Format(PyExc_ValueError, "expected %d x %d uint16 values", self->height, self->width);
+        return NULL;
+    }
+
+    status = seek_set_additional_flat_field(self->cam, static_cast<const uint16_t*>(view.buf),
+                                            self->width * sizeof(uint16_t));
+    PyBuffer_Release(&view);
+
+    if (status != SEEK_OK)
+        return raise_error(status);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Camera_iter(CameraObject* self)
+{
+    Py_INCREF(self);
+    return reinterpret_cast<PyObject*>(self);
+}
+
+static PyObject* Camera_iternext(CameraObject* self)
+{
+    /* blocks until the next frame, the end of a recording stops the iteration, errors raise */
+    int status;
+
+    if (check_usable(self) < 0)
+        return NULL;
+
+    status = grab(self);
+    if (status == SEEK_ERROR_END_OF_STREAM)
+        return NULL;
+    if (status != SEEK_OK)
+        return raise_error(status);
+
+    if (check_usable(self) < 0)
+        return NULL;
+
+    return retrieve_frame(self, self->default_level);
+}
+
+static PyObject* Camera_enter(CameraObject* self, PyObject*)
+{
+    Py_INCREF(self);
+    return reinterpret_cast<PyObject*>(self);
+}
+
+static PyObject* Camera_exit(CameraObject* self, PyObject*)
+{
+    PyObject* res = Camera_close(self, NULL);
+
+    if (res == NULL)
+        return NULL;
+    Py_DECREF(res);
+
+    Py_RETURN_FALSE;
+}
+
+static PyMethodDef Camera_methods[] = {
+    { "close", reinterpret_cast<PyCFunction>(Camera_close), METH_NOARGS,
+      "Close the camera" },
+    { "grab", reinterpret_cast<PyCFunction>(Camera_grab), METH_NOARGS,
+      "Grab a frame, the GIL is released while waiting for it" },
+    { "retrieve", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(Camera_retrieve)), METH_VARARGS | METH_KEYWORDS,
+      "retrieve(level=FULLY_CORRECTED) -> Frame of the last grabbed frame" },
+    { "read", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(Camera_read)), METH_VARARGS | METH_KEYWORDS,
+      "read(level=FULLY_CORRECTED) -> Frame, grab and retrieve" },
+    { "set_flat_field", reinterpret_cast<PyCFunction>(Camera_set_flat_field), METH_O,
+      "Set the additional flat field calibration (height x width uint16 buffer) or remove it (None)" },
+    { "__enter__", reinterpret_cast<PyCFunction>(Camera_enter), METH_NOARGS, NULL },
+    { "__exit__", reinterpret_cast<PyCFunction>(Camera_exit), METH_VARARGS, NULL },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyMemberDef Camera_members[] = {
+    { const_cast<char*>("width"), T_INT, offsetof(CameraObject, width), READONLY, NULL },
+    { const_cast<char*>("height"), T_INT, offsetof(CameraObject, height), READONLY, NULL },
+    { const_cast<char*>("level"), T_INT, offsetof(CameraObject, default_level), 0,
+      const_cast<char*>("processing level of the frames returned by iteration") },
+    { NULL, 0, 0, 0, NULL }
+};
+
+static struct PyModuleDef seek_module = {
+    PyModuleDef_HEAD_INIT,
+    "libseek",
+    "Seek thermal camera bindings. Frames support the buffer protocol, "
+    "numpy.asarray(frame) gives a (height, width) uint16 view without copying.",
+    -1,
+    NULL, NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit_libseek(void)
+{
+    PyObject* m;
+
+    FrameType_.tp_name = "libseek.Frame";
+    FrameType_.tp_basicsize = sizeof(FrameObject);
+    FrameType_.tp_dealloc = reinterpret_cast<destructor>(Frame_dealloc);
+    FrameType_.tp_as_buffer = &Frame_as_buffer;
+    FrameType_.tp_flags = Py_TPFLAGS_DEFAULT;
+    FrameType_.tp_doc = "Frame in a camera pool buffer, use numpy.asarray(frame) for a zero copy view";
+    FrameType_.tp_members = Frame_members;
+    FrameType_.tp_getset = Frame_getset;
+
+    CameraType_.tp_name = "libseek.Camera";
+    CameraType_.tp_basicsize = sizeof(CameraObject);
+    CameraType_.tp_dealloc = reinterpret_cast<destructor>(Camera_dealloc);
+    CameraType_.tp_flags = Py_TPFLAGS_DEFAULT;
+    CameraType_.tp_doc = "Camera(model=MODEL_AUTO, recording=None, realtime=False), iterating it blocks for "
+                         "and yields frames. With recording, the frames come from a raw recording file";
+    CameraType_.tp_iter = reinterpret_cast<getiterfunc>(Camera_iter);
+    CameraType_.tp_iternext = reinterpret_cast<iternextfunc>(Camera_iternext);
+    CameraType_.tp_methods = Camera_methods;
+    CameraType_.tp_members = Camera_members;
+    CameraType_.tp_init = reinterpret_cast<initproc>(Camera_init);
+    CameraType_.tp_new = Camera_new;
+
+    if (PyType_Ready(&FrameType_) < 0 || PyType_Ready(&CameraType_) < 0)
+        return NULL;
+
+    m = PyModule_Create(&seek_module);
+    if (m == NULL)
+        return NULL;
+
+    SeekError = PyErr_NewException("libseek.Error", PyExc_RuntimeError, NULL);
+    Py_INCREF(SeekError);
+    PyModule_AddObject(m, "Error", SeekError);
+
+    Py_INCREF(&CameraType_);
+    PyModule_AddObject(m, "Camera", reinterpret_cast<PyObject*>(&CameraType_));
+    Py_INCREF(&FrameType_);
+    PyModule_AddObject(m, "Frame", reinterpret_cast<PyObject*>(&FrameType_));
+
+    PyModule_AddIntConstant(m, "MODEL_AUTO", SEEK_MODEL_AUTO);
+    PyModule_AddIntConstant(m, "MODEL_THERMAL", SEEK_MODEL_THERMAL);
+    PyModule_AddIntConstant(m, "MODEL_THERMAL_PRO", SEEK_MODEL_THERMAL_PRO);
+    PyModule_AddIntConstant(m, "RAW", SEEK_LEVEL_RAW);
+    PyModule_AddIntConstant(m, "OFFSET_CORRECTED", SEEK_LEVEL_OFFSET_CORRECTED);
+    PyModule_AddIntConstant(m, "FULLY_CORRECTED", SEEK_LEVEL_FULLY_CORRECTED);
+
+    return m;
+}
@@ -7,40 +7,49 @@
 #define SEEK_CAM_H
 
 #include <opencv2/opencv.hpp>
-#include "SeekDevice.h"
+#include "SeekCamCore.h"
+#include "SeekRoiStatistics.h"
 
 namespace LibSeek {
 
-class SeekCam
+/*
+ *  OpenCV adapter of SeekCamCore: cv::Mat frames, additional flat field
+ *  calibration loaded from an image file and region statistics
+ */
+class SeekCam: public SeekCamCore
 {
 public:
     /*
      *  Initialize the camera
      *  Returns true on success
      */
-    bool open();
+    virtual bool open();
 
     /*
-     *  Returns true when camera is initialized
+     *  Retrieve the last grabbed 14-bit frame at the given processing level.
+     *  Only the stages needed for the level are run. Each level is computed
+     *  once per grabbed frame and cached, so retrieving the same level again
+     *  only costs a copy
      */
-    bool isOpened();
+    void retrieve(cv::Mat& dst, ProcessingLevel::Enum level=ProcessingLevel::FULLY_CORRECTED);
 
-    /*
-     *  Close the camera
-     */
-    void close();
+    using SeekCamCore::retrieveInto;
 
     /*
-     *  Grab a frame
-     *  Returns true on success
+     *  Same as SeekCamCore::retrieveInto for a preallocated CV_16UC1 matrix
+     *  of width() x height(), dst is never (re)allocated
      */
-    bool grab();
+    bool retrieveInto(cv::Mat& dst, ProcessingLevel::Enum level=ProcessingLevel::FULLY_CORRECTED,
+                      FrameMeta* meta=nullptr) const;
 
     /*
-     *  Retrieve the last grabbed 14-bit frame
-     *  Returns true on success
+     *  Update the statistics of the registered regions directly from the
+     *  last grabbed raw frame. Flat field calibration is only applied to
+     *  the pixels inside the regions and dead pixels are left out instead
+     *  of being interpolated.
+     *  Returns false when the region frame size doesn't match the camera
      */
-    void retrieve(cv::Mat& dst);
+    bool retrieveRoiStatistics(SeekRoiStatistics& rois);
 
     /*
      *  Convert a 14-bit thermal measurement to an
@@ -52,44 +61,23 @@ public:
      *  Read grabs and retrieves a frame
      *  Returns true on success
      */
-    bool read(cv::Mat& dst);
-
-    /*
-     *  Get the frame counter value
-     */
-    virtual int frame_counter() = 0;
+    bool read(cv::Mat& dst, ProcessingLevel::Enum level=ProcessingLevel::FULLY_CORRECTED);
 
 protected:
 
-    SeekCam(int vendor_id, int product_id, uint16_t* buffer, size_t raw_height, size_t raw_width, size_t request_size, cv::Rect roi, std::string ffc_filename);
-    ~SeekCam();
+    SeekCam(int vendor_id, int product_id, size_t raw_height, size_t raw_width, size_t request_size,
+            int roi_x, int roi_y, int width, int height, std::string ffc_filename);
 
-    virtual bool init_cam() = 0;
-    virtual int frame_id() = 0;
-    bool open_cam();
-    bool get_frame();
-    void print_usb_data(std::vector<uint8_t>& data);
-    void create_dead_pixel_list(cv::Mat frame, cv::Mat& dead_pixel_mask,
-                                            std::vector<cv::Point>& dead_pixel_list);
-    void apply_dead_pixel_filter(cv::Mat& src, cv::Mat& dst);
-    uint16_t calc_mean_value(cv::Mat& img, cv::Point p, uint32_t dead_pixel_marker);
+    const cv::Mat& processed_frame(ProcessingLevel::Enum level);
 
     /*
      *  Variables
      */
-    const int m_offset;
-
     std::string m_ffc_filename;
-    bool m_is_opened;
-    SeekDevice m_dev;
-    uint16_t* m_raw_data;
-    size_t m_raw_data_size;
-    size_t m_request_size;
-    cv::Mat m_raw_frame;
-    cv::Mat m_flat_field_calibration_frame;
-    cv::Mat m_additional_ffc;
-    cv::Mat m_dead_pixel_mask;
-    std::vector<cv::Point> m_dead_pixel_list;
+    cv::Mat m_raw_frame;                /* image part of the raw frame buffer */
+    cv::Mat m_level_frame[ProcessingLevel::NUM_LEVELS];
+    uint64_t m_level_sequence[ProcessingLevel::NUM_LEVELS];   /* frame sequence + 1 of the cached level, 0 if none */
+    std::vector<uint16_t> m_roi_row;
 };
 
 } /* LibSeek */
@@ -0,0 +1,387 @@
+/*
+ *  Seek camera core
+ */
+
+#include "SeekCamCore.h"
+#include "SeekLogging.h"
+#include "SeekMetrics.h"
+#include "SeekTrace.h"
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+
+using namespace LibSeek;
+
+static const size_t cache_line_size = 64;
+
+/* reserve size words in storage and return the first cache line aligned word */
+static uint16_t* aligned_buffer(std::vector<uint16_t>& storage, size_t size)
+{
+    storage.resize(size + cache_line_size / sizeof(uint16_t));
+    const uintptr_t p = reinterpret_cast<uintptr_t>(storage.data());
+    return reinterpret_cast<uint16_t*>((p + cache_line_size - 1) & ~(cache_line_size - 1));
+}
+
+SeekCamCore::SeekCamCore(int vendor_id, int product_id, size_t raw_height, size_t raw_width, size_t request_size,
+                         int roi_x, int roi_y, int width, int height) :
+    m_offset(0x4000),
+    m_product_id(product_id),
+    m_is_opened(false),
+    m_dev(vendor_id, product_id),
+    m_raw_storage(),
+    m_raw_data(aligned_buffer(m_raw_storage, raw_height * raw_width)),
+    m_raw_data_size(raw_height * raw_width),
+    m_raw_width(raw_width),
+    m_request_size(request_size),
+    m_roi_x(roi_x),
+    m_roi_y(roi_y),
+    m_width(width),
+    m_height(height),
+    m_meta(),
+    m_sequence(0),
+    m_flat_field_calibration_frame(width * height),
+    m_has_flat_field_calibration(false),
+    m_additional_ffc(),
+    m_dead_pixel_mask(width * height, 255),
+    m_raw_sink(nullptr),
+    m_raw_source(nullptr)
+{
+    /* frame request payload, built once so grabbing doesn't allocate */
+    uint8_t* s = reinterpret_cast<uint8_t*>(&m_raw_data_size);
+    m_frame_request.assign(s, s + 4);
+}
+
+SeekCamCore::~SeekCamCore()
+{
+    close();
+}
+
+bool SeekCamCore::open()
+{
+    return open_cam();
+}
+
+void SeekCamCore::close()
+{
+    if (m_dev.isOpened()) {
+        std::vector<uint8_t> data = { 0x00, 0x00 };
+        m_dev.request_set(DeviceCommand::SET_OPERATION_MODE, data);
+        m_dev.request_set(DeviceCommand::SET_OPERATION_MODE, data);
+        m_dev.request_set(DeviceCommand::SET_OPERATION_MODE, data);
+        m_dev.close();
+    }
+    m_is_opened = false;
+}
+
+bool SeekCamCore::isOpened()
+{
+    return m_is_opened;
+}
+
+const FrameMeta& SeekCamCore::meta() const
+{
+    return m_meta;
+}
+
+int SeekCamCore::frame_counter() const
+{
+    return m_meta.frame_counter;
+}
+
+int SeekCamCore::width() const
+{
+    return m_width;
+}
+
+int SeekCamCore::height() const
+{
+    return m_height;
+}
+
+int SeekCamCore::raw_width() const
+{
+    return m_raw_width;
+}
+
+int SeekCamCore::raw_height() const
+{
+    return m_raw_data_size / m_raw_width;
+}
+
+int SeekCamCore::product_id() const
+{
+    return m_product_id;
+}
+
+void SeekCamCore::setRawFrameSink(RawFrameSink* sink)
+{
+    m_raw_sink = sink;
+}
+
+void SeekCamCore::setUsbDevice(std::shared_ptr<UsbDevice> device)
+{
+    m_dev.setDevice(device);
+}
+
+void SeekCamCore::setRawFrameSource(RawFrameSource* source)
+{
+    m_raw_source = source;
+}
+
+const std::vector<uint8_t>& SeekCamCore::factory_settings() const
+{
+    return m_factory_settings;
+}
+
+bool SeekCamCore::grab()
+{
+    int i, y;
+    bool shutter = false;
+
+    SEEK_TRACE_SCOPE("grab");
+    SEEK_METRIC_SCOPE(MetricStage::GRAB);
+
+    for (i=0; i<40; i++) {
+        if(!get_frame()) {
+            metric_add(MetricCounter::GRAB_ERRORS);
+            error("Error: frame acquisition failed\n");
+            return false;
+        }
+
+        if (m_meta.frame_id == FrameType::IMAGE) {
+            m_meta.frames_skipped = i;
+            m_meta.shutter = shutter;
+            metric_add(MetricCounter::FRAMES_CAPTURED);
+            metric_add(MetricCounter::FRAMES_SKIPPED, i);
+            return true;
+
+        } else if (m_meta.frame_id == FrameType::SHUTTER) {
+            const uint16_t* raw = raw_roi();
+            SEEK_TRACE_INSTANT("shutter");
+            metric_add(MetricCounter::SHUTTER_EVENTS);
+            for (y=0; y<m_height; y++)
+                std::copy(raw + y * m_raw_width, raw + y * m_raw_width + m_width,
+                          m_flat_field_calibration_frame.begin() + y * m_width);
+            m_has_flat_field_calibration = true;
+            shutter = true;
+        }
+    }
+
+    metric_add(MetricCounter::GRAB_ERRORS);
+    metric_add(MetricCounter::FRAMES_SKIPPED, i);
+    return false;
+}
+
+bool SeekCamCore::retrieveInto(uint16_t* dst, size_t step, ProcessingLevel::Enum level, FrameMeta* meta) const
+{
+    const size_t stride = step / sizeof(uint16_t);
+
+    SEEK_TRACE_SCOPE("retrieve");
+    SEEK_METRIC_SCOPE(MetricStage::RETRIEVE);
+
+    if (dst == nullptr || step % sizeof(uint16_t) != 0 || stride < static_cast<size_t>(m_width))
+        return false;
+
+    if (level != ProcessingLevel::RAW && !m_has_flat_field_calibration)
+        return false;
+
+    if (meta != nullptr)
+        *meta = m_meta;
+
+    correct_frame(dst, stride, level);
+
+    return true;
+}
+
+void SeekCamCore::setAdditionalFlatField(const uint16_t* ffc, size_t step)
+{
+    int y;
+    const size_t stride = step / sizeof(uint16_t);
+
+    if (ffc == nullptr) {
+        m_additional_ffc.clear();
+        return;
+    }
+
+    m_additional_ffc.resize(m_width * m_height);
+    for (y=0; y<m_height; y++)
+        std::copy(ffc + y * stride, ffc + y * stride + m_width, m_additional_ffc.begin() + y * m_width);
+}
+
+bool SeekCamCore::open_cam()
+{
+    int i;
+
+    if (m_raw_source == nullptr && !m_dev.open()) {
+        error("Error: open failed\n");
+        return false;
+    }
+
+    /* init retry loop: sometimes cam skips first 512 bytes of first frame (needed for dead pixel filter) */
+    for (i=0; i<3; i++) {
+        /* cam specific configuration */
+        m_factory_settings.clear();
+        if (m_raw_source == nullptr && !init_cam()) {
+            error("Error: init_cam failed\n");
+            return false;
+        }
+
+        if (!get_frame()) {
+            error("Error: first frame acquisition failed, retry attempt %d\n", i+1);
+            continue;
+        }
+
+        if (m_meta.frame_id != FrameType::FIRST) {
+            error("Error: expected first frame to have id 4\n");
+            return false;
+        }
+
+        create_dead_pixel_list();
+
+        if (!grab()) {
+            error("Error: first grab failed\n");
+            return false;
+        }
+
+        m_is_opened = true;
+        return true;
+    }
+
+    error("Error: max init retry count exceeded\n");
+    return false;
+}
+
+bool SeekCamCore::get_frame()
+{
+    if (m_raw_source != nullptr) {
+        FrameMeta source_meta;
+
+        if (!m_raw_source->next_raw_frame(m_raw_data, source_meta))
+            return false;
+
+        parse_header(m_meta);
+        m_meta.timestamp_ns = source_meta.timestamp_ns;
+        m_meta.sequence = source_meta.sequence;
+        m_meta.frames_skipped = 0;
+        m_meta.shutter = false;
+
+        return true;
+    }
+
+    /* request new frame */
+    if (!m_dev.request_set(DeviceCommand::START_GET_IMAGE_TRANSFER, m_frame_request))
+        return false;
+
+    /* store frame data */
+    if (!m_dev.fetch_frame(m_raw_data, m_raw_data_size, m_request_size))
+        return false;
+
+    /* decode the header once, consumers only look at m_meta */
+    const int previous_counter = m_meta.frame_counter;
+    parse_header(m_meta);
+
+    /* frames the camera counted but never delivered, a reset counter (reopen) isn't a gap */
+    const int gap = m_meta.frame_counter - previous_counter - 1;
+    if (m_sequence > 0 && gap > 0 && gap < 1000)
+        metric_add(MetricCounter::FRAMES_DROPPED, gap);
+    m_meta.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    m_meta.sequence = m_sequence++;
+    m_meta.frames_skipped = 0;
+    m_meta.shutter = false;
+
+    if (m_raw_sink != nullptr) {
+        SEEK_TRACE_SCOPE("raw_sink");
+        SEEK_METRIC_SCOPE(MetricStage::RAW_SINK);
+        m_raw_sink->raw_frame(m_raw_data, m_meta);
+    }
+
+    return true;
+}
+
+const uint16_t* SeekCamCore::raw_roi() const
+{
+    return m_raw_data + m_roi_y * m_raw_width + m_roi_x;
+}
+
+void SeekCamCore::print_usb_data(std::vector<uint8_t>& data)
+{
+    std::stringstream ss;
+    std::string out;
+
+    if (!log_enabled(LogLevel::DEBUG))
+        return;
+
+    ss << "Response:";
+    for (size_t i = 0; i < data.size(); i++) {
+        ss << " " << std::uppercase << std::setfill('0') << std::setw(2) << std::hex << static_cast<int>(data[i]);
+    }
+    out = ss.str();
+    debug("%s\n", out.c_str());
+}
+
+void SeekCamCore::store_factory_settings(std::vector<uint8_t>& data)
+{
+    m_factory_settings.insert(m_factory_settings.end(), data.begin(), data.end());
+}
+
+void SeekCamCore::create_dead_pixel_list()
+{
+    int x, y;
+    bool has_unlisted_pixels;
+    int max_value = 0;
+    const uint16_t* frame = raw_roi();
+    std::vector<uint32_t> hist(0x4000, 0);
+    std::vector<uint16_t> tmp(m_width * m_height);
+
+    /* calculate optimal threshold to determine what pixels are dead pixels,
+     * integer histogram of the 14-bit values */
+    for (y=0; y<m_height; y++) {
+        const uint16_t* row = frame + y * m_raw_width;
+
+        for (x=0; x<m_width; x++) {
+            max_value = std::max(max_value, static_cast<int>(row[x]));
+            if (row[x] < 0x4000)
+                hist[row[x]]++;
+        }
+    }
+    hist[0] = 0;                    /* suppres 0th bin since its usual the highest,
+                                    but we don't want this one */
+    const int hist_max_value = std::max_element(hist.begin(), hist.end()) - hist.begin();
+    const int threshold = hist_max_value - (max_value - hist_max_value);
+
+    /* calculate the dead pixels mask */
+    for (y=0; y<m_height; y++) {
+        const uint16_t* row = frame + y * m_raw_width;
+
+        for (x=0; x<m_width; x++) {
+            m_dead_pixel_mask[y * m_width + x] = row[x] > threshold ? 255 : 0;
+            tmp[y * m_width + x] = m_dead_pixel_mask[y * m_width + x];
+        }
+    }
+
+    /* build dead pixel list in a certain order to assure that every dead pixel value
+     * gets an estimated value in the filter stage */
+    m_dead_pixel_list.clear();
+    do {
+        has_unlisted_pixels = false;
+
+        for (y=0; y<m_height; y++) {
+            for (x=0; x<m_width; x++) {
+                const PixelPos p = { x, y };
+
+                if (tmp[y * m_width + x] != 0)
+                    continue;   /* not a dead pixel */
+
+                /* only add pixel to the list if we can estimate its value
+                 * directly from its neighbor pixels */
+                if (dead_pixel_mean(tmp.data(), m_width, m_width, m_height, x, y, 0) != 0) {
+                    m_dead_pixel_list.push_back(p);
+                    tmp[y * m_width + x] = 255;
+                } else
+                    has_unlisted_pixels = true;
+            }
+        }
+    } while (has_unlisted_pixels);
+}
@@ -0,0 +1,228 @@
+/*
+ *  Seek camera core
+ *  Acquisition, flat field calibration, dead pixel correction and frame
+ *  metadata on plain buffers, without any OpenCV dependency
+ */
+
+#ifndef SEEK_CAM_CORE_H
+#define SEEK_CAM_CORE_H
+
+#include <vector>
+#include <cstdint>
+#include "SeekDevice.h"
+#include "SeekCamTraits.h"
+#include "SeekFrameMeta.h"
+#include "SeekProcessing.h"
+
+namespace LibSeek {
+
+struct ProcessingLevel {
+    enum Enum {
+        RAW              = 0,   /* raw sensor values, no correction */
+        OFFSET_CORRECTED = 1,   /* shutter flat field calibration applied */
+        FULLY_CORRECTED  = 2,   /* + dead pixel filter and additional flat field calibration */
+        NUM_LEVELS       = 3,
+    };
+};
+
+/*
+ *  Receives every raw frame fetched from the camera, including shutter
+ *  and first frames, before it is processed. Called on the grabbing thread.
+ *  raw:    raw_width() x raw_height() words, valid during the call
+ *  meta:   frame_id, frame_counter, timestamp_ns and sequence are set
+ */
+class RawFrameSink
+{
+public:
+    virtual ~RawFrameSink() { }
+    virtual void raw_frame(const uint16_t* raw, const FrameMeta& meta) = 0;
+};
+
+/*
+ *  Supplies raw frames instead of the usb device, e.g. to replay a
+ *  recording. The camera is not touched at all while a source is set.
+ */
+class RawFrameSource
+{
+public:
+    virtual ~RawFrameSource() { }
+
+    /*
+     *  Write the next frame into raw (raw_width() x raw_height() words)
+     *  meta:   timestamp_ns and sequence of the frame, the rest is parsed
+     *          from the frame header like for live frames
+     *  Returns false at the end of the frames
+     */
+    virtual bool next_raw_frame(uint16_t* raw, FrameMeta& meta) = 0;
+};
+
+class SeekCamCore
+{
+public:
+    virtual ~SeekCamCore();
+
+    /*
+     *  Initialize the camera
+     *  Returns true on success
+     */
+    virtual bool open();
+
+    /*
+     *  Returns true when camera is initialized
+     */
+    bool isOpened();
+
+    /*
+     *  Close the camera
+     */
+    void close();
+
+    /*
+     *  Grab a frame
+     *  Returns true on success
+     */
+    bool grab();
+
+    /*
+     *  Retrieve the last grabbed frame into a caller provided buffer
+     *  without modifying any camera state and without allocating.
+     *  Safe to call from several threads at once, as long as no grab()
+     *  runs concurrently.
+     *  dst:    width() x height() uint16_t pixels
+     *  step:   distance between rows in bytes
+     *  meta:   if not null, receives the metadata of the frame
+     *  Returns false when the buffer is too small or no frame is available
+     */
+    bool retrieveInto(uint16_t* dst, size_t step,
+                      ProcessingLevel::Enum level=ProcessingLevel::FULLY_CORRECTED,
+                      FrameMeta* meta=nullptr) const;
+
+    /*
+     *  Additional flat field calibration for corner gradient elimination,
+     *  subtracted from each retrieved fully corrected frame.
+     *  ffc:    width() x height() uint16_t pixels, nullptr removes it
+     *  step:   distance between rows in bytes
+     */
+    void setAdditionalFlatField(const uint16_t* ffc, size_t step);
+
+    /*
+     *  Metadata of the last grabbed frame
+     */
+    const FrameMeta& meta() const;
+
+    /*
+     *  Get the frame counter value, same as meta().frame_counter
+     */
+    int frame_counter() const;
+
+    /*
+     *  Size of the retrieved frames
+     */
+    int width() const;
+    int height() const;
+
+    /*
+     *  Size of the raw frames fetched from the camera, in words
+     */
+    int raw_width() const;
+    int raw_height() const;
+
+    /*
+     *  Usb product id of the camera model
+     */
+    int product_id() const;
+
+    /*
+     *  Pass every fetched raw frame to sink, nullptr to stop. Set it before
+     *  open() to include the frames taken during initialization
+     */
+    void setRawFrameSink(RawFrameSink* sink);
+
+    /*
+     *  Open device, found by SeekDevice::find(), instead of enumerating
+     *  the usb bus again in open(). Set it before open()
+     */
+    void setUsbDevice(std::shared_ptr<UsbDevice> device);
+
+    /*
+     *  Take raw frames from source instead of the usb device, nullptr for
+     *  the device again. Set it before open(), which then only runs the
+     *  frame processing part of the initialization
+     */
+    void setRawFrameSource(RawFrameSource* source);
+
+    /*
+     *  Raw factory settings blocks read during initialization,
+     *  concatenated in the order they were requested. Their layout is
+     *  undocumented, they are kept for radiometric calibration tooling.
+     */
+    const std::vector<uint8_t>& factory_settings() const;
+
+protected:
+
+    SeekCamCore(int vendor_id, int product_id, size_t raw_height, size_t raw_width, size_t request_size,
+                int roi_x, int roi_y, int width, int height);
+
+    virtual bool init_cam() = 0;
+
+    /*
+     *  Decode the header of the frame in m_raw_data into meta,
+     *  called once for every fetched frame
+     */
+    virtual void parse_header(FrameMeta& meta) const = 0;
+
+    /*
+     *  Write the last grabbed frame at the given level into dst,
+     *  stride in pixels. The flat field calibration frame is present
+     *  unless level is RAW
+     */
+    virtual void correct_frame(uint16_t* dst, size_t stride, ProcessingLevel::Enum level) const = 0;
+
+    /*
+     *  Usb init sequences of the supported models, selected by traits type
+     */
+    bool init_sequence(const SeekThermalTraits&);
+    bool init_sequence(const SeekThermalProTraits&);
+
+    bool open_cam();
+    bool get_frame();
+    void print_usb_data(std::vector<uint8_t>& data);
+    void store_factory_settings(std::vector<uint8_t>& data);
+    void create_dead_pixel_list();
+
+    /* first pixel of the image part of the raw frame, rows are m_raw_width apart */
+    const uint16_t* raw_roi() const;
+
+    /*
+     *  Variables
+     */
+    const int m_offset;
+    const int m_product_id;
+
+    bool m_is_opened;
+    SeekDevice m_dev;
+    std::vector<uint16_t> m_raw_storage;
+    uint16_t* m_raw_data;               /* cache line aligned, inside m_raw_storage */
+    size_t m_raw_data_size;
+    size_t m_raw_width;
+    size_t m_request_size;
+    int m_roi_x;
+    int m_roi_y;
+    int m_width;
+    int m_height;
+    std::vector<uint8_t> m_frame_request;
+    FrameMeta m_meta;
+    uint64_t m_sequence;
+    std::vector<uint16_t> m_flat_field_calibration_frame;   /* width x height */
+    bool m_has_flat_field_calibration;
+    std::vector<uint16_t> m_additional_ffc;                 /* width x height or empty */
+    std::vector<uint8_t> m_dead_pixel_mask;                 /* width x height, 0 for dead pixels */
+    std::vector<PixelPos> m_dead_pixel_list;
+    std::vector<uint8_t> m_factory_settings;
+    RawFrameSink* m_raw_sink;
+    RawFrameSource* m_raw_source;
+};
+
+} /* LibSeek */
+
+#endif /* SEEK_CAM_CORE_H */
@@ -0,0 +1,80 @@
+/*
+ *  Seek camera factory
+ */
+
+#include "SeekCamFactory.h"
+#include "SeekThermal.h"
+#include "SeekThermalPro.h"
+#include "SeekLogging.h"
+
+using namespace LibSeek;
+
+/* one enumeration of the bus for any of the supported models */
+static std::shared_ptr<UsbDevice> find_camera()
+{
+    const std::vector<int> product_ids = {
+        static_cast<int>(SeekThermalTraits::product_id),
+        static_cast<int>(SeekThermalProTraits::product_id)
+    };
+
+    return SeekDevice::find(SeekThermalTraits::vendor_id, product_ids);
+}
+
+CameraType::Enum SeekCamFactory::detect()
+{
+    const std::shared_ptr<UsbDevice> device = find_camera();
+
+    return device ? fromProductId(device->product_id()) : CameraType::UNKNOWN;
+}
+
+CameraType::Enum SeekCamFactory::fromName(const std::string& name)
+{
+    if (name.empty() || name == "auto")
+        return CameraType::AUTO;
+    if (name == "seek")
+        return CameraType::SEEK_THERMAL;
+    if (name == "seekpro")
+        return CameraType::SEEK_THERMAL_PRO;
+
+    return CameraType::UNKNOWN;
+}
+
+CameraType::Enum SeekCamFactory::fromProductId(int product_id)
+{
+    if (product_id == SeekThermalTraits::product_id)
+        return CameraType::SEEK_THERMAL;
+    if (product_id == SeekThermalProTraits::product_id)
+        return CameraType::SEEK_THERMAL_PRO;
+
+    return CameraType::UNKNOWN;
+}
+
+std::unique_ptr<SeekCam> SeekCamFactory::create(CameraType::Enum type, std::string ffc_filename)
+{
+    std::shared_ptr<UsbDevice> device;
+    std::unique_ptr<SeekCam> cam;
+
+    /* the detected device is handed to the camera, open() doesn't search the bus again */
+    if (type == CameraType::AUTO) {
+        device = find_camera();
+        type = device ? fromProductId(device->product_id()) : CameraType::UNKNOWN;
+        if (type == CameraType::UNKNOWN)
+            error("Error: no supported seek camera found\n");
+    }
+
+    switch (type) {
+    case CameraType::SEEK_THERMAL:
+        cam.reset(new SeekThermal(ffc_filename));
+        break;
+    case CameraType::SEEK_THERMAL_PRO:
+        cam.reset(new SeekThermalPro(ffc_filename));
+        break;
+    default:
+        return cam;
+    }
+
+    if (device)
+        cam->setUsbDevice(device);
+
+    return cam;
+}
@@ -0,0 +1,56 @@
+/*
+ *  Seek camera factory
+ *  Detects the attached camera model and creates only that camera
+ */
+
+#ifndef SEEK_CAM_FACTORY_H
+#define SEEK_CAM_FACTORY_H
+
+#include <memory>
+#include <string>
+#include "SeekCam.h"
+
+namespace LibSeek {
+
+struct CameraType {
+    enum Enum {
+        AUTO             = 0,   /* detect the attached model */
+        SEEK_THERMAL     = 1,
+        SEEK_THERMAL_PRO = 2,
+        UNKNOWN          = 3,
+    };
+};
+
+class SeekCamFactory
+{
+public:
+    /*
+     *  Enumerate the usb bus once and return the model of the first
+     *  attached camera, or UNKNOWN when none is found
+     */
+    static CameraType::Enum detect();
+
+    /*
+     *  Map a camtype name to a model: "seek", "seekpro", or "" / "auto"
+     *  for detection. Returns UNKNOWN for other names
+     */
+    static CameraType::Enum fromName(const std::string& name);
+
+    /*
+     *  Map a usb product id, e.g. of a recording, to a model.
+     *  Returns UNKNOWN for other ids
+     */
+    static CameraType::Enum fromProductId(int product_id);
+
+    /*
+     *  Create a camera of the given model, detecting it first when type is AUTO,
+     *  in which case the camera opens the detected device without enumerating
+     *  the bus again. The camera is not opened. Returns nullptr when no model matches
+     */
+    static std::unique_ptr<SeekCam> create(CameraType::Enum type=CameraType::AUTO,
+                                           std::string ffc_filename=std::string());
+};
+
+} /* LibSeek */
+
+#endif /* SEEK_CAM_FACTORY_H */
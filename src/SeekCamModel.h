@@ -0,0 +1,87 @@
+/*
+ *  Seek camera model base class
+ *  Instantiates the usb init, header parsing and correction pipeline
+ *  of SeekCamCore for the compile time geometry of a model
+ */
+
+#ifndef SEEK_CAM_MODEL_H
+#define SEEK_CAM_MODEL_H
+
+#include <algorithm>
+#include <utility>
+#include "SeekCamCore.h"
+#include "SeekCamTraits.h"
+
+namespace LibSeek {
+
+/*
+ *  Traits: one of the model traits in SeekCamTraits.h
+ *  Base:   SeekCamCore, or a class derived from it adding an API
+ *          (e.g. SeekCam). Extra constructor arguments are passed
+ *          on to Base after the model geometry
+ */
+template<class Traits, class Base=SeekCamCore>
+class SeekCamModel: public Base
+{
+public:
+    template<typename... Args>
+    explicit SeekCamModel(Args&&... args) :
+        Base(Traits::vendor_id, Traits::product_id,
+             Traits::raw_height, Traits::raw_width, Traits::request_size,
+             Traits::roi_x, Traits::roi_y, Traits::width, Traits::height,
+             std::forward<Args>(args)...)
+    { }
+
+protected:
+    virtual bool init_cam()
+    {
+        return this->init_sequence(Traits());
+    }
+
+    virtual void parse_header(FrameMeta& meta) const
+    {
+        meta.frame_id = this->m_raw_data[Traits::frame_id_word];
+        meta.frame_counter = this->m_raw_data[Traits::frame_counter_word];
+    }
+
+    virtual void correct_frame(uint16_t* dst, size_t stride, ProcessingLevel::Enum level) const
+    {
+        const uint16_t* raw = this->m_raw_data + Traits::roi_y * Traits::raw_width + Traits::roi_x;
+
+        if (level == ProcessingLevel::RAW) {
+            for (int y=0; y<Traits::height; y++)
+                std::copy(raw + y * Traits::raw_width, raw + y * Traits::raw_width + Traits::width,
+                          dst + y * stride);
+            return;
+        }
+
+        /* apply flat field calibration */
+        offset_correction<Traits::width, Traits::height>(
+                    raw, Traits::raw_width,
+                    this->m_flat_field_calibration_frame.data(), Traits::width,
+                    dst, stride, this->m_offset);
+
+        if (level == ProcessingLevel::OFFSET_CORRECTED)
+            return;
+
+        /* filter out dead pixels */
+        dead_pixel_filter(dst, stride, Traits::width, Traits::height,
+                          this->m_dead_pixel_list.data(), this->m_dead_pixel_list.size());
+
+        /* apply additional flat field calibration for degradient */
+        if (!this->m_additional_ffc.empty()) {
+            offset_correction<Traits::width, Traits::height>(
+                        dst, stride,
+                        this->m_additional_ffc.data(), Traits::width,
+                        dst, stride, this->m_offset);
+        }
+    }
+};
+
+/* OpenCV free cameras */
+typedef SeekCamModel<SeekThermalTraits> SeekThermalCore;
+typedef SeekCamModel<SeekThermalProTraits> SeekThermalProCore;
+
+} /* LibSeek */
+
+#endif /* SEEK_CAM_MODEL_H */
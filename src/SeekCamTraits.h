@@ -0,0 +1,66 @@
+/*
+ *  Seek camera model traits
+ *  Compile time geometry and header layout of the supported models
+ */
+
+#ifndef SEEK_CAM_TRAITS_H
+#define SEEK_CAM_TRAITS_H
+
+#include <cstddef>
+
+#define THERMAL_WIDTH       207
+#define THERMAL_HEIGHT      154
+#define THERMAL_RAW_WIDTH   208
+#define THERMAL_RAW_HEIGHT  156
+#define THERMAL_REQUEST_SIZE 16224
+#define THERMAL_RAW_SIZE    (THERMAL_RAW_WIDTH * THERMAL_RAW_HEIGHT)
+
+#define THERMAL_PRO_WIDTH       320
+#define THERMAL_PRO_HEIGHT      240
+#define THERMAL_PRO_RAW_WIDTH   342
+#define THERMAL_PRO_RAW_HEIGHT  260
+#define THERMAL_PRO_REQUEST_SIZE 13680
+#define THERMAL_PRO_RAW_SIZE    (THERMAL_PRO_RAW_WIDTH * THERMAL_PRO_RAW_HEIGHT)
+
+namespace LibSeek {
+
+/*
+ *  Every model provides:
+ *      vendor_id, product_id       USB ids
+ *      raw_width, raw_height       size of the transferred frame, header included
+ *      request_size                size of a single bulk transfer in bytes
+ *      roi_x, roi_y, width, height part of the raw frame holding the image
+ *      frame_id_word               raw frame word holding the FrameType
+ *      frame_counter_word          raw frame word holding the frame counter
+ */
+struct SeekThermalTraits {
+    static constexpr int vendor_id          = 0x289d;
+    static constexpr int product_id         = 0x0010;
+    static constexpr int raw_width          = THERMAL_RAW_WIDTH;
+    static constexpr int raw_height         = THERMAL_RAW_HEIGHT;
+    static constexpr size_t request_size    = THERMAL_REQUEST_SIZE;
+    static constexpr int roi_x              = 0;
+    static constexpr int roi_y              = 1;
+    static constexpr int width              = THERMAL_WIDTH;
+    static constexpr int height             = THERMAL_HEIGHT;
+    static constexpr int frame_id_word      = 10;
+    static constexpr int frame_counter_word = 40;
+};
+
+struct SeekThermalProTraits {
+    static constexpr int vendor_id          = 0x289d;
+    static constexpr int product_id         = 0x0011;
+    static constexpr int raw_width          = THERMAL_PRO_RAW_WIDTH;
+    static constexpr int raw_height         = THERMAL_PRO_RAW_HEIGHT;
+    static constexpr size_t request_size    = THERMAL_PRO_REQUEST_SIZE;
+    static constexpr int roi_x              = 1;
+    static constexpr int roi_y              = 4;
+    static constexpr int width              = THERMAL_PRO_WIDTH;
+    static constexpr int height             = THERMAL_PRO_HEIGHT;
+    static constexpr int frame_id_word      = 2;
+    static constexpr int frame_counter_word = 1;
+};
+
+} /* LibSeek */
+
+#endif /* SEEK_CAM_TRAITS_H */
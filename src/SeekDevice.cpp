@@ -5,19 +5,74 @@
 
 #include "SeekDevice.h"
 #include "SeekLogging.h"
+#include "SeekMetrics.h"
+#include "SeekTrace.h"
 #include <libusb.h>
 #include <endian.h>
 #include <stdio.h>
+#include <algorithm>
 
 using namespace LibSeek;
 
+/* largest control transfer payload used by the cameras */
+static const size_t max_ctrl_data_size = 64;
+
+static void LIBUSB_CALL transfer_done(struct libusb_transfer* transfer)
+{
+    *static_cast<int*>(transfer->user_data) = 1;
+}
+
+static const char* transfer_status_name(int status)
+{
+    switch (status) {
+    case LIBUSB_TRANSFER_COMPLETED:     return "LIBUSB_TRANSFER_COMPLETED";
+    case LIBUSB_TRANSFER_ERROR:         return "LIBUSB_TRANSFER_ERROR";
+    case LIBUSB_TRANSFER_TIMED_OUT:     return "LIBUSB_TRANSFER_TIMED_OUT";
+    case LIBUSB_TRANSFER_CANCELLED:     return "LIBUSB_TRANSFER_CANCELLED";
+    case LIBUSB_TRANSFER_STALL:         return "LIBUSB_TRANSFER_STALL";
+    case LIBUSB_TRANSFER_NO_DEVICE:     return "LIBUSB_TRANSFER_NO_DEVICE";
+    case LIBUSB_TRANSFER_OVERFLOW:      return "LIBUSB_TRANSFER_OVERFLOW";
+    default:                            return "unknown transfer status";
+    }
+}
+
+UsbDevice::UsbDevice(struct libusb_context* ctx, struct libusb_device* device, int product_id) :
+    m_ctx(ctx),
+    m_device(libusb_ref_device(device)),
+    m_product_id(product_id)
+{ }
+
+UsbDevice::~UsbDevice()
+{
+    libusb_unref_device(m_device);
+    libusb_exit(m_ctx);
+}
+
+struct libusb_context* UsbDevice::context() const
+{
+    return m_ctx;
+}
+
+struct libusb_device* UsbDevice::device() const
+{
+    return m_device;
+}
+
+int UsbDevice::product_id() const
+{
+    return m_product_id;
+}
+
 SeekDevice::SeekDevice(int vendor_id, int product_id, int timeout) :
     m_vendor_id(vendor_id),
     m_product_id(product_id),
     m_timeout(timeout),
     m_is_opened(false),
     m_ctx(nullptr),
-    m_handle(nullptr) { }
+    m_handle(nullptr),
+    m_bulk_transfer(nullptr),
+    m_ctrl_transfer(nullptr),
+    m_ctrl_buffer(LIBUSB_CONTROL_SETUP_SIZE + max_ctrl_data_size) { }
 
 SeekDevice::~SeekDevice()
 {
@@ -36,16 +91,27 @@ bool SeekDevice::open()
 
     //libusb_set_debug(NULL, LIBUSB_LOG_LEVEL_WARNING);
 
-    // Init libusb
-    res = libusb_init(&m_ctx);
-    if (res < 0) {
-        error("Error: libusb init failed: %s\n", libusb_error_name(res));
-        return false;
-    }
+    if (m_device) {
+        /* found before, open it in the context it was enumerated in */
+        m_ctx = m_device->context();
+        res = libusb_open(m_device->device(), &m_handle);
+        if (res < 0) {
+            error("Error: failed to open device %04x:%04x: %s\n", m_vendor_id, m_product_id, libusb_error_name(res));
+            close();
+            return false;
+        }
+    } else {
+        // Init libusb
+        res = libusb_init(&m_ctx);
+        if (res < 0) {
+            error("Error: libusb init failed: %s\n", libusb_error_name(res));
+            return false;
+        }
 
-    if (!open_device()) {
-        close();
-        return false;
+        if (!open_device()) {
+            close();
+            return false;
+        }
     }
 
     res = libusb_get_configuration(m_handle, &bConfigurationValue);
@@ -72,12 +138,31 @@ bool SeekDevice::open()
         return false;
     }
 
+    m_bulk_transfer = libusb_alloc_transfer(0);
+    m_ctrl_transfer = libusb_alloc_transfer(0);
+    if (m_bulk_transfer == NULL || m_ctrl_transfer == NULL) {
+        error("Error: failed to allocate usb transfers\n");
+        close();
+        return false;
+    }
+
     m_is_opened = true;
     return true;
 }
 
 void SeekDevice::close()
 {
+    /* transfers are never left in flight, so they can be freed right away */
+    if (m_bulk_transfer != NULL) {
+        libusb_free_transfer(m_bulk_transfer);
+        m_bulk_transfer = NULL;
+    }
+
+    if (m_ctrl_transfer != NULL) {
+        libusb_free_transfer(m_ctrl_transfer);
+        m_ctrl_transfer = NULL;
+    }
+
     if (m_handle != NULL) {
         libusb_release_interface(m_handle, 0);  /* release claim */
         libusb_close(m_handle);                 /* revert open */
@@ -85,13 +170,29 @@ void SeekDevice::close()
     }
 
     if (m_ctx != NULL) {
-        libusb_exit(m_ctx);                     /* revert exit */
+        if (!m_device)
+            libusb_exit(m_ctx);                 /* revert init, a found device keeps its context */
         m_ctx = NULL;
     }
 
     m_is_opened = false;
 }
 
+void SeekDevice::setDevice(std::shared_ptr<UsbDevice> device)
+{
+    if (m_handle != NULL) {
+        error("Error: SeekDevice already opened\n");
+        return;
+    }
+
+    if (device && device->product_id() != m_product_id) {
+        error("Error: found device %04x is not a %04x\n", device->product_id(), m_product_id);
+        return;
+    }
+
+    m_device = device;
+}
+
 bool SeekDevice::isOpened()
 {
     return m_is_opened;
@@ -109,22 +210,39 @@ bool SeekDevice::request_get(DeviceCommand::Enum command, std::vector<uint8_t>&
 
 bool SeekDevice::fetch_frame(uint16_t* buffer, std::size_t size, std::size_t request_size)
 {
-    int res;
+    int status;
     int actual_length;
     int todo = size * sizeof(uint16_t);
     uint8_t* buf = reinterpret_cast<uint8_t*>(buffer);
     int done = 0;
 
+    SEEK_TRACE_SCOPE("usb_fetch_frame");
+    SEEK_METRIC_SCOPE(MetricStage::USB_FETCH);
+
+    if (m_bulk_transfer == NULL) {
+        error("Error: SeekDevice not opened\n");
+        return false;
+    }
+
     while (todo != 0) {
-        debug("Asking for %d B of data at %d\n", request_size, done);
-        res = libusb_bulk_transfer(m_handle, 0x81, &buf[done], request_size, &actual_length, m_timeout);
-        if (res == LIBUSB_ERROR_TIMEOUT)
+        debug("Asking for %zu B of data at %d\n", request_size, done);
+        libusb_fill_bulk_transfer(m_bulk_transfer, m_handle, 0x81, &buf[done], request_size,
+                                  transfer_done, NULL, m_timeout);
+        if (!submit_and_wait(m_bulk_transfer))
+            return false;
+
+        status = m_bulk_transfer->status;
+        if (status == LIBUSB_TRANSFER_TIMED_OUT)
         {
+            SEEK_TRACE_INSTANT("usb_timeout");
+            metric_add(MetricCounter::USB_TIMEOUTS);
             error("Error: LIBUSB_ERROR_TIMEOUT\n");
-        } else if (res != 0) {
-            error("Error: bulk transfer failed: %s\n", libusb_error_name(res));
+        } else if (status != LIBUSB_TRANSFER_COMPLETED) {
+            metric_add(MetricCounter::USB_ERRORS);
+            error("Error: bulk transfer failed: %s\n", transfer_status_name(status));
             return false;
         }
+        actual_length = m_bulk_transfer->actual_length;
         debug("Actual length %d\n", actual_length);
         todo -= actual_length;
         done += actual_length;
@@ -134,6 +252,52 @@ bool SeekDevice::fetch_frame(uint16_t* buffer, std::size_t size, std::size_t req
     return true;
 }
 
+std::shared_ptr<UsbDevice> SeekDevice::find(int vendor_id, const std::vector<int>& product_ids)
+{
+    int res;
+    int idx_dev;
+    int cnt;
+    struct libusb_context* ctx;
+    struct libusb_device **devs;
+    struct libusb_device_descriptor desc;
+    std::shared_ptr<UsbDevice> device;
+
+    res = libusb_init(&ctx);
+    if (res < 0) {
+        error("Error: libusb init failed: %s\n", libusb_error_name(res));
+        return device;
+    }
+
+    cnt = libusb_get_device_list(ctx, &devs);
+    if (cnt < 0) {
+        error("Error: no devices found: %s\n", libusb_error_name(cnt));
+        libusb_exit(ctx);
+        return device;
+    }
+
+    for (idx_dev = 0; idx_dev < cnt && !device; idx_dev++) {
+        if (libusb_get_device_descriptor(devs[idx_dev], &desc) < 0)
+            continue;
+
+        if (desc.idVendor != vendor_id)
+            continue;
+
+        for (int id : product_ids) {
+            if (desc.idProduct == id) {
+                /* takes over the context, references the device before the list is freed */
+                device.reset(new UsbDevice(ctx, devs[idx_dev], id));
+                break;
+            }
+        }
+    }
+
+    libusb_free_device_list(devs, 1);
+    if (!device)
+        libusb_exit(ctx);
+
+    return device;
+}
+
 bool SeekDevice::open_device()
 {
     int res;
@@ -190,29 +354,79 @@ bool SeekDevice::control_transfer(bool direction, uint8_t req, uint16_t value, u
     int res;
     uint8_t bmRequestType = (direction ? LIBUSB_ENDPOINT_IN : LIBUSB_ENDPOINT_OUT)
                             | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE;
-    if (data.size() == 0) {
-        data.reserve(16);
-    }
-    
-    uint8_t* aData = data.data();
     uint16_t wLength = data.size();
 
+    SEEK_TRACE_SCOPE("usb_control");
+
+    if (m_ctrl_transfer == NULL) {
+        error("Error: SeekDevice not opened\n");
+        return false;
+    }
+
+    if (m_ctrl_buffer.size() < LIBUSB_CONTROL_SETUP_SIZE + wLength)
+        m_ctrl_buffer.resize(LIBUSB_CONTROL_SETUP_SIZE + wLength);
+
+    uint8_t* buffer = m_ctrl_buffer.data();
+    libusb_fill_control_setup(buffer, bmRequestType, req, value, index, wLength);
+    if (!direction)
+        std::copy(data.begin(), data.end(), buffer + LIBUSB_CONTROL_SETUP_SIZE);
+
     // to device
     debug("ctrl_transfer to/from dev(0x%x, 0x%x, 0x%x, 0x%x, %d)\n",
                     bmRequestType, req, value, index, wLength);
 
-    res = libusb_control_transfer(m_handle, bmRequestType, req, value, index, aData, wLength, m_timeout);
+    libusb_fill_control_transfer(m_ctrl_transfer, m_handle, buffer, transfer_done, NULL, m_timeout);
+    if (!submit_and_wait(m_ctrl_transfer))
+        return false;
 
-    if (res < 0) {
-        error("Error: control transfer failed: %s\n", libusb_error_name(res));
+    if (m_ctrl_transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+        metric_add(MetricCounter::USB_ERRORS);
+        error("Error: control transfer failed: %s\n", transfer_status_name(m_ctrl_transfer->status));
         return false;
     }
 
+    res = m_ctrl_transfer->actual_length;
     if (res != wLength) {
         error("Error: control transfer returned %d bytes, expected %d bytes\n", res, wLength);
         return false;
     }
 
+    if (direction)
+        std::copy(buffer + LIBUSB_CONTROL_SETUP_SIZE, buffer + LIBUSB_CONTROL_SETUP_SIZE + res, data.begin());
+
+    return true;
+}
+
+bool SeekDevice::submit_and_wait(struct libusb_transfer* transfer)
+{
+    int res;
+    int completed = 0;
+
+    SEEK_TRACE_SCOPE("usb_wait");
+
+    transfer->user_data = &completed;
+    res = libusb_submit_transfer(transfer);
+    if (res < 0) {
+        metric_add(MetricCounter::USB_ERRORS);
+        error("Error: failed to submit transfer: %s\n", libusb_error_name(res));
+        return false;
+    }
+
+    while (!completed) {
+        res = libusb_handle_events_completed(m_ctx, &completed);
+        if (res < 0 && res != LIBUSB_ERROR_INTERRUPTED) {
+            metric_add(MetricCounter::USB_ERRORS);
+            error("Error: usb event handling failed: %s\n", libusb_error_name(res));
+            /* the transfer has to be reaped before it can be reused or freed */
+            libusb_cancel_transfer(transfer);
+            while (!completed) {
+                if (libusb_handle_events_completed(m_ctx, &completed) < 0)
+                    break;
+            }
+            return false;
+        }
+    }
+
     return true;
 }
 
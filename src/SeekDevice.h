@@ -8,10 +8,13 @@
 
 #include <vector>
 #include <cstdint>
+#include <memory>
 
 /* forward struct declarations for libusb stuff */
 struct libusb_context;
+struct libusb_device;
 struct libusb_device_handle;
+struct libusb_transfer;
 
 namespace LibSeek {
 
@@ -57,6 +60,31 @@ struct DeviceCommand {
     };
 };
 
+/*
+ *  A device found on the bus by SeekDevice::find(). Keeps the libusb
+ *  context it was enumerated in and a reference to the device, so it
+ *  is opened without enumerating the bus again
+ */
+class UsbDevice
+{
+public:
+    UsbDevice(struct libusb_context* ctx, struct libusb_device* device, int product_id);
+
+    ~UsbDevice();
+
+    struct libusb_context* context() const;
+    struct libusb_device* device() const;
+    int product_id() const;
+
+private:
+    UsbDevice(const UsbDevice&);
+    UsbDevice& operator=(const UsbDevice&);
+
+    struct libusb_context* m_ctx;
+    struct libusb_device* m_device;
+    int m_product_id;
+};
+
 class SeekDevice
 {
 public:
@@ -86,6 +114,19 @@ public:
      */
     bool isOpened();
 
+    /*
+     *  Enumerate the usb bus once and return the first attached device of
+     *  vendor_id whose product id is in product_ids, or nullptr when there
+     *  is none
+     */
+    static std::shared_ptr<UsbDevice> find(int vendor_id, const std::vector<int>& product_ids);
+
+    /*
+     *  Open device, found by find(), instead of searching the bus in
+     *  open(). nullptr searches again. Set it while the device is closed
+     */
+    void setDevice(std::shared_ptr<UsbDevice> device);
+
     /*
      *  vendor specific requests for setting data
      *  command:    request command
@@ -117,10 +158,17 @@ private:
     int m_timeout;
     bool m_is_opened;
 
-    struct libusb_context* m_ctx;
+    std::shared_ptr<UsbDevice> m_device;
+    struct libusb_context* m_ctx;       /* m_device's context or our own */
     struct libusb_device_handle* m_handle;
 
+    /* transfers and control buffer are allocated once so requests don't hit the heap */
+    struct libusb_transfer* m_bulk_transfer;
+    struct libusb_transfer* m_ctrl_transfer;
+    std::vector<uint8_t> m_ctrl_buffer;
+
     bool open_device();
+    bool submit_and_wait(struct libusb_transfer* transfer);
     bool control_transfer(bool direction, uint8_t req, uint16_t value, uint16_t index, std::vector<uint8_t>& data);
     void correct_endianness(uint16_t* buffer, std::size_t size);
 };
@@ -0,0 +1,36 @@
+/*
+ *  Seek per frame metadata
+ */
+
+#ifndef SEEK_FRAME_META_H
+#define SEEK_FRAME_META_H
+
+#include <cstdint>
+
+namespace LibSeek {
+
+struct FrameType {
+    enum Enum {
+        SHUTTER     = 1,    /* shutter closed, used as flat field calibration */
+        IMAGE       = 3,    /* regular thermal image */
+        FIRST       = 4,    /* first frame after init, used for the dead pixel list */
+    };
+};
+
+/*
+ *  Metadata of a fetched frame, decoded once from the frame header when
+ *  the frame arrives
+ */
+struct FrameMeta
+{
+    int frame_id;               /* FrameType reported by the camera */
+    int frame_counter;          /* camera frame counter */
+    uint64_t timestamp_ns;      /* host receive time, std::chrono::steady_clock nanoseconds */
+    uint64_t sequence;          /* number of frames fetched from the camera before this one */
+    int frames_skipped;         /* non image frames grab() consumed before this frame */
+    bool shutter;               /* a new flat field calibration frame was taken during that grab */
+};
+
+} /* LibSeek */
+
+#endif /* SEEK_FRAME_META_H */
@@ -0,0 +1,439 @@
+/*
+ *  Seek shared memory frame ring
+ */
+
+#include "SeekFrameRing.h"
+#include "SeekLogging.h"
+#include "SeekMetrics.h"
+#include "SeekTrace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace LibSeek;
+
+static const uint32_t ring_magic = 0x47524b53;     /* "SKRG" */
+static const uint32_t ring_version = 1;
+static const size_t cache_line_size = 64;
+static const std::chrono::milliseconds stale_check_interval(250);
+
+/* atomics that fall back to a lock only exclude threads of one process */
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_LONG_LOCK_FREE == 2,
+              "the frame ring needs lock free 64-bit atomics");
+
+/*
+ *  Shared memory layout: RingHeader, then slot_count slots of slot_size
+ *  bytes. A slot is a RingSlot followed by width x height pixels.
+ *  Only fixed size types, readers may be built separately.
+ */
+struct LibSeek::RingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    std::atomic<uint64_t> next_sequence;        /* published frames so far */
+    uint8_t pad[cache_line_size - 32];
+};
+
+struct LibSeek::RingSlot {
+    /* 0: never written, 2 * seq + 1: frame seq being written, 2 * seq + 2: frame seq complete */
+    std::atomic<uint64_t> lock;
+    uint64_t timestamp_ns;
+    uint64_t camera_sequence;
+    int32_t frame_id;
+    int32_t frame_counter;
+    int32_t frames_skipped;
+    int32_t shutter;
+    uint8_t pad[cache_line_size - 40];
+};
+
+static_assert(sizeof(RingHeader) == cache_line_size, "ring header layout");
+static_assert(sizeof(RingSlot) == cache_line_size, "ring slot layout");
+
+static RingSlot* slot_at(RingHeader* header, uint64_t seq)
+{
+    uint8_t* base = reinterpret_cast<uint8_t*>(header + 1);
+    return reinterpret_cast<RingSlot*>(base + (seq % header->slot_count) * header->slot_size);
+}
+
+static const RingSlot* slot_at(const RingHeader* header, uint64_t seq)
+{
+    return slot_at(const_cast<RingHeader*>(header), seq);
+}
+
+static uint16_t* slot_pixels(RingSlot* slot)
+{
+    return reinterpret_cast<uint16_t*>(slot + 1);
+}
+
+static const uint16_t* slot_pixels(const RingSlot* slot)
+{
+    return reinterpret_cast<const uint16_t*>(slot + 1);
+}
+
+/*
+ *  Writer
+ */
+SeekFrameRingWriter::SeekFrameRingWriter() :
+    m_name(),
+    m_map(nullptr),
+    m_map_size(0),
+    m_header(nullptr)
+{ }
+
+SeekFrameRingWriter::~SeekFrameRingWriter()
+{
+    close();
+}
+
+bool SeekFrameRingWriter::create(const std::string& name, int width, int height, int slot_count)
+{
+    int fd;
+    void* map;
+
+    if (width <= 0 || height <= 0 || slot_count <= 0) {
+        error("Error: invalid frame ring size\n");
+        return false;
+    }
+
+    close();
+
+    const size_t frame_size = width * height * sizeof(uint16_t);
+    const size_t slot_size = sizeof(RingSlot) + (frame_size + cache_line_size - 1) / cache_line_size * cache_line_size;
+    const size_t map_size = sizeof(RingHeader) + slot_count * slot_size;
+
+    /* replace a ring left behind by a publisher that didn't exit cleanly */
+    shm_unlink(name.c_str());
+    fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        error("Error: failed to create shared memory object %s\n", name.c_str());
+        return false;
+    }
+
+    if (ftruncate(fd, map_size) != 0) {
+        error("Error: failed to size shared memory object %s\n", name.c_str());
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        error("Error: failed to map shared memory object %s\n", name.c_str());
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    /* ftruncate zero fills, so every slot lock starts at 0 (never written) */
+    m_name = name;
+    m_map = map;
+    m_map_size = map_size;
+    m_header = static_cast<RingHeader*>(map);
+    m_header->width = width;
+    m_header->height = height;
+    m_header->slot_count = slot_count;
+    m_header->slot_size = slot_size;
+    m_header->version = ring_version;
+    m_header->next_sequence.store(0, std::memory_order_relaxed);
+
+    /* readers check the magic last */
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = ring_magic;
+
+    return true;
+}
+
+void SeekFrameRingWriter::close()
+{
+    if (m_map == nullptr)
+        return;
+
+    munmap(m_map, m_map_size);
+    shm_unlink(m_name.c_str());
+    m_map = nullptr;
+    m_map_size = 0;
+    m_header = nullptr;
+}
+
+bool SeekFrameRingWriter::isOpened() const
+{
+    return m_map != nullptr;
+}
+
+uint64_t SeekFrameRingWriter::sequence() const
+{
+    return m_header ? m_header->next_sequence.load(std::memory_order_relaxed) : 0;
+}
+
+uint16_t* SeekFrameRingWriter::begin_write(RingSlot*& slot, uint64_t& seq)
+{
+    seq = m_header->next_sequence.load(std::memory_order_relaxed);
+    slot = slot_at(m_header, seq);
+
+    /* mark the slot as being written before touching its data */
+    slot->lock.store(2 * seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    return slot_pixels(slot);
+}
+
+void SeekFrameRingWriter::end_write(RingSlot* slot, uint64_t seq, const FrameMeta& meta)
+{
+    slot->timestamp_ns = meta.timestamp_ns;
+    slot->camera_sequence = meta.sequence;
+    slot->frame_id = meta.frame_id;
+    slot->frame_counter = meta.frame_counter;
+    slot->frames_skipped = meta.frames_skipped;
+    slot->shutter = meta.shutter;
+
+    slot->lock.store(2 * seq + 2, std::memory_order_release);
+    m_header->next_sequence.store(seq + 1, std::memory_order_release);
+}
+
+bool SeekFrameRingWriter::publish(const SeekCamCore& cam, ProcessingLevel::Enum level)
+{
+    RingSlot* slot;
+    uint64_t seq;
+    FrameMeta meta;
+
+    SEEK_TRACE_SCOPE("ring_publish");
+    SEEK_METRIC_SCOPE(MetricStage::RING_PUBLISH);
+
+    if (m_header == nullptr || cam.width() != static_cast<int>(m_header->width) ||
+            cam.height() != static_cast<int>(m_header->height))
+        return false;
+
+    uint16_t* pixels = begin_write(slot, seq);
+    if (!cam.retrieveInto(pixels, m_header->width * sizeof(uint16_t), level, &meta)) {
+        /* the slot stays marked as being written, seq is reused by the next publish */
+        return false;
+    }
+
+    end_write(slot, seq, meta);
+    return true;
+}
+
+bool SeekFrameRingWriter::publish(const uint16_t* frame, size_t step, const FrameMeta& meta)
+{
+    RingSlot* slot;
+    uint64_t seq;
+    uint32_t y;
+
+    if (m_header == nullptr || frame == nullptr || step < m_header->width * sizeof(uint16_t))
+        return false;
+
+    uint16_t* pixels = begin_write(slot, seq);
+    for (y=0; y<m_header->height; y++)
+        std::memcpy(pixels + y * m_header->width, reinterpret_cast<const uint8_t*>(frame) + y * step,
+                    m_header->width * sizeof(uint16_t));
+
+    end_write(slot, seq, meta);
+    return true;
+}
+
+/*
+ *  Reader
+ */
+SeekFrameRingReader::SeekFrameRingReader() :
+    m_name(),
+    m_map(nullptr),
+    m_map_size(0),
+    m_header(nullptr),
+    m_device(0),
+    m_inode(0),
+    m_next(0),
+    m_dropped(0),
+    m_checked()
+{ }
+
+SeekFrameRingReader::~SeekFrameRingReader()
+{
+    close();
+}
+
+bool SeekFrameRingReader::open(const std::string& name)
+{
+    int fd;
+    void* map;
+    struct stat st;
+
+    close();
+
+    fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        error("Error: no frame ring %s\n", name.c_str());
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(RingHeader)) {
+        error("Error: frame ring %s not initialized\n", name.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        error("Error: failed to map frame ring %s\n", name.c_str());
+        return false;
+    }
+
+    const RingHeader* header = static_cast<const RingHeader*>(map);
+    const uint32_t magic = header->magic;
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (magic != ring_magic || header->version != ring_version ||
+            sizeof(RingHeader) + static_cast<size_t>(header->slot_count) * header->slot_size > static_cast<size_t>(st.st_size)) {
+        error("Error: %s is not a compatible frame ring\n", name.c_str());
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    m_name = name;
+    m_map = map;
+    m_map_size = st.st_size;
+    m_header = header;
+    m_device = st.st_dev;
+    m_inode = st.st_ino;
+    m_next = header->next_sequence.load(std::memory_order_acquire);
+    m_dropped = 0;
+    m_checked = std::chrono::steady_clock::now();
+
+    return true;
+}
+
+void SeekFrameRingReader::close()
+{
+    if (m_map == nullptr)
+        return;
+
+    munmap(const_cast<void*>(m_map), m_map_size);
+    m_map = nullptr;
+    m_map_size = 0;
+    m_header = nullptr;
+}
+
+bool SeekFrameRingReader::isOpened() const
+{
+    return m_map != nullptr;
+}
+
+int SeekFrameRingReader::width() const
+{
+    return m_header ? m_header->width : 0;
+}
+
+int SeekFrameRingReader::height() const
+{
+    return m_header ? m_header->height : 0;
+}
+
+int SeekFrameRingReader::slot_count() const
+{
+    return m_header ? m_header->slot_count : 0;
+}
+
+uint64_t SeekFrameRingReader::latest() const
+{
+    return m_header ? m_header->next_sequence.load(std::memory_order_acquire) : 0;
+}
+
+uint64_t SeekFrameRingReader::dropped() const
+{
+    return m_dropped;
+}
+
+bool SeekFrameRingReader::stale() const
+{
+    int fd;
+    struct stat st;
+    bool same;
+
+    if (m_header == nullptr)
+        return false;
+
+    /* our mapping keeps the old object alive, so a new one never gets its inode */
+    fd = shm_open(m_name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return true;
+
+    same = fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_dev) == m_device &&
+           static_cast<uint64_t>(st.st_ino) == m_inode;
+    ::close(fd);
+
+    return !same;
+}
+
+RingStatus::Enum SeekFrameRingReader::read(uint64_t sequence, uint16_t* dst, size_t step, FrameMeta* meta) const
+{
+    uint32_t y;
+    FrameMeta m;
+
+    if (m_header == nullptr || dst == nullptr || step < m_header->width * sizeof(uint16_t))
+        return RingStatus::ERROR;
+
+    const uint64_t next = m_header->next_sequence.load(std::memory_order_acquire);
+    if (sequence >= next)
+        return RingStatus::NOT_READY;
+    if (next - sequence > m_header->slot_count)
+        return RingStatus::OVERRUN;
+
+    const RingSlot* slot = slot_at(m_header, sequence);
+    const uint64_t lock = slot->lock.load(std::memory_order_acquire);
+    if (lock != 2 * sequence + 2)
+        return RingStatus::OVERRUN;
+
+    m.timestamp_ns = slot->timestamp_ns;
+    m.sequence = slot->camera_sequence;
+    m.frame_id = slot->frame_id;
+    m.frame_counter = slot->frame_counter;
+    m.frames_skipped = slot->frames_skipped;
+    m.shutter = slot->shutter != 0;
+
+    const uint16_t* pixels = slot_pixels(slot);
+    for (y=0; y<m_header->height; y++)
+        std::memcpy(reinterpret_cast<uint8_t*>(dst) + y * step, pixels + y * m_header->width,
+                    m_header->width * sizeof(uint16_t));
+
+    /* the copy is only valid when the writer didn't start on the slot meanwhile */
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->lock.load(std::memory_order_relaxed) != lock)
+        return RingStatus::OVERRUN;
+
+    if (meta != nullptr)
+        *meta = m;
+
+    return RingStatus::OK;
+}
+
+RingStatus::Enum SeekFrameRingReader::read_next(uint16_t* dst, size_t step, FrameMeta* meta)
+{
+    const RingStatus::Enum status = read(m_next, dst, step, meta);
+
+    if (status == RingStatus::OK) {
+        m_next++;
+
+    } else if (status == RingStatus::OVERRUN) {
+        /* continue with the newest frame, it has the most time left before it's overwritten */
+        const uint64_t next = latest();
+        m_dropped += next - 1 - m_next;
+        m_next = next - 1;
+
+    } else if (status == RingStatus::NOT_READY) {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - m_checked >= stale_check_interval) {
+            m_checked = now;
+            if (stale())
+                return RingStatus::STALE;
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,158 @@
+/*
+ *  Seek shared memory frame ring
+ *  Lets one process that owns the camera publish frames to any number of
+ *  local reader processes through a POSIX shared memory object.
+ *
+ *  Every slot is guarded by a sequence lock: the writer never waits for
+ *  readers, readers never write to the ring and detect a frame that was
+ *  overwritten before or while they copied it. POSIX only.
+ */
+
+#ifndef SEEK_FRAME_RING_H
+#define SEEK_FRAME_RING_H
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include "SeekCamCore.h"
+
+namespace LibSeek {
+
+struct RingHeader;
+struct RingSlot;
+
+struct RingStatus {
+    enum Enum {
+        OK          = 0,
+        NOT_READY   = 1,    /* the frame hasn't been published yet */
+        OVERRUN     = 2,    /* the frame was overwritten, the reader is too slow */
+        ERROR       = 3,    /* ring not opened or buffer too small */
+        STALE       = 4,    /* the writer removed the ring or created a new one, open() it again */
+    };
+};
+
+class SeekFrameRingWriter
+{
+public:
+    SeekFrameRingWriter();
+    ~SeekFrameRingWriter();
+
+    /*
+     *  Create the shared memory object and map it
+     *  name:       shared memory object name, e.g. "/seek"
+     *  slot_count: number of frames kept, readers lagging more frames behind overrun
+     *  An existing object with the same name is replaced.
+     *  Returns true on success
+     */
+    bool create(const std::string& name, int width, int height, int slot_count=8);
+
+    /*
+     *  Unmap and remove the shared memory object, mapped readers keep
+     *  their mapping but no new frames arrive
+     */
+    void close();
+
+    bool isOpened() const;
+
+    /*
+     *  Publish the last frame grabbed by cam, retrieved straight into the ring
+     *  Returns false when the ring isn't created, sizes differ or no frame is available
+     */
+    bool publish(const SeekCamCore& cam, ProcessingLevel::Enum level=ProcessingLevel::FULLY_CORRECTED);
+
+    /*
+     *  Publish a frame from a buffer
+     *  step:   distance between rows in bytes
+     */
+    bool publish(const uint16_t* frame, size_t step, const FrameMeta& meta);
+
+    /*
+     *  Ring sequence number the next published frame gets
+     */
+    uint64_t sequence() const;
+
+private:
+    SeekFrameRingWriter(const SeekFrameRingWriter&);
+    SeekFrameRingWriter& operator=(const SeekFrameRingWriter&);
+
+    uint16_t* begin_write(RingSlot*& slot, uint64_t& seq);
+    void end_write(RingSlot* slot, uint64_t seq, const FrameMeta& meta);
+
+    std::string m_name;
+    void* m_map;
+    size_t m_map_size;
+    RingHeader* m_header;
+};
+
+class SeekFrameRingReader
+{
+public:
+    SeekFrameRingReader();
+    ~SeekFrameRingReader();
+
+    /*
+     *  Map an existing ring read only, reading starts with the next
+     *  published frame
+     *  Returns true on success
+     */
+    bool open(const std::string& name);
+
+    void close();
+
+    bool isOpened() const;
+
+    int width() const;
+    int height() const;
+    int slot_count() const;
+
+    /*
+     *  Ring sequence number the next published frame gets
+     */
+    uint64_t latest() const;
+
+    /*
+     *  Copy frame sequence into dst without blocking or retrying
+     *  dst:    width() x height() uint16_t pixels
+     *  step:   distance between rows in bytes
+     *  meta:   if not null, receives the camera metadata of the frame
+     */
+    RingStatus::Enum read(uint64_t sequence, uint16_t* dst, size_t step, FrameMeta* meta=nullptr) const;
+
+    /*
+     *  Copy the frame after the previously read one. On OVERRUN the
+     *  frames that were lost are added to dropped() and the next call
+     *  continues with the newest frame. Poll again on NOT_READY. While
+     *  no frames arrive it checks stale() now and then and returns STALE.
+     */
+    RingStatus::Enum read_next(uint16_t* dst, size_t step, FrameMeta* meta=nullptr);
+
+    /*
+     *  True when the shared memory object under the name isn't the mapped
+     *  one anymore: the writer closed it, or a restarted writer replaced it
+     *  and this mapping gets no more frames. A system call, don't poll it
+     */
+    bool stale() const;
+
+    /*
+     *  Number of frames read_next() skipped because of overruns
+     */
+    uint64_t dropped() const;
+
+private:
+    SeekFrameRingReader(const SeekFrameRingReader&);
+    SeekFrameRingReader& operator=(const SeekFrameRingReader&);
+
+    std::string m_name;
+    const void* m_map;
+    size_t m_map_size;
+    const RingHeader* m_header;
+    uint64_t m_device;                                  /* identity of the mapped object */
+    uint64_t m_inode;
+    uint64_t m_next;
+    uint64_t m_dropped;
+    std::chrono::steady_clock::time_point m_checked;    /* last stale() check of read_next() */
+};
+
+} /* LibSeek */
+
+#endif /* SEEK_FRAME_RING_H */
@@ -0,0 +1,405 @@
+/*
+ *  Seek logger
+ */
+
+#include "SeekLog.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace LibSeek;
+
+#ifdef SEEK_DEBUG
+std::atomic<int> LibSeek::log_current_level(LogLevel::DEBUG);
+#else
+std::atomic<int> LibSeek::log_current_level(LogLevel::ERROR);
+#endif
+
+namespace {
+
+const size_t queue_size = 512;              /* power of 2 */
+const size_t message_size = 240;
+
+struct LogRecord {
+    std::atomic<uint64_t> sequence;         /* position + 1 when filled, position + queue_size when free */
+    uint64_t time_ns;
+    const LogSite* site;
+    uint32_t suppressed;
+    uint32_t thread;
+    int format;
+    bool location;                          /* TEXT with time and location */
+    char message[message_size];
+};
+
+std::atomic<int> log_format(LogFormat::TEXT);
+std::atomic<int> log_rate(20);
+std::atomic<uint32_t> thread_count(0);
+std::atomic<bool> logger_destroyed(false);
+thread_local uint32_t thread_number = 0;
+
+uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* level_name(LogLevel::Enum level)
+{
+    switch (level) {
+    case LogLevel::ERROR:   return "error";
+    case LogLevel::WARNING: return "warning";
+    case LogLevel::INFO:    return "info";
+    case LogLevel::DEBUG:   return "debug";
+    default:                return "off";
+    }
+}
+
+const char* base_name(const char* path)
+{
+    const char* slash = strrchr(path, '/');
+    return slash != nullptr ? slash + 1 : path;
+}
+
+void append_json_string(std::string& out, const char* s)
+{
+    char buf[8];
+
+    out += '"';
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            out += '\\';
+            out += *s;
+        } else if (static_cast<unsigned char>(*s) < 0x20) {
+            snprintf(buf, sizeof(buf), "\\u%04x", *s);
+            out += buf;
+        } else {
+            out += *s;
+        }
+    }
+    out += '"';
+}
+
+/*
+ *  Bounded multi producer queue (per record sequence numbers, after
+ *  D. Vyukov) drained by a single logging thread
+ */
+class Logger
+{
+public:
+    Logger() :
+        m_tail(0),
+        m_head(0),
+        m_written(0),
+        m_dropped(0),
+        m_sleeping(false),
+        m_stop(false),
+        m_handler(nullptr),
+        m_handler_data(nullptr),
+        m_start_ns(now_ns())
+    {
+        for (size_t i = 0; i < queue_size; i++)
+            m_records[i].sequence.store(i, std::memory_order_relaxed);
+        m_thread = std::thread(&Logger::run, this);
+    }
+
+    ~Logger()
+    {
+        m_stop = true;
+        m_wake.notify_one();
+        m_thread.join();
+        logger_destroyed = true;
+    }
+
+    /* returns false when the queue is full */
+    bool push(const LogSite& site, uint32_t suppressed, const char* fmt, va_list args)
+    {
+        LogRecord* record;
+        uint64_t pos = m_tail.load(std::memory_order_relaxed);
+
+        for (;;) {
+            record = &m_records[pos & (queue_size - 1)];
+            const int64_t diff = static_cast<int64_t>(record->sequence.load(std::memory_order_acquire) - pos);
+
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        if (thread_number == 0)
+            thread_number = ++thread_count;
+
+        record->time_ns = now_ns();
+        record->site = &site;
+        record->suppressed = suppressed;
+        record->thread = thread_number;
+        record->format = log_format.load(std::memory_order_relaxed);
+        record->location = log_current_level.load(std::memory_order_relaxed) >= LogLevel::DEBUG;
+        vsnprintf(record->message, message_size, fmt, args);
+        record->sequence.store(pos + 1, std::memory_order_release);
+
+        if (m_sleeping.load(std::memory_order_relaxed))
+            m_wake.notify_one();
+
+        return true;
+    }
+
+    void flush()
+    {
+        const uint64_t tail = m_tail.load(std::memory_order_acquire);
+
+        while (m_written.load(std::memory_order_acquire) < tail) {
+            m_wake.notify_one();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    uint64_t dropped() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+    uint64_t queued() const
+    {
+        const uint64_t written = m_written.load(std::memory_order_relaxed);
+        const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        return tail > written ? tail - written : 0;
+    }
+
+    void set_handler(LogHandler handler, void* user_data)
+    {
+        std::lock_guard<std::mutex> lock(m_handler_mutex);
+        m_handler = handler;
+        m_handler_data = user_data;
+    }
+
+private:
+    void run()
+    {
+        std::string line;
+        char note[64];
+        uint64_t dropped = 0;
+
+        for (;;) {
+            LogRecord& record = m_records[m_head & (queue_size - 1)];
+
+            if (record.sequence.load(std::memory_order_acquire) != m_head + 1) {
+                if (m_stop)
+                    break;
+
+                /* the timeout covers a producer that checked m_sleeping just before it was set */
+                std::unique_lock<std::mutex> lock(m_wake_mutex);
+                m_sleeping.store(true);
+                if (record.sequence.load(std::memory_order_acquire) != m_head + 1 && !m_stop)
+                    m_wake.wait_for(lock, std::chrono::milliseconds(50));
+                m_sleeping.store(false);
+                continue;
+            }
+
+            format(record, line);
+            write(record.site->level, line);
+
+            const uint64_t total = m_dropped.load(std::memory_order_relaxed);
+            if (total != dropped) {
+                snprintf(note, sizeof(note), "%llu log messages dropped, queue full",
+                         static_cast<unsigned long long>(total - dropped));
+                write(LogLevel::WARNING, note);
+                dropped = total;
+            }
+
+            record.sequence.store(m_head + queue_size, std::memory_order_release);
+            m_head++;
+            m_written.store(m_head, std::memory_order_release);
+        }
+    }
+
+    void format(const LogRecord& record, std::string& line)
+    {
+        char buf[64];
+        const LogSite& site = *record.site;
+        size_t length = strlen(record.message);
+
+        /* the library messages end with a newline, the writer adds its own */
+        while (length > 0 && record.message[length - 1] == '\n')
+            length--;
+        const std::string message(record.message, length);
+        const double seconds = (record.time_ns - m_start_ns) / 1e9;
+
+        line.clear();
+        if (record.format == LogFormat::JSON) {
+            snprintf(buf, sizeof(buf), "{\"time\":%.6f,\"level\":", seconds);
+            line += buf;
+            append_json_string(line, level_name(site.level));
+            snprintf(buf, sizeof(buf), ",\"thread\":%u,\"file\":", record.thread);
+            line += buf;
+            append_json_string(line, base_name(site.file));
+            snprintf(buf, sizeof(buf), ",\"line\":%d,\"function\":", site.line);
+            line += buf;
+            append_json_string(line, site.func);
+            line += ",\"message\":";
+            append_json_string(line, message.c_str());
+            if (record.suppressed != 0) {
+                snprintf(buf, sizeof(buf), ",\"suppressed\":%u", record.suppressed);
+                line += buf;
+            }
+            line += '}';
+            return;
+        }
+
+        if (record.location) {
+            snprintf(buf, sizeof(buf), "[%12.6f] %u ", seconds, record.thread);
+            line += buf;
+            line += base_name(site.file);
+            snprintf(buf, sizeof(buf), ":%d:", site.line);
+            line += buf;
+            line += site.func;
+            line += "(): ";
+        }
+        line += message;
+        if (record.suppressed != 0) {
+            snprintf(buf, sizeof(buf), " (%u similar messages suppressed)", record.suppressed);
+            line += buf;
+        }
+    }
+
+    void write(LogLevel::Enum level, const std::string& line)
+    {
+        std::lock_guard<std::mutex> lock(m_handler_mutex);
+
+        if (m_handler != nullptr) {
+            m_handler(level, line.c_str(), m_handler_data);
+        } else {
+            fprintf(stderr, "%s\n", line.c_str());
+            fflush(stderr);
+        }
+    }
+
+    LogRecord m_records[queue_size];
+    std::atomic<uint64_t> m_tail;           /* next position to fill */
+    uint64_t m_head;                        /* next position to write, logging thread only */
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<bool> m_sleeping;
+    std::atomic<bool> m_stop;
+    std::mutex m_wake_mutex;
+    std::condition_variable m_wake;
+    std::mutex m_handler_mutex;
+    LogHandler m_handler;
+    void* m_handler_data;
+    const uint64_t m_start_ns;
+    std::thread m_thread;
+};
+
+Logger& logger()
+{
+    static Logger instance;
+    return instance;
+}
+
+/* environment settings, applied before main */
+bool read_environment()
+{
+    const char* level = getenv("SEEK_LOG_LEVEL");
+    const char* format = getenv("SEEK_LOG_FORMAT");
+    const char* rate = getenv("SEEK_LOG_RATE");
+    int i;
+
+    for (i = LogLevel::OFF; level != nullptr && i <= LogLevel::DEBUG; i++) {
+        if (strcmp(level, level_name(static_cast<LogLevel::Enum>(i))) == 0)
+            log_current_level.store(i);
+    }
+    if (format != nullptr && strcmp(format, "json") == 0)
+        log_format.store(LogFormat::JSON);
+    if (rate != nullptr)
+        log_rate.store(atoi(rate));
+
+    return true;
+}
+
+const bool environment_read = read_environment();
+
+} /* namespace */
+
+void LibSeek::log_set_level(LogLevel::Enum level)
+{
+    log_current_level.store(level, std::memory_order_relaxed);
+}
+
+LogLevel::Enum LibSeek::log_level()
+{
+    return static_cast<LogLevel::Enum>(log_current_level.load(std::memory_order_relaxed));
+}
+
+void LibSeek::log_set_format(LogFormat::Enum format)
+{
+    log_format.store(format, std::memory_order_relaxed);
+}
+
+void LibSeek::log_set_rate_limit(int messages_per_second)
+{
+    log_rate.store(messages_per_second, std::memory_order_relaxed);
+}
+
+void LibSeek::log_set_handler(LogHandler handler, void* user_data)
+{
+    if (!logger_destroyed)
+        logger().set_handler(handler, user_data);
+}
+
+void LibSeek::log_flush()
+{
+    if (!logger_destroyed)
+        logger().flush();
+}
+
+uint64_t LibSeek::log_dropped()
+{
+    return logger_destroyed ? 0 : logger().dropped();
+}
+
+uint64_t LibSeek::log_queued()
+{
+    return logger_destroyed ? 0 : logger().queued();
+}
+
+void LibSeek::log_write(LogSite& site, const char* fmt, ...)
+{
+    va_list args;
+    uint32_t suppressed = 0;
+    const uint64_t now = now_ns();
+    const uint64_t second = now / 1000000000;
+    const int rate = log_rate.load(std::memory_order_relaxed);
+
+    (void)environment_read;
+
+    /* rate limit per message site, racy between threads but never blocking */
+    if (site.window.load(std::memory_order_relaxed) != second) {
+        site.window.store(second, std::memory_order_relaxed);
+        site.count.store(0, std::memory_order_relaxed);
+    }
+    if (rate > 0 && site.count.fetch_add(1, std::memory_order_relaxed) >= static_cast<uint32_t>(rate)) {
+        site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+
+    va_start(args, fmt);
+    if (!logger_destroyed) {
+        logger().push(site, suppressed, fmt, args);
+    } else {
+        /* from static destructors running after the logger's */
+        vfprintf(stderr, fmt, args);
+    }
+    va_end(args);
+}
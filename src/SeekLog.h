@@ -0,0 +1,109 @@
+/*
+ *  Seek logger
+ *  Messages of the library are formatted by the calling thread into a
+ *  lock free queue and written by a background thread, so logging never
+ *  waits for the terminal or a file. The queue drops messages instead of
+ *  blocking when it is full, and every message site is rate limited, so
+ *  an error storm (e.g. usb timeouts) can't flood the output.
+ *
+ *  The level, format and rate limit can also be set with the environment
+ *  variables SEEK_LOG_LEVEL (off, error, warning, info, debug),
+ *  SEEK_LOG_FORMAT (text, json) and SEEK_LOG_RATE (messages per second).
+ */
+
+#ifndef SEEK_LOG_H
+#define SEEK_LOG_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace LibSeek {
+
+struct LogLevel {
+    enum Enum {
+        OFF     = 0,
+        ERROR   = 1,
+        WARNING = 2,
+        INFO    = 3,
+        DEBUG   = 4,
+    };
+};
+
+struct LogFormat {
+    enum Enum {
+        TEXT    = 0,    /* the message, prefixed with time and location at DEBUG level */
+        JSON    = 1,    /* a JSON object per line with time, level, thread and location */
+    };
+};
+
+/*
+ *  Called by the logging thread for every message instead of writing to stderr
+ *  line:   formatted according to the LogFormat, without newline
+ */
+typedef void (*LogHandler)(LogLevel::Enum level, const char* line, void* user_data);
+
+/*
+ *  Messages above level are discarded at the call site, default ERROR
+ *  (DEBUG when built with WITH_DEBUG_VERBOSITY)
+ */
+void log_set_level(LogLevel::Enum level);
+LogLevel::Enum log_level();
+
+void log_set_format(LogFormat::Enum format);
+
+/*
+ *  Messages per second written for every message site, the others are
+ *  counted and reported with the next message written. 0 for no limit,
+ *  default 20
+ */
+void log_set_rate_limit(int messages_per_second);
+
+/*
+ *  handler:    nullptr writes to stderr again
+ */
+void log_set_handler(LogHandler handler, void* user_data);
+
+/*
+ *  Wait until all queued messages are written
+ */
+void log_flush();
+
+/*
+ *  Messages lost because the queue was full
+ */
+uint64_t log_dropped();
+
+/*
+ *  Messages waiting for the logging thread
+ */
+uint64_t log_queued();
+
+/*
+ *  Used by the macros in SeekLogging.h
+ */
+struct LogSite {
+    const char* file;
+    int line;
+    const char* func;
+    LogLevel::Enum level;
+    std::atomic<uint64_t> window;       /* second of the rate limit window */
+    std::atomic<uint32_t> count;        /* messages in the window */
+    std::atomic<uint32_t> suppressed;   /* messages dropped by the rate limit, not reported yet */
+};
+
+extern std::atomic<int> log_current_level;
+
+inline bool log_enabled(LogLevel::Enum level)
+{
+    return level <= log_current_level.load(std::memory_order_relaxed);
+}
+
+#ifdef __GNUC__
+void log_write(LogSite& site, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+#else
+void log_write(LogSite& site, const char* fmt, ...);
+#endif
+
+} /* LibSeek */
+
+#endif /* SEEK_LOG_H */
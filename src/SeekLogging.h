@@ -1,20 +1,27 @@
 /*
  *  Seek debug macros
  *  Author: Maarten Vandersteegen
+ *
+ *  Log through SeekLog.h. A disabled level costs an atomic load, the
+ *  arguments aren't evaluated then.
  */
 
 #ifndef SEEK_DEBUG_H
 #define SEEK_DEBUG_H
 
-#include <stdio.h>
+#include "SeekLog.h"
 
+#define seek_log(lvl, fmt, ...) \
+    do { \
+        if (LibSeek::log_enabled(lvl)) { \
+            static LibSeek::LogSite seek_log_site = { __FILE__, __LINE__, __func__, lvl, {0}, {0}, {0} }; \
+            LibSeek::log_write(seek_log_site, fmt, ## __VA_ARGS__); \
+        } \
+    } while (0)
 
-#ifdef SEEK_DEBUG
-#define debug(fmt, ...)     printf("%s:%d:%s(): " fmt, __FILE__, __LINE__, __func__, ## __VA_ARGS__);
-#define error(fmt, ...)     fprintf(stderr, "%s:%d:%s(): " fmt, __FILE__, __LINE__, __func__, ## __VA_ARGS__);
-#else
-#define debug(...)
-#define error(fmt, ...)     fprintf(stderr, fmt, ## __VA_ARGS__);
-#endif
+#define debug(fmt, ...)     seek_log(LibSeek::LogLevel::DEBUG, fmt, ## __VA_ARGS__)
+#define info(fmt, ...)      seek_log(LibSeek::LogLevel::INFO, fmt, ## __VA_ARGS__)
+#define warning(fmt, ...)   seek_log(LibSeek::LogLevel::WARNING, fmt, ## __VA_ARGS__)
+#define error(fmt, ...)     seek_log(LibSeek::LogLevel::ERROR, fmt, ## __VA_ARGS__)
 
 #endif /* SEEK_DEBUG_H */
@@ -0,0 +1,166 @@
+/*
+ *  Seek metrics
+ */
+
+#include "SeekMetrics.h"
+#include "SeekLog.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+
+using namespace LibSeek;
+
+namespace {
+
+struct CounterInfo {
+    const char* name;
+    const char* help;
+};
+
+const CounterInfo counter_info[MetricCounter::COUNT] = {
+    { "seek_frames_captured_total",     "Images returned by grab" },
+    { "seek_frames_skipped_total",      "Non image frames consumed by grab" },
+    { "seek_frames_dropped_total",      "Frames missing in the camera frame counter" },
+    { "seek_grab_errors_total",         "Failed grabs" },
+    { "seek_usb_errors_total",          "Failed usb transfers" },
+    { "seek_usb_timeouts_total",        "Timed out usb bulk transfers" },
+    { "seek_shutter_events_total",      "Flat field calibration frames taken" },
+    { "seek_stream_frames_published_total", "Frames published to the stream servers" },
+    { "seek_stream_frames_dropped_total", "Published frames replaced before they were sent" },
+    { "seek_stream_client_frames_dropped_total", "Frames skipped for stream clients that were behind" },
+};
+
+const CounterInfo gauge_info[MetricGauge::COUNT] = {
+    { "seek_stream_clients",            "Connected tcp clients and udp subscribers" },
+    { "seek_stream_send_queue",         "Tcp clients still sending a frame" },
+};
+
+const char* const stage_names[MetricStage::COUNT] = {
+    "usb_fetch",
+    "grab",
+    "retrieve",
+    "grey_scale",
+    "raw_sink",
+    "ring_publish",
+    "stream_publish",
+};
+
+/* upper bounds, the last bucket is +Inf */
+const int bucket_count = 16;
+const uint64_t bucket_bounds_ns[bucket_count - 1] = {
+    25000, 50000,
+    100000, 250000, 500000,
+    1000000, 2500000, 5000000,
+    10000000, 25000000, 50000000,
+    100000000, 250000000, 500000000,
+    1000000000,
+};
+
+struct Histogram {
+    std::atomic<uint64_t> buckets[bucket_count];  /* not cumulative */
+    std::atomic<uint64_t> sum_ns;
+};
+
+Histogram histograms[MetricStage::COUNT];
+
+void append(std::string& out, const char* fmt, ...)
+{
+    char buf[256];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    out += buf;
+}
+
+void append_header(std::string& out, const char* name, const char* help, const char* type)
+{
+    append(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+} /* namespace */
+
+std::atomic<bool> LibSeek::metrics_active(false);
+std::atomic<uint64_t> LibSeek::metric_counters[MetricCounter::COUNT];
+std::atomic<int64_t> LibSeek::metric_gauges[MetricGauge::COUNT];
+
+void LibSeek::metrics_enable(bool enable)
+{
+    metrics_active.store(enable, std::memory_order_relaxed);
+}
+
+uint64_t LibSeek::metric_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LibSeek::metric_observe(MetricStage::Enum stage, uint64_t duration_ns)
+{
+    Histogram& histogram = histograms[stage];
+    int i = 0;
+
+    while (i < bucket_count - 1 && duration_ns > bucket_bounds_ns[i])
+        i++;
+
+    histogram.buckets[i].fetch_add(1, std::memory_order_relaxed);
+    histogram.sum_ns.fetch_add(duration_ns, std::memory_order_relaxed);
+}
+
+uint64_t LibSeek::metric_value(MetricCounter::Enum counter)
+{
+    return metric_counters[counter].load(std::memory_order_relaxed);
+}
+
+int64_t LibSeek::metric_value(MetricGauge::Enum gauge)
+{
+    return metric_gauges[gauge].load(std::memory_order_relaxed);
+}
+
+std::string LibSeek::metrics_text()
+{
+    int i, j;
+    std::string out;
+
+    out.reserve(8192);
+
+    for (i = 0; i < MetricCounter::COUNT; i++) {
+        append_header(out, counter_info[i].name, counter_info[i].help, "counter");
+        append(out, "%s %llu\n", counter_info[i].name,
+               static_cast<unsigned long long>(metric_counters[i].load(std::memory_order_relaxed)));
+    }
+
+    for (i = 0; i < MetricGauge::COUNT; i++) {
+        append_header(out, gauge_info[i].name, gauge_info[i].help, "gauge");
+        append(out, "%s %lld\n", gauge_info[i].name,
+               static_cast<long long>(metric_gauges[i].load(std::memory_order_relaxed)));
+    }
+
+    append_header(out, "seek_log_queue", "Log messages waiting to be written", "gauge");
+    append(out, "seek_log_queue %llu\n", static_cast<unsigned long long>(log_queued()));
+    append_header(out, "seek_log_messages_dropped_total", "Log messages lost because the queue was full", "counter");
+    append(out, "seek_log_messages_dropped_total %llu\n", static_cast<unsigned long long>(log_dropped()));
+
+    /* the count is the sum of the buckets read, so +Inf always matches it */
+    append_header(out, "seek_stage_duration_seconds", "Time spent in a pipeline stage", "histogram");
+    for (i = 0; i < MetricStage::COUNT; i++) {
+        uint64_t count = 0;
+        const uint64_t sum_ns = histograms[i].sum_ns.load(std::memory_order_relaxed);
+
+        for (j = 0; j < bucket_count; j++) {
+            count += histograms[i].buckets[j].load(std::memory_order_relaxed);
+            if (j < bucket_count - 1)
+                append(out, "seek_stage_duration_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n",
+                       stage_names[i], bucket_bounds_ns[j] / 1e9, static_cast<unsigned long long>(count));
+            else
+                append(out, "seek_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n",
+                       stage_names[i], static_cast<unsigned long long>(count));
+        }
+        append(out, "seek_stage_duration_seconds_sum{stage=\"%s\"} %.9f\n", stage_names[i], sum_ns / 1e9);
+        append(out, "seek_stage_duration_seconds_count{stage=\"%s\"} %llu\n",
+               stage_names[i], static_cast<unsigned long long>(count));
+    }
+
+    return out;
+}
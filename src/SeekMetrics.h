@@ -0,0 +1,123 @@
+/*
+ *  Seek metrics
+ *  Library wide counters, gauges and stage latency histograms, rendered
+ *  in the Prometheus text format. Every update is a relaxed atomic add,
+ *  rendering only loads them, so a scrape never takes a lock the capture
+ *  path waits on. SeekMetricsServer serves them over http.
+ *
+ *  Counters and gauges are always updated. Stage latencies are only
+ *  timed while metrics_enable(true) (or a running SeekMetricsServer),
+ *  otherwise a timed stage costs an atomic load.
+ */
+
+#ifndef SEEK_METRICS_H
+#define SEEK_METRICS_H
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include "SeekScopedTimer.h"
+
+namespace LibSeek {
+
+struct MetricCounter {
+    enum Enum {
+        FRAMES_CAPTURED = 0,        /* images returned by grab() */
+        FRAMES_SKIPPED,             /* non image frames grab() consumed */
+        FRAMES_DROPPED,             /* gaps in the camera frame counter */
+        GRAB_ERRORS,
+        USB_ERRORS,                 /* failed usb transfers */
+        USB_TIMEOUTS,
+        SHUTTER_EVENTS,
+        STREAM_FRAMES_PUBLISHED,
+        STREAM_FRAMES_DROPPED,      /* replaced before the network thread sent them */
+        STREAM_CLIENT_FRAMES_DROPPED,
+        COUNT
+    };
+};
+
+struct MetricGauge {
+    enum Enum {
+        STREAM_CLIENTS = 0,         /* tcp clients and udp subscribers */
+        STREAM_SEND_QUEUE,          /* tcp clients still sending a frame */
+        COUNT
+    };
+};
+
+struct MetricStage {
+    enum Enum {
+        USB_FETCH = 0,
+        GRAB,
+        RETRIEVE,
+        GREY_SCALE,
+        RAW_SINK,
+        RING_PUBLISH,
+        STREAM_PUBLISH,
+        COUNT
+    };
+};
+
+/*
+ *  Time the stages from now on, counters are always kept
+ */
+void metrics_enable(bool enable);
+
+/*
+ *  All metrics in the Prometheus text exposition format (version 0.0.4)
+ */
+std::string metrics_text();
+
+/*
+ *  Current values, e.g. for tests or a status line
+ */
+uint64_t metric_value(MetricCounter::Enum counter);
+int64_t metric_value(MetricGauge::Enum gauge);
+
+/*
+ *  Used by the library, and by applications for their own use of the stages
+ */
+extern std::atomic<bool> metrics_active;
+extern std::atomic<uint64_t> metric_counters[MetricCounter::COUNT];
+extern std::atomic<int64_t> metric_gauges[MetricGauge::COUNT];
+
+inline void metric_add(MetricCounter::Enum counter, uint64_t n=1)
+{
+    metric_counters[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+inline void metric_add(MetricGauge::Enum gauge, int64_t n)
+{
+    metric_gauges[gauge].fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t metric_now_ns();
+
+void metric_observe(MetricStage::Enum stage, uint64_t duration_ns);
+
+struct MetricSink {
+    typedef MetricStage::Enum Key;
+
+    static bool active()
+    {
+        return metrics_active.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t now_ns()
+    {
+        return metric_now_ns();
+    }
+
+    static void record(MetricStage::Enum stage, uint64_t, uint64_t duration_ns)
+    {
+        metric_observe(stage, duration_ns);
+    }
+};
+
+typedef ScopedTimer<MetricSink> MetricTimer;
+
+/* time the rest of the enclosing scope */
+#define SEEK_METRIC_SCOPE(stage)    SEEK_SCOPED_TIMER(LibSeek::MetricTimer, seek_metric_timer_, stage)
+
+} /* LibSeek */
+
+#endif /* SEEK_METRICS_H */
@@ -0,0 +1,215 @@
+/*
+ *  Seek metrics server
+ */
+
+#include "SeekMetricsServer.h"
+#include "SeekLogging.h"
+#include "SeekTrace.h"
+#include <cstring>
+#include <cerrno>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace LibSeek;
+
+/* a scraper that doesn't send its request in time is dropped */
+static const int request_timeout_ms = 2000;
+static const size_t max_request_size = 4096;
+
+static bool send_all(int fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        const ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+SeekMetricsServer::SeekMetricsServer() :
+    m_listen_fd(-1),
+    m_port(-1),
+    m_metrics_were_active(false),
+    m_running(false)
+{
+    m_wake_fds[0] = -1;
+    m_wake_fds[1] = -1;
+}
+
+SeekMetricsServer::~SeekMetricsServer()
+{
+    stop();
+}
+
+bool SeekMetricsServer::start(int port, const std::string& address)
+{
+    int one = 1;
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    stop();
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (port < 0 || inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        error("Error: invalid metrics address %s:%d\n", address.c_str(), port);
+        return false;
+    }
+
+    m_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listen_fd < 0) {
+        error("Error: failed to create metrics socket\n");
+        return false;
+    }
+
+    setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(m_listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(m_listen_fd, 4) != 0 ||
+            getsockname(m_listen_fd, reinterpret_cast<struct sockaddr*>(&addr), &len) != 0) {
+        error("Error: failed to listen on metrics port %s:%d\n", address.c_str(), port);
+        stop();
+        return false;
+    }
+
+    if (pipe(m_wake_fds) != 0) {
+        error("Error: failed to create wake pipe\n");
+        stop();
+        return false;
+    }
+
+    m_port = ntohs(addr.sin_port);
+    m_metrics_were_active = metrics_active.load();
+    metrics_enable(true);
+
+    m_running = true;
+    m_thread = std::thread(&SeekMetricsServer::run, this);
+
+    return true;
+}
+
+void SeekMetricsServer::stop()
+{
+    const bool running = m_running;
+
+    if (running) {
+        const char c = 0;
+        const ssize_t n = write(m_wake_fds[1], &c, 1);
+        (void)n;
+        m_running = false;
+    }
+    if (m_thread.joinable())
+        m_thread.join();
+
+    /* start() enabled stage timing */
+    if (running)
+        metrics_enable(m_metrics_were_active);
+
+    for (int* fd : { &m_listen_fd, &m_wake_fds[0], &m_wake_fds[1] }) {
+        if (*fd >= 0)
+            ::close(*fd);
+        *fd = -1;
+    }
+    m_port = -1;
+}
+
+bool SeekMetricsServer::isRunning() const
+{
+    return m_running;
+}
+
+int SeekMetricsServer::port() const
+{
+    return m_port;
+}
+
+void SeekMetricsServer::run()
+{
+    trace_thread_name("metrics");
+
+    while (m_running) {
+        struct pollfd fds[2] = {
+            { m_wake_fds[0], POLLIN, 0 },
+            { m_listen_fd, POLLIN, 0 },
+        };
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            error("Error: metrics server poll failed\n");
+            break;
+        }
+
+        if (fds[0].revents & POLLIN)
+            break;
+
+        if (fds[1].revents & POLLIN) {
+            const int fd = accept(m_listen_fd, nullptr, nullptr);
+            if (fd >= 0) {
+                serve(fd);
+                ::close(fd);
+            }
+        }
+    }
+}
+
+/* one request per connection, scrapes are rare and small */
+void SeekMetricsServer::serve(int fd)
+{
+    char request[max_request_size + 1];
+    size_t size = 0;
+    struct timeval timeout = { request_timeout_ms / 1000, 0 };
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    /* read up to the end of the request headers */
+    while (size < max_request_size) {
+        const ssize_t n = recv(fd, request + size, max_request_size - size, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        size += n;
+        request[size] = '\0';
+        if (strstr(request, "\r\n\r\n") != nullptr || strstr(request, "\n\n") != nullptr)
+            break;
+    }
+    request[size] = '\0';
+
+    const bool head = strncmp(request, "HEAD ", 5) == 0;
+    const char* path = head ? request + 5 : strncmp(request, "GET ", 4) == 0 ? request + 4 : nullptr;
+    const size_t path_length = path != nullptr ? strcspn(path, " ?\r\n") : 0;
+    std::string status = "200 OK";
+    std::string type = "text/plain; version=0.0.4; charset=utf-8";
+    std::string body;
+
+    if (path == nullptr) {
+        status = "405 Method Not Allowed";
+        type = "text/plain";
+        body = "Only GET is supported\n";
+    } else if (std::string(path, path_length) == "/metrics" || std::string(path, path_length) == "/") {
+        body = metrics_text();
+    } else {
+        status = "404 Not Found";
+        type = "text/plain";
+        body = "Metrics are at /metrics\n";
+    }
+
+    const std::string header = "HTTP/1.1 " + status + "\r\n"
+                               "Content-Type: " + type + "\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                               "Connection: close\r\n\r\n";
+
+    if (send_all(fd, header.data(), header.size()) && !head)
+        send_all(fd, body.data(), body.size());
+}
@@ -0,0 +1,67 @@
+/*
+ *  Seek metrics server
+ *  Minimal http endpoint serving metrics_text() at /metrics for
+ *  Prometheus, from its own thread. A scrape only loads the atomic
+ *  metrics, it never waits for or blocks capture. POSIX only.
+ *
+ *      SeekMetricsServer metrics;
+ *      metrics.start(9100);
+ *      ...
+ *      curl http://localhost:9100/metrics
+ */
+
+#ifndef SEEK_METRICS_SERVER_H
+#define SEEK_METRICS_SERVER_H
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include "SeekMetrics.h"
+
+namespace LibSeek {
+
+class SeekMetricsServer
+{
+public:
+    SeekMetricsServer();
+    ~SeekMetricsServer();
+
+    /*
+     *  Listen and start the server thread, also enables stage timing
+     *  until stop()
+     *  port:       0 for any free port
+     *  address:    ipv4 address to listen on, "0.0.0.0" for all interfaces
+     *  Returns true on success
+     */
+    bool start(int port, const std::string& address="127.0.0.1");
+
+    /*
+     *  Stop the server thread, stage timing is back to what it was before start()
+     */
+    void stop();
+
+    bool isRunning() const;
+
+    /*
+     *  Port actually bound, -1 when not running
+     */
+    int port() const;
+
+private:
+    SeekMetricsServer(const SeekMetricsServer&);
+    SeekMetricsServer& operator=(const SeekMetricsServer&);
+
+    void run();
+    void serve(int fd);
+
+    int m_listen_fd;
+    int m_wake_fds[2];
+    int m_port;
+    bool m_metrics_were_active;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+};
+
+} /* LibSeek */
+
+#endif /* SEEK_METRICS_SERVER_H */
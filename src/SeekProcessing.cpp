@@ -0,0 +1,549 @@
+/*
+ *  Seek frame processing kernels
+ */
+
+#include "SeekProcessing.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace LibSeek;
+
+static const uint32_t dead_pixel_marker = 0xffff;
+
+void LibSeek::offset_correction(const uint16_t* src, size_t src_stride,
+                                const uint16_t* ffc, size_t ffc_stride,
+                                uint16_t* dst, size_t dst_stride,
+                                int width, int height, int offset)
+{
+    int x, y;
+
+    for (y=0; y<height; y++) {
+        const uint16_t* s = src + y * src_stride;
+        const uint16_t* f = ffc + y * ffc_stride;
+        uint16_t* d = dst + y * dst_stride;
+
+        for (x=0; x<width; x++) {
+            const int correction = offset - f[x];
+            const int value = s[x] + (correction < 0 ? 0 : correction);
+            d[x] = value > 0xffff ? 0xffff : value;
+        }
+    }
+}
+
+uint16_t LibSeek::dead_pixel_mean(const uint16_t* img, size_t stride, int width, int height,
+                                  int x, int y, uint32_t dead_pixel_marker)
+{
+    uint32_t value = 0, temp;
+    uint32_t div = 0;
+    const uint16_t* row = img + y * stride;
+
+    if (x != 0) {
+        /* if not on the left border of the image */
+        temp = row[x-1];
+        if (temp != dead_pixel_marker) {
+            value += temp;
+            div++;
+        }
+    }
+    if (x != width - 1) {
+        /* if not on the right border of the image */
+        temp = row[x+1];
+        if (temp != dead_pixel_marker) {
+            value += temp;
+            div++;
+        }
+    }
+    if (y != 0) {
+        /* upper */
+        temp = img[(y-1) * stride + x];
+        if (temp != dead_pixel_marker) {
+            value += temp;
+            div++;
+        }
+    }
+    if (y != height - 1) {
+        /* lower */
+        temp = img[(y+1) * stride + x];
+        if (temp != dead_pixel_marker) {
+            value += temp;
+            div++;
+        }
+    }
+
+    if (div)
+        return (value / div);
+
+    return 0;
+}
+
+void LibSeek::dead_pixel_filter(uint16_t* img, size_t stride, int width, int height,
+                                const PixelPos* dead_pixels, size_t count)
+{
+    size_t i;
+
+    /* mark all dead pixels first so they are never used as a neighbor */
+    for (i=0; i<count; i++)
+        img[dead_pixels[i].y * stride + dead_pixels[i].x] = dead_pixel_marker;
+
+    /* replace dead pixel values with the mean of their non dead surrounding pixels */
+    for (i=0; i<count; i++) {
+        const PixelPos& p = dead_pixels[i];
+        img[p.y * stride + p.x] = dead_pixel_mean(img, stride, width, height, p.x, p.y, dead_pixel_marker);
+    }
+}
+
+void LibSeek::grey_scale(const uint16_t* src, size_t src_stride,
+                         uint8_t* dst, size_t dst_stride, int width, int height)
+{
+#ifdef SEEK_FIXED_POINT
+    grey_scale_fixed(src, src_stride, dst, dst_stride, width, height);
+#else
+    grey_scale_reference(src, src_stride, dst, dst_stride, width, height);
+#endif
+}
+
+static int grey_scale_band(int value, double tmin, double rsize, const int* lower)
+{
+    /* last band whose lower bound doesn't exceed the value */
+    int n = std::min(static_cast<int>((value - tmin) / rsize), 9);
+
+    while (n < 9 && value >= lower[n+1])
+        n++;
+    while (n > 0 && value < lower[n])
+        n--;
+
+    return n;
+}
+
+void LibSeek::grey_scale_reference(const uint16_t* src, size_t src_stride,
+                                   uint8_t* dst, size_t dst_stride, int width, int height)
+{
+    int x, y, n;
+    uint16_t min, max;
+    double tmin, rsize;
+    double rnint;
+    double rnstart = 0;
+    int lower[10], upper[10];
+    size_t count[10] = { 0 };
+    double scale[10], shift[10];
+    const size_t num_of_pixels = width * height;
+
+    min_max(src, src_stride, width, height, &min, &max);
+    tmin = min;
+    rsize = (max - tmin) / 10.0;
+
+    if (rsize == 0) {
+        for (y=0; y<height; y++)
+            std::fill(dst + y * dst_stride, dst + y * dst_stride + width, 0);
+        return;
+    }
+
+    /* inclusive integer bounds of 10 equally sized value bands */
+    for (n=0; n<10; n++) {
+        lower[n] = static_cast<int>(std::ceil(tmin + n * rsize));
+        upper[n] = static_cast<int>(std::floor(tmin + n * rsize + rsize));
+    }
+
+    /* count the pixels of each band, a value on the border of two bands counts for both */
+    for (y=0; y<height; y++) {
+        const uint16_t* in = src + y * src_stride;
+
+        for (x=0; x<width; x++) {
+            const int v = in[x];
+            n = grey_scale_band(v, tmin, rsize, lower);
+            count[n]++;
+            if (n > 0 && v <= upper[n-1])
+                count[n-1]++;
+        }
+    }
+
+    /* each band gets a share of the 256 grey levels proportional to its pixel count */
+    for (n=0; n<10; n++) {
+        /* num_of_pixels_in_range / total_num_of_pixels * 256 */
+        rnint = (count[n] << 8) / num_of_pixels;
+        scale[n] = rnint / rsize;
+        shift[n] = rnstart - (tmin + n * rsize) * scale[n];
+        rnstart += rnint;
+    }
+
+    for (y=0; y<height; y++) {
+        const uint16_t* in = src + y * src_stride;
+        uint8_t* out = dst + y * dst_stride;
+
+        for (x=0; x<width; x++) {
+            const int v = in[x];
+            n = grey_scale_band(v, tmin, rsize, lower);
+            const long value = std::lrint(v * scale[n] + shift[n]);
+            out[x] = value < 0 ? 0 : (value > 255 ? 255 : value);
+        }
+    }
+}
+
+void LibSeek::grey_scale_fixed(const uint16_t* src, size_t src_stride,
+                               uint8_t* dst, size_t dst_stride, int width, int height)
+{
+    int x, y, n;
+    uint16_t min, max;
+    int32_t range;
+    uint32_t rnstart = 0;
+    uint32_t count[10] = { 0 };
+    uint32_t rnint[10], start[10];
+    const uint32_t num_of_pixels = width * height;
+
+    min_max(src, src_stride, width, height, &min, &max);
+    range = max - min;
+
+    if (range == 0) {
+        for (y=0; y<height; y++)
+            std::fill(dst + y * dst_stride, dst + y * dst_stride + width, 0);
+        return;
+    }
+
+    /*
+     * With d = value - min and band size range / 10 everything is exact in
+     * units of 1/10th: the band of d is 10 * d / range and d lies on the
+     * border with the previous band when 10 * d is a multiple of range
+     */
+    for (y=0; y<height; y++) {
+        const uint16_t* in = src + y * src_stride;
+
+        for (x=0; x<width; x++) {
+            const int32_t d10 = (in[x] - min) * 10;
+            n = std::min(d10 / range, 9);
+            count[n]++;
+            if (n > 0 && d10 == n * range)
+                count[n-1]++;
+        }
+    }
+
+    for (n=0; n<10; n++) {
+        rnint[n] = (count[n] << 8) / num_of_pixels;
+        start[n] = rnstart;
+        rnstart += rnint[n];
+    }
+
+    /* value = (d - n * range / 10) * rnint / (range / 10) + rnstart, rounded */
+    for (y=0; y<height; y++) {
+        const uint16_t* in = src + y * src_stride;
+        uint8_t* out = dst + y * dst_stride;
+
+        for (x=0; x<width; x++) {
+            const int32_t d10 = (in[x] - min) * 10;
+            n = std::min(d10 / range, 9);
+            const uint32_t value = ((d10 - n * range) * rnint[n] * 2 + range) / (2 * range) + start[n];
+            out[x] = value > 255 ? 255 : value;
+        }
+    }
+}
+
+void LibSeek::min_max(const uint16_t* img, size_t stride, int width, int height,
+                      uint16_t* min, uint16_t* max)
+{
+    int x, y;
+    uint16_t lo = 0xffff;
+    uint16_t hi = 0;
+
+    for (y=0; y<height; y++) {
+        const uint16_t* row = img + y * stride;
+
+        for (x=0; x<width; x++) {
+            lo = std::min(lo, row[x]);
+            hi = std::max(hi, row[x]);
+        }
+    }
+
+    *min = lo;
+    *max = hi;
+}
+
+void LibSeek::normalize_fixed(uint16_t* img, size_t stride, int width, int height,
+                              uint16_t min, uint16_t max)
+{
+    int x, y;
+    const uint32_t range = max > min ? max - min : 1;
+
+    for (y=0; y<height; y++) {
+        uint16_t* row = img + y * stride;
+
+        for (x=0; x<width; x++) {
+            const uint32_t v = row[x];
+
+            if (v <= min)
+                row[x] = 0;
+            else if (v >= max)
+                row[x] = 0xffff;
+            else
+                row[x] = ((v - min) * 0xffff + range / 2) / range;
+        }
+    }
+}
+
+void LibSeek::convert_to_8bit(const uint16_t* src, size_t src_stride,
+                              uint8_t* dst, size_t dst_stride, int width, int height)
+{
+    int x, y;
+
+    for (y=0; y<height; y++) {
+        const uint16_t* in = src + y * src_stride;
+        uint8_t* out = dst + y * dst_stride;
+
+        for (x=0; x<width; x++) {
+            const uint32_t v = (in[x] + 128u) >> 8;
+            out[x] = v > 255 ? 255 : v;
+        }
+    }
+}
+
+template<int factor>
+static void nearest_colorize_row(const uint8_t* src, int width, const uint8_t* palette, uint8_t* dst)
+{
+    int x, i;
+
+    for (x=0; x<width; x++) {
+        const uint8_t* color = palette + 3 * src[x];
+
+        /* constant trip count, fully unrolled for the common factors */
+        for (i=0; i<factor; i++) {
+            dst[0] = color[0];
+            dst[1] = color[1];
+            dst[2] = color[2];
+            dst += 3;
+        }
+    }
+}
+
+static void nearest_colorize_row(const uint8_t* src, int width, const uint8_t* palette, int factor, uint8_t* dst)
+{
+    int x, i;
+
+    switch (factor) {
+    case 1: nearest_colorize_row<1>(src, width, palette, dst); return;
+    case 2: nearest_colorize_row<2>(src, width, palette, dst); return;
+    case 3: nearest_colorize_row<3>(src, width, palette, dst); return;
+    case 4: nearest_colorize_row<4>(src, width, palette, dst); return;
+    default: break;
+    }
+
+    for (x=0; x<width; x++) {
+        const uint8_t* color = palette + 3 * src[x];
+
+        for (i=0; i<factor; i++) {
+            dst[0] = color[0];
+            dst[1] = color[1];
+            dst[2] = color[2];
+            dst += 3;
+        }
+    }
+}
+
+#if defined(__AVX2__)
+/* largest factor of the vector nearest upscaling, larger ones are rare and run the scalar code */
+static const int max_simd_factor = 8;
+
+/*
+ *  The palette as one 32-bit word per color (the 3 color bytes and a zero),
+ *  so a gather fetches one color per lane without reading past the table
+ */
+static void palette_words(const uint8_t* palette, uint32_t* words)
+{
+    int i;
+
+    for (i=0; i<256; i++)
+        words[i] = palette[3*i] | palette[3*i+1] << 8 | palette[3*i+2] << 16;
+}
+
+/* stores the 8 colors of c as 24 bytes at dst, overwriting the 4 bytes after them */
+static inline void store_colors(uint8_t* dst, __m256i c)
+{
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    c = _mm256_shuffle_epi8(c, pack);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(c));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 12), _mm256_extracti128_si256(c, 1));
+}
+
+/*
+ *  8 source pixels per step: one gather for their colors, then factor
+ *  vectors of 8 output pixels, spread[i] selecting the colors of vector i.
+ *  Returns the number of source pixels done, the rest is left to the
+ *  scalar code
+ */
+static int nearest_colorize_row_avx2(const uint8_t* src, int width, const uint32_t* words,
+                                     int factor, const __m256i* spread, uint8_t* dst)
+{
+    int x, i;
+
+    /* the last store writes 4 bytes past its colors, keep them in the row */
+    for (x=0; (x + 8) * factor + 2 <= width * factor; x+=8) {
+        const __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + x)));
+        const __m256i colors = _mm256_i32gather_epi32(reinterpret_cast<const int*>(words), index, 4);
+
+        for (i=0; i<factor; i++)
+            store_colors(dst + 3 * (x * factor + 8 * i), _mm256_permutevar8x32_epi32(colors, spread[i]));
+    }
+
+    return x;
+}
+
+/*
+ *  Vertical blend of two horizontally interpolated rows and palette lookup,
+ *  8 output pixels per step. Returns the number of pixels done
+ */
+static int bilinear_colorize_row_avx2(const int32_t* r0, const int32_t* r1, int w0, int w1, int shift,
+                                      int width, const uint32_t* words, uint8_t* dst)
+{
+    int x;
+    const __m256i weight0 = _mm256_set1_epi32(w0);
+    const __m256i weight1 = _mm256_set1_epi32(w1);
+    const __m256i round = _mm256_set1_epi32(1 << (shift - 1));
+
+    for (x=0; x + 10 <= width; x+=8) {
+        const __m256i a = _mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(r0 + x)), weight0);
+        const __m256i b = _mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(r1 + x)), weight1);
+        const __m256i value = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(a, b), round), shift);
+
+        store_colors(dst + 3 * x, _mm256_i32gather_epi32(reinterpret_cast<const int*>(words), value, 4));
+    }
+
+    return x;
+}
+#endif /* __AVX2__ */
+
+void LibSeek::upscale_nearest_colorize(const uint8_t* src, size_t src_stride, int width, int height,
+                                       const uint8_t* palette, int factor,
+                                       uint8_t* dst, size_t dst_stride)
+{
+    int y, i;
+    const size_t row_bytes = 3 * width * factor;
+
+#if defined(__AVX2__)
+    uint32_t words[256];
+    __m256i spread[max_simd_factor];
+
+    palette_words(palette, words);
+    for (i=0; i<factor && i<max_simd_factor; i++)
+        spread[i] = _mm256_setr_epi32((8*i + 0) / factor, (8*i + 1) / factor, (8*i + 2) / factor, (8*i + 3) / factor,
+                                      (8*i + 4) / factor, (8*i + 5) / factor, (8*i + 6) / factor, (8*i + 7) / factor);
+#endif
+
+    for (y=0; y<height; y++) {
+        const uint8_t* in = src + y * src_stride;
+        uint8_t* out = dst + y * factor * dst_stride;
+        int x = 0;
+
+        /* colorize one output row, the other rows of the block are plain copies */
+#if defined(__AVX2__)
+        if (factor <= max_simd_factor)
+            x = nearest_colorize_row_avx2(in, width, words, factor, spread, out);
+#endif
+        nearest_colorize_row(in + x, width - x, palette, factor, out + 3 * x * factor);
+        for (i=1; i<factor; i++)
+            std::memcpy(out + i * dst_stride, out, row_bytes);
+    }
+}
+
+static const int resize_coef_bits = 11;
+static const int resize_coef_scale = 1 << resize_coef_bits;
+
+/*
+ *  Source offset and weight of the second tap for output phase p of an
+ *  integer upscale: the output pixel center maps to (p + 0.5) / factor - 0.5
+ */
+static void bilinear_phase(int p, int factor, int* offset, int* weight)
+{
+    const int num = 2 * p + 1 - factor;     /* position * 2 * factor */
+
+    if (num < 0) {
+        *offset = -1;
+        *weight = ((num + 2 * factor) * resize_coef_scale + factor) / (2 * factor);
+    } else {
+        *offset = 0;
+        *weight = (num * resize_coef_scale + factor) / (2 * factor);
+    }
+}
+
+static void bilinear_row(const uint8_t* src, int width, int factor, int32_t* dst)
+{
+    int x, p;
+
+    for (p=0; p<factor; p++) {
+        int offset, w1;
+        bilinear_phase(p, factor, &offset, &w1);
+        const int w0 = resize_coef_scale - w1;
+
+        for (x=0; x<width; x++) {
+            int x0 = x + offset;
+            int x1 = x0 + 1;
+            x0 = x0 < 0 ? 0 : x0;
+            x1 = x1 >= width ? width - 1 : x1;
+            dst[x * factor + p] = src[x0] * w0 + src[x1] * w1;
+        }
+    }
+}
+
+void LibSeek::upscale_bilinear_colorize(const uint8_t* src, size_t src_stride, int width, int height,
+                                        const uint8_t* palette, int factor,
+                                        uint8_t* dst, size_t dst_stride, int32_t* scratch)
+{
+    int y, p, x;
+    const int out_width = width * factor;
+    int32_t* rows[2] = { scratch, scratch + out_width };
+    int cached[2] = { -1, -1 };     /* source row held by each scratch row */
+    const int round = 1 << (2 * resize_coef_bits - 1);
+
+#if defined(__AVX2__)
+    uint32_t words[256];
+    palette_words(palette, words);
+#endif
+
+    for (y=0; y<height; y++) {
+        for (p=0; p<factor; p++) {
+            int offset, w1;
+            bilinear_phase(p, factor, &offset, &w1);
+            const int w0 = resize_coef_scale - w1;
+
+            int y0 = y + offset;
+            int y1 = y0 + 1;
+            y0 = y0 < 0 ? 0 : y0;
+            y1 = y1 >= height ? height - 1 : y1;
+
+            /* horizontally interpolated source rows, each computed once */
+            const int32_t* r0;
+            const int32_t* r1;
+            int slot;
+            for (slot=0; slot<2 && cached[slot]!=y0; slot++);
+            if (slot == 2) {
+                slot = (cached[0] == y1) ? 1 : 0;
+                bilinear_row(src + y0 * src_stride, width, factor, rows[slot]);
+                cached[slot] = y0;
+            }
+            r0 = rows[slot];
+            for (slot=0; slot<2 && cached[slot]!=y1; slot++);
+            if (slot == 2) {
+                slot = (rows[0] == r0) ? 1 : 0;
+                bilinear_row(src + y1 * src_stride, width, factor, rows[slot]);
+                cached[slot] = y1;
+            }
+            r1 = rows[slot];
+
+            uint8_t* out = dst + (y * factor + p) * dst_stride;
+            x = 0;
+#if defined(__AVX2__)
+            x = bilinear_colorize_row_avx2(r0, r1, w0, w1, 2 * resize_coef_bits, out_width, words, out);
+#endif
+            for (; x<out_width; x++) {
+                const int value = (r0[x] * w0 + r1[x] * w1 + round) >> (2 * resize_coef_bits);
+                const uint8_t* color = palette + 3 * value;
+                out[3*x+0] = color[0];
+                out[3*x+1] = color[1];
+                out[3*x+2] = color[2];
+            }
+        }
+    }
+}
@@ -0,0 +1,122 @@
+/*
+ *  Seek frame processing kernels
+ *  Operate on plain uint16_t buffers, strides are in pixels
+ */
+
+#ifndef SEEK_PROCESSING_H
+#define SEEK_PROCESSING_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace LibSeek {
+
+struct PixelPos {
+    int x;
+    int y;
+};
+
+/*
+ *  dst = src + max(offset - ffc, 0), saturated to 0xffff, the same
+ *  saturating arithmetic as the equivalent uint16_t cv::Mat expression.
+ *  src and dst may be the same buffer
+ */
+void offset_correction(const uint16_t* src, size_t src_stride,
+                       const uint16_t* ffc, size_t ffc_stride,
+                       uint16_t* dst, size_t dst_stride,
+                       int width, int height, int offset);
+
+/*
+ *  Same as above for a frame size known at compile time, instantiated
+ *  per camera model so the row loop has a constant trip count
+ */
+template<int Width, int Height>
+inline void offset_correction(const uint16_t* src, size_t src_stride,
+                              const uint16_t* ffc, size_t ffc_stride,
+                              uint16_t* dst, size_t dst_stride, int offset)
+{
+    for (int y=0; y<Height; y++) {
+        const uint16_t* s = src + y * src_stride;
+        const uint16_t* f = ffc + y * ffc_stride;
+        uint16_t* d = dst + y * dst_stride;
+
+        for (int x=0; x<Width; x++) {
+            const int correction = offset - f[x];
+            const int value = s[x] + (correction < 0 ? 0 : correction);
+            d[x] = value > 0xffff ? 0xffff : value;
+        }
+    }
+}
+
+/*
+ *  Mean of the left, right, upper and lower neighbors of (x, y)
+ *  that don't have the dead_pixel_marker value. Returns 0 when
+ *  none of the neighbors qualifies
+ */
+uint16_t dead_pixel_mean(const uint16_t* img, size_t stride, int width, int height,
+                         int x, int y, uint32_t dead_pixel_marker);
+
+/*
+ *  Replace the dead pixels in img, in place, with the mean of their
+ *  non dead neighbors. The list order must guarantee every dead pixel
+ *  has an already estimated or healthy neighbor when it is visited
+ */
+void dead_pixel_filter(uint16_t* img, size_t stride, int width, int height,
+                       const PixelPos* dead_pixels, size_t count);
+
+/*
+ *  Convert a 14-bit frame to an enhanced 8-bit greyscale image: the value
+ *  range is split in 10 equal bands and each band gets a share of the 256
+ *  grey levels proportional to the number of pixels in it.
+ *  grey_scale() runs the integer implementation when built with
+ *  SEEK_FIXED_POINT and the floating point reference otherwise
+ */
+void grey_scale(const uint16_t* src, size_t src_stride,
+                uint8_t* dst, size_t dst_stride, int width, int height);
+void grey_scale_reference(const uint16_t* src, size_t src_stride,
+                          uint8_t* dst, size_t dst_stride, int width, int height);
+void grey_scale_fixed(const uint16_t* src, size_t src_stride,
+                      uint8_t* dst, size_t dst_stride, int width, int height);
+
+/*
+ *  Smallest and largest value of a frame
+ */
+void min_max(const uint16_t* img, size_t stride, int width, int height,
+             uint16_t* min, uint16_t* max);
+
+/*
+ *  Stretch [min, max] linearly to [0, 0xffff] in place, values outside
+ *  the range are clamped. Integer only
+ */
+void normalize_fixed(uint16_t* img, size_t stride, int width, int height,
+                     uint16_t min, uint16_t max);
+
+/*
+ *  dst = round(src / 256). Integer only
+ */
+void convert_to_8bit(const uint16_t* src, size_t src_stride,
+                     uint8_t* dst, size_t dst_stride, int width, int height);
+
+/*
+ *  Upscale an 8-bit frame by an integer factor and map it through a
+ *  palette (256 entries of 3 bytes) in one pass, writing straight into
+ *  dst, a (width * factor) x (height * factor) 3 byte per pixel image.
+ *  A factor of 1 only colorizes.
+ */
+void upscale_nearest_colorize(const uint8_t* src, size_t src_stride, int width, int height,
+                              const uint8_t* palette, int factor,
+                              uint8_t* dst, size_t dst_stride);
+
+/*
+ *  Same as above with bilinear interpolation of the 8-bit values (same
+ *  pixel center convention as cv::resize INTER_LINEAR), 11-bit fixed
+ *  point weights.
+ *  scratch: 2 * width * factor int32_t values
+ */
+void upscale_bilinear_colorize(const uint8_t* src, size_t src_stride, int width, int height,
+                               const uint8_t* palette, int factor,
+                               uint8_t* dst, size_t dst_stride, int32_t* scratch);
+
+} /* LibSeek */
+
+#endif /* SEEK_PROCESSING_H */
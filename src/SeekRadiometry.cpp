@@ -0,0 +1,150 @@
+/*
+ *  Seek radiometric conversion
+ */
+
+#include "SeekRadiometry.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace LibSeek;
+
+static const size_t lut_size = 0x10000;
+static const double kelvin_offset = 273.15;
+
+RadiometricParams::RadiometricParams() :
+    emissivity(1.0),
+    reflected_temp(20.0),
+    planck_r(309300.0),
+    planck_b(1428.0),
+    planck_f(1.0),
+    planck_o(13995.25)
+{ }
+
+SeekRadiometry::SeekRadiometry() :
+    m_params()
+{ }
+
+SeekRadiometry::SeekRadiometry(const RadiometricParams& params) :
+    m_params()
+{
+    build(params);
+}
+
+void SeekRadiometry::build(const RadiometricParams& params)
+{
+    size_t i;
+    const double emissivity = params.emissivity > 0.0 ? std::min(params.emissivity, 1.0) : 1.0;
+    const double refl_kelvin = params.reflected_temp + kelvin_offset;
+    const double refl_signal = params.planck_r / (std::exp(params.planck_b / refl_kelvin) - params.planck_f)
+                                    + params.planck_o;
+
+    m_params = params;
+    m_params.emissivity = emissivity;
+
+    /* one extra entry so the vectorized lookup can always read 32 bits */
+    m_celsius_lut.resize(lut_size);
+    m_centikelvin_lut.resize(lut_size + 1);
+
+    for (i=0; i<lut_size; i++) {
+        const double signal = (i - (1.0 - emissivity) * refl_signal) / emissivity;
+        const double x = signal - params.planck_o;
+        double kelvin = 0.0;
+
+        /* signals at or below the curve offset map to absolute zero */
+        if (x > 0.0) {
+            const double arg = params.planck_r / x + params.planck_f;
+            if (arg > 1.0)
+                kelvin = params.planck_b / std::log(arg);
+        }
+
+        m_celsius_lut[i] = static_cast<float>(kelvin - kelvin_offset);
+        m_centikelvin_lut[i] = static_cast<uint16_t>(std::min(std::floor(kelvin * 100.0 + 0.5), 65535.0));
+    }
+    m_centikelvin_lut[lut_size] = 0;
+}
+
+bool SeekRadiometry::empty() const
+{
+    return m_celsius_lut.empty();
+}
+
+const RadiometricParams& SeekRadiometry::params() const
+{
+    return m_params;
+}
+
+float SeekRadiometry::celsius(uint16_t counts) const
+{
+    return m_celsius_lut[counts];
+}
+
+uint16_t SeekRadiometry::centikelvin(uint16_t counts) const
+{
+    return m_centikelvin_lut[counts];
+}
+
+void SeekRadiometry::convertToCelsius(const cv::Mat& src, cv::Mat& dst) const
+{
+    int y;
+    const float* lut = m_celsius_lut.data();
+
+    CV_Assert(!empty() && src.type() == CV_16UC1);
+    dst.create(src.rows, src.cols, CV_32FC1);
+
+    for (y=0; y<src.rows; y++) {
+        const uint16_t* in = src.ptr<uint16_t>(y);
+        float* out = dst.ptr<float>(y);
+        int x = 0;
+
+#if defined(__AVX2__)
+        for (; x+8<=src.cols; x+=8) {
+            const __m256i idx = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x)));
+            _mm256_storeu_ps(out + x, _mm256_i32gather_ps(lut, idx, 4));
+        }
+#endif
+        for (; x<src.cols; x++)
+            out[x] = lut[in[x]];
+    }
+}
+
+void SeekRadiometry::convertToCelsius(const cv::Mat& src, cv::Mat& dst, cv::Rect roi) const
+{
+    convertToCelsius(src(roi), dst);
+}
+
+void SeekRadiometry::convertToCentiKelvin(const cv::Mat& src, cv::Mat& dst) const
+{
+    int y;
+    const uint16_t* lut = m_centikelvin_lut.data();
+
+    CV_Assert(!empty() && src.type() == CV_16UC1);
+    dst.create(src.rows, src.cols, CV_16UC1);
+
+    for (y=0; y<src.rows; y++) {
+        const uint16_t* in = src.ptr<uint16_t>(y);
+        uint16_t* out = dst.ptr<uint16_t>(y);
+        int x = 0;
+
+#if defined(__AVX2__)
+        const __m256i low_mask = _mm256_set1_epi32(0xffff);
+        for (; x+8<=src.cols; x+=8) {
+            const __m256i idx = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x)));
+            /* gather 32 bits at each 16-bit entry, keep the low half */
+            __m256i val = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int*>(lut), idx, 2), low_mask);
+            val = _mm256_permute4x64_epi64(_mm256_packus_epi32(val, val), 0xd8);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm256_castsi256_si128(val));
+        }
+#endif
+        for (; x<src.cols; x++)
+            out[x] = lut[in[x]];
+    }
+}
+
+void SeekRadiometry::convertToCentiKelvin(const cv::Mat& src, cv::Mat& dst, cv::Rect roi) const
+{
+    convertToCentiKelvin(src(roi), dst);
+}
@@ -0,0 +1,100 @@
+/*
+ *  Seek radiometric conversion
+ *  Converts corrected 14-bit counts to absolute temperatures
+ */
+
+#ifndef SEEK_RADIOMETRY_H
+#define SEEK_RADIOMETRY_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace LibSeek {
+
+/*
+ *  Parameters of the counts -> temperature model
+ *
+ *  The sensor response is modelled with the usual Planck curve
+ *      S(T) = planck_r / (exp(planck_b / T) - planck_f) + planck_o
+ *  with S the corrected pixel value in counts and T in Kelvin.
+ *  The object signal is recovered from the measured signal with
+ *      S_obj = (S - (1 - emissivity) * S(reflected_temp)) / emissivity
+ *
+ *  The default curve constants are nominal values for an uncooled
+ *  microbolometer that put the shutter offset (0x4000) at 20 degrees
+ *  Celsius with roughly 40 counts per Kelvin. Calibrate them against a
+ *  reference source for accurate readings.
+ */
+struct RadiometricParams
+{
+    RadiometricParams();
+
+    double emissivity;          /* object emissivity, 0 < emissivity <= 1 */
+    double reflected_temp;      /* reflected apparent temperature in degrees Celsius */
+    double planck_r;
+    double planck_b;
+    double planck_f;
+    double planck_o;
+};
+
+class SeekRadiometry
+{
+public:
+    /*
+     *  Create an empty converter, call build() before converting
+     */
+    SeekRadiometry();
+
+    /*
+     *  Create a converter and build its lookup tables
+     */
+    SeekRadiometry(const RadiometricParams& params);
+
+    /*
+     *  (Re)build the counts -> temperature lookup tables for the
+     *  given parameters. This evaluates the model once for every
+     *  possible 16-bit pixel value so converting a frame is a single
+     *  table lookup per pixel.
+     */
+    void build(const RadiometricParams& params);
+
+    /*
+     *  Returns true when no lookup table has been built yet
+     */
+    bool empty() const;
+
+    /*
+     *  Parameters the current lookup tables were built with
+     */
+    const RadiometricParams& params() const;
+
+    /*
+     *  Convert a retrieved CV_16UC1 frame (or ROI of it) to a
+     *  CV_32FC1 frame in degrees Celsius
+     */
+    void convertToCelsius(const cv::Mat& src, cv::Mat& dst) const;
+    void convertToCelsius(const cv::Mat& src, cv::Mat& dst, cv::Rect roi) const;
+
+    /*
+     *  Convert a retrieved CV_16UC1 frame (or ROI of it) to a
+     *  CV_16UC1 frame in centi-Kelvin (e.g. 29315 = 20.00 degrees Celsius)
+     */
+    void convertToCentiKelvin(const cv::Mat& src, cv::Mat& dst) const;
+    void convertToCentiKelvin(const cv::Mat& src, cv::Mat& dst, cv::Rect roi) const;
+
+    /*
+     *  Single pixel conversions
+     */
+    float celsius(uint16_t counts) const;
+    uint16_t centikelvin(uint16_t counts) const;
+
+private:
+    RadiometricParams m_params;
+    std::vector<float> m_celsius_lut;
+    std::vector<uint16_t> m_centikelvin_lut;
+};
+
+} /* LibSeek */
+
+#endif /* SEEK_RADIOMETRY_H */
@@ -0,0 +1,855 @@
+/*
+ *  Seek raw recordings
+ */
+
+#include "SeekRecording.h"
+#include "SeekLogging.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace LibSeek;
+
+static_assert(sizeof(RecordFileHeader) == 32, "record file header layout");
+static_assert(sizeof(RecordFrameHeader) == 40, "record frame header layout");
+static_assert(sizeof(RecordIndexEntry) == 24, "record index layout");
+static_assert(sizeof(RecordFooter) == 24, "record footer layout");
+
+static const int block_size = 16;           /* samples sharing a Rice parameter */
+static const int k_bits = 4;                /* bits of the Rice parameter */
+static const int max_k = (1 << k_bits) - 1;
+static const uint32_t escape_q = 20;        /* quotient marking a verbatim residual */
+static const int escape_bits = 17;          /* zigzag residuals of 16-bit samples */
+
+namespace {
+
+/* LSB first bit writer into a buffer sized for the worst case */
+class BitWriter
+{
+public:
+    explicit BitWriter(uint8_t* out) : m_out(out), m_pos(out), m_acc(0), m_n(0) { }
+
+    /* bits <= 32 */
+    void put(uint32_t value, int bits)
+    {
+        m_acc |= static_cast<uint64_t>(value) << m_n;
+        m_n += bits;
+        if (m_n >= 32) {
+            const uint32_t word = static_cast<uint32_t>(m_acc);
+            std::memcpy(m_pos, &word, 4);
+            m_pos += 4;
+            m_acc >>= 32;
+            m_n -= 32;
+        }
+    }
+
+    /* flush the remaining bits, returns the number of bytes written */
+    size_t finish()
+    {
+        while (m_n > 0) {
+            *m_pos++ = static_cast<uint8_t>(m_acc);
+            m_acc >>= 8;
+            m_n -= 8;
+        }
+        m_n = 0;
+        return m_pos - m_out;
+    }
+
+private:
+    uint8_t* m_out;
+    uint8_t* m_pos;
+    uint64_t m_acc;
+    int m_n;
+};
+
+/* LSB first bit reader, reads zeros past the end and reports it in overrun() */
+class BitReader
+{
+public:
+    BitReader(const uint8_t* data, size_t size) :
+        m_pos(data), m_end(data + size), m_acc(0), m_n(0), m_padding(0), m_consumed_past_end(0)
+    { }
+
+    /* bits <= 32 */
+    uint32_t get(int bits)
+    {
+        if (m_n < bits)
+            refill();
+        const uint32_t value = static_cast<uint32_t>(m_acc & ((uint64_t(1) << bits) - 1));
+        consume(bits);
+        return value;
+    }
+
+    /* number of zero bits before the next one bit, which is consumed too */
+    uint32_t unary()
+    {
+        if (m_n < 32)
+            refill();
+        if ((m_acc & 0xffffffff) == 0)
+            return UINT32_MAX;
+#ifdef __GNUC__
+        const int q = __builtin_ctzll(m_acc);
+#else
+        int q = 0;
+        while (((m_acc >> q) & 1) == 0)
+            q++;
+#endif
+        consume(q + 1);
+        return q;
+    }
+
+    bool overrun() const
+    {
+        return m_consumed_past_end > 0;
+    }
+
+private:
+    void refill()
+    {
+        while (m_n <= 56) {
+            if (m_pos < m_end)
+                m_acc |= static_cast<uint64_t>(*m_pos++) << m_n;
+            else
+                m_padding += 8;
+            m_n += 8;
+        }
+    }
+
+    void consume(int bits)
+    {
+        m_acc >>= bits;
+        m_n -= bits;
+        if (m_n < m_padding) {
+            m_consumed_past_end += m_padding - m_n;
+            m_padding = m_n;
+        }
+    }
+
+    const uint8_t* m_pos;
+    const uint8_t* m_end;
+    uint64_t m_acc;
+    int m_n;
+    int m_padding;          /* zero bits at the top of m_acc that are past the end of the data */
+    int m_consumed_past_end;
+};
+
+} /* namespace */
+
+/* median edge detector of LOCO-I / JPEG-LS */
+static inline int predict(int a, int b, int c)
+{
+    const int mx = std::max(a, b);
+    const int mn = std::min(a, b);
+
+    if (c >= mx)
+        return mn;
+    if (c <= mn)
+        return mx;
+    return a + b - c;
+}
+
+/* left, up and up left neighbour, the first row and column use what exists */
+static inline int predict_at(const uint16_t* p, int x, int y, int width)
+{
+    if (y == 0)
+        return x == 0 ? 0 : p[-1];
+    if (x == 0)
+        return p[-width];
+    return predict(p[-1], p[-width], p[-width - 1]);
+}
+
+static inline uint32_t zigzag(int e)
+{
+    return e >= 0 ? static_cast<uint32_t>(e) << 1 : (static_cast<uint32_t>(-e) << 1) - 1;
+}
+
+static inline int unzigzag(uint32_t m)
+{
+    return (m & 1) ? -static_cast<int>((m + 1) >> 1) : static_cast<int>(m >> 1);
+}
+
+static size_t encode_rice(const uint16_t* src, int width, int height, uint8_t* out)
+{
+    int x, y, i;
+    uint32_t mapped[block_size];
+    BitWriter writer(out);
+
+    for (y=0; y<height; y++) {
+        const uint16_t* row = src + y * width;
+
+        for (x=0; x<width; x+=block_size) {
+            const int n = std::min(block_size, width - x);
+            uint32_t sum = 0;
+            int k = 0;
+
+            for (i=0; i<n; i++) {
+                mapped[i] = zigzag(row[x + i] - predict_at(row + x + i, x + i, y, width));
+                sum += mapped[i];
+            }
+
+            /* smallest k with n * 2^k >= sum, about log2 of the mean residual */
+            while (k < max_k && (static_cast<uint32_t>(n) << k) < sum)
+                k++;
+            writer.put(k, k_bits);
+
+            for (i=0; i<n; i++) {
+                const uint32_t q = mapped[i] >> k;
+
+                if (q < escape_q) {
+                    writer.put(1u << q, q + 1);
+                    writer.put(mapped[i] & ((1u << k) - 1), k);
+                } else {
+                    writer.put(1u << escape_q, escape_q + 1);
+                    writer.put(mapped[i], escape_bits);
+                }
+            }
+        }
+    }
+
+    return writer.finish();
+}
+
+static bool decode_rice(const uint8_t* data, size_t size, int width, int height, uint16_t* dst)
+{
+    int x, y, i;
+    BitReader reader(data, size);
+
+    for (y=0; y<height; y++) {
+        uint16_t* row = dst + y * width;
+
+        for (x=0; x<width; x+=block_size) {
+            const int n = std::min(block_size, width - x);
+            const int k = reader.get(k_bits);
+
+            for (i=0; i<n; i++) {
+                uint32_t m;
+                const uint32_t q = reader.unary();
+
+                if (q < escape_q)
+                    m = (q << k) | reader.get(k);
+                else if (q == escape_q)
+                    m = reader.get(escape_bits);
+                else
+                    return false;
+
+                const int value = predict_at(row + x + i, x + i, y, width) + unzigzag(m);
+                if (value < 0 || value > 0xffff)
+                    return false;
+                row[x + i] = value;
+            }
+        }
+    }
+
+    return !reader.overrun();
+}
+
+static size_t encode_packed(const uint16_t* src, size_t count, int bits, uint8_t* out)
+{
+    size_t i;
+    BitWriter writer(out);
+
+    for (i=0; i<count; i++)
+        writer.put(src[i], bits);
+
+    return writer.finish();
+}
+
+static bool decode_packed(const uint8_t* data, size_t size, size_t count, int bits, uint16_t* dst)
+{
+    size_t i;
+    BitReader reader(data, size);
+
+    if (bits < 1 || bits > 16)
+        return false;
+
+    for (i=0; i<count; i++)
+        dst[i] = reader.get(bits);
+
+    return !reader.overrun();
+}
+
+void LibSeek::encode_record_frame(const uint16_t* src, int width, int height,
+                                  RecordFrameHeader& header, std::vector<uint8_t>& out)
+{
+    const size_t count = width * height;
+    const uint16_t max_value = count ? *std::max_element(src, src + count) : 0;
+    int bits = 1;
+
+    while (bits < 16 && (max_value >> bits) != 0)
+        bits++;
+
+    /* worst case of the rice coder, escapes and parameters plus flush slack */
+    out.resize(count * (escape_q + 1 + escape_bits + 7) / 8 + (count / block_size + height + 1) + 8);
+
+    const size_t packed_size = (count * bits + 7) / 8;
+    const size_t rice_size = encode_rice(src, width, height, out.data());
+
+    if (rice_size < packed_size) {
+        header.codec = RecordCodec::RICE;
+        header.bits = 16;
+        header.data_size = rice_size;
+    } else {
+        header.codec = RecordCodec::PACKED;
+        header.bits = bits;
+        header.data_size = encode_packed(src, count, bits, out.data());
+    }
+
+    out.resize(header.data_size);
+}
+
+bool LibSeek::decode_record_frame(const RecordFrameHeader& header, const uint8_t* data,
+                                  int width, int height, uint16_t* dst)
+{
+    switch (header.codec) {
+    case RecordCodec::PACKED:
+        return decode_packed(data, header.data_size, width * height, header.bits, dst);
+    case RecordCodec::RICE:
+        return decode_rice(data, header.data_size, width, height, dst);
+    default:
+        return false;
+    }
+}
+
+/*
+ *  Writer
+ */
+SeekRecordingWriter::SeekRecordingWriter() :
+    m_file(nullptr),
+    m_header(),
+    m_buffer(),
+    m_index(),
+    m_frames(0),
+    m_bytes(0),
+    m_good(false)
+{ }
+
+SeekRecordingWriter::~SeekRecordingWriter()
+{
+    close();
+}
+
+bool SeekRecordingWriter::open(const std::string& filename, const SeekCamCore& cam)
+{
+    return open(filename, cam.product_id(), cam.raw_width(), cam.raw_height());
+}
+
+bool SeekRecordingWriter::open(const std::string& filename, int product_id, int raw_width, int raw_height)
+{
+    close();
+
+    m_file = fopen(filename.c_str(), "wb");
+    if (m_file == nullptr) {
+        error("Error: failed to create recording %s\n", filename.c_str());
+        return false;
+    }
+
+    std::memset(&m_header, 0, sizeof(m_header));
+    m_header.magic = record_magic;
+    m_header.version = record_version;
+    m_header.header_size = sizeof(RecordFileHeader);
+    m_header.vendor_id = SeekThermalTraits::vendor_id;
+    m_header.product_id = product_id;
+    m_header.raw_width = raw_width;
+    m_header.raw_height = raw_height;
+
+    m_index.clear();
+    m_frames = 0;
+    m_bytes = 0;
+    m_good = fwrite(&m_header, sizeof(m_header), 1, m_file) == 1;
+    if (!m_good) {
+        error("Error: failed to write recording %s\n", filename.c_str());
+        close();
+        return false;
+    }
+    m_bytes = sizeof(m_header);
+
+    return true;
+}
+
+void SeekRecordingWriter::close()
+{
+    RecordFooter footer;
+    const uint8_t padding[8] = { 0 };
+
+    if (m_file == nullptr)
+        return;
+
+    /* without the index readers scan the whole file, still usable */
+    if (m_good) {
+        const size_t pad = (8 - m_bytes % 8) % 8;
+
+        std::memset(&footer, 0, sizeof(footer));
+        footer.magic = record_index_magic;
+        footer.index_offset = m_bytes + pad;
+        footer.frame_count = m_index.size();
+
+        if (fwrite(padding, 1, pad, m_file) != pad ||
+                fwrite(m_index.data(), sizeof(RecordIndexEntry), m_index.size(), m_file) != m_index.size() ||
+                fwrite(&footer, sizeof(footer), 1, m_file) != 1) {
+            error("Error: failed to write the recording index\n");
+            m_good = false;
+        } else {
+            m_bytes += pad + m_index.size() * sizeof(RecordIndexEntry) + sizeof(footer);
+        }
+    }
+
+    if (fclose(m_file) != 0)
+        m_good = false;
+    m_file = nullptr;
+}
+
+bool SeekRecordingWriter::isOpened() const
+{
+    return m_file != nullptr;
+}
+
+bool SeekRecordingWriter::good() const
+{
+    return m_good;
+}
+
+uint64_t SeekRecordingWriter::frames() const
+{
+    return m_frames;
+}
+
+uint64_t SeekRecordingWriter::bytes() const
+{
+    return m_bytes;
+}
+
+bool SeekRecordingWriter::write(const uint16_t* raw, const FrameMeta& meta)
+{
+    RecordFrameHeader header;
+
+    if (m_file == nullptr || !m_good)
+        return false;
+
+    std::memset(&header, 0, sizeof(header));
+    header.magic = record_frame_magic;
+    header.frame_id = meta.frame_id;
+    header.frame_counter = meta.frame_counter;
+    header.timestamp_ns = meta.timestamp_ns;
+    header.sequence = meta.sequence;
+    encode_record_frame(raw, m_header.raw_width, m_header.raw_height, header, m_buffer);
+
+    if (fwrite(&header, sizeof(header), 1, m_file) != 1 ||
+            fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size()) {
+        error("Error: failed to write recording, stopped after %llu frames\n",
+              static_cast<unsigned long long>(m_frames));
+        m_good = false;
+        return false;
+    }
+
+    const RecordIndexEntry entry = { m_bytes, meta.timestamp_ns, meta.frame_id, meta.frame_counter };
+    m_index.push_back(entry);
+    m_frames++;
+    m_bytes += sizeof(header) + m_buffer.size();
+
+    return true;
+}
+
+void SeekRecordingWriter::raw_frame(const uint16_t* raw, const FrameMeta& meta)
+{
+    write(raw, meta);
+}
+
+/*
+ *  Reader
+ */
+SeekRecordingReader::SeekRecordingReader() :
+    m_data(nullptr),
+    m_size(0),
+    m_file_data(),
+    m_header(),
+    m_index(nullptr),
+    m_frames(0),
+    m_rebuilt_index(),
+    m_pool(4),
+    m_pool_clock(0),
+    m_position(0)
+{ }
+
+SeekRecordingReader::~SeekRecordingReader()
+{
+    close();
+}
+
+bool SeekRecordingReader::open(const std::string& filename)
+{
+    close();
+
+#ifdef _WIN32
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file != nullptr) {
+        fseek(file, 0, SEEK_END);
+        m_file_data.resize(ftell(file));
+        fseek(file, 0, SEEK_SET);
+        if (fread(m_file_data.data(), 1, m_file_data.size(), file) == m_file_data.size()) {
+            m_data = m_file_data.data();
+            m_size = m_file_data.size();
+        }
+        fclose(file);
+    }
+#else
+    struct stat st;
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (map != MAP_FAILED) {
+                m_data = static_cast<const uint8_t*>(map);
+                m_size = st.st_size;
+            }
+        }
+        ::close(fd);
+    }
+#endif
+
+    if (m_data == nullptr) {
+        error("Error: failed to open recording %s\n", filename.c_str());
+        return false;
+    }
+
+    if (m_size >= sizeof(m_header))
+        std::memcpy(&m_header, m_data, sizeof(m_header));
+
+    if (m_size < sizeof(m_header) || m_header.magic != record_magic || m_header.version != record_version ||
+            m_header.header_size < sizeof(m_header) || m_header.raw_width == 0 || m_header.raw_height == 0) {
+        error("Error: %s is not a seek recording\n", filename.c_str());
+        close();
+        return false;
+    }
+
+    if (!load_index()) {
+        error("Error: corrupt recording index in %s\n", filename.c_str());
+        close();
+        return false;
+    }
+
+    for (size_t i = 0; i < m_pool.size(); i++)
+        m_pool[i].index = SIZE_MAX;
+    m_position = 0;
+
+    return true;
+}
+
+bool SeekRecordingReader::load_index()
+{
+    RecordFooter footer;
+    RecordFrameHeader header;
+
+    /* index written when the recording was closed */
+    if (m_size >= m_header.header_size + sizeof(footer)) {
+        std::memcpy(&footer, m_data + m_size - sizeof(footer), sizeof(footer));
+
+        if (footer.magic == record_index_magic && footer.index_offset % 8 == 0 &&
+                footer.index_offset <= m_size - sizeof(footer) &&
+                footer.frame_count == (m_size - sizeof(footer) - footer.index_offset) / sizeof(RecordIndexEntry)) {
+            m_index = reinterpret_cast<const RecordIndexEntry*>(m_data + footer.index_offset);
+            m_frames = footer.frame_count;
+
+            /* compared without adding to the offsets, they come from the file and may wrap */
+            for (size_t i = 0; i < m_frames; i++) {
+                if (footer.index_offset < sizeof(header) || m_index[i].offset > footer.index_offset - sizeof(header))
+                    return false;
+            }
+            return true;
+        }
+    }
+
+    /* not closed, e.g. the recorder crashed: walk the frames, a truncated last one is left out */
+    uint64_t offset = m_header.header_size;
+    m_rebuilt_index.clear();
+
+    while (m_size >= sizeof(header) && offset <= m_size - sizeof(header)) {
+        std::memcpy(&header, m_data + offset, sizeof(header));
+        if (header.magic != record_frame_magic || header.data_size > m_size - offset - sizeof(header))
+            break;
+
+        const RecordIndexEntry entry = { offset, header.timestamp_ns, header.frame_id, header.frame_counter };
+        m_rebuilt_index.push_back(entry);
+        offset += sizeof(header) + header.data_size;
+    }
+
+    m_index = m_rebuilt_index.data();
+    m_frames = m_rebuilt_index.size();
+
+    return true;
+}
+
+void SeekRecordingReader::close()
+{
+    if (m_data == nullptr)
+        return;
+
+#ifndef _WIN32
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+    m_file_data.clear();
+    m_rebuilt_index.clear();
+    m_data = nullptr;
+    m_size = 0;
+    m_index = nullptr;
+    m_frames = 0;
+}
+
+bool SeekRecordingReader::isOpened() const
+{
+    return m_data != nullptr;
+}
+
+int SeekRecordingReader::product_id() const
+{
+    return m_header.product_id;
+}
+
+int SeekRecordingReader::raw_width() const
+{
+    return m_header.raw_width;
+}
+
+int SeekRecordingReader::raw_height() const
+{
+    return m_header.raw_height;
+}
+
+size_t SeekRecordingReader::frames() const
+{
+    return m_frames;
+}
+
+bool SeekRecordingReader::frame_info(size_t index, FrameMeta& meta) const
+{
+    if (index >= m_frames)
+        return false;
+
+    meta.frame_id = m_index[index].frame_id;
+    meta.frame_counter = m_index[index].frame_counter;
+    meta.timestamp_ns = m_index[index].timestamp_ns;
+    meta.sequence = 0;
+    meta.frames_skipped = 0;
+    meta.shutter = false;
+
+    return true;
+}
+
+size_t SeekRecordingReader::find_time(uint64_t timestamp_ns) const
+{
+    int steps;
+
+    if (m_frames == 0 || timestamp_ns <= m_index[0].timestamp_ns)
+        return 0;
+    if (timestamp_ns > m_index[m_frames - 1].timestamp_ns)
+        return m_frames;
+
+    /* guess from the average frame interval, then walk to the exact frame */
+    const uint64_t first = m_index[0].timestamp_ns;
+    const uint64_t span = m_index[m_frames - 1].timestamp_ns - first;
+    size_t i = span ? static_cast<size_t>(static_cast<double>(timestamp_ns - first) / span * (m_frames - 1)) : 0;
+    i = std::min(i, m_frames - 1);
+
+    for (steps = 0; steps < 16; steps++) {
+        if (i > 0 && m_index[i - 1].timestamp_ns >= timestamp_ns)
+            i--;
+        else if (m_index[i].timestamp_ns < timestamp_ns)
+            i++;
+        else
+            return i;
+    }
+
+    /* irregular timing, e.g. a paused recording */
+    const RecordIndexEntry* it = std::lower_bound(m_index, m_index + m_frames, timestamp_ns,
+            [](const RecordIndexEntry& e, uint64_t t) { return e.timestamp_ns < t; });
+    return it - m_index;
+}
+
+bool SeekRecordingReader::frame_header(size_t index, RecordFrameHeader& header) const
+{
+    if (index >= m_frames)
+        return false;
+
+    const uint64_t offset = m_index[index].offset;
+    if (m_size < sizeof(header) || offset > m_size - sizeof(header))
+        return false;
+
+    std::memcpy(&header, m_data + offset, sizeof(header));
+
+    return header.magic == record_frame_magic && header.data_size <= m_size - offset - sizeof(header);
+}
+
+bool SeekRecordingReader::decode(size_t index, uint16_t* raw, FrameMeta* meta) const
+{
+    RecordFrameHeader header;
+
+    if (!frame_header(index, header) ||
+            !decode_record_frame(header, m_data + m_index[index].offset + sizeof(header),
+                                 m_header.raw_width, m_header.raw_height, raw)) {
+        error("Error: corrupt recording frame %zu\n", index);
+        return false;
+    }
+
+    if (meta != nullptr) {
+        meta->frame_id = header.frame_id;
+        meta->frame_counter = header.frame_counter;
+        meta->timestamp_ns = header.timestamp_ns;
+        meta->sequence = header.sequence;
+        meta->frames_skipped = 0;
+        meta->shutter = false;
+    }
+
+    return true;
+}
+
+const uint16_t* SeekRecordingReader::frame(size_t index, FrameMeta* meta)
+{
+    size_t i;
+    PoolEntry* entry = &m_pool[0];
+
+    if (index >= m_frames)
+        return nullptr;
+
+    for (i = 0; i < m_pool.size(); i++) {
+        if (m_pool[i].index == index) {
+            entry = &m_pool[i];
+            break;
+        }
+        if (m_pool[i].last_use < entry->last_use)
+            entry = &m_pool[i];
+    }
+
+    /* not in the pool: decode into the least recently used buffer */
+    if (entry->index != index) {
+        entry->raw.resize(m_header.raw_width * m_header.raw_height);
+        entry->index = SIZE_MAX;
+        if (!decode(index, entry->raw.data(), &entry->meta))
+            return nullptr;
+        entry->index = index;
+    }
+
+    entry->last_use = ++m_pool_clock;
+    if (meta != nullptr)
+        *meta = entry->meta;
+
+    return entry->raw.data();
+}
+
+void SeekRecordingReader::setPoolSize(size_t size)
+{
+    const size_t old_size = m_pool.size();
+
+    m_pool.resize(std::max<size_t>(size, 1));
+    for (size_t i = old_size; i < m_pool.size(); i++) {
+        m_pool[i].index = SIZE_MAX;
+        m_pool[i].last_use = 0;
+    }
+}
+
+size_t SeekRecordingReader::pool_size() const
+{
+    return m_pool.size();
+}
+
+bool SeekRecordingReader::read(uint16_t* raw, FrameMeta* meta)
+{
+    if (m_position >= m_frames || !decode(m_position, raw, meta))
+        return false;
+
+    m_position++;
+    return true;
+}
+
+void SeekRecordingReader::seek(size_t index)
+{
+    m_position = std::min(index, m_frames);
+}
+
+size_t SeekRecordingReader::position() const
+{
+    return m_position;
+}
+
+/*
+ *  Player
+ */
+SeekRecordingPlayer::SeekRecordingPlayer(const SeekRecordingReader& reader) :
+    m_reader(reader),
+    m_realtime(true),
+    m_started(false),
+    m_resync(true),
+    m_position(0),
+    m_shutter(SIZE_MAX),
+    m_start_ns(0),
+    m_wall_start()
+{ }
+
+void SeekRecordingPlayer::setRealtime(bool realtime)
+{
+    m_realtime = realtime;
+    m_resync = true;
+}
+
+void SeekRecordingPlayer::seek(size_t index)
+{
+    size_t i;
+    FrameMeta meta;
+
+    m_position = std::min(index, m_reader.frames());
+    m_shutter = SIZE_MAX;
+    m_resync = true;
+
+    /* the camera keeps the flat field of the last shutter frame it saw */
+    for (i = m_position; i-- > 1; ) {
+        if (m_reader.frame_info(i, meta) && meta.frame_id == FrameType::SHUTTER) {
+            m_shutter = i;
+            break;
+        }
+    }
+}
+
+size_t SeekRecordingPlayer::position() const
+{
+    return m_position;
+}
+
+bool SeekRecordingPlayer::next_raw_frame(uint16_t* raw, FrameMeta& meta)
+{
+    size_t index;
+    bool paced = false;
+
+    if (!m_started) {
+        /* the first frame builds the dead pixel list during open() */
+        index = 0;
+        m_started = true;
+        m_position = std::max<size_t>(m_position, 1);
+    } else if (m_shutter != SIZE_MAX) {
+        index = m_shutter;
+        m_shutter = SIZE_MAX;
+    } else {
+        if (m_position >= m_reader.frames())
+            return false;
+        index = m_position++;
+        paced = true;
+    }
+
+    if (!m_reader.decode(index, raw, &meta))
+        return false;
+
+    if (m_realtime && paced) {
+        if (m_resync) {
+            m_wall_start = std::chrono::steady_clock::now();
+            m_start_ns = meta.timestamp_ns;
+            m_resync = false;
+        } else if (meta.timestamp_ns > m_start_ns) {
+            std::this_thread::sleep_until(m_wall_start + std::chrono::nanoseconds(meta.timestamp_ns - m_start_ns));
+        }
+    }
+
+    return true;
+}
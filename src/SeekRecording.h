@@ -0,0 +1,296 @@
+/*
+ *  Seek raw recordings
+ *  Lossless compressed recording of the raw frames fetched from the
+ *  camera, including shutter and first frames, so a recording can be
+ *  processed again later exactly like a live camera.
+ *
+ *  Frames are coded independently: median edge prediction from the
+ *  neighbour pixels followed by block adaptive Rice coding, or plain bit
+ *  packing (14 bits for sensor data) when that comes out smaller.
+ */
+
+#ifndef SEEK_RECORDING_H
+#define SEEK_RECORDING_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include "SeekCamCore.h"
+
+namespace LibSeek {
+
+/*
+ *  File format, all fields little endian
+ *
+ *  RecordFileHeader, then for every frame a RecordFrameHeader followed
+ *  by data_size bytes of coded samples (raw_width x raw_height, row major).
+ *  Closing the recording appends a RecordIndexEntry for every frame,
+ *  aligned to 8 bytes, and a RecordFooter as the last bytes of the file.
+ *  Recordings that weren't closed have no index, readers rebuild it.
+ */
+struct RecordFileHeader {
+    uint32_t magic;             /* record_magic */
+    uint16_t version;           /* record_version */
+    uint16_t header_size;       /* sizeof(RecordFileHeader), the first frame starts after it */
+    uint16_t vendor_id;
+    uint16_t product_id;        /* camera model */
+    uint32_t raw_width;
+    uint32_t raw_height;
+    uint32_t reserved[3];
+};
+
+struct RecordFrameHeader {
+    uint32_t magic;             /* record_frame_magic */
+    uint32_t data_size;         /* coded bytes following this header */
+    uint8_t codec;              /* RecordCodec */
+    uint8_t bits;               /* bits per sample for RecordCodec::PACKED */
+    uint16_t reserved;
+    int32_t frame_id;
+    int32_t frame_counter;
+    uint32_t reserved2;
+    uint64_t timestamp_ns;
+    uint64_t sequence;
+};
+
+struct RecordIndexEntry {
+    uint64_t offset;            /* of the RecordFrameHeader in the file */
+    uint64_t timestamp_ns;
+    int32_t frame_id;
+    int32_t frame_counter;
+};
+
+struct RecordFooter {
+    uint32_t magic;             /* record_index_magic */
+    uint32_t reserved;
+    uint64_t index_offset;      /* of the first RecordIndexEntry */
+    uint64_t frame_count;
+};
+
+struct RecordCodec {
+    enum Enum {
+        PACKED  = 0,    /* samples bit packed, LSB first */
+        RICE    = 1,    /* median edge prediction + Rice coding in blocks of 16 samples */
+    };
+};
+
+static const uint32_t record_magic = 0x43524b53;        /* "SKRC" */
+static const uint32_t record_frame_magic = 0x52464b53;  /* "SKFR" */
+static const uint32_t record_index_magic = 0x58494b53;  /* "SKIX" */
+static const uint16_t record_version = 1;
+
+/*
+ *  Code a frame, selects the codec giving the smallest result
+ *  header:     codec, bits and data_size are set
+ *  out:        receives the coded data, keeps its capacity between frames
+ */
+void encode_record_frame(const uint16_t* src, int width, int height,
+                         RecordFrameHeader& header, std::vector<uint8_t>& out);
+
+/*
+ *  Decode a frame coded by encode_record_frame
+ *  Returns false on corrupt data
+ */
+bool decode_record_frame(const RecordFrameHeader& header, const uint8_t* data,
+                         int width, int height, uint16_t* dst);
+
+class SeekRecordingWriter: public RawFrameSink
+{
+public:
+    SeekRecordingWriter();
+    virtual ~SeekRecordingWriter();
+
+    /*
+     *  Create a recording for the raw frames of cam, attach it with
+     *  cam.setRawFrameSink() before cam.open() to record from the start
+     *  Returns true on success
+     */
+    bool open(const std::string& filename, const SeekCamCore& cam);
+    bool open(const std::string& filename, int product_id, int raw_width, int raw_height);
+
+    /*
+     *  Append the frame index and close the file
+     */
+    void close();
+
+    bool isOpened() const;
+
+    /*
+     *  Append a raw frame
+     *  Returns false on a write error, the recording stops then
+     */
+    bool write(const uint16_t* raw, const FrameMeta& meta);
+
+    /*
+     *  RawFrameSink, appends every frame fetched from the camera
+     */
+    virtual void raw_frame(const uint16_t* raw, const FrameMeta& meta);
+
+    /*
+     *  Frames and bytes written so far
+     */
+    uint64_t frames() const;
+    uint64_t bytes() const;
+
+    /*
+     *  False after a write error
+     */
+    bool good() const;
+
+private:
+    SeekRecordingWriter(const SeekRecordingWriter&);
+    SeekRecordingWriter& operator=(const SeekRecordingWriter&);
+
+    FILE* m_file;
+    RecordFileHeader m_header;
+    std::vector<uint8_t> m_buffer;
+    std::vector<RecordIndexEntry> m_index;
+    uint64_t m_frames;
+    uint64_t m_bytes;
+    bool m_good;
+};
+
+/*
+ *  Memory maps a recording. Frames are found through the index, so any
+ *  frame is decoded without touching the ones before it.
+ */
+class SeekRecordingReader
+{
+public:
+    SeekRecordingReader();
+    ~SeekRecordingReader();
+
+    /*
+     *  Open a recording, rebuilds the index of a recording that wasn't closed
+     *  Returns true on success
+     */
+    bool open(const std::string& filename);
+
+    void close();
+
+    bool isOpened() const;
+
+    int product_id() const;
+    int raw_width() const;
+    int raw_height() const;
+
+    /*
+     *  Number of frames
+     */
+    size_t frames() const;
+
+    /*
+     *  frame_id, frame_counter and timestamp_ns of a frame from the index,
+     *  without decoding it
+     */
+    bool frame_info(size_t index, FrameMeta& meta) const;
+
+    /*
+     *  Index of the first frame recorded at or after timestamp_ns,
+     *  frames() if there is none. Interpolates in the index, constant
+     *  time for a steady frame rate
+     */
+    size_t find_time(uint64_t timestamp_ns) const;
+
+    /*
+     *  Decode a frame into raw (raw_width() x raw_height() words)
+     *  meta:   if not null, receives frame_id, frame_counter, timestamp_ns and sequence
+     *  Returns false for an invalid index or corrupt data
+     */
+    bool decode(size_t index, uint16_t* raw, FrameMeta* meta=nullptr) const;
+
+    /*
+     *  Decoded frame from a pool of buffers, only decoded when it isn't in
+     *  the pool yet. Valid until pool_size() other frames were requested
+     *  Returns nullptr for an invalid index or corrupt data
+     */
+    const uint16_t* frame(size_t index, FrameMeta* meta=nullptr);
+
+    void setPoolSize(size_t size);
+    size_t pool_size() const;
+
+    /*
+     *  Sequential access: decode the frame at position(), then advance
+     *  Returns false at the end of the recording or on corrupt data
+     */
+    bool read(uint16_t* raw, FrameMeta* meta=nullptr);
+    void seek(size_t index);
+    size_t position() const;
+
+private:
+    SeekRecordingReader(const SeekRecordingReader&);
+    SeekRecordingReader& operator=(const SeekRecordingReader&);
+
+    bool load_index();
+    bool frame_header(size_t index, RecordFrameHeader& header) const;
+
+    struct PoolEntry {
+        size_t index;
+        uint64_t last_use;
+        FrameMeta meta;
+        std::vector<uint16_t> raw;
+    };
+
+    const uint8_t* m_data;
+    size_t m_size;
+    std::vector<uint8_t> m_file_data;           /* file contents where mmap isn't available */
+    RecordFileHeader m_header;
+    const RecordIndexEntry* m_index;
+    size_t m_frames;
+    std::vector<RecordIndexEntry> m_rebuilt_index;
+    std::vector<PoolEntry> m_pool;
+    uint64_t m_pool_clock;
+    size_t m_position;
+};
+
+/*
+ *  Replays a recording into a camera as raw frame source, so it runs
+ *  through the same processing as live frames:
+ *
+ *      cam->setRawFrameSource(&player);
+ *      cam->open();
+ *      while (cam->grab()) ...
+ */
+class SeekRecordingPlayer: public RawFrameSource
+{
+public:
+    explicit SeekRecordingPlayer(const SeekRecordingReader& reader);
+
+    /*
+     *  true:   deliver frames at the pace they were recorded (default)
+     *  false:  as fast as possible
+     */
+    void setRealtime(bool realtime);
+
+    /*
+     *  Continue playback at frame index. The shutter frame preceding it is
+     *  delivered first, so the flat field calibration matches the recording
+     */
+    void seek(size_t index);
+
+    /*
+     *  Index of the next frame delivered in recording order
+     */
+    size_t position() const;
+
+    /*
+     *  RawFrameSource, the first call delivers the first recorded frame
+     *  that the camera initialization needs
+     */
+    virtual bool next_raw_frame(uint16_t* raw, FrameMeta& meta);
+
+private:
+    const SeekRecordingReader& m_reader;
+    bool m_realtime;
+    bool m_started;
+    bool m_resync;
+    size_t m_position;
+    size_t m_shutter;                       /* shutter frame to deliver first, SIZE_MAX if none */
+    uint64_t m_start_ns;                    /* recorded timestamp at m_wall_start */
+    std::chrono::steady_clock::time_point m_wall_start;
+};
+
+} /* LibSeek */
+
+#endif /* SEEK_RECORDING_H */
@@ -0,0 +1,257 @@
+/*
+ *  Seek region of interest statistics
+ */
+
+#include "SeekRoiStatistics.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace LibSeek;
+
+static const uint16_t invalid_pixel_marker = 0xffff;
+
+namespace {
+
+class MatSpanReader: public SeekRoiStatistics::SpanReader
+{
+public:
+    MatSpanReader(const cv::Mat& frame) :
+        m_frame(frame)
+    { }
+
+    virtual const uint16_t* read(int y, int x, int length)
+    {
+        (void)length;
+        return m_frame.ptr<uint16_t>(y) + x;
+    }
+
+private:
+    const cv::Mat& m_frame;
+};
+
+} /* namespace */
+
+SeekRoiStatistics::SeekRoiStatistics(cv::Size frame_size) :
+    m_frame_size(frame_size)
+{ }
+
+int SeekRoiStatistics::addRect(cv::Rect rect)
+{
+    int y;
+    std::vector<Span> spans;
+
+    rect = rect & cv::Rect(0, 0, m_frame_size.width, m_frame_size.height);
+
+    for (y=rect.y; y<rect.y+rect.height; y++)
+        add_span(spans, y, rect.x, rect.x + rect.width);
+
+    return add_region(spans);
+}
+
+int SeekRoiStatistics::addPolygon(const std::vector<cv::Point>& polygon)
+{
+    int y;
+    size_t i, j;
+    std::vector<Span> spans;
+    std::vector<double> crossings;
+
+    if (polygon.size() < 3)
+        return -1;
+
+    int min_y = polygon[0].y;
+    int max_y = polygon[0].y;
+    for (i=1; i<polygon.size(); i++) {
+        min_y = std::min(min_y, polygon[i].y);
+        max_y = std::max(max_y, polygon[i].y);
+    }
+    min_y = std::max(min_y, 0);
+    max_y = std::min(max_y, m_frame_size.height - 1);
+
+    /* scanline fill sampling each row at its pixel centers (even-odd rule) */
+    for (y=min_y; y<=max_y; y++) {
+        const double yc = y + 0.5;
+
+        crossings.clear();
+        for (i=0, j=polygon.size()-1; i<polygon.size(); j=i++) {
+            const cv::Point& a = polygon[i];
+            const cv::Point& b = polygon[j];
+
+            if ((a.y <= yc) != (b.y <= yc))
+                crossings.push_back(a.x + (yc - a.y) * (b.x - a.x) / (b.y - a.y));
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        for (i=0; i+1<crossings.size(); i+=2) {
+            const int x0 = static_cast<int>(std::ceil(crossings[i] - 0.5));
+            const int x1 = static_cast<int>(std::ceil(crossings[i+1] - 0.5));
+            add_span(spans, y, x0, x1);
+        }
+    }
+
+    return add_region(spans);
+}
+
+int SeekRoiStatistics::addSpot(cv::Point center, int radius)
+{
+    int dy;
+    std::vector<Span> spans;
+
+    radius = std::max(radius, 0);
+    for (dy=-radius; dy<=radius; dy++) {
+        const int half = static_cast<int>(std::sqrt(static_cast<double>(radius * radius - dy * dy)));
+        add_span(spans, center.y + dy, center.x - half, center.x + half + 1);
+    }
+
+    return add_region(spans);
+}
+
+void SeekRoiStatistics::setPercentiles(const std::vector<double>& percentiles)
+{
+    size_t i;
+
+    m_percentiles = percentiles;
+    std::sort(m_percentiles.begin(), m_percentiles.end());
+
+    for (i=0; i<m_regions.size(); i++)
+        m_regions[i].stats.percentiles.assign(m_percentiles.size(), 0);
+}
+
+size_t SeekRoiStatistics::size() const
+{
+    return m_regions.size();
+}
+
+const std::vector<SeekRoiStatistics::Span>& SeekRoiStatistics::spans(int id) const
+{
+    return m_regions.at(id).spans;
+}
+
+const RoiStats& SeekRoiStatistics::stats(int id) const
+{
+    return m_regions.at(id).stats;
+}
+
+cv::Size SeekRoiStatistics::frameSize() const
+{
+    return m_frame_size;
+}
+
+void SeekRoiStatistics::update(const cv::Mat& frame)
+{
+    CV_Assert(frame.type() == CV_16UC1 && frame.size() == m_frame_size);
+
+    MatSpanReader reader(frame);
+    update(reader);
+}
+
+void SeekRoiStatistics::update(SpanReader& reader)
+{
+    size_t i;
+
+    for (i=0; i<m_regions.size(); i++)
+        update_region(m_regions[i], reader);
+}
+
+int SeekRoiStatistics::add_region(std::vector<Span>& spans)
+{
+    size_t i;
+    Region region;
+
+    if (spans.empty())
+        return -1;
+
+    region.num_pixels = 0;
+    for (i=0; i<spans.size(); i++)
+        region.num_pixels += spans[i].length;
+
+    region.spans.swap(spans);
+    region.stats.count = 0;
+    region.stats.min = 0;
+    region.stats.max = 0;
+    region.stats.mean = 0;
+    region.stats.percentiles.assign(m_percentiles.size(), 0);
+
+    /* size the percentile scratch buffer once, not per frame */
+    if (m_scratch.size() < region.num_pixels)
+        m_scratch.resize(region.num_pixels);
+
+    m_regions.push_back(region);
+    return static_cast<int>(m_regions.size() - 1);
+}
+
+void SeekRoiStatistics::add_span(std::vector<Span>& spans, int y, int x0, int x1)
+{
+    if (y < 0 || y >= m_frame_size.height)
+        return;
+
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, m_frame_size.width);
+    if (x1 <= x0)
+        return;
+
+    Span span = { y, x0, x1 - x0 };
+    spans.push_back(span);
+}
+
+void SeekRoiStatistics::update_region(Region& region, SpanReader& reader)
+{
+    size_t i, k;
+    int n;
+    RoiStats& stats = region.stats;
+    const bool want_percentiles = !m_percentiles.empty();
+    uint16_t* scratch = m_scratch.data();
+    uint64_t sum = 0;
+    size_t count = 0;
+    uint16_t min = 0xffff;
+    uint16_t max = 0;
+
+    for (i=0; i<region.spans.size(); i++) {
+        const Span& span = region.spans[i];
+        const uint16_t* values = reader.read(span.y, span.x, span.length);
+
+        for (n=0; n<span.length; n++) {
+            const uint16_t value = values[n];
+
+            if (value == invalid_pixel_marker)
+                continue;
+
+            if (value < min) {
+                min = value;
+                stats.min_loc = cv::Point(span.x + n, span.y);
+            }
+            if (value > max) {
+                max = value;
+                stats.max_loc = cv::Point(span.x + n, span.y);
+            }
+            sum += value;
+
+            if (want_percentiles)
+                scratch[count] = value;
+            count++;
+        }
+    }
+
+    stats.count = count;
+    if (count == 0) {
+        stats.min = 0;
+        stats.max = 0;
+        stats.mean = 0;
+        std::fill(stats.percentiles.begin(), stats.percentiles.end(), 0);
+        return;
+    }
+
+    stats.min = min;
+    stats.max = max;
+    stats.mean = static_cast<double>(sum) / count;
+
+    /* percentiles are sorted ascending so each selection can narrow the range */
+    size_t first = 0;
+    for (k=0; k<m_percentiles.size(); k++) {
+        const double p = std::min(std::max(m_percentiles[k], 0.0), 100.0);
+        const size_t rank = static_cast<size_t>(p / 100.0 * (count - 1) + 0.5);
+
+        std::nth_element(scratch + first, scratch + rank, scratch + count);
+        stats.percentiles[k] = scratch[rank];
+        first = rank;
+    }
+}
@@ -0,0 +1,115 @@
+/*
+ *  Seek region of interest statistics
+ *  Computes min/max/mean/percentiles of registered regions only
+ */
+
+#ifndef SEEK_ROI_STATISTICS_H
+#define SEEK_ROI_STATISTICS_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace LibSeek {
+
+struct RoiStats
+{
+    size_t count;                       /* number of valid pixels in the region */
+    uint16_t min;
+    uint16_t max;
+    double mean;
+    cv::Point min_loc;
+    cv::Point max_loc;
+    std::vector<uint16_t> percentiles;  /* one value per requested percentile */
+};
+
+class SeekRoiStatistics
+{
+public:
+    /*
+     *  Horizontal run of pixels [x, x + length) on row y
+     */
+    struct Span {
+        int y;
+        int x;
+        int length;
+    };
+
+    /*
+     *  Source of pixel values for update(). read() returns a pointer
+     *  to 'length' values of row y starting at column x. Pixels with
+     *  the value 0xffff are considered invalid and are skipped.
+     */
+    class SpanReader {
+    public:
+        virtual ~SpanReader() { }
+        virtual const uint16_t* read(int y, int x, int length) = 0;
+    };
+
+    /*
+     *  frame_size: size of the frames that will be analysed
+     */
+    SeekRoiStatistics(cv::Size frame_size);
+
+    /*
+     *  Register regions, the part outside the frame is clipped.
+     *  Returns the region id, or -1 if the region is empty after clipping.
+     *  Polygon pixels are included when their center lies inside the polygon.
+     */
+    int addRect(cv::Rect rect);
+    int addPolygon(const std::vector<cv::Point>& polygon);
+    int addSpot(cv::Point center, int radius=0);
+
+    /*
+     *  Percentiles (0..100) to compute for every region, nearest rank.
+     *  RoiStats::percentiles holds the results in ascending percentile order.
+     */
+    void setPercentiles(const std::vector<double>& percentiles);
+
+    /*
+     *  Number of registered regions
+     */
+    size_t size() const;
+
+    /*
+     *  Precomputed spans of a region
+     */
+    const std::vector<Span>& spans(int id) const;
+
+    /*
+     *  Update the statistics of all regions from a corrected CV_16UC1 frame
+     */
+    void update(const cv::Mat& frame);
+
+    /*
+     *  Update the statistics of all regions from a span reader
+     */
+    void update(SpanReader& reader);
+
+    /*
+     *  Statistics of a region after the last update
+     */
+    const RoiStats& stats(int id) const;
+
+    cv::Size frameSize() const;
+
+private:
+    struct Region {
+        std::vector<Span> spans;
+        size_t num_pixels;
+        RoiStats stats;
+    };
+
+    int add_region(std::vector<Span>& spans);
+    void add_span(std::vector<Span>& spans, int y, int x0, int x1);
+    void update_region(Region& region, SpanReader& reader);
+
+    cv::Size m_frame_size;
+    std::vector<double> m_percentiles;
+    std::vector<Region> m_regions;
+    std::vector<uint16_t> m_scratch;
+};
+
+} /* LibSeek */
+
+#endif /* SEEK_ROI_STATISTICS_H */
@@ -0,0 +1,52 @@
+/*
+ *  Seek scoped timer
+ *  Times the rest of the enclosing scope for the trace points and the
+ *  stage metrics. The clock is only read while the sink is active,
+ *  otherwise a timer costs what Sink::active() costs. A sink provides
+ *
+ *      typedef ... Key;
+ *      static bool active();
+ *      static uint64_t now_ns();
+ *      static void record(Key key, uint64_t start_ns, uint64_t duration_ns);
+ */
+
+#ifndef SEEK_SCOPED_TIMER_H
+#define SEEK_SCOPED_TIMER_H
+
+#include <cstdint>
+
+namespace LibSeek {
+
+template<typename Sink>
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(typename Sink::Key key) :
+        m_key(key),
+        m_start_ns(Sink::active() ? Sink::now_ns() : 0)
+    { }
+
+    ~ScopedTimer()
+    {
+        if (m_start_ns != 0)
+            Sink::record(m_key, m_start_ns, Sink::now_ns() - m_start_ns);
+    }
+
+private:
+    ScopedTimer(const ScopedTimer&);
+    ScopedTimer& operator=(const ScopedTimer&);
+
+    const typename Sink::Key m_key;
+    const uint64_t m_start_ns;
+};
+
+} /* LibSeek */
+
+#define SEEK_CONCAT2(a, b)          a ## b
+#define SEEK_CONCAT(a, b)           SEEK_CONCAT2(a, b)
+
+/* a timer of type named prefix<line>, timing the rest of the enclosing scope */
+#define SEEK_SCOPED_TIMER(type, prefix, key) \
+    type SEEK_CONCAT(prefix, __LINE__)(key)
+
+#endif /* SEEK_SCOPED_TIMER_H */
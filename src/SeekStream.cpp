@@ -0,0 +1,1014 @@
+/*
+ *  Seek network streaming
+ */
+
+#include "SeekStream.h"
+#include "SeekLogging.h"
+#include "SeekMetrics.h"
+#include "SeekTrace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <random>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace LibSeek;
+
+static_assert(sizeof(StreamHeader) == 56, "stream header layout");
+static_assert(sizeof(StreamFragment) == 24, "stream fragment layout");
+
+/* frame bytes per datagram, keeps datagrams within an ethernet MTU */
+static const size_t udp_chunk_size = 1400;
+static const uint64_t subscriber_timeout_ns = 10000000000ULL;
+static const uint64_t resubscribe_interval_ns = 2000000000ULL;
+/* a cookie stays valid for one to two periods */
+static const uint64_t cookie_period_ns = 60000000000ULL;
+static const size_t cookie_size = 8;
+/* far beyond any camera frame, bounds what a bogus fragment makes the client allocate */
+static const size_t max_udp_frame_size = 64 << 20;
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool set_nonblocking(int fd)
+{
+    const int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+/* wake the network thread, a full pipe already wakes it */
+static void wake(int fd)
+{
+    const char c = 0;
+    const ssize_t n = write(fd, &c, 1);
+    (void)n;
+}
+
+static int bind_socket(int type, int port, const std::string& address)
+{
+    int fd;
+    int one = 1;
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+        return -1;
+
+    fd = socket(AF_INET, type, 0);
+    if (fd < 0)
+        return -1;
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            (type == SOCK_STREAM && listen(fd, 8) != 0) || !set_nonblocking(fd) ||
+            getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &len) != 0) {
+        ::close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int bound_port(int fd)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    if (fd < 0 || getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &len) != 0)
+        return -1;
+
+    return ntohs(addr.sin_port);
+}
+
+static uint64_t rotl(uint64_t x, int b)
+{
+    return (x << b) | (x >> (64 - b));
+}
+
+static void sip_round(uint64_t v[4])
+{
+    v[0] += v[1]; v[1] = rotl(v[1], 13); v[1] ^= v[0]; v[0] = rotl(v[0], 32);
+    v[2] += v[3]; v[3] = rotl(v[3], 16); v[3] ^= v[2];
+    v[0] += v[3]; v[3] = rotl(v[3], 21); v[3] ^= v[0];
+    v[2] += v[1]; v[1] = rotl(v[1], 17); v[1] ^= v[2]; v[2] = rotl(v[2], 32);
+}
+
+/*
+ *  SipHash-2-4, a keyed hash that can't be forged without the key
+ */
+static uint64_t siphash(const uint64_t key[2], const uint8_t* data, size_t size)
+{
+    size_t i, j;
+    uint64_t m;
+    uint64_t v[4] = {
+        key[0] ^ 0x736f6d6570736575ULL, key[1] ^ 0x646f72616e646f6dULL,
+        key[0] ^ 0x6c7967656e657261ULL, key[1] ^ 0x7465646279746573ULL
+    };
+
+    for (i = 0; i + 8 <= size; i += 8) {
+        m = 0;
+        for (j = 0; j < 8; j++)
+            m |= static_cast<uint64_t>(data[i + j]) << (8 * j);
+        v[3] ^= m;
+        sip_round(v);
+        sip_round(v);
+        v[0] ^= m;
+    }
+
+    m = static_cast<uint64_t>(size) << 56;
+    for (j = 0; i + j < size; j++)
+        m |= static_cast<uint64_t>(data[i + j]) << (8 * j);
+    v[3] ^= m;
+    sip_round(v);
+    sip_round(v);
+    v[0] ^= m;
+
+    v[2] ^= 0xff;
+    for (j = 0; j < 4; j++)
+        sip_round(v);
+
+    return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+/*
+ *  Point iov at bytes [offset, offset + size) of the frame encoding,
+ *  the header and the pixels stay in separate buffers
+ *  Returns the number of iovecs used, at most 2
+ */
+static int frame_iov(const StreamFrame& frame, size_t offset, size_t size, struct iovec* iov)
+{
+    const size_t header_size = sizeof(StreamHeader);
+    const uint8_t* header = reinterpret_cast<const uint8_t*>(&frame.header);
+    const uint8_t* pixels = reinterpret_cast<const uint8_t*>(frame.pixels.data());
+    int n = 0;
+
+    if (offset < header_size) {
+        const size_t len = std::min(size, header_size - offset);
+        iov[n].iov_base = const_cast<uint8_t*>(header + offset);
+        iov[n].iov_len = len;
+        n++;
+        offset += len;
+        size -= len;
+    }
+
+    if (size > 0) {
+        iov[n].iov_base = const_cast<uint8_t*>(pixels + offset - header_size);
+        iov[n].iov_len = size;
+        n++;
+    }
+
+    return n;
+}
+
+/*
+ *  Server
+ */
+SeekStreamServer::SeekStreamServer() :
+    m_width(0),
+    m_height(0),
+    m_max_clients(0),
+    m_listen_fd(-1),
+    m_udp_fd(-1),
+    m_tcp_port(-1),
+    m_udp_port(-1),
+    m_running(false),
+    m_pending(-1),
+    m_stream_sequence(0),
+    m_stats()
+{
+    m_wake_fds[0] = -1;
+    m_wake_fds[1] = -1;
+    m_cookie_key[0] = 0;
+    m_cookie_key[1] = 0;
+}
+
+SeekStreamServer::~SeekStreamServer()
+{
+    stop();
+}
+
+bool SeekStreamServer::start(int tcp_port, int udp_port, int width, int height, int max_clients,
+                             const std::string& address)
+{
+    int i;
+    int sndbuf = 1 << 20;
+    std::random_device entropy;
+
+    stop();
+
+    if (width <= 0 || height <= 0 || max_clients <= 0 || (tcp_port < 0 && udp_port < 0)) {
+        error("Error: invalid stream server settings\n");
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_max_clients = max_clients;
+
+    if (tcp_port >= 0 && (m_listen_fd = bind_socket(SOCK_STREAM, tcp_port, address)) < 0) {
+        error("Error: failed to listen on tcp port %s:%d\n", address.c_str(), tcp_port);
+        stop();
+        return false;
+    }
+
+    if (udp_port >= 0 && (m_udp_fd = bind_socket(SOCK_DGRAM, udp_port, address)) < 0) {
+        error("Error: failed to bind udp port %s:%d\n", address.c_str(), udp_port);
+        stop();
+        return false;
+    }
+    if (m_udp_fd >= 0)
+        setsockopt(m_udp_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    if (pipe(m_wake_fds) != 0 || !set_nonblocking(m_wake_fds[0]) || !set_nonblocking(m_wake_fds[1])) {
+        error("Error: failed to create wake pipe\n");
+        stop();
+        return false;
+    }
+
+    m_tcp_port = bound_port(m_listen_fd);
+    m_udp_port = bound_port(m_udp_fd);
+
+    /* every tcp client holds at most one frame, plus the pending and the publishing one */
+    m_frames.resize(max_clients + 2);
+    for (i=0; i<static_cast<int>(m_frames.size()); i++) {
+        m_frames[i].pixels.resize(width * height);
+        m_frames[i].refs = 0;
+    }
+    m_clients.reserve(max_clients);
+    m_subscribers.reserve(max_clients);
+    m_pending = -1;
+    m_stream_sequence = 0;
+    m_stats = StreamStats();
+    for (i=0; i<2; i++)
+        m_cookie_key[i] = (static_cast<uint64_t>(entropy()) << 32) | entropy();
+
+    m_running = true;
+    m_thread = std::thread(&SeekStreamServer::run, this);
+
+    return true;
+}
+
+void SeekStreamServer::stop()
+{
+    if (m_running) {
+        m_running = false;
+        wake(m_wake_fds[1]);
+    }
+    if (m_thread.joinable())
+        m_thread.join();
+
+    for (int* fd : { &m_listen_fd, &m_udp_fd, &m_wake_fds[0], &m_wake_fds[1] }) {
+        if (*fd >= 0)
+            ::close(*fd);
+        *fd = -1;
+    }
+    m_tcp_port = -1;
+    m_udp_port = -1;
+    m_frames.clear();
+}
+
+bool SeekStreamServer::isRunning() const
+{
+    return m_running;
+}
+
+int SeekStreamServer::tcp_port() const
+{
+    return m_tcp_port;
+}
+
+int SeekStreamServer::udp_port() const
+{
+    return m_udp_port;
+}
+
+StreamStats SeekStreamServer::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+int SeekStreamServer::acquire_frame()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (size_t i = 0; i < m_frames.size(); i++) {
+        if (m_frames[i].refs == 0) {
+            m_frames[i].refs = 1;
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void SeekStreamServer::release_frame(int index)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_frames[index].refs--;
+}
+
+void SeekStreamServer::submit_frame(int index, const FrameMeta& meta, ProcessingLevel::Enum level)
+{
+    StreamHeader& header = m_frames[index].header;
+
+    /* the only encode step, shared by every client */
+    header.magic = stream_magic;
+    header.version = stream_version;
+    header.header_size = sizeof(StreamHeader);
+    header.width = m_width;
+    header.height = m_height;
+    header.level = level;
+    header.payload_size = m_width * m_height * sizeof(uint16_t);
+    header.sequence = meta.sequence;
+    header.timestamp_ns = meta.timestamp_ns;
+    header.frame_id = meta.frame_id;
+    header.frame_counter = meta.frame_counter;
+    header.frames_skipped = meta.frames_skipped;
+    header.flags = meta.shutter ? stream_flag_shutter : 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_frames[index].stream_sequence = m_stream_sequence++;
+        m_stats.frames_published++;
+        metric_add(MetricCounter::STREAM_FRAMES_PUBLISHED);
+
+        /* the network thread hasn't picked up the previous frame yet, replace it */
+        if (m_pending >= 0) {
+            m_frames[m_pending].refs--;
+            m_stats.frames_dropped++;
+            metric_add(MetricCounter::STREAM_FRAMES_DROPPED);
+        }
+        m_pending = index;
+    }
+
+    wake(m_wake_fds[1]);
+}
+
+bool SeekStreamServer::publish(const SeekCamCore& cam, ProcessingLevel::Enum level)
+{
+    FrameMeta meta;
+
+    SEEK_TRACE_SCOPE("stream_publish");
+    SEEK_METRIC_SCOPE(MetricStage::STREAM_PUBLISH);
+
+    if (!m_running || cam.width() != m_width || cam.height() != m_height)
+        return false;
+
+    const int index = acquire_frame();
+    if (index < 0)
+        return false;
+
+    if (!cam.retrieveInto(m_frames[index].pixels.data(), m_width * sizeof(uint16_t), level, &meta)) {
+        release_frame(index);
+        return false;
+    }
+
+    submit_frame(index, meta, level);
+    return true;
+}
+
+bool SeekStreamServer::publish(const uint16_t* frame, size_t step, const FrameMeta& meta,
+                               ProcessingLevel::Enum level)
+{
+    int y;
+
+    SEEK_METRIC_SCOPE(MetricStage::STREAM_PUBLISH);
+
+    if (!m_running || frame == nullptr || step < m_width * sizeof(uint16_t))
+        return false;
+
+    const int index = acquire_frame();
+    if (index < 0)
+        return false;
+
+    uint16_t* pixels = m_frames[index].pixels.data();
+    for (y=0; y<m_height; y++)
+        std::memcpy(pixels + y * m_width, reinterpret_cast<const uint8_t*>(frame) + y * step,
+                    m_width * sizeof(uint16_t));
+
+    submit_frame(index, meta, level);
+    return true;
+}
+
+void SeekStreamServer::run()
+{
+    size_t i;
+    char buf[64];
+    std::vector<struct pollfd> fds;
+    int64_t clients = 0;
+    int64_t sending = 0;
+
+    trace_thread_name("stream_network");
+    fds.reserve(m_max_clients + 3);
+
+    while (m_running) {
+        fds.clear();
+        fds.push_back({ m_wake_fds[0], POLLIN, 0 });
+        fds.push_back({ m_listen_fd, POLLIN, 0 });
+        fds.push_back({ m_udp_fd, POLLIN, 0 });
+        for (i = 0; i < m_clients.size(); i++)
+            fds.push_back({ m_clients[i].fd, static_cast<short>(m_clients[i].frame >= 0 ? POLLIN | POLLOUT : POLLIN), 0 });
+
+        /* wake up once in a while to expire silent udp subscribers */
+        if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) {
+            error("Error: stream server poll failed\n");
+            break;
+        }
+
+        /* clients first, their pollfd indices are only valid until the list changes */
+        for (i = m_clients.size(); i-- > 0; ) {
+            const short revents = fds[3 + i].revents;
+            bool ok = true;
+
+            if (revents & (POLLERR | POLLHUP | POLLNVAL))
+                ok = false;
+
+            /* clients don't send anything, data or eof means they're done */
+            if (ok && (revents & POLLIN))
+                ok = false;
+
+            if (ok && (revents & POLLOUT))
+                ok = flush_client(m_clients[i]);
+
+            if (!ok)
+                drop_client(i);
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int index;
+
+            while (read(m_wake_fds[0], buf, sizeof(buf)) > 0)
+                ;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                index = m_pending;
+                m_pending = -1;
+            }
+            if (index >= 0)
+                distribute(index);
+        }
+
+        if (fds[1].revents & POLLIN)
+            accept_client();
+
+        if (fds[2].revents & POLLIN)
+            handle_udp();
+
+        /* expire udp subscribers */
+        const uint64_t now = now_ns();
+        for (i = m_subscribers.size(); i-- > 0; ) {
+            if (now - m_subscribers[i].last_seen_ns > subscriber_timeout_ns)
+                m_subscribers.erase(m_subscribers.begin() + i);
+        }
+
+        /* added as differences, several servers share the gauges */
+        const int64_t clients_now = m_clients.size() + m_subscribers.size();
+        const int64_t sending_now = std::count_if(m_clients.begin(), m_clients.end(),
+                                                  [](const StreamClientState& c) { return c.frame >= 0; });
+        metric_add(MetricGauge::STREAM_CLIENTS, clients_now - clients);
+        metric_add(MetricGauge::STREAM_SEND_QUEUE, sending_now - sending);
+        clients = clients_now;
+        sending = sending_now;
+    }
+
+    metric_add(MetricGauge::STREAM_CLIENTS, -clients);
+    metric_add(MetricGauge::STREAM_SEND_QUEUE, -sending);
+
+    while (!m_clients.empty())
+        drop_client(m_clients.size() - 1);
+    m_subscribers.clear();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pending >= 0)
+        m_frames[m_pending].refs--;
+    m_pending = -1;
+}
+
+void SeekStreamServer::distribute(int index)
+{
+    size_t i;
+
+    SEEK_TRACE_SCOPE("stream_distribute");
+
+    for (i = m_clients.size(); i-- > 0; ) {
+        StreamClientState& client = m_clients[i];
+
+        /* still busy with an older frame: skip this one instead of queueing */
+        if (client.frame >= 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.client_frames_dropped++;
+            metric_add(MetricCounter::STREAM_CLIENT_FRAMES_DROPPED);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_frames[index].refs++;
+        }
+        client.frame = index;
+        client.offset = 0;
+
+        if (!flush_client(client))
+            drop_client(i);
+    }
+
+    for (i = 0; i < m_subscribers.size(); i++)
+        send_udp(m_subscribers[i], index);
+
+    release_frame(index);
+}
+
+bool SeekStreamServer::flush_client(StreamClientState& client)
+{
+    struct iovec iov[2];
+    struct msghdr msg;
+
+    if (client.frame < 0)
+        return true;
+
+    const StreamFrame& frame = m_frames[client.frame];
+    const size_t total = sizeof(StreamHeader) + frame.header.payload_size;
+
+    while (client.offset < total) {
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = frame_iov(frame, client.offset, total - client.offset, iov);
+
+        const ssize_t n = sendmsg(client.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            /* socket buffer full, continue when poll reports POLLOUT */
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        client.offset += n;
+    }
+
+    release_frame(client.frame);
+    client.frame = -1;
+
+    return true;
+}
+
+void SeekStreamServer::drop_client(size_t i)
+{
+    if (m_clients[i].frame >= 0)
+        release_frame(m_clients[i].frame);
+    ::close(m_clients[i].fd);
+    m_clients.erase(m_clients.begin() + i);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.tcp_clients = m_clients.size();
+}
+
+void SeekStreamServer::accept_client()
+{
+    int fd;
+    int one = 1;
+
+    while ((fd = accept(m_listen_fd, nullptr, nullptr)) >= 0) {
+        if (static_cast<int>(m_clients.size()) >= m_max_clients || !set_nonblocking(fd)) {
+            debug("rejecting stream client\n");
+            ::close(fd);
+            continue;
+        }
+
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        m_clients.push_back({ fd, -1, 0 });
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.tcp_clients = m_clients.size();
+    }
+}
+
+void SeekStreamServer::handle_udp()
+{
+    char buf[16];
+    struct sockaddr_storage addr;
+    socklen_t len;
+    ssize_t n;
+    size_t i;
+
+    for (;;) {
+        len = sizeof(addr);
+        n = recvfrom(m_udp_fd, buf, sizeof(buf), 0, reinterpret_cast<struct sockaddr*>(&addr), &len);
+        if (n < 0)
+            break;
+
+        for (i = 0; i < m_subscribers.size(); i++) {
+            if (m_subscribers[i].addr_len == len && std::memcmp(m_subscribers[i].addr, &addr, len) == 0)
+                break;
+        }
+
+        if (n == 3 && std::memcmp(buf, "SUB", 3) == 0) {
+            send_cookie(&addr, len);
+        } else if (n == static_cast<ssize_t>(3 + cookie_size) && std::memcmp(buf, "SUB", 3) == 0) {
+            if (!valid_cookie(buf + 3, &addr, len)) {
+                send_cookie(&addr, len);
+            } else if (i < m_subscribers.size()) {
+                m_subscribers[i].last_seen_ns = now_ns();
+            } else if (static_cast<int>(m_subscribers.size()) < m_max_clients) {
+                StreamSubscriber subscriber;
+                std::memcpy(subscriber.addr, &addr, len);
+                subscriber.addr_len = len;
+                subscriber.last_seen_ns = now_ns();
+                m_subscribers.push_back(subscriber);
+            }
+        } else if (n == static_cast<ssize_t>(5 + cookie_size) && std::memcmp(buf, "UNSUB", 5) == 0 &&
+                   i < m_subscribers.size() && valid_cookie(buf + 5, &addr, len)) {
+            m_subscribers.erase(m_subscribers.begin() + i);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.udp_subscribers = m_subscribers.size();
+}
+
+uint64_t SeekStreamServer::cookie(const void* addr, uint32_t addr_len, uint64_t epoch) const
+{
+    uint8_t data[sizeof(StreamSubscriber::addr) + sizeof(epoch)];
+
+    std::memcpy(data, addr, addr_len);
+    std::memcpy(data + addr_len, &epoch, sizeof(epoch));
+
+    return siphash(m_cookie_key, data, addr_len + sizeof(epoch));
+}
+
+bool SeekStreamServer::valid_cookie(const char* data, const void* addr, uint32_t addr_len) const
+{
+    uint64_t value;
+    const uint64_t epoch = now_ns() / cookie_period_ns;
+
+    std::memcpy(&value, data, sizeof(value));
+
+    /* the current or the previous period */
+    return value == cookie(addr, addr_len, epoch) || value == cookie(addr, addr_len, epoch - 1);
+}
+
+void SeekStreamServer::send_cookie(const void* addr, uint32_t addr_len)
+{
+    char reply[6 + cookie_size];
+    const uint64_t value = cookie(addr, addr_len, now_ns() / cookie_period_ns);
+
+    std::memcpy(reply, "COOKIE", 6);
+    std::memcpy(reply + 6, &value, sizeof(value));
+
+    const ssize_t n = sendto(m_udp_fd, reply, sizeof(reply), MSG_DONTWAIT,
+                             static_cast<const struct sockaddr*>(addr), addr_len);
+    (void)n;
+}
+
+void SeekStreamServer::send_udp(StreamSubscriber& subscriber, int index)
+{
+    size_t offset;
+    StreamFragment fragment;
+    struct iovec iov[3];
+    struct msghdr msg;
+
+    const StreamFrame& frame = m_frames[index];
+    const size_t total = sizeof(StreamHeader) + frame.header.payload_size;
+
+    fragment.magic = stream_fragment_magic;
+    fragment.frame_size = total;
+    fragment.stream_sequence = frame.stream_sequence;
+    fragment.reserved = 0;
+
+    for (offset = 0; offset < total; offset += udp_chunk_size) {
+        fragment.offset = offset;
+
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_name = subscriber.addr;
+        msg.msg_namelen = subscriber.addr_len;
+        msg.msg_iov = iov;
+        iov[0].iov_base = &fragment;
+        iov[0].iov_len = sizeof(fragment);
+        msg.msg_iovlen = 1 + frame_iov(frame, offset, std::min(udp_chunk_size, total - offset), iov + 1);
+
+        if (sendmsg(m_udp_fd, &msg, MSG_DONTWAIT) < 0) {
+            /* the rest of the frame is useless to the subscriber now */
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.client_frames_dropped++;
+            metric_add(MetricCounter::STREAM_CLIENT_FRAMES_DROPPED);
+            return;
+        }
+    }
+}
+
+/*
+ *  Client
+ */
+SeekStreamClient::SeekStreamClient() :
+    m_fd(-1),
+    m_udp(false),
+    m_last_subscribe_ns(0),
+    m_has_cookie(false),
+    m_tcp_frame(),
+    m_tcp_frame_size(0),
+    m_tcp_received(0),
+    m_assembly(),
+    m_assembly_chunks(),
+    m_assembly_sequence(0),
+    m_assembly_missing(0),
+    m_assembling(false),
+    m_incomplete(0)
+{
+    std::memset(m_cookie, 0, sizeof(m_cookie));
+}
+
+SeekStreamClient::~SeekStreamClient()
+{
+    close();
+}
+
+static int connect_socket(const std::string& host, int port, int type)
+{
+    int fd = -1;
+    struct addrinfo hints;
+    struct addrinfo* res;
+    const std::string service = std::to_string(port);
+
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = type;
+
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &res) != 0) {
+        error("Error: failed to resolve %s\n", host.c_str());
+        return -1;
+    }
+
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0 && ::connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd < 0)
+        error("Error: failed to connect to %s:%d\n", host.c_str(), port);
+
+    return fd;
+}
+
+bool SeekStreamClient::connect(const std::string& host, int port)
+{
+    close();
+
+    m_fd = connect_socket(host, port, SOCK_STREAM);
+    m_udp = false;
+    m_tcp_frame.resize(sizeof(StreamHeader));
+    m_tcp_frame_size = 0;
+    m_tcp_received = 0;
+
+    return m_fd >= 0;
+}
+
+bool SeekStreamClient::subscribe(const std::string& host, int port)
+{
+    int rcvbuf = 4 << 20;
+
+    close();
+
+    m_fd = connect_socket(host, port, SOCK_DGRAM);
+    if (m_fd < 0)
+        return false;
+
+    /* a whole frame arrives in a burst of datagrams */
+    setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    m_udp = true;
+    m_has_cookie = false;
+    m_assembling = false;
+
+    return send_subscribe();
+}
+
+void SeekStreamClient::close()
+{
+    if (m_fd < 0)
+        return;
+
+    /* best effort, the server expires silent subscribers anyway */
+    if (m_udp && m_has_cookie) {
+        char request[5 + cookie_size];
+        std::memcpy(request, "UNSUB", 5);
+        std::memcpy(request + 5, m_cookie, cookie_size);
+        const ssize_t n = send(m_fd, request, sizeof(request), 0);
+        (void)n;
+    }
+
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+uint64_t SeekStreamClient::incomplete() const
+{
+    return m_incomplete;
+}
+
+bool SeekStreamClient::send_subscribe()
+{
+    char request[3 + cookie_size];
+    const size_t size = m_has_cookie ? sizeof(request) : 3;
+
+    std::memcpy(request, "SUB", 3);
+    std::memcpy(request + 3, m_cookie, cookie_size);
+    m_last_subscribe_ns = now_ns();
+
+    return send(m_fd, request, size, 0) == static_cast<ssize_t>(size);
+}
+
+bool SeekStreamClient::receive(StreamHeader& header, std::vector<uint16_t>& pixels, int timeout_ms)
+{
+    if (m_fd < 0)
+        return false;
+
+    return m_udp ? receive_udp(header, pixels, timeout_ms) : receive_tcp(header, pixels, timeout_ms);
+}
+
+/* milliseconds left until deadline, -1 for no deadline */
+static int remaining_ms(uint64_t deadline_ns)
+{
+    if (deadline_ns == 0)
+        return -1;
+
+    const uint64_t now = now_ns();
+    return now >= deadline_ns ? 0 : static_cast<int>((deadline_ns - now + 999999) / 1000000);
+}
+
+/*
+ *  Reads up to size bytes, as many as arrive before the deadline
+ *  Returns the bytes read, -1 when the connection was closed or failed
+ */
+static ssize_t recv_until(int fd, void* data, size_t size, uint64_t deadline_ns)
+{
+    uint8_t* p = static_cast<uint8_t*>(data);
+    size_t received = 0;
+
+    while (received < size) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        const int timeout = remaining_ms(deadline_ns);
+
+        if (timeout == 0)
+            break;
+        const int ready = poll(&pfd, 1, timeout);
+        if (ready < 0 && errno != EINTR)
+            return -1;
+        if (ready <= 0)
+            continue;
+
+        const ssize_t n = recv(fd, p + received, size - received, 0);
+        if (n <= 0)
+            return -1;
+        received += n;
+    }
+
+    return received;
+}
+
+static bool valid_header(const StreamHeader& header)
+{
+    return header.magic == stream_magic && header.version == stream_version &&
+           header.header_size >= sizeof(StreamHeader) &&
+           header.payload_size == static_cast<uint64_t>(header.width) * header.height * sizeof(uint16_t);
+}
+
+bool SeekStreamClient::receive_tcp(StreamHeader& header, std::vector<uint16_t>& pixels, int timeout_ms)
+{
+    const uint64_t deadline = timeout_ms < 0 ? 0 : now_ns() + timeout_ms * 1000000ULL;
+
+    for (;;) {
+        const size_t size = m_tcp_frame_size > 0 ? m_tcp_frame_size : sizeof(StreamHeader);
+
+        if (m_tcp_received < size) {
+            const ssize_t n = recv_until(m_fd, m_tcp_frame.data() + m_tcp_received, size - m_tcp_received, deadline);
+            if (n < 0) {
+                close();
+                return false;
+            }
+            /* timed out, the next call goes on with the rest of the frame */
+            m_tcp_received += n;
+            if (m_tcp_received < size)
+                return false;
+        }
+
+        if (m_tcp_frame_size > 0)
+            break;
+
+        std::memcpy(&header, m_tcp_frame.data(), sizeof(header));
+        if (!valid_header(header)) {
+            error("Error: invalid stream header\n");
+            close();
+            return false;
+        }
+
+        /* a newer server may send a longer header, it is skipped */
+        m_tcp_frame_size = header.header_size + header.payload_size;
+        m_tcp_frame.resize(m_tcp_frame_size);
+    }
+
+    std::memcpy(&header, m_tcp_frame.data(), sizeof(header));
+    pixels.resize(header.width * header.height);
+    std::memcpy(pixels.data(), m_tcp_frame.data() + header.header_size, header.payload_size);
+    m_tcp_frame_size = 0;
+    m_tcp_received = 0;
+
+    return true;
+}
+
+bool SeekStreamClient::receive_udp(StreamHeader& header, std::vector<uint16_t>& pixels, int timeout_ms)
+{
+    uint8_t buf[sizeof(StreamFragment) + udp_chunk_size];
+    StreamFragment fragment;
+    const uint64_t deadline = timeout_ms < 0 ? 0 : now_ns() + timeout_ms * 1000000ULL;
+
+    for (;;) {
+        struct pollfd pfd = { m_fd, POLLIN, 0 };
+        int timeout = remaining_ms(deadline);
+
+        if (timeout == 0)
+            return false;
+
+        /* keep the subscription alive */
+        if (now_ns() - m_last_subscribe_ns > resubscribe_interval_ns)
+            send_subscribe();
+        timeout = timeout < 0 ? 1000 : std::min(timeout, 1000);
+
+        if (poll(&pfd, 1, timeout) <= 0)
+            continue;
+
+        const ssize_t n = recv(m_fd, buf, sizeof(buf), 0);
+
+        /* answer to a subscription, send it back to get frames */
+        if (n == static_cast<ssize_t>(6 + cookie_size) && std::memcmp(buf, "COOKIE", 6) == 0) {
+            std::memcpy(m_cookie, buf + 6, cookie_size);
+            m_has_cookie = true;
+            send_subscribe();
+            continue;
+        }
+
+        if (n < static_cast<ssize_t>(sizeof(fragment)))
+            continue;
+
+        /* every fragment but the last one carries a whole chunk */
+        std::memcpy(&fragment, buf, sizeof(fragment));
+        const size_t size = n - sizeof(fragment);
+        if (fragment.magic != stream_fragment_magic || fragment.frame_size < sizeof(StreamHeader) ||
+                fragment.frame_size > max_udp_frame_size || fragment.offset % udp_chunk_size != 0 ||
+                fragment.offset >= fragment.frame_size ||
+                size != std::min<size_t>(udp_chunk_size, fragment.frame_size - fragment.offset))
+            continue;
+
+        if (!m_assembling || fragment.stream_sequence != m_assembly_sequence) {
+            /* late fragment of a frame we gave up on */
+            if (m_assembling && fragment.stream_sequence < m_assembly_sequence)
+                continue;
+            if (m_assembling)
+                m_incomplete++;
+
+            const size_t chunks = (fragment.frame_size + udp_chunk_size - 1) / udp_chunk_size;
+            m_assembly.resize(fragment.frame_size);
+            m_assembly_chunks.assign(chunks, false);
+            m_assembly_sequence = fragment.stream_sequence;
+            m_assembly_missing = chunks;
+            m_assembling = true;
+        }
+
+        /* the frame size is the one of the first fragment, a duplicate chunk doesn't count twice */
+        const size_t chunk = fragment.offset / udp_chunk_size;
+        if (fragment.frame_size != m_assembly.size() || m_assembly_chunks[chunk])
+            continue;
+
+        std::memcpy(m_assembly.data() + fragment.offset, buf + sizeof(fragment), size);
+        m_assembly_chunks[chunk] = true;
+        if (--m_assembly_missing > 0)
+            continue;
+
+        m_assembling = false;
+        std::memcpy(&header, m_assembly.data(), sizeof(header));
+        if (!valid_header(header) || header.header_size + header.payload_size != m_assembly.size()) {
+            error("Error: invalid stream header\n");
+            continue;
+        }
+
+        pixels.resize(header.width * header.height);
+        std::memcpy(pixels.data(), m_assembly.data() + header.header_size, header.payload_size);
+        return true;
+    }
+}
@@ -0,0 +1,247 @@
+/*
+ *  Seek network streaming
+ *  Sends 16-bit frames with their metadata to any number of TCP clients
+ *  and UDP subscribers, and receives them again on the other side.
+ *
+ *  Every frame is encoded once and shared by all subscribers. Sockets are
+ *  non blocking: a client that can't keep up misses frames instead of
+ *  slowing down capture or the other clients. POSIX only.
+ */
+
+#ifndef SEEK_STREAM_H
+#define SEEK_STREAM_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+#include "SeekCamCore.h"
+
+namespace LibSeek {
+
+/*
+ *  Wire format, all fields little endian
+ *
+ *  TCP: a StreamHeader followed by payload_size bytes of pixels
+ *  (width x height uint16_t, row major), repeated for every frame.
+ *
+ *  UDP: send "SUB" to the server port, the server answers with "COOKIE"
+ *  and an 8 byte cookie for the sender address. "SUB" followed by the
+ *  cookie subscribes, repeat it at least every 10 s to stay subscribed,
+ *  "UNSUB" followed by the cookie ends it. An expired cookie is answered
+ *  with a new one. Only an address that receives the cookie can subscribe,
+ *  so a forged sender address doesn't get frames sent to somebody else.
+ *  Frames arrive as datagrams of a StreamFragment followed by bytes
+ *  [offset, offset + n) of the TCP encoding of the frame, in chunks of
+ *  1400 bytes, only the last one shorter.
+ */
+struct StreamHeader {
+    uint32_t magic;             /* stream_magic */
+    uint16_t version;           /* stream_version */
+    uint16_t header_size;       /* sizeof(StreamHeader), payload starts after it */
+    uint32_t width;
+    uint32_t height;
+    uint32_t level;             /* ProcessingLevel */
+    uint32_t payload_size;      /* width * height * 2 */
+    uint64_t sequence;          /* FrameMeta::sequence */
+    uint64_t timestamp_ns;      /* FrameMeta::timestamp_ns */
+    int32_t frame_id;
+    int32_t frame_counter;
+    uint32_t frames_skipped;
+    uint32_t flags;             /* stream_flag_* */
+};
+
+struct StreamFragment {
+    uint32_t magic;             /* stream_fragment_magic */
+    uint32_t frame_size;        /* header_size + payload_size of the frame */
+    uint64_t stream_sequence;   /* frames sent by the server before this one */
+    uint32_t offset;            /* of the data in this datagram within the frame */
+    uint32_t reserved;
+};
+
+static const uint32_t stream_magic = 0x54534b53;            /* "SKST" */
+static const uint32_t stream_fragment_magic = 0x46534b53;   /* "SKSF" */
+static const uint16_t stream_version = 1;
+static const uint32_t stream_flag_shutter = 1;
+
+struct StreamStats {
+    uint64_t frames_published;
+    uint64_t frames_dropped;        /* published while the previous frame wasn't sent out yet */
+    uint64_t client_frames_dropped; /* frames skipped for tcp clients / subscribers that were behind */
+    int tcp_clients;
+    int udp_subscribers;
+};
+
+/* encoded frame shared by all clients */
+struct StreamFrame {
+    StreamHeader header;
+    std::vector<uint16_t> pixels;
+    uint64_t stream_sequence;
+    int refs;                   /* publisher, pending slot and clients still sending it */
+};
+
+struct StreamClientState {
+    int fd;
+    int frame;                  /* index of the frame being sent, -1 when idle */
+    size_t offset;              /* bytes of it already sent */
+};
+
+struct StreamSubscriber {
+    uint8_t addr[128];          /* struct sockaddr_storage */
+    uint32_t addr_len;
+    uint64_t last_seen_ns;
+};
+
+class SeekStreamServer
+{
+public:
+    SeekStreamServer();
+    ~SeekStreamServer();
+
+    /*
+     *  Bind the sockets and start the network thread
+     *  tcp_port, udp_port: port to listen on, 0 for any free port, -1 to disable
+     *  width, height:      frame size
+     *  max_clients:        tcp clients and udp subscribers, each
+     *  address:            ipv4 address to listen on, "0.0.0.0" for all interfaces
+     *  Returns true on success
+     */
+    bool start(int tcp_port, int udp_port, int width, int height, int max_clients=8,
+               const std::string& address="127.0.0.1");
+
+    /*
+     *  Stop the network thread and disconnect everybody
+     */
+    void stop();
+
+    bool isRunning() const;
+
+    /*
+     *  Ports actually bound, -1 when disabled
+     */
+    int tcp_port() const;
+    int udp_port() const;
+
+    /*
+     *  Send the last frame grabbed by cam, retrieved straight into the
+     *  send buffer. Never waits for the network.
+     *  Returns false when not running, sizes differ or no frame is available
+     */
+    bool publish(const SeekCamCore& cam, ProcessingLevel::Enum level=ProcessingLevel::FULLY_CORRECTED);
+
+    /*
+     *  Send a frame from a buffer
+     *  step:   distance between rows in bytes
+     */
+    bool publish(const uint16_t* frame, size_t step, const FrameMeta& meta,
+                 ProcessingLevel::Enum level=ProcessingLevel::FULLY_CORRECTED);
+
+    StreamStats stats() const;
+
+private:
+    SeekStreamServer(const SeekStreamServer&);
+    SeekStreamServer& operator=(const SeekStreamServer&);
+
+    int acquire_frame();
+    void submit_frame(int index, const FrameMeta& meta, ProcessingLevel::Enum level);
+    void release_frame(int index);
+
+    void run();
+    void distribute(int index);
+    void accept_client();
+    void handle_udp();
+    bool flush_client(StreamClientState& client);
+    void drop_client(size_t i);
+    void send_udp(StreamSubscriber& subscriber, int index);
+    uint64_t cookie(const void* addr, uint32_t addr_len, uint64_t epoch) const;
+    bool valid_cookie(const char* data, const void* addr, uint32_t addr_len) const;
+    void send_cookie(const void* addr, uint32_t addr_len);
+
+    int m_width;
+    int m_height;
+    int m_max_clients;
+    int m_listen_fd;
+    int m_udp_fd;
+    int m_wake_fds[2];
+    int m_tcp_port;
+    int m_udp_port;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+
+    /* guards the frame reference counts, m_pending and m_stats */
+    mutable std::mutex m_mutex;
+    std::vector<StreamFrame> m_frames;
+    int m_pending;                      /* frame waiting for the network thread, -1 if none */
+    uint64_t m_stream_sequence;
+    StreamStats m_stats;
+
+    /* network thread only */
+    std::vector<StreamClientState> m_clients;
+    std::vector<StreamSubscriber> m_subscribers;
+    uint64_t m_cookie_key[2];           /* random per start() */
+};
+
+class SeekStreamClient
+{
+public:
+    SeekStreamClient();
+    ~SeekStreamClient();
+
+    /*
+     *  Connect to the tcp port of a server
+     */
+    bool connect(const std::string& host, int port);
+
+    /*
+     *  Subscribe at the udp port of a server, frames arrive once receive()
+     *  has completed the cookie exchange
+     */
+    bool subscribe(const std::string& host, int port);
+
+    void close();
+
+    /*
+     *  Wait for the next frame
+     *  header:     receives the frame header
+     *  pixels:     resized to width x height and filled
+     *  timeout_ms: -1 waits forever
+     *  Returns false on timeout, a closed connection or a protocol error.
+     *  A tcp frame cut off by the timeout is continued by the next call,
+     *  after a closed connection or a protocol error the client is closed.
+     */
+    bool receive(StreamHeader& header, std::vector<uint16_t>& pixels, int timeout_ms=-1);
+
+    /*
+     *  Udp frames that didn't arrive completely
+     */
+    uint64_t incomplete() const;
+
+private:
+    SeekStreamClient(const SeekStreamClient&);
+    SeekStreamClient& operator=(const SeekStreamClient&);
+
+    bool receive_tcp(StreamHeader& header, std::vector<uint16_t>& pixels, int timeout_ms);
+    bool receive_udp(StreamHeader& header, std::vector<uint16_t>& pixels, int timeout_ms);
+    bool send_subscribe();
+
+    int m_fd;
+    bool m_udp;
+    uint64_t m_last_subscribe_ns;
+    uint8_t m_cookie[8];                /* udp subscription cookie from the server */
+    bool m_has_cookie;
+    std::vector<uint8_t> m_tcp_frame;   /* tcp frame being received, kept across timeouts */
+    size_t m_tcp_frame_size;            /* 0 until the header of the frame arrived */
+    size_t m_tcp_received;
+    std::vector<uint8_t> m_assembly;    /* udp frame being reassembled */
+    std::vector<bool> m_assembly_chunks;    /* chunks of the frame that arrived */
+    uint64_t m_assembly_sequence;
+    size_t m_assembly_missing;          /* chunks still missing */
+    bool m_assembling;
+    uint64_t m_incomplete;
+};
+
+} /* LibSeek */
+
+#endif /* SEEK_STREAM_H */
@@ -3,23 +3,13 @@
  *  Author: Maarten Vandersteegen
  */
 
-#include "SeekThermal.h"
+#include "SeekCamCore.h"
 #include "SeekLogging.h"
 #include <endian.h>
 
 using namespace LibSeek;
 
-SeekThermal::SeekThermal() :
-    SeekThermal(std::string())
-{ }
-
-SeekThermal::SeekThermal(std::string ffc_filename) :
-    SeekCam(0x289d, 0x0010, m_buffer,
-            THERMAL_RAW_HEIGHT, THERMAL_RAW_WIDTH, THERMAL_REQUEST_SIZE,
-            cv::Rect(0, 1, THERMAL_WIDTH, THERMAL_HEIGHT), ffc_filename)
-{ }
-
-bool SeekThermal::init_cam()
+bool SeekCamCore::init_sequence(const SeekThermalTraits&)
 {
     {
         std::vector<uint8_t> data = { 0x01 };
@@ -57,6 +47,7 @@ bool SeekThermal::init_cam()
         if (!m_dev.request_get(DeviceCommand::GET_FACTORY_SETTINGS, data))
             return false;
         print_usb_data(data);
+        store_factory_settings(data);
     }
     {
         std::vector<uint8_t> data = { 0x20, 0x00, 0x50, 0x00, 0x00, 0x00 };
@@ -68,6 +59,7 @@ bool SeekThermal::init_cam()
         if (!m_dev.request_get(DeviceCommand::GET_FACTORY_SETTINGS, data))
             return false;
         print_usb_data(data);
+        store_factory_settings(data);
     }
     {
         std::vector<uint8_t> data = { 0x0c, 0x00, 0x70, 0x00, 0x00, 0x00 };
@@ -79,6 +71,7 @@ bool SeekThermal::init_cam()
         if (!m_dev.request_get(DeviceCommand::GET_FACTORY_SETTINGS, data))
             return false;
         print_usb_data(data);
+        store_factory_settings(data);
     }
     {
         std::vector<uint8_t> data = { 0x06, 0x00, 0x08, 0x00, 0x00, 0x00 };
@@ -90,6 +83,7 @@ bool SeekThermal::init_cam()
         if (!m_dev.request_get(DeviceCommand::GET_FACTORY_SETTINGS, data))
             return false;
         print_usb_data(data);
+        store_factory_settings(data);
     }
     {
         std::vector<uint8_t> data = { 0x08, 0x00 };
@@ -121,13 +115,3 @@ bool SeekThermal::init_cam()
 
     return true;
 }
-
-int SeekThermal::frame_id()
-{
-    return m_raw_data[10];
-}
-
-int SeekThermal::frame_counter()
-{
-    return m_raw_data[40];
-}
@@ -8,20 +8,17 @@
 
 #include <opencv2/opencv.hpp>
 #include "SeekCam.h"
-
-#define THERMAL_WIDTH       207
-#define THERMAL_HEIGHT      154
-#define THERMAL_RAW_WIDTH   208
-#define THERMAL_RAW_HEIGHT  156
-#define THERMAL_REQUEST_SIZE 16224
-#define THERMAL_RAW_SIZE    (THERMAL_RAW_WIDTH * THERMAL_RAW_HEIGHT)
+#include "SeekCamModel.h"
 
 namespace LibSeek {
 
-class SeekThermal: public SeekCam
+class SeekThermal: public SeekCamModel<SeekThermalTraits, SeekCam>
 {
 public:
-    SeekThermal();
+    SeekThermal() :
+        SeekThermal(std::string())
+    { }
+
     /*
      *  ffc_filename:
      *      Filename for additional flat field calibration and corner
@@ -29,15 +26,9 @@ public:
      *      be subtracted from each retrieved frame. If not, no additional
      *      flat field calibration will be applied
      */
-    SeekThermal(std::string ffc_filename);
-
-    virtual bool init_cam();
-    virtual int frame_id();
-    virtual int frame_counter();
-
-private:
-    uint16_t m_buffer[THERMAL_RAW_SIZE];
-
+    SeekThermal(std::string ffc_filename) :
+        SeekCamModel<SeekThermalTraits, SeekCam>(ffc_filename)
+    { }
 };
 
 } /* LibSeek */
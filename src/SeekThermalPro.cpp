@@ -3,23 +3,13 @@
  *  Author: Maarten Vandersteegen
  */
 
-#include "SeekThermalPro.h"
+#include "SeekCamCore.h"
 #include "SeekLogging.h"
 #include <endian.h>
 
 using namespace LibSeek;
 
-SeekThermalPro::SeekThermalPro() :
-    SeekThermalPro(std::string())
-{ }
-
-SeekThermalPro::SeekThermalPro(std::string ffc_filename) :
-    SeekCam(0x289d, 0x0011, m_buffer,
-            THERMAL_PRO_RAW_HEIGHT, THERMAL_PRO_RAW_WIDTH, THERMAL_PRO_REQUEST_SIZE,
-            cv::Rect(1, 4, THERMAL_PRO_WIDTH, THERMAL_PRO_HEIGHT), ffc_filename)
-{ }
-
-bool SeekThermalPro::init_cam()
+bool SeekCamCore::init_sequence(const SeekThermalProTraits&)
 {
     {
         std::vector<uint8_t> data = { 0x01 };
@@ -57,6 +47,7 @@ bool SeekThermalPro::init_cam()
         if (!m_dev.request_get(DeviceCommand::GET_FACTORY_SETTINGS, data))
             return false;
         print_usb_data(data);
+        store_factory_settings(data);
     }
     {
         std::vector<uint8_t> data = { 0x17, 0x00 };
@@ -79,6 +70,7 @@ bool SeekThermalPro::init_cam()
         if (!m_dev.request_get(DeviceCommand::GET_FACTORY_SETTINGS, data))
             return false;
         print_usb_data(data);
+        store_factory_settings(data);
     }
     {
         std::vector<uint8_t> data = { 0x01, 0x00, 0x01, 0x06, 0x00, 0x00 };
@@ -90,6 +82,7 @@ bool SeekThermalPro::init_cam()
         if (!m_dev.request_get(DeviceCommand::GET_FACTORY_SETTINGS, data))
             return false;
         print_usb_data(data);
+        store_factory_settings(data);
     }
 
     uint16_t addr, addrle;
@@ -107,6 +100,7 @@ bool SeekThermalPro::init_cam()
             if (!m_dev.request_get(DeviceCommand::GET_FACTORY_SETTINGS, data))
                 return false;
             print_usb_data(data);
+            store_factory_settings(data);
         }
     }
 
@@ -134,14 +128,3 @@ bool SeekThermalPro::init_cam()
 
     return true;
 }
-
-int SeekThermalPro::frame_id()
-{
-    return m_raw_data[2];
-}
-
-int SeekThermalPro::frame_counter()
-{
-    return m_raw_data[1];
-}
-
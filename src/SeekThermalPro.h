@@ -8,20 +8,17 @@
 
 #include <opencv2/opencv.hpp>
 #include "SeekCam.h"
-
-#define THERMAL_PRO_WIDTH       320
-#define THERMAL_PRO_HEIGHT      240
-#define THERMAL_PRO_RAW_WIDTH   342
-#define THERMAL_PRO_RAW_HEIGHT  260
-#define THERMAL_PRO_REQUEST_SIZE 13680
-#define THERMAL_PRO_RAW_SIZE    (THERMAL_PRO_RAW_WIDTH * THERMAL_PRO_RAW_HEIGHT)
+#include "SeekCamModel.h"
 
 namespace LibSeek {
 
-class SeekThermalPro: public SeekCam
+class SeekThermalPro: public SeekCamModel<SeekThermalProTraits, SeekCam>
 {
 public:
-    SeekThermalPro();
+    SeekThermalPro() :
+        SeekThermalPro(std::string())
+    { }
+
     /*
      *  ffc_filename:
      *      Filename for additional flat field calibration and corner
@@ -29,15 +26,9 @@ public:
      *      be subtracted from each retrieved frame. If not, no additional
      *      flat field calibration will be applied
      */
-    SeekThermalPro(std::string ffc_filename);
-
-    virtual bool init_cam();
-    virtual int frame_id();
-    virtual int frame_counter();
-
-private:
-    uint16_t m_buffer[THERMAL_PRO_RAW_SIZE];
-
+    SeekThermalPro(std::string ffc_filename) :
+        SeekCamModel<SeekThermalProTraits, SeekCam>(ffc_filename)
+    { }
 };
 
 } /* LibSeek */
@@ -0,0 +1,274 @@
+/*
+ *  Seek tracing
+ */
+
+#include "SeekTrace.h"
+#include "SeekLogging.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace LibSeek;
+
+#ifdef SEEK_TRACING
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start_ns;
+    int64_t dur_ns;             /* -1 for instant events */
+};
+
+/* an event in a ring, atomic as export reads it while the thread may overwrite it */
+struct TraceSlot {
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> start_ns;
+    std::atomic<int64_t> dur_ns;
+};
+
+/*
+ *  Ring of the events of one thread, only written by that thread.
+ *  Event n is stored in events[n % size] before head is advanced past n
+ */
+struct TraceBuffer {
+    std::unique_ptr<TraceSlot[]> events;
+    size_t size;
+    std::atomic<uint64_t> head;         /* events recorded so far */
+    std::atomic<uint64_t> first;        /* events before it were cleared */
+    std::atomic<const char*> name;
+    int tid;
+    bool owned;                         /* by a running thread, guarded by registry_mutex */
+    uint64_t exported;                  /* head at the last export, guarded by registry_mutex */
+};
+
+/* guards the list of buffers, only taken when a thread records for the first time, exits and on export */
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<TraceBuffer> > registry;
+size_t events_per_thread = 65536;
+uint64_t origin_ns = 0;
+int thread_count = 0;
+
+/* beyond this many buffers new threads take over those with events that weren't exported */
+const size_t max_buffers = 32;
+
+/* hands the buffer of a thread back when the thread exits */
+struct BufferOwner {
+    TraceBuffer* buffer;
+
+    ~BufferOwner()
+    {
+        if (buffer != nullptr) {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            buffer->owned = false;
+        }
+    }
+};
+
+thread_local BufferOwner local_owner = { nullptr };
+thread_local const char* local_name = nullptr;
+
+/* only called while recording, threads that never record don't get a buffer */
+TraceBuffer* thread_buffer()
+{
+    TraceBuffer* buffer = local_owner.buffer;
+    size_t i;
+
+    if (buffer != nullptr)
+        return buffer;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    /* take over the buffer of an exited thread, preferably one with its events exported or cleared */
+    for (i = 0; i < registry.size(); i++) {
+        TraceBuffer* candidate = registry[i].get();
+        const uint64_t head = candidate->head.load();
+
+        if (candidate->owned)
+            continue;
+        if (head == candidate->first.load() || head == candidate->exported) {
+            buffer = candidate;
+            break;
+        }
+        if (buffer == nullptr && registry.size() >= max_buffers)
+            buffer = candidate;
+    }
+    if (buffer == nullptr) {
+        registry.push_back(std::unique_ptr<TraceBuffer>(new TraceBuffer()));
+        buffer = registry.back().get();
+    }
+
+    if (buffer->size != events_per_thread) {
+        buffer->events.reset(new TraceSlot[events_per_thread]);
+        buffer->size = events_per_thread;
+    }
+    buffer->head = 0;
+    buffer->first = 0;
+    buffer->name = local_name;
+    buffer->tid = ++thread_count;
+    buffer->owned = true;
+    buffer->exported = 0;
+    local_owner.buffer = buffer;
+
+    return buffer;
+}
+
+} /* namespace */
+
+std::atomic<bool> LibSeek::trace_active(false);
+
+uint64_t LibSeek::trace_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LibSeek::trace_record(const char* name, uint64_t start_ns, int64_t dur_ns)
+{
+    TraceBuffer* buffer = thread_buffer();
+    const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    TraceSlot& event = buffer->events[head % buffer->size];
+
+    /* an export that sees any of these stores also sees head, see trace_export() */
+    event.name.store(name, std::memory_order_release);
+    event.start_ns.store(start_ns, std::memory_order_release);
+    event.dur_ns.store(dur_ns, std::memory_order_release);
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+bool LibSeek::trace_start(size_t events)
+{
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        /* threads that already recorded keep their buffer size, taken over buffers are resized */
+        events_per_thread = std::max<size_t>(events, 16);
+        if (origin_ns == 0)
+            origin_ns = trace_now_ns();
+    }
+
+    trace_active.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void LibSeek::trace_stop()
+{
+    trace_active.store(false, std::memory_order_relaxed);
+}
+
+void LibSeek::trace_clear()
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    for (size_t i = 0; i < registry.size(); i++)
+        registry[i]->first.store(registry[i]->head.load(std::memory_order_acquire));
+    origin_ns = trace_now_ns();
+}
+
+void LibSeek::trace_thread_name(const char* name)
+{
+    /* kept for the buffer created by the first event */
+    local_name = name;
+    if (local_owner.buffer != nullptr)
+        local_owner.buffer->name.store(name);
+}
+
+bool LibSeek::trace_export(const std::string& filename)
+{
+    size_t i;
+    uint64_t n;
+    bool separator = false;
+    std::vector<TraceEvent> events;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    FILE* file = fopen(filename.c_str(), "w");
+    if (file == nullptr) {
+        error("Error: failed to create trace %s\n", filename.c_str());
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (i = 0; i < registry.size(); i++) {
+        TraceBuffer& buffer = *registry[i];
+        const uint64_t size = buffer.size;
+        const uint64_t head = buffer.head.load(std::memory_order_acquire);
+        buffer.exported = head;
+        uint64_t first = std::max(buffer.first.load(), head > size ? head - size : 0);
+
+        /*
+         *  Copy, then drop what the thread may have overwritten meanwhile. A
+         *  copied field of event m was stored after head reached m, so
+         *  head_after is at least m
+         */
+        events.clear();
+        for (n = first; n < head; n++) {
+            const TraceSlot& slot = buffer.events[n % size];
+            const TraceEvent event = {
+                slot.name.load(std::memory_order_acquire),
+                slot.start_ns.load(std::memory_order_acquire),
+                slot.dur_ns.load(std::memory_order_acquire)
+            };
+            events.push_back(event);
+        }
+
+        const uint64_t head_after = buffer.head.load(std::memory_order_acquire);
+        const uint64_t overwritten = head_after >= size ? head_after - size + 1 : 0;
+        const size_t skip = overwritten > first ? std::min<uint64_t>(overwritten - first, events.size()) : 0;
+
+        const char* name = buffer.name.load();
+        if (name != nullptr) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    separator ? ",\n" : "", buffer.tid, name);
+            separator = true;
+        }
+
+        for (n = skip; n < events.size(); n++) {
+            const TraceEvent& event = events[n];
+            const double ts_us = (static_cast<int64_t>(event.start_ns - origin_ns)) / 1000.0;
+
+            if (event.dur_ns < 0)
+                fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                        separator ? ",\n" : "", event.name, ts_us, buffer.tid);
+            else
+                fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                        separator ? ",\n" : "", event.name, ts_us, event.dur_ns / 1000.0, buffer.tid);
+            separator = true;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0) {
+        error("Error: failed to write trace %s\n", filename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+#else
+
+bool LibSeek::trace_start(size_t)
+{
+    error("Error: built without tracing, configure with WITH_TRACING\n");
+    return false;
+}
+
+void LibSeek::trace_stop()
+{ }
+
+bool LibSeek::trace_export(const std::string&)
+{
+    return false;
+}
+
+void LibSeek::trace_clear()
+{ }
+
+void LibSeek::trace_thread_name(const char*)
+{ }
+
+#endif /* SEEK_TRACING */
@@ -0,0 +1,113 @@
+/*
+ *  Seek tracing
+ *  Scoped trace points recording how long the pipeline stages take, on
+ *  every thread, exported as Chrome trace JSON for chrome://tracing or
+ *  https://ui.perfetto.dev
+ *
+ *  Trace points only exist when built with WITH_TRACING (SEEK_TRACING),
+ *  otherwise the macros expand to nothing. Built in but not started, a
+ *  trace point costs a relaxed atomic load. Every thread records into its
+ *  own ring buffer without locks, the oldest events are overwritten. The
+ *  buffer is allocated on the first event of a thread. After the thread
+ *  exited it is reused by a new thread once its events were exported or
+ *  cleared. With 32 buffers allocated it is reused right away, dropping
+ *  its events.
+ *
+ *      trace_start();
+ *      ...
+ *      trace_export("seek.json");
+ */
+
+#ifndef SEEK_TRACE_H
+#define SEEK_TRACE_H
+
+#include <atomic>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include "SeekScopedTimer.h"
+
+namespace LibSeek {
+
+/*
+ *  Start recording, keeps the last events_per_thread events of every thread
+ *  Returns false when built without tracing
+ */
+bool trace_start(size_t events_per_thread=65536);
+
+/*
+ *  Stop recording, the events are kept for export
+ */
+void trace_stop();
+
+/*
+ *  Write the recorded events as Chrome trace JSON, can be called while
+ *  recording. Returns false on a write error or when built without tracing
+ */
+bool trace_export(const std::string& filename);
+
+/*
+ *  Drop all recorded events
+ */
+void trace_clear();
+
+/*
+ *  Name of the calling thread in the trace, name must stay valid (a literal).
+ *  Allocates nothing, also while not recording
+ */
+void trace_thread_name(const char* name);
+
+#ifdef SEEK_TRACING
+
+extern std::atomic<bool> trace_active;
+
+uint64_t trace_now_ns();
+
+/*
+ *  Record an event of the calling thread
+ *  name:   must stay valid (a literal)
+ *  dur_ns: duration of a scope, -1 for an instant event
+ */
+void trace_record(const char* name, uint64_t start_ns, int64_t dur_ns);
+
+struct TraceSink {
+    typedef const char* Key;
+
+    static bool active()
+    {
+        return trace_active.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t now_ns()
+    {
+        return trace_now_ns();
+    }
+
+    static void record(const char* name, uint64_t start_ns, uint64_t duration_ns)
+    {
+        trace_record(name, start_ns, static_cast<int64_t>(duration_ns));
+    }
+};
+
+typedef ScopedTimer<TraceSink> TraceScope;
+
+/* time the rest of the enclosing scope */
+#define SEEK_TRACE_SCOPE(name)      SEEK_SCOPED_TIMER(LibSeek::TraceScope, seek_trace_scope_, name)
+
+/* mark a point in time, e.g. a shutter event */
+#define SEEK_TRACE_INSTANT(name) \
+    do { \
+        if (LibSeek::trace_active.load(std::memory_order_relaxed)) \
+            LibSeek::trace_record(name, LibSeek::trace_now_ns(), -1); \
+    } while (0)
+
+#else
+
+#define SEEK_TRACE_SCOPE(name)      do { } while (0)
+#define SEEK_TRACE_INSTANT(name)    do { } while (0)
+
+#endif /* SEEK_TRACING */
+
+} /* LibSeek */
+
+#endif /* SEEK_TRACE_H */
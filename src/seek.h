@@ -3,5 +3,8 @@
 
 #include "SeekThermalPro.h"
 #include "SeekThermal.h"
+#include "SeekCamFactory.h"
+#include "SeekRadiometry.h"
+#include "SeekRoiStatistics.h"
 
 #endif /* SEEK_H */
@@ -0,0 +1,386 @@
+/*
+ *  Seek C API
+ */
+
+#include "seek_c.h"
+#include "SeekCamModel.h"
+#include "SeekRecording.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+using namespace LibSeek;
+
+struct seek_camera {
+    std::unique_ptr<SeekRecordingReader> recording;     /* seek_open_recording(), outlive cam */
+    std::unique_ptr<SeekRecordingPlayer> player;
+    std::unique_ptr<SeekCamCore> cam;
+    int model;
+    std::thread stream_thread;
+    std::mutex stream_mutex;            /* stream_thread assignment against the stream thread detaching itself */
+    std::atomic<bool> streaming;
+    std::atomic<bool> stop_requested;
+    bool close_deferred;                /* seek_close() from the callback, stream thread only */
+
+    seek_camera() :
+        model(SEEK_MODEL_AUTO),
+        streaming(false),
+        stop_requested(false),
+        close_deferred(false)
+    { }
+};
+
+/* the camera whose stream thread this is, to detect calls from the callback */
+static thread_local seek_camera_t* stream_camera = nullptr;
+
+/* the found device is opened by the camera, the bus is enumerated once */
+static int detect_model(std::shared_ptr<UsbDevice>& device)
+{
+    const std::vector<int> product_ids = {
+        static_cast<int>(SeekThermalTraits::product_id),
+        static_cast<int>(SeekThermalProTraits::product_id)
+    };
+
+    device = SeekDevice::find(SeekThermalTraits::vendor_id, product_ids);
+    if (device && device->product_id() == SeekThermalTraits::product_id)
+        return SEEK_MODEL_THERMAL;
+    if (device && device->product_id() == SeekThermalProTraits::product_id)
+        return SEEK_MODEL_THERMAL_PRO;
+
+    return SEEK_MODEL_AUTO;
+}
+
+static bool valid_level(int level)
+{
+    return level >= SEEK_LEVEL_RAW && level <= SEEK_LEVEL_FULLY_CORRECTED;
+}
+
+static void to_c_meta(const FrameMeta& meta, seek_frame_meta_t& c_meta)
+{
+    c_meta.struct_size = sizeof(seek_frame_meta_t);
+    c_meta.frame_id = meta.frame_id;
+    c_meta.frame_counter = meta.frame_counter;
+    c_meta.frames_skipped = meta.frames_skipped;
+    c_meta.timestamp_ns = meta.timestamp_ns;
+    c_meta.sequence = meta.sequence;
+    c_meta.shutter = meta.shutter;
+    c_meta.reserved = 0;
+}
+
+/* copy the fields the caller's (possibly older, smaller) struct has room for */
+static void copy_meta(const seek_frame_meta_t& src, seek_frame_meta_t* dst)
+{
+    const uint32_t struct_size = dst->struct_size;
+    const size_t n = std::min<size_t>(struct_size, sizeof(seek_frame_meta_t));
+
+    std::memcpy(dst, &src, n);
+    dst->struct_size = struct_size;
+}
+
+static int retrieve(seek_camera_t* camera, uint16_t* buffer, size_t stride, int level, FrameMeta* meta)
+{
+    if (stride < camera->cam->width() * sizeof(uint16_t))
+        return SEEK_ERROR_BUFFER_TOO_SMALL;
+
+    if (!camera->cam->retrieveInto(buffer, stride, static_cast<ProcessingLevel::Enum>(level), meta))
+        return SEEK_ERROR_NO_FRAME;
+
+    return SEEK_OK;
+}
+
+/* a recording that ran out of frames ends, anything else failed */
+static int grab(seek_camera_t* camera)
+{
+    if (camera->cam->grab())
+        return SEEK_OK;
+    if (camera->player && camera->player->position() >= camera->recording->frames())
+        return SEEK_ERROR_END_OF_STREAM;
+
+    return SEEK_ERROR_GRAB_FAILED;
+}
+
+static void stream_loop(seek_camera_t* camera, uint16_t* buffer, size_t stride, int level,
+                        seek_frame_callback_t callback, void* user_data)
+{
+    FrameMeta meta;
+    seek_frame_meta_t c_meta;
+
+    stream_camera = camera;
+
+    while (!camera->stop_requested.load()) {
+        int status = grab(camera);
+        if (status == SEEK_OK)
+            status = retrieve(camera, buffer, stride, level, &meta);
+
+        if (status != SEEK_OK) {
+            callback(user_data, status, nullptr, nullptr);
+            break;
+        }
+
+        to_c_meta(meta, c_meta);
+        if (callback(user_data, SEEK_OK, buffer, &c_meta) != 0)
+            break;
+    }
+
+    camera->streaming.store(false);
+    stream_camera = nullptr;
+
+    /* seek_close() from the callback, nobody is left to join this thread */
+    if (camera->close_deferred) {
+        {
+            std::lock_guard<std::mutex> lock(camera->stream_mutex);
+            camera->stream_thread.detach();
+        }
+        delete camera;
+    }
+}
+
+uint32_t seek_api_version(void)
+{
+    return SEEK_API_VERSION;
+}
+
+const char* seek_strerror(int status)
+{
+    switch (status) {
+    case SEEK_OK:                       return "success";
+    case SEEK_ERROR_INVALID_ARGUMENT:   return "invalid argument";
+    case SEEK_ERROR_NOT_FOUND:          return "no supported camera found";
+    case SEEK_ERROR_OPEN_FAILED:        return "failed to open camera";
+    case SEEK_ERROR_GRAB_FAILED:        return "frame acquisition failed";
+    case SEEK_ERROR_NO_FRAME:           return "no frame available";
+    case SEEK_ERROR_BUFFER_TOO_SMALL:   return "buffer too small";
+    case SEEK_ERROR_BUSY:               return "camera is streaming";
+    case SEEK_ERROR_NO_MEMORY:          return "out of memory";
+    case SEEK_ERROR_END_OF_STREAM:      return "end of recording";
+    default:                            return "unknown error";
+    }
+}
+
+/* create and open the camera of a model, from a usb device or a raw frame source */
+static int open_camera(seek_camera_t* c, int model, std::shared_ptr<UsbDevice> device, RawFrameSource* source)
+{
+    switch (model) {
+    case SEEK_MODEL_THERMAL:
+        c->cam.reset(new (std::nothrow) SeekThermalCore());
+        break;
+    case SEEK_MODEL_THERMAL_PRO:
+        c->cam.reset(new (std::nothrow) SeekThermalProCore());
+        break;
+    default:
+        return SEEK_ERROR_INVALID_ARGUMENT;
+    }
+    if (!c->cam)
+        return SEEK_ERROR_NO_MEMORY;
+    c->model = model;
+    if (device)
+        c->cam->setUsbDevice(device);
+    c->cam->setRawFrameSource(source);
+
+    try {
+        if (!c->cam->open())
+            return SEEK_ERROR_OPEN_FAILED;
+    } catch (const std::bad_alloc&) {
+        return SEEK_ERROR_NO_MEMORY;
+    }
+
+    return SEEK_OK;
+}
+
+int seek_open(seek_camera_t** camera, int model)
+{
+    int status;
+    std::shared_ptr<UsbDevice> device;
+
+    if (camera == nullptr)
+        return SEEK_ERROR_INVALID_ARGUMENT;
+    *camera = nullptr;
+
+    if (model == SEEK_MODEL_AUTO) {
+        model = detect_model(device);
+        if (model == SEEK_MODEL_AUTO)
+            return SEEK_ERROR_NOT_FOUND;
+    }
+
+    std::unique_ptr<seek_camera_t> c(new (std::nothrow) seek_camera_t());
+    if (!c)
+        return SEEK_ERROR_NO_MEMORY;
+
+    status = open_camera(c.get(), model, device, nullptr);
+    if (status != SEEK_OK)
+        return status;
+
+    *camera = c.release();
+    return SEEK_OK;
+}
+
+int seek_open_recording(seek_camera_t** camera, const char* filename, int realtime)
+{
+    int status, model;
+
+    if (camera == nullptr || filename == nullptr)
+        return SEEK_ERROR_INVALID_ARGUMENT;
+    *camera = nullptr;
+
+    std::unique_ptr<seek_camera_t> c(new (std::nothrow) seek_camera_t());
+    if (!c)
+        return SEEK_ERROR_NO_MEMORY;
+
+    try {
+        c->recording.reset(new SeekRecordingReader());
+        if (!c->recording->open(filename))
+            return SEEK_ERROR_NOT_FOUND;
+        c->player.reset(new SeekRecordingPlayer(*c->recording));
+    } catch (const std::bad_alloc&) {
+        return SEEK_ERROR_NO_MEMORY;
+    }
+    c->player->setRealtime(realtime != 0);
+
+    /* the player decodes raw_width x raw_height words into the camera buffer */
+    if (c->recording->product_id() == SeekThermalTraits::product_id &&
+            c->recording->raw_width() == SeekThermalTraits::raw_width &&
+            c->recording->raw_height() == SeekThermalTraits::raw_height)
+        model = SEEK_MODEL_THERMAL;
+    else if (c->recording->product_id() == SeekThermalProTraits::product_id &&
+             c->recording->raw_width() == SeekThermalProTraits::raw_width &&
+             c->recording->raw_height() == SeekThermalProTraits::raw_height)
+        model = SEEK_MODEL_THERMAL_PRO;
+    else
+        return SEEK_ERROR_NOT_FOUND;
+
+    status = open_camera(c.get(), model, nullptr, c->player.get());
+    if (status != SEEK_OK)
+        return status;
+
+    *camera = c.release();
+    return SEEK_OK;
+}
+
+void seek_close(seek_camera_t* camera)
+{
+    if (camera == nullptr)
+        return;
+
+    /* the stream thread can't join itself, it frees the camera when the callback returns */
+    if (stream_camera == camera) {
+        camera->close_deferred = true;
+        camera->stop_requested.store(true);
+        return;
+    }
+
+    seek_stream_stop(camera);
+    delete camera;
+}
+
+int seek_get_model(const seek_camera_t* camera)
+{
+    return camera ? camera->model : SEEK_ERROR_INVALID_ARGUMENT;
+}
+
+int seek_get_width(const seek_camera_t* camera)
+{
+    return camera ? camera->cam->width() : SEEK_ERROR_INVALID_ARGUMENT;
+}
+
+int seek_get_height(const seek_camera_t* camera)
+{
+    return camera ? camera->cam->height() : SEEK_ERROR_INVALID_ARGUMENT;
+}
+
+int seek_set_additional_flat_field(seek_camera_t* camera, const uint16_t* ffc, size_t stride)
+{
+    if (camera == nullptr)
+        return SEEK_ERROR_INVALID_ARGUMENT;
+    if (ffc != nullptr && stride < camera->cam->width() * sizeof(uint16_t))
+        return SEEK_ERROR_BUFFER_TOO_SMALL;
+    if (camera->streaming.load())
+        return SEEK_ERROR_BUSY;
+
+    try {
+        camera->cam->setAdditionalFlatField(ffc, stride);
+    } catch (const std::bad_alloc&) {
+        return SEEK_ERROR_NO_MEMORY;
+    }
+
+    return SEEK_OK;
+}
+
+int seek_grab(seek_camera_t* camera)
+{
+    if (camera == nullptr)
+        return SEEK_ERROR_INVALID_ARGUMENT;
+    if (camera->streaming.load())
+        return SEEK_ERROR_BUSY;
+
+    return grab(camera);
+}
+
+int seek_retrieve_into(seek_camera_t* camera, uint16_t* buffer, size_t stride,
+                       int level, seek_frame_meta_t* meta)
+{
+    int status;
+    FrameMeta frame_meta;
+    seek_frame_meta_t c_meta;
+
+    if (camera == nullptr || buffer == nullptr || !valid_level(level) ||
+            (meta != nullptr && meta->struct_size < sizeof(uint32_t)))
+        return SEEK_ERROR_INVALID_ARGUMENT;
+    if (camera->streaming.load())
+        return SEEK_ERROR_BUSY;
+
+    status = retrieve(camera, buffer, stride, level, &frame_meta);
+    if (status == SEEK_OK && meta != nullptr) {
+        to_c_meta(frame_meta, c_meta);
+        copy_meta(c_meta, meta);
+    }
+
+    return status;
+}
+
+int seek_stream_start(seek_camera_t* camera, uint16_t* buffer, size_t stride, int level,
+                      seek_frame_callback_t callback, void* user_data)
+{
+    if (camera == nullptr || buffer == nullptr || callback == nullptr || !valid_level(level))
+        return SEEK_ERROR_INVALID_ARGUMENT;
+    if (stride < camera->cam->width() * sizeof(uint16_t))
+        return SEEK_ERROR_BUFFER_TOO_SMALL;
+    if (camera->streaming.load())
+        return SEEK_ERROR_BUSY;
+
+    /* reap a stream that ended by itself */
+    if (camera->stream_thread.joinable())
+        camera->stream_thread.join();
+
+    camera->stop_requested.store(false);
+    camera->streaming.store(true);
+    try {
+        std::lock_guard<std::mutex> lock(camera->stream_mutex);
+        camera->stream_thread = std::thread(stream_loop, camera, buffer, stride, level, callback, user_data);
+    } catch (const std::exception&) {
+        camera->streaming.store(false);
+        return SEEK_ERROR_NO_MEMORY;
+    }
+
+    return SEEK_OK;
+}
+
+int seek_stream_stop(seek_camera_t* camera)
+{
+    if (camera == nullptr)
+        return SEEK_ERROR_INVALID_ARGUMENT;
+
+    if (stream_camera == camera)
+        return SEEK_ERROR_BUSY;
+
+    if (!camera->stream_thread.joinable())
+        return SEEK_OK;
+
+    camera->stop_requested.store(true);
+    camera->stream_thread.join();
+
+    return SEEK_OK;
+}
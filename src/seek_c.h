@@ -0,0 +1,162 @@
+/*
+ *  Seek C API
+ *  Stable C ABI on top of the OpenCV free core. Frames are always written
+ *  into memory owned by the caller, so they can land directly in the
+ *  arrays of another language.
+ *
+ *  ABI rules: functions are only ever added, existing signatures and
+ *  constant values never change, and structs passed in by the caller
+ *  start with their size so they can grow at the end.
+ */
+
+#ifndef SEEK_C_H
+#define SEEK_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* the seek_c library exports the seek_* functions only */
+#if defined(_WIN32) && defined(seek_c_EXPORTS)
+#define SEEK_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define SEEK_API __attribute__((visibility("default")))
+#else
+#define SEEK_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SEEK_API_VERSION 2
+
+/* status codes, 0 on success, negative on failure */
+#define SEEK_OK                         0
+#define SEEK_ERROR_INVALID_ARGUMENT     -1
+#define SEEK_ERROR_NOT_FOUND            -2      /* no supported camera attached */
+#define SEEK_ERROR_OPEN_FAILED          -3
+#define SEEK_ERROR_GRAB_FAILED          -4
+#define SEEK_ERROR_NO_FRAME             -5      /* nothing grabbed yet, or no flat field calibration frame */
+#define SEEK_ERROR_BUFFER_TOO_SMALL     -6
+#define SEEK_ERROR_BUSY                 -7      /* not allowed while streaming */
+#define SEEK_ERROR_NO_MEMORY            -8
+#define SEEK_ERROR_END_OF_STREAM        -9      /* a recording has no more frames */
+
+/* camera models */
+#define SEEK_MODEL_AUTO                 0       /* detect the attached model */
+#define SEEK_MODEL_THERMAL              1       /* Compact / CompactXR */
+#define SEEK_MODEL_THERMAL_PRO          2       /* Compact PRO */
+
+/* processing levels, see LibSeek::ProcessingLevel */
+#define SEEK_LEVEL_RAW                  0
+#define SEEK_LEVEL_OFFSET_CORRECTED     1
+#define SEEK_LEVEL_FULLY_CORRECTED      2
+
+typedef struct seek_camera seek_camera_t;
+
+/*
+ *  Frame metadata, see LibSeek::FrameMeta.
+ *  Set struct_size to sizeof(seek_frame_meta_t) before passing it in.
+ */
+typedef struct seek_frame_meta {
+    uint32_t struct_size;
+    int32_t frame_id;
+    int32_t frame_counter;
+    int32_t frames_skipped;
+    uint64_t timestamp_ns;
+    uint64_t sequence;
+    int32_t shutter;
+    int32_t reserved;
+} seek_frame_meta_t;
+
+/*
+ *  Stream callback, called from the stream thread for every frame.
+ *  status:     SEEK_OK, or the error that ends the stream (frame and meta are NULL then)
+ *  frame:      the buffer passed to seek_stream_start(), valid until the callback returns
+ *  Return non zero to stop streaming.
+ */
+typedef int (*seek_frame_callback_t)(void* user_data, int status,
+                                     const uint16_t* frame, const seek_frame_meta_t* meta);
+
+/*
+ *  SEEK_API_VERSION the library was built with
+ */
+SEEK_API uint32_t seek_api_version(void);
+
+/*
+ *  Human readable description of a status code
+ */
+SEEK_API const char* seek_strerror(int status);
+
+/*
+ *  Create and initialize a camera of the given model
+ *  Returns SEEK_OK and the camera in *camera on success
+ */
+SEEK_API int seek_open(seek_camera_t** camera, int model);
+
+/*
+ *  Open a raw recording (see SeekRecording.h, e.g. made with seek_record)
+ *  instead of a camera, its frames run through the same processing as
+ *  live frames. Grabbing fails with SEEK_ERROR_END_OF_STREAM at its end
+ *  (SEEK_ERROR_GRAB_FAILED before API version 2).
+ *  realtime:   non zero to deliver the frames at the pace they were recorded
+ *  Returns SEEK_ERROR_NOT_FOUND when the file isn't a readable recording
+ */
+SEEK_API int seek_open_recording(seek_camera_t** camera, const char* filename, int realtime);
+
+/*
+ *  Stop streaming, close and free the camera. NULL is ignored.
+ *  From the stream callback the stream ends and the camera is freed
+ *  once the callback returns, don't use it after the call either way
+ */
+SEEK_API void seek_close(seek_camera_t* camera);
+
+/*
+ *  Model and frame size of an opened camera
+ */
+SEEK_API int seek_get_model(const seek_camera_t* camera);
+SEEK_API int seek_get_width(const seek_camera_t* camera);
+SEEK_API int seek_get_height(const seek_camera_t* camera);
+
+/*
+ *  Additional flat field calibration subtracted from fully corrected frames
+ *  ffc:        width x height pixels, NULL removes it
+ *  stride:     distance between rows in bytes
+ */
+SEEK_API int seek_set_additional_flat_field(seek_camera_t* camera, const uint16_t* ffc, size_t stride);
+
+/*
+ *  Grab a frame
+ */
+SEEK_API int seek_grab(seek_camera_t* camera);
+
+/*
+ *  Write the last grabbed frame into buffer
+ *  buffer:     width x height pixels, owned by the caller
+ *  stride:     distance between rows in bytes
+ *  level:      SEEK_LEVEL_*
+ *  meta:       optional, receives the frame metadata
+ */
+SEEK_API int seek_retrieve_into(seek_camera_t* camera, uint16_t* buffer, size_t stride,
+                                int level, seek_frame_meta_t* meta);
+
+/*
+ *  Grab frames on a background thread and deliver each one to callback
+ *  after writing it into buffer. buffer must stay valid until the stream
+ *  is stopped. seek_grab and seek_retrieve_into return SEEK_ERROR_BUSY
+ *  while streaming.
+ */
+SEEK_API int seek_stream_start(seek_camera_t* camera, uint16_t* buffer, size_t stride, int level,
+                               seek_frame_callback_t callback, void* user_data);
+
+/*
+ *  Stop streaming and wait for the stream thread to finish. Returns
+ *  SEEK_ERROR_BUSY when called from the callback, return non zero there instead
+ */
+SEEK_API int seek_stream_stop(seek_camera_t* camera);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SEEK_C_H */
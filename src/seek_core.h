@@ -0,0 +1,7 @@
+#ifndef SEEK_CORE_H
+#define SEEK_CORE_H
+
+#include "SeekCamModel.h"
+#include "SeekProcessing.h"
+
+#endif /* SEEK_CORE_H */
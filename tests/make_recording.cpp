@@ -0,0 +1,52 @@
+/*
+ *  Writes the synthetic frames of the tests as a raw recording, for the
+ *  tests that can only get frames into a camera through a file
+ *
+ *  make_recording <file> [pro] [frames]
+ */
+#include "SeekCamModel.h"
+#include "SeekRecording.h"
+#include <cstdlib>
+#include <string>
+#include "bench.h"
+
+using namespace LibSeek;
+
+template<class Traits>
+static bool write(const char* filename, int count)
+{
+    int n;
+    SeekRecordingWriter recording;
+    const bench::FrameList frames = bench::synthetic_frames<Traits>(count);
+
+    if (!recording.open(filename, Traits::product_id, Traits::raw_width, Traits::raw_height))
+        return false;
+
+    for (n = 0; n < count; n++) {
+        FrameMeta meta = FrameMeta();
+        meta.frame_id = frames[n][Traits::frame_id_word];
+        meta.frame_counter = frames[n][Traits::frame_counter_word];
+        meta.timestamp_ns = n * 111000000ULL;
+        meta.sequence = n;
+        recording.write(frames[n].data(), meta);
+    }
+    recording.close();
+
+    return recording.good();
+}
+
+int main(int argc, char** argv)
+{
+    const bool pro = argc > 2 && std::string(argv[2]) == "pro";
+    const int count = argc > 3 ? std::atoi(argv[3]) : 64;
+
+    if (argc < 2 || count < 2) {
+        fprintf(stderr, "usage: make_recording <file> [pro] [frames]\n");
+        return 2;
+    }
+
+    if (!(pro ? write<SeekThermalProTraits>(argv[1], count) : write<SeekThermalTraits>(argv[1], count)))
+        return 1;
+
+    return 0;
+}
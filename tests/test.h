@@ -0,0 +1,41 @@
+/*
+ *  Checks for the test programs
+ *
+ *  A failed CHECK prints the expression and its location and the test
+ *  goes on, main() returns test::result(), 1 when any check failed.
+ *  Include in exactly one translation unit of a test.
+ */
+
+#ifndef SEEK_TEST_H
+#define SEEK_TEST_H
+
+#include <cstdio>
+
+namespace test {
+
+static int failures = 0;
+
+inline bool check(bool ok, const char* expression, const char* file, int line)
+{
+    if (!ok) {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+        failures++;
+    }
+
+    return ok;
+}
+
+inline int result()
+{
+    if (failures > 0)
+        fprintf(stderr, "%d checks failed\n", failures);
+
+    return failures > 0 ? 1 : 0;
+}
+
+} /* test */
+
+/* evaluates to the outcome, so a test can stop when going on makes no sense */
+#define CHECK(expression) test::check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
+
+#endif /* SEEK_TEST_H */
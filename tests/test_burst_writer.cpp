@@ -0,0 +1,176 @@
+/*
+ *  Burst writer test
+ *  With the writers held up, frames beyond the buffers are dropped right
+ *  away instead of waiting. finish() writes everything that was queued,
+ *  each frame with its own pixels and index, counts failed writes and
+ *  gives the buffers back for reuse, so does release() without writing.
+ *  The destructor finishes too.
+ */
+#include "burst_writer.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "test.h"
+
+static const int width = 16;
+static const int height = 4;
+
+/* records the frames written, only once opened */
+class Disk
+{
+public:
+    Disk(bool open) :
+        m_open(open),
+        m_corrupt(0)
+    { }
+
+    bool write(const uint16_t* frame, int index)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_open)
+            m_wake.wait(lock);
+
+        for (int i = 0; i < width * height; i++)
+            m_corrupt += frame[i] != static_cast<uint16_t>(index * 100 + i);
+        m_indices.insert(index);
+
+        /* a full disk for every third frame */
+        return index % 3 != 2;
+    }
+
+    void open()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_open = true;
+        }
+        m_wake.notify_all();
+    }
+
+    std::set<int> indices()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_indices;
+    }
+
+    int corrupt()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_corrupt;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_open;
+    int m_corrupt;
+    std::set<int> m_indices;
+};
+
+static void fill(uint16_t* frame, int index)
+{
+    for (int i = 0; i < width * height; i++)
+        frame[i] = static_cast<uint16_t>(index * 100 + i);
+}
+
+int main()
+{
+    int i;
+
+    {
+        Disk disk(false);
+        BurstWriter writer(width, height, 4, 2, [&](const uint16_t* frame, int index) {
+            return disk.write(frame, index);
+        });
+
+        /* the writers are stuck, the 5th frame finds no buffer and doesn't wait */
+        for (i = 0; i < 4; i++) {
+            uint16_t* frame = writer.acquire();
+            if (!CHECK(frame != nullptr))
+                return test::result();
+            fill(frame, i);
+            writer.submit(frame, i);
+        }
+        const auto start = std::chrono::steady_clock::now();
+        CHECK(writer.acquire() == nullptr);
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100));
+        CHECK(writer.written() == 0 && writer.failed() == 0);
+
+        /* everything queued when finish() is called is written, frame 2 fails */
+        std::thread opener([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            disk.open();
+        });
+        writer.finish();
+        opener.join();
+        CHECK(writer.written() == 3);
+        CHECK(writer.failed() == 1);
+        CHECK(disk.indices() == std::set<int>({ 0, 1, 2, 3 }));
+        CHECK(disk.corrupt() == 0);
+
+        /* all buffers are free again, distinct */
+        std::set<uint16_t*> buffers;
+        uint16_t* frame;
+        while ((frame = writer.acquire()) != nullptr)
+            buffers.insert(frame);
+        CHECK(buffers.size() == 4);
+
+        /* a buffer given back unwritten is free again, nothing gets written */
+        writer.release(*buffers.begin());
+        CHECK(writer.acquire() == *buffers.begin());
+        CHECK(writer.acquire() == nullptr);
+        CHECK(writer.written() == 3 && writer.failed() == 1);
+    }
+
+    /* keeping up: as many frames as the writers take, every frame is either written, failed or dropped */
+    {
+        Disk disk(true);
+        int dropped = 0;
+        BurstWriter writer(width, height, 2, 2, [&](const uint16_t* frame, int index) {
+            return disk.write(frame, index);
+        });
+
+        for (i = 0; i < 300; i++) {
+            uint16_t* frame = writer.acquire();
+            if (frame == nullptr) {
+                dropped++;
+                continue;
+            }
+            fill(frame, i);
+            writer.submit(frame, i);
+        }
+        writer.finish();
+
+        CHECK(writer.written() + writer.failed() + dropped == 300);
+        CHECK(static_cast<int>(disk.indices().size()) == 300 - dropped);
+        CHECK(disk.corrupt() == 0);
+    }
+
+    /* the destructor writes what is still queued */
+    {
+        Disk disk(false);
+        std::thread opener;
+        {
+            BurstWriter writer(width, height, 3, 1, [&](const uint16_t* frame, int index) {
+                return disk.write(frame, index);
+            });
+            for (i = 0; i < 3; i++) {
+                uint16_t* frame = writer.acquire();
+                fill(frame, i);
+                writer.submit(frame, i);
+            }
+            opener = std::thread([&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                disk.open();
+            });
+        }
+        opener.join();
+        CHECK(disk.indices().size() == 3);
+        CHECK(disk.corrupt() == 0);
+    }
+
+    return test::result();
+}
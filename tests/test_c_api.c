@@ -0,0 +1,85 @@
+/*
+ *  C API test
+ *  Compiled as C against seek_c.h and linked to the seek_c library only,
+ *  so the header has to be plain C and every function it declares has to
+ *  be exported. Needs no camera: checks the argument validation, the
+ *  status code descriptions and the frozen layout of seek_frame_meta_t.
+ */
+#include "seek_c.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+static int check(int ok, const char* expression, int line)
+{
+    if (!ok) {
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, line, expression);
+        failures++;
+    }
+
+    return ok;
+}
+
+#define CHECK(expression) check((expression) != 0, #expression, __LINE__)
+
+static int callback(void* user_data, int status, const uint16_t* frame, const seek_frame_meta_t* meta)
+{
+    (void)user_data;
+    (void)status;
+    (void)frame;
+    (void)meta;
+    return 1;
+}
+
+int main(void)
+{
+    int i;
+    seek_camera_t* cam = (seek_camera_t*)&failures;
+    uint16_t frame[4];
+    seek_frame_meta_t meta;
+    const int errors[] = {
+        SEEK_ERROR_INVALID_ARGUMENT, SEEK_ERROR_NOT_FOUND, SEEK_ERROR_OPEN_FAILED, SEEK_ERROR_GRAB_FAILED,
+        SEEK_ERROR_NO_FRAME, SEEK_ERROR_BUFFER_TOO_SMALL, SEEK_ERROR_BUSY, SEEK_ERROR_NO_MEMORY,
+        SEEK_ERROR_END_OF_STREAM
+    };
+
+    CHECK(seek_api_version() == SEEK_API_VERSION);
+
+    CHECK(strcmp(seek_strerror(SEEK_OK), "success") == 0);
+    CHECK(strcmp(seek_strerror(-1000), "unknown error") == 0);
+    for (i = 0; i < (int)(sizeof(errors) / sizeof(errors[0])); i++)
+        CHECK(errors[i] < 0 && strcmp(seek_strerror(errors[i]), "unknown error") != 0);
+
+    /* an unknown model fails before any usb access and leaves no camera behind */
+    CHECK(seek_open(NULL, SEEK_MODEL_AUTO) == SEEK_ERROR_INVALID_ARGUMENT);
+    CHECK(seek_open(&cam, 42) == SEEK_ERROR_INVALID_ARGUMENT);
+    CHECK(cam == NULL);
+
+    seek_close(NULL);
+    CHECK(seek_get_model(NULL) == SEEK_ERROR_INVALID_ARGUMENT);
+    CHECK(seek_get_width(NULL) == SEEK_ERROR_INVALID_ARGUMENT);
+    CHECK(seek_get_height(NULL) == SEEK_ERROR_INVALID_ARGUMENT);
+    CHECK(seek_set_additional_flat_field(NULL, NULL, 0) == SEEK_ERROR_INVALID_ARGUMENT);
+    CHECK(seek_grab(NULL) == SEEK_ERROR_INVALID_ARGUMENT);
+    meta.struct_size = sizeof(meta);
+    CHECK(seek_retrieve_into(NULL, frame, sizeof(frame), SEEK_LEVEL_RAW, &meta) == SEEK_ERROR_INVALID_ARGUMENT);
+    CHECK(seek_stream_start(NULL, frame, sizeof(frame), SEEK_LEVEL_RAW, callback, NULL) == SEEK_ERROR_INVALID_ARGUMENT);
+    CHECK(seek_stream_stop(NULL) == SEEK_ERROR_INVALID_ARGUMENT);
+
+    /* the struct only ever grows at the end */
+    CHECK(offsetof(seek_frame_meta_t, struct_size) == 0);
+    CHECK(offsetof(seek_frame_meta_t, frame_id) == 4);
+    CHECK(offsetof(seek_frame_meta_t, frame_counter) == 8);
+    CHECK(offsetof(seek_frame_meta_t, frames_skipped) == 12);
+    CHECK(offsetof(seek_frame_meta_t, timestamp_ns) == 16);
+    CHECK(offsetof(seek_frame_meta_t, sequence) == 24);
+    CHECK(offsetof(seek_frame_meta_t, shutter) == 32);
+    CHECK(sizeof(seek_frame_meta_t) == 40);
+
+    if (failures > 0)
+        fprintf(stderr, "%d checks failed\n", failures);
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+/*
+ *  Fixed point test
+ *  The integer kernels of WITH_FIXED_POINT against the floating point
+ *  paths they replace: grey_scale_fixed against grey_scale_reference,
+ *  normalize_fixed and convert_to_8bit against the cv::normalize
+ *  NORM_MINMAX and convertTo(CV_8U, 1/256) arithmetic seek_viewer uses
+ *  otherwise, on frames of different value ranges.
+ */
+#include "SeekProcessing.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "bench.h"
+#include "test.h"
+
+using namespace LibSeek;
+
+static const int width = 207;
+static const int height = 154;
+
+/* value range [base, base + range], a smooth gradient, noise and a hot spot */
+static std::vector<uint16_t> test_frame(int seed, int base, int range)
+{
+    int x, y;
+    std::vector<uint16_t> frame(width * height);
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            const uint32_t h = bench::hash(seed * width * height + y * width + x);
+            const int dx = x - width / 3, dy = y - height / 2;
+            int value = (x * 3 + y * 5 + h % (range / 4 + 1)) % (range + 1);
+            if (dx * dx + dy * dy < 300)
+                value += range / 4;
+            frame[y * width + x] = base + std::min(value, range);
+        }
+    }
+
+    return frame;
+}
+
+static int max_difference(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+{
+    int diff = 0;
+
+    for (size_t i = 0; i < a.size(); i++)
+        diff = std::max(diff, std::abs(a[i] - b[i]));
+
+    return diff;
+}
+
+static void compare_grey_scale(const std::vector<uint16_t>& frame, int stride_padding)
+{
+    const int stride = width + stride_padding;
+    std::vector<uint16_t> src(stride * height);
+    std::vector<uint8_t> fixed(width * height), reference(width * height);
+
+    for (int y = 0; y < height; y++)
+        std::copy(frame.begin() + y * width, frame.begin() + (y + 1) * width, src.begin() + y * stride);
+
+    grey_scale_reference(src.data(), stride, reference.data(), width, width, height);
+    grey_scale_fixed(src.data(), stride, fixed.data(), width, width, height);
+    CHECK(max_difference(fixed, reference) <= 1);
+}
+
+static void compare_normalize(const std::vector<uint16_t>& frame)
+{
+    size_t i;
+    uint16_t min, max;
+    std::vector<uint16_t> fixed(frame);
+    std::vector<uint8_t> fixed_8bit(frame.size()), float_8bit(frame.size());
+    int diff = 0;
+
+    min_max(frame.data(), width, width, height, &min, &max);
+    CHECK(min == *std::min_element(frame.begin(), frame.end()));
+    CHECK(max == *std::max_element(frame.begin(), frame.end()));
+
+    normalize_fixed(fixed.data(), width, width, height, min, max);
+    convert_to_8bit(fixed.data(), width, fixed_8bit.data(), width, width, height);
+
+    /* cv::normalize(NORM_MINMAX) scales in double and rounds, convertTo rounds to nearest */
+    const double scale = max > min ? 65535.0 / (max - min) : 0;
+    for (i = 0; i < frame.size(); i++) {
+        const double normalized = std::min(65535.0, (frame[i] - min) * scale);
+        diff = std::max(diff, std::abs(fixed[i] - static_cast<int>(std::lrint(normalized))));
+        float_8bit[i] = static_cast<uint8_t>(std::min(255L, std::lrint(std::lrint(normalized) / 256.0)));
+    }
+
+    CHECK(diff <= 1);
+    CHECK(max_difference(fixed_8bit, float_8bit) <= 1);
+    if (max > min) {
+        CHECK(*std::min_element(fixed.begin(), fixed.end()) == 0);
+        CHECK(*std::max_element(fixed.begin(), fixed.end()) == 0xffff);
+    }
+}
+
+int main()
+{
+    int seed;
+    const int ranges[] = { 1, 9, 10, 11, 100, 999, 4000, 0x3fff };
+
+    /* typical camera frames, narrow ranges with values on the band borders, the full 14 bits */
+    for (seed = 0; seed < 8; seed++) {
+        const std::vector<uint16_t> frame = test_frame(seed, seed == 7 ? 0 : 8000, ranges[seed]);
+        compare_grey_scale(frame, 0);
+        compare_grey_scale(frame, 13);
+        compare_normalize(frame);
+    }
+
+    /* a flat frame maps to black */
+    const std::vector<uint16_t> flat(width * height, 8123);
+    std::vector<uint8_t> fixed(width * height, 1), reference(width * height, 1);
+    grey_scale_reference(flat.data(), width, reference.data(), width, width, height);
+    grey_scale_fixed(flat.data(), width, fixed.data(), width, width, height);
+    CHECK(*std::max_element(reference.begin(), reference.end()) == 0);
+    CHECK(*std::max_element(fixed.begin(), fixed.end()) == 0);
+
+    /* grey_scale() follows the build option */
+    const std::vector<uint16_t> frame = test_frame(42, 8000, 2000);
+    std::vector<uint8_t> selected(width * height);
+    grey_scale(frame.data(), width, selected.data(), width, width, height);
+#ifdef SEEK_FIXED_POINT
+    grey_scale_fixed(frame.data(), width, fixed.data(), width, width, height);
+#else
+    grey_scale_reference(frame.data(), width, fixed.data(), width, width, height);
+#endif
+    CHECK(selected == fixed);
+
+    return test::result();
+}
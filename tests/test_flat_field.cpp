@@ -0,0 +1,137 @@
+/*
+ *  Flat field statistics test
+ *  The streaming mean and variance match a two pass computation on
+ *  synthetic frames, a hand in front of the lens is rejected once the
+ *  pixels have enough samples, and the variance floor keeps a pixel that
+ *  never changed from rejecting the next small change.
+ */
+#include "flat_field.h"
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "test.h"
+
+static const int width = 8;
+static const int height = 4;
+static const int stride = width + 3;            /* rows are padded */
+static const size_t step = stride * sizeof(uint16_t);
+static const int frame_count = 40;
+
+/* pixel i of frame k: a fixed pattern plus +-5 counts of noise, a hand covers the left half of frames 20 to 24 */
+static int value(int k, int i, bool hand)
+{
+    const int x = i % width;
+    const int noise = (k * 7 + i * 3) % 11 - 5;
+
+    return 1000 + i * 10 + noise + (hand && x < width / 2 && k >= 20 && k < 25 ? 2000 : 0);
+}
+
+static void add_frames(FlatFieldStatistics& statistics, bool hand)
+{
+    std::vector<uint16_t> frame(stride * height, 0xffff);
+
+    for (int k = 0; k < frame_count; k++) {
+        for (int i = 0; i < width * height; i++)
+            frame[(i / width) * stride + i % width] = value(k, i, hand);
+        statistics.add(frame.data(), step);
+    }
+}
+
+/* mean and sample variance of the samples a pixel should have accepted, in two passes */
+static void expected(int i, bool hand, double& mean, double& variance)
+{
+    int k, n = 0;
+    double sum = 0, sum2 = 0;
+
+    for (k = 0; k < frame_count; k++) {
+        if (hand && value(k, i, true) != value(k, i, false))
+            continue;
+        sum += value(k, i, false);
+        n++;
+    }
+    mean = sum / n;
+    for (k = 0; k < frame_count; k++) {
+        if (hand && value(k, i, true) != value(k, i, false))
+            continue;
+        sum2 += (value(k, i, false) - mean) * (value(k, i, false) - mean);
+    }
+    variance = sum2 / (n - 1);
+}
+
+/* every pixel within 1 count of the two pass result */
+static bool matches(const FlatFieldStatistics& statistics, bool hand)
+{
+    std::vector<uint16_t> mean(stride * height), variance(stride * height);
+    double expected_mean, expected_variance;
+
+    statistics.mean(mean.data(), step);
+    statistics.variance(variance.data(), step);
+
+    for (int i = 0; i < width * height; i++) {
+        const int pos = (i / width) * stride + i % width;
+        expected(i, hand, expected_mean, expected_variance);
+        if (std::abs(mean[pos] - expected_mean) > 1 || std::abs(variance[pos] - expected_variance) > 1) {
+            fprintf(stderr, "pixel %d: mean %d variance %d, expected %.2f %.2f\n", i, mean[pos], variance[pos],
+                    expected_mean, expected_variance);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    const int half = width / 2 * height;
+    std::vector<uint16_t> mean(stride * height);
+
+    /* everything kept */
+    FlatFieldStatistics all(width, height, 0);
+    add_frames(all, false);
+    CHECK(all.samples() == static_cast<uint64_t>(frame_count) * width * height);
+    CHECK(all.rejected() == 0);
+    CHECK(matches(all, false));
+
+    /* the hand frames are left out of the covered pixels only */
+    FlatFieldStatistics rejecting(width, height, 3);
+    add_frames(rejecting, true);
+    CHECK(rejecting.samples() == static_cast<uint64_t>(frame_count) * width * height);
+    CHECK(rejecting.rejected() == static_cast<uint64_t>(5 * half));
+    CHECK(matches(rejecting, true));
+
+    /* without rejection the hand ends up in the flat field */
+    FlatFieldStatistics keeping(width, height, 0);
+    add_frames(keeping, true);
+    CHECK(keeping.rejected() == 0);
+    keeping.mean(mean.data(), step);
+    CHECK(mean[0] >= 1000 + 5 * 2000 / frame_count - 5);
+
+    /* nothing is rejected before a pixel has 10 samples */
+    FlatFieldStatistics early(1, 1, 3);
+    std::vector<uint16_t> sample(1, 1000);
+    for (int k = 0; k < 5; k++)
+        early.add(sample.data(), sizeof(uint16_t));
+    sample[0] = 5000;
+    early.add(sample.data(), sizeof(uint16_t));
+    CHECK(early.rejected() == 0);
+    sample[0] = 1000;
+    for (int k = 0; k < 10; k++)
+        early.add(sample.data(), sizeof(uint16_t));
+    sample[0] = 5000;
+    early.add(sample.data(), sizeof(uint16_t));
+    CHECK(early.rejected() == 1);
+
+    /* a pixel without any noise still accepts a few counts, within 3 sigma of the floor of 4 counts^2 */
+    FlatFieldStatistics quiet(1, 1, 3);
+    sample[0] = 1000;
+    for (int k = 0; k < 20; k++)
+        quiet.add(sample.data(), sizeof(uint16_t));
+    sample[0] = 1005;
+    quiet.add(sample.data(), sizeof(uint16_t));
+    CHECK(quiet.rejected() == 0);
+    sample[0] = 1020;
+    quiet.add(sample.data(), sizeof(uint16_t));
+    CHECK(quiet.rejected() == 1);
+
+    return test::result();
+}
@@ -0,0 +1,98 @@
+/*
+ *  Frame queue test
+ *  A full queue makes the producer wait instead of replacing a value, and
+ *  with a slow consumer thread every value published arrives whole, once
+ *  and in order. Meant to run under ThreadSanitizer too.
+ */
+#include "frame_queue.h"
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "test.h"
+
+static const int pixels = 4096;
+static const int frame_count = 5000;
+
+/* every pixel of frame n holds n */
+static void fill(std::vector<int>& frame, int n)
+{
+    for (int i = 0; i < pixels; i++)
+        frame[i] = n;
+}
+
+static bool holds(const std::vector<int>& frame, int n)
+{
+    for (int i = 0; i < pixels; i++) {
+        if (frame[i] != n)
+            return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    int i;
+
+    /* one thread: values come out in order, a full queue takes no more */
+    {
+        FrameQueue<std::vector<int> > queue(3);
+        for (i = 0; i < queue.size(); i++)
+            queue.slot(i).resize(pixels);
+
+        CHECK(!queue.wait(std::chrono::milliseconds(0)));
+        for (i = 0; i < 3; i++) {
+            if (!CHECK(queue.reserve(std::chrono::milliseconds(0))))
+                return test::result();
+            fill(queue.back(), i);
+            queue.publish();
+        }
+        const auto start = std::chrono::steady_clock::now();
+        CHECK(!queue.reserve(std::chrono::milliseconds(20)));
+        CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+
+        CHECK(queue.wait(std::chrono::milliseconds(0)) && holds(queue.front(), 0));
+        queue.release();
+        CHECK(queue.reserve(std::chrono::milliseconds(0)));
+        fill(queue.back(), 3);
+        queue.publish();
+        for (i = 1; i <= 3; i++) {
+            CHECK(queue.wait(std::chrono::milliseconds(0)) && holds(queue.front(), i));
+            queue.release();
+        }
+        CHECK(!queue.wait(std::chrono::milliseconds(0)));
+    }
+
+    /* a producer thread ahead of a consumer that sometimes stalls */
+    {
+        FrameQueue<std::vector<int> > queue(4);
+        int received = 0, wrong = 0;
+
+        for (i = 0; i < queue.size(); i++)
+            queue.slot(i).resize(pixels);
+
+        std::thread producer([&]() {
+            for (int n = 0; n < frame_count; n++) {
+                while (!queue.reserve(std::chrono::milliseconds(100)))
+                    ;
+                fill(queue.back(), n);
+                queue.publish();
+            }
+        });
+
+        while (received < frame_count && queue.wait(std::chrono::milliseconds(2000))) {
+            wrong += !holds(queue.front(), received);
+            queue.release();
+            received++;
+            if (received % 500 == 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        producer.join();
+
+        CHECK(received == frame_count);
+        CHECK(wrong == 0);
+        CHECK(!queue.wait(std::chrono::milliseconds(0)));
+    }
+
+    return test::result();
+}
@@ -0,0 +1,140 @@
+/*
+ *  Frame ring test
+ *  A writer and a reader on one ring: frames and metadata arrive intact,
+ *  a reader that falls behind gets OVERRUN and continues with the newest
+ *  frame, a reader racing a writer thread never gets a torn frame, and a
+ *  ring replaced by a new writer is detected as stale.
+ */
+#include "SeekFrameRing.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "test.h"
+
+using namespace LibSeek;
+
+static const int width = 640;
+static const int height = 480;
+static const size_t step = width * sizeof(uint16_t);
+
+/* every pixel of frame n holds n + pixel index, the metadata is derived from n */
+static void publish(SeekFrameRingWriter& writer, int n)
+{
+    std::vector<uint16_t> frame(width * height);
+    FrameMeta meta = FrameMeta();
+
+    for (size_t i = 0; i < frame.size(); i++)
+        frame[i] = static_cast<uint16_t>(n + i);
+    meta.frame_id = FrameType::IMAGE;
+    meta.frame_counter = n;
+    meta.timestamp_ns = n * 1000ULL;
+    meta.sequence = n;
+    meta.shutter = n % 2 == 1;
+
+    writer.publish(frame.data(), step, meta);
+}
+
+/* the frame is n intact, with the metadata of frame n */
+static bool intact(const std::vector<uint16_t>& frame, const FrameMeta& meta, int n)
+{
+    for (size_t i = 0; i < frame.size(); i++) {
+        if (frame[i] != static_cast<uint16_t>(n + i))
+            return false;
+    }
+
+    return meta.frame_counter == n && meta.timestamp_ns == n * 1000ULL && meta.sequence == static_cast<uint64_t>(n) &&
+           meta.shutter == (n % 2 == 1) && meta.frame_id == FrameType::IMAGE;
+}
+
+int main()
+{
+    int n;
+    const std::string name = "/seek_test_ring_" + std::to_string(getpid());
+    SeekFrameRingWriter writer;
+    SeekFrameRingReader reader;
+    std::vector<uint16_t> frame(width * height);
+    FrameMeta meta;
+
+    if (!CHECK(writer.create(name, width, height, 4)) || !CHECK(reader.open(name)))
+        return test::result();
+    CHECK(reader.width() == width && reader.height() == height && reader.slot_count() == 4);
+    CHECK(reader.read_next(frame.data(), step, &meta) == RingStatus::NOT_READY);
+    CHECK(reader.read_next(frame.data(), step - 1, &meta) == RingStatus::ERROR);
+
+    /* a reader keeping up gets every frame */
+    for (n = 0; n < 3; n++) {
+        publish(writer, n);
+        CHECK(reader.read_next(frame.data(), step, &meta) == RingStatus::OK);
+        CHECK(intact(frame, meta, n));
+    }
+    CHECK(reader.dropped() == 0);
+
+    /* 10 frames behind on 4 slots: the reader skips to the newest frame */
+    for (n = 3; n < 13; n++)
+        publish(writer, n);
+    CHECK(reader.read(3, frame.data(), step) == RingStatus::OVERRUN);
+    CHECK(reader.read(13, frame.data(), step) == RingStatus::NOT_READY);
+    CHECK(reader.read(9, frame.data(), step, &meta) == RingStatus::OK && intact(frame, meta, 9));
+    CHECK(reader.read_next(frame.data(), step, &meta) == RingStatus::OVERRUN);
+    CHECK(reader.dropped() == 9);
+    CHECK(reader.read_next(frame.data(), step, &meta) == RingStatus::OK);
+    CHECK(intact(frame, meta, 12));
+    CHECK(reader.read_next(frame.data(), step, &meta) == RingStatus::NOT_READY);
+
+    /* against a writer thread every frame read is intact, whatever gets overrun */
+    std::atomic<bool> done(false);
+    std::thread thread([&]() {
+        for (int i = 13; i < 2013; i++) {
+            publish(writer, i);
+            if (i % 16 == 0)
+                std::this_thread::yield();
+        }
+        done.store(true);
+    });
+
+    int ok = 0, overruns = 0, torn = 0;
+    while (!done.load()) {
+        const RingStatus::Enum status = reader.read_next(frame.data(), step, &meta);
+        if (status == RingStatus::OK) {
+            ok++;
+            torn += !intact(frame, meta, meta.frame_counter);
+        } else if (status == RingStatus::OVERRUN) {
+            overruns++;
+        }
+    }
+    thread.join();
+    for (RingStatus::Enum status; (status = reader.read_next(frame.data(), step, &meta)) != RingStatus::NOT_READY; ) {
+        if (status == RingStatus::OK) {
+            ok++;
+            torn += !intact(frame, meta, meta.frame_counter);
+        }
+    }
+    CHECK(torn == 0);
+    CHECK(ok > 0);
+    CHECK(meta.frame_counter == 2012);
+    /* every frame was either read or counted as dropped, 9 were dropped before */
+    CHECK(ok + reader.dropped() - 9 == 2000);
+    CHECK(reader.dropped() >= static_cast<uint64_t>(overruns));
+    fprintf(stderr, "%d frames read, %d overruns, %llu dropped\n", ok, overruns,
+            static_cast<unsigned long long>(reader.dropped()));
+
+    /* a restarted writer creates a new ring under the name */
+    CHECK(!reader.stale());
+    SeekFrameRingWriter restarted;
+    CHECK(restarted.create(name, width + 1, height, 4));
+    CHECK(reader.stale());
+    usleep(300000);
+    CHECK(reader.read_next(frame.data(), step, &meta) == RingStatus::STALE);
+
+    CHECK(reader.open(name));
+    CHECK(!reader.stale() && reader.width() == width + 1);
+
+    /* a writer that closed removes the name */
+    restarted.close();
+    CHECK(reader.stale());
+    writer.close();
+
+    return test::result();
+}
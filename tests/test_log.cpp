@@ -0,0 +1,247 @@
+/*
+ *  Logger test
+ *  Through a handler: a message site over its rate limit is cut off and
+ *  the next message written reports how many were suppressed, messages
+ *  from several threads arrive once and in order per thread while they
+ *  fit the queue, a stalled logging thread makes the queue drop and count
+ *  the rest, JSON lines escape quotes and control characters, and
+ *  log_flush() returns once everything queued before it was handled.
+ */
+#include "SeekLogging.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "test.h"
+
+using namespace LibSeek;
+
+/* collects the lines, held up while closed */
+class Handler
+{
+public:
+    Handler() : m_open(true), m_stalled(false) { }
+
+    static void handle(LogLevel::Enum level, const char* line, void* user_data)
+    {
+        Handler* handler = static_cast<Handler*>(user_data);
+        std::unique_lock<std::mutex> lock(handler->m_mutex);
+
+        while (!handler->m_open) {
+            handler->m_stalled = true;
+            handler->m_wake.wait(lock);
+        }
+        handler->m_stalled = false;
+        handler->m_levels.push_back(level);
+        handler->m_lines.push_back(line);
+    }
+
+    void set_open(bool open)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_open = open;
+        }
+        m_wake.notify_all();
+    }
+
+    /* the logging thread waits in the handler */
+    bool stalled()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stalled;
+    }
+
+    std::vector<std::string> take(std::vector<LogLevel::Enum>* levels=nullptr)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<std::string> lines;
+
+        lines.swap(m_lines);
+        if (levels != nullptr)
+            levels->swap(m_levels);
+        m_levels.clear();
+
+        return lines;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_open;
+    bool m_stalled;
+    std::vector<LogLevel::Enum> m_levels;
+    std::vector<std::string> m_lines;
+};
+
+static Handler handler;
+
+/* one message site for all callers */
+static void log_numbered(int thread, int i)
+{
+    error("thread %d message %d\n", thread, i);
+}
+
+/* the rate limit windows are whole seconds of the steady clock, start early in one */
+static void wait_for_second_start()
+{
+    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    std::this_thread::sleep_for(std::chrono::nanoseconds(1000000000 - ns % 1000000000 + 1000000));
+}
+
+static void test_rate_limit()
+{
+    int i;
+
+    log_set_rate_limit(5);
+    wait_for_second_start();
+    for (i = 0; i < 12; i++)
+        log_numbered(0, i);
+    log_flush();
+
+    std::vector<std::string> lines = handler.take();
+    if (CHECK(lines.size() == 5)) {
+        CHECK(lines[0] == "thread 0 message 0");
+        CHECK(lines[4] == "thread 0 message 4");
+    }
+
+    /* the next window reports what was cut off */
+    wait_for_second_start();
+    log_numbered(0, 12);
+    log_flush();
+    lines = handler.take();
+    CHECK(lines.size() == 1 && lines[0] == "thread 0 message 12 (7 similar messages suppressed)");
+
+    log_set_rate_limit(0);
+}
+
+/* threads x messages from as many threads at once */
+static void log_from_threads(int threads, int messages)
+{
+    std::vector<std::thread> writers;
+
+    for (int t = 0; t < threads; t++) {
+        writers.push_back(std::thread([t, messages]() {
+            for (int i = 0; i < messages; i++)
+                log_numbered(t, i);
+        }));
+    }
+    for (size_t t = 0; t < writers.size(); t++)
+        writers[t].join();
+}
+
+static void test_threads()
+{
+    int thread, i;
+    const int threads = 4;
+
+    /* fits the queue: every message once, in order for every thread */
+    const uint64_t dropped = log_dropped();
+    log_from_threads(threads, 100);
+    log_flush();
+
+    std::vector<std::string> lines = handler.take();
+    std::vector<int> next(threads, 0);
+    int wrong = 0;
+    for (size_t l = 0; l < lines.size(); l++) {
+        if (sscanf(lines[l].c_str(), "thread %d message %d", &thread, &i) != 2 || thread < 0 || thread >= threads ||
+                i != next[thread]++)
+            wrong++;
+    }
+    CHECK(lines.size() == static_cast<size_t>(threads * 100));
+    CHECK(wrong == 0);
+    CHECK(log_dropped() == dropped);
+
+    /* the logging thread is held up in the handler, its message keeps the slot: 511 more queue */
+    handler.set_open(false);
+    log_numbered(-1, 0);
+    while (!handler.stalled())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    log_from_threads(threads, 300);
+    CHECK(log_queued() == 512);
+    const uint64_t lost = log_dropped() - dropped;
+    CHECK(lost == threads * 300 - 511);
+    handler.set_open(true);
+    log_flush();
+
+    /* and reported */
+    std::vector<LogLevel::Enum> levels;
+    lines = handler.take(&levels);
+    size_t messages = 0;
+    uint64_t reported = 0;
+    for (size_t l = 0; l < lines.size(); l++) {
+        unsigned long long n;
+        if (levels[l] == LogLevel::WARNING && sscanf(lines[l].c_str(), "%llu log messages dropped, queue full", &n) == 1)
+            reported += n;
+        else
+            messages++;
+    }
+    CHECK(messages == 512);
+    CHECK(reported == lost);
+    CHECK(log_queued() == 0);
+}
+
+static void test_json()
+{
+    log_set_format(LogFormat::JSON);
+    error("quote \" backslash \\ newline\n tab\t bell\a end\n");
+    log_flush();
+    log_set_format(LogFormat::TEXT);
+
+    const std::vector<std::string> lines = handler.take();
+    if (!CHECK(lines.size() == 1))
+        return;
+    const std::string& line = lines[0];
+
+    CHECK(line.find("\"message\":\"quote \\\" backslash \\\\ newline\\u000a tab\\u0009 bell\\u0007 end\"") !=
+          std::string::npos);
+    CHECK(line.find("\"level\":\"error\"") != std::string::npos);
+    CHECK(line.find("\"file\":\"test_log.cpp\"") != std::string::npos);
+    CHECK(line.find("\"function\":\"test_json\"") != std::string::npos);
+    CHECK(line.front() == '{' && line.back() == '}');
+
+    int control = 0;
+    for (size_t i = 0; i < line.size(); i++)
+        control += static_cast<unsigned char>(line[i]) < 0x20;
+    CHECK(control == 0);
+}
+
+static void test_flush()
+{
+    /* a slow handler, flush() waits for all of it */
+    handler.set_open(false);
+    for (int i = 0; i < 300; i++)
+        log_numbered(0, i);
+    std::thread opener([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        handler.set_open(true);
+    });
+    log_flush();
+    const std::vector<std::string> lines = handler.take();
+    opener.join();
+
+    CHECK(lines.size() == 300);
+    CHECK(!lines.empty() && lines.back() == "thread 0 message 299");
+}
+
+int main()
+{
+    log_set_level(LogLevel::ERROR);
+    log_set_format(LogFormat::TEXT);
+    log_set_handler(&Handler::handle, &handler);
+
+    test_rate_limit();
+    test_threads();
+    test_json();
+    test_flush();
+
+    log_set_handler(nullptr, nullptr);
+
+    return test::result();
+}
@@ -0,0 +1,99 @@
+/*
+ *  Metrics server test
+ *  Scrapes a server on 127.0.0.1 with a port picked by the system: the
+ *  Prometheus text carries the counters and stage timings recorded so
+ *  far, other paths and methods get errors, and stop() leaves stage
+ *  timing enabled or disabled as it was before start().
+ */
+#include "SeekMetricsServer.h"
+#include <cstring>
+#include <string>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "test.h"
+
+using namespace LibSeek;
+
+/* the whole response to request, the server closes the connection after it */
+static std::string scrape(int port, const std::string& request)
+{
+    char buf[4096];
+    std::string response;
+    struct sockaddr_in addr;
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            send(fd, request.data(), request.size(), 0) != static_cast<ssize_t>(request.size())) {
+        if (fd >= 0)
+            close(fd);
+        return std::string();
+    }
+
+    for (ssize_t n; (n = recv(fd, buf, sizeof(buf), 0)) > 0; )
+        response.append(buf, n);
+    close(fd);
+
+    return response;
+}
+
+static bool contains(const std::string& text, const std::string& part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+int main()
+{
+    SeekMetricsServer server;
+
+    CHECK(!metrics_active.load());
+    CHECK(!server.isRunning() && server.port() == -1);
+    CHECK(!server.start(0, "localhost"));
+
+    if (!CHECK(server.start(0)) || !CHECK(server.port() > 0))
+        return test::result();
+    CHECK(metrics_active.load());
+
+    metric_add(MetricCounter::STREAM_FRAMES_PUBLISHED, 3);
+    {
+        SEEK_METRIC_SCOPE(MetricStage::GREY_SCALE);
+    }
+
+    const std::string response = scrape(server.port(), "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    const size_t body = response.find("\r\n\r\n");
+    CHECK(response.compare(0, 17, "HTTP/1.1 200 OK\r\n") == 0);
+    CHECK(contains(response, "Content-Type: text/plain; version=0.0.4"));
+    if (CHECK(body != std::string::npos)) {
+        CHECK(contains(response, "Content-Length: " + std::to_string(response.size() - body - 4) + "\r\n"));
+        CHECK(contains(response, "\nseek_stream_frames_published_total 3\n"));
+        CHECK(contains(response, "\nseek_stage_duration_seconds_count{stage=\"grey_scale\"} 1\n"));
+        CHECK(contains(response, "# TYPE seek_stage_duration_seconds histogram\n"));
+    }
+
+    /* without a body */
+    const std::string head = scrape(server.port(), "HEAD /metrics HTTP/1.1\r\n\r\n");
+    CHECK(head.compare(0, 17, "HTTP/1.1 200 OK\r\n") == 0);
+    CHECK(head.size() == head.find("\r\n\r\n") + 4);
+
+    CHECK(scrape(server.port(), "GET /other HTTP/1.1\r\n\r\n").compare(0, 22, "HTTP/1.1 404 Not Found") == 0);
+    CHECK(scrape(server.port(), "POST /metrics HTTP/1.1\r\n\r\n").compare(0, 31, "HTTP/1.1 405 Method Not Allowed") == 0);
+
+    /* the root path, with bare newlines */
+    CHECK(contains(scrape(server.port(), "GET / HTTP/1.0\n\n"), "seek_stream_frames_published_total 3"));
+
+    server.stop();
+    CHECK(!server.isRunning() && server.port() == -1);
+    CHECK(!metrics_active.load());
+
+    /* enabled by the application before, stays enabled */
+    metrics_enable(true);
+    CHECK(server.start(0));
+    server.stop();
+    CHECK(metrics_active.load());
+
+    return test::result();
+}
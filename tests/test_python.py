@@ -0,0 +1,113 @@
+"""
+Python module test
+Replays a synthetic recording through libseek.Camera and checks the frames
+as numpy arrays: shape, type, zero copy views, the one dimensional buffer
+of consumers that don't ask for a shape, and the frame metadata.
+
+usage: test_python.py <module dir> <make_recording program> <scratch dir>
+Exits with 77 (skipped) without numpy.
+"""
+
+import ctypes
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, sys.argv[1])
+
+try:
+    import numpy as np
+except ImportError:
+    print("numpy not available")
+    sys.exit(77)
+
+import libseek
+
+failures = 0
+
+
+def check(ok, what):
+    global failures
+    if not ok:
+        print("check failed: " + what)
+        failures += 1
+    return ok
+
+
+class Py_buffer(ctypes.Structure):
+    _fields_ = [("buf", ctypes.c_void_p), ("obj", ctypes.c_void_p),
+                ("len", ctypes.c_ssize_t), ("itemsize", ctypes.c_ssize_t),
+                ("readonly", ctypes.c_int), ("ndim", ctypes.c_int),
+                ("format", ctypes.c_char_p), ("shape", ctypes.POINTER(ctypes.c_ssize_t)),
+                ("strides", ctypes.POINTER(ctypes.c_ssize_t)), ("suboffsets", ctypes.c_void_p),
+                ("internal", ctypes.c_void_p)]
+
+
+def simple_buffer(obj):
+    """ndim and len of the buffer a PyBUF_SIMPLE consumer gets"""
+    view = Py_buffer()
+    get_buffer = ctypes.pythonapi.PyObject_GetBuffer
+    get_buffer.argtypes = [ctypes.py_object, ctypes.POINTER(Py_buffer), ctypes.c_int]
+    release = ctypes.pythonapi.PyBuffer_Release
+    release.argtypes = [ctypes.POINTER(Py_buffer)]
+
+    if get_buffer(obj, ctypes.byref(view), 0) != 0:
+        return None
+    result = (view.ndim, view.len, bool(view.shape))
+    release(ctypes.byref(view))
+    return result
+
+
+def replay(recording, model, frame_count):
+    subprocess.check_call([sys.argv[2], recording] + (["pro"] if model == libseek.MODEL_THERMAL_PRO else [])
+                          + [str(frame_count)])
+
+    with libseek.Camera(recording=recording) as cam:
+        frame = cam.read()
+        array = np.asarray(frame)
+
+        check(array.shape == (cam.height, cam.width), "shape %s" % (array.shape,))
+        check(array.dtype == np.uint16, "dtype %s" % array.dtype)
+        check(not array.flags.writeable, "read only")
+        check(frame.shape == array.shape, "frame shape")
+        check(np.shares_memory(array, np.asarray(frame)), "arrays view the frame buffer")
+        check(array.max() > array.min(), "corrected frame has contrast")
+
+        check(simple_buffer(frame) == (1, cam.width * cam.height * 2, False), "simple buffer %s" % (simple_buffer(frame),))
+        view = memoryview(frame)
+        check(view.ndim == 2 and view.shape == (cam.height, cam.width) and view.format == "H", "memoryview")
+        view.release()
+
+        raw = np.asarray(cam.read(libseek.RAW))
+        check(raw.shape == array.shape and raw.min() >= 40, "raw frame")
+
+        # the rest of the recording, frame 51 is a shutter frame that grab() skips
+        frames = 2
+        shutters = []
+        for frame in cam:
+            frames += 1
+            check(type(frame.shutter) is int, "shutter is an int")
+            if frame.shutter:
+                shutters.append(frame.frame_counter)
+
+        # the end stays the end, read() raises there
+        check(next(iter(cam), None) is None, "iteration ended")
+        try:
+            cam.read()
+            check(False, "read() past the end raises")
+        except libseek.Error as e:
+            check(str(e) == "end of recording", "error %s" % e)
+
+        # open() consumes the first frame, the shutter frame 1 and grabs frame 2
+        check(frames == frame_count - 4, "%d frames" % frames)
+        check(shutters == [52], "shutters %s" % shutters)
+
+
+recording = os.path.join(sys.argv[3], "test_python.skr")
+replay(recording, libseek.MODEL_THERMAL, 64)
+replay(recording, libseek.MODEL_THERMAL_PRO, 64)
+os.remove(recording)
+
+if failures:
+    print("%d checks failed" % failures)
+sys.exit(1 if failures else 0)
@@ -0,0 +1,498 @@
+/*
+ *  Recording test
+ *  Frames come back bit exact from the codec: smooth frames through Rice
+ *  coding, noise through the packed fallback, full range pixels, odd
+ *  widths and single rows. Escape codes, which the encoder only needs
+ *  for residuals it can't reach with its parameter choice, are decoded
+ *  from hand made streams, and truncated or corrupted data is rejected.
+ *  Recordings on disk: a closed one is read through its index, one that
+ *  wasn't closed gets its index rebuilt without the cut off last frame,
+ *  time lookup at the ends and across a pause, pooled frames staying
+ *  valid, and a player seek replaying the shutter frame before it.
+ */
+#include "SeekRecording.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "test.h"
+
+using namespace LibSeek;
+
+static uint32_t next_random(uint32_t& state)
+{
+    state = state * 1664525 + 1013904223;
+    return state >> 8;
+}
+
+/* a sensor like frame: a gradient with a little noise */
+static std::vector<uint16_t> smooth_frame(int width, int height)
+{
+    uint32_t state = 1;
+    std::vector<uint16_t> frame(width * height);
+
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            frame[y * width + x] = 8000 + x * 3 + y * 5 + next_random(state) % 8;
+
+    return frame;
+}
+
+static std::vector<uint16_t> noise_frame(int width, int height, int bits)
+{
+    uint32_t state = 7;
+    std::vector<uint16_t> frame(width * height);
+
+    for (size_t i = 0; i < frame.size(); i++)
+        frame[i] = next_random(state) & ((1u << bits) - 1);
+
+    return frame;
+}
+
+/* encodes and decodes frame, the coded data and header are returned for further checks */
+static bool round_trip(const std::vector<uint16_t>& frame, int width, int height,
+                       RecordFrameHeader& header, std::vector<uint8_t>& coded)
+{
+    std::vector<uint16_t> decoded(width * height, 0x5555);
+
+    std::memset(&header, 0, sizeof(header));
+    encode_record_frame(frame.data(), width, height, header, coded);
+    if (header.data_size != coded.size())
+        return false;
+
+    return decode_record_frame(header, coded.data(), width, height, decoded.data()) && decoded == frame;
+}
+
+/* LSB first, like the recording bit streams */
+class BitPacker
+{
+public:
+    BitPacker() : m_bits(0) { }
+
+    void put(uint32_t value, int bits)
+    {
+        for (int i = 0; i < bits; i++, m_bits++) {
+            if (m_bits % 8 == 0)
+                m_data.push_back(0);
+            m_data.back() |= ((value >> i) & 1) << (m_bits % 8);
+        }
+    }
+
+    const std::vector<uint8_t>& data() const
+    {
+        return m_data;
+    }
+
+private:
+    std::vector<uint8_t> m_data;
+    int m_bits;
+};
+
+/* decodes a 1 x 1 Rice frame of k = 0 and quotient q, followed by bits more bits of value */
+static bool decode_escape(uint32_t q, uint32_t value, int bits, uint16_t& pixel)
+{
+    BitPacker packer;
+    RecordFrameHeader header;
+
+    packer.put(0, 4);
+    packer.put(1u << q, q + 1);
+    packer.put(value, bits);
+
+    std::memset(&header, 0, sizeof(header));
+    header.codec = RecordCodec::RICE;
+    header.bits = 16;
+    header.data_size = packer.data().size();
+
+    return decode_record_frame(header, packer.data().data(), 1, 1, &pixel);
+}
+
+static void test_codec()
+{
+    int i;
+    RecordFrameHeader header;
+    std::vector<uint8_t> coded;
+
+    /* sensor like frames are Rice coded, much smaller than 14 bit packing */
+    const std::vector<uint16_t> smooth = smooth_frame(342, 260);
+    CHECK(round_trip(smooth, 342, 260, header, coded));
+    CHECK(header.codec == RecordCodec::RICE);
+    CHECK(coded.size() < smooth.size() * 14 / 8 / 2);
+
+    /* noise doesn't compress, it is packed with as many bits as the largest sample needs */
+    const std::vector<uint16_t> noise14 = noise_frame(342, 260, 14);
+    CHECK(round_trip(noise14, 342, 260, header, coded));
+    CHECK(header.codec == RecordCodec::PACKED && header.bits == 14);
+    CHECK(coded.size() == (noise14.size() * 14 + 7) / 8);
+
+    const std::vector<uint16_t> noise16 = noise_frame(37, 9, 16);
+    CHECK(round_trip(noise16, 37, 9, header, coded));
+    CHECK(header.codec == RecordCodec::PACKED && header.bits == 16);
+
+    /* full range jumps in a smooth frame are the largest residuals there are */
+    std::vector<uint16_t> extremes = smooth_frame(64, 16);
+    for (i = 0; i < 64 * 16; i += 37)
+        extremes[i] = i % 2 ? 0xffff : 0x0000;
+    extremes[0] = 0xffff;
+    extremes[64 * 16 - 1] = 0x0000;
+    CHECK(round_trip(extremes, 64, 16, header, coded));
+    CHECK(header.codec == RecordCodec::RICE);
+
+    std::vector<uint16_t> zeros(21 * 3, 0x0000), ones(21 * 3, 0xffff);
+    CHECK(round_trip(zeros, 21, 3, header, coded));
+    CHECK(round_trip(ones, 21, 3, header, coded));
+
+    /* partial blocks at the end of the rows, a single row, a single column */
+    const int widths[] = { 1, 2, 15, 16, 17, 33, 207 };
+    const int heights[] = { 1, 2, 5 };
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        for (size_t h = 0; h < sizeof(heights) / sizeof(heights[0]); h++) {
+            const std::vector<uint16_t> frame = smooth_frame(widths[w], heights[h]);
+            if (!CHECK(round_trip(frame, widths[w], heights[h], header, coded)))
+                fprintf(stderr, "%d x %d\n", widths[w], heights[h]);
+        }
+    }
+
+    /* escape codes: quotient 20 and a 17 bit zigzag residual, the prediction of the first pixel is 0 */
+    uint16_t pixel = 0;
+    CHECK(decode_escape(20, 2 * 50000, 17, pixel) && pixel == 50000);
+    CHECK(decode_escape(20, 2 * 65535, 17, pixel) && pixel == 65535);
+    CHECK(decode_escape(2, 0, 0, pixel) && pixel == 1);
+    /* a residual below 0, a quotient beyond the escape, a cut off escape */
+    CHECK(!decode_escape(20, 131071, 17, pixel));
+    CHECK(!decode_escape(21, 0, 17, pixel));
+    CHECK(!decode_escape(20, 2 * 50000, 9, pixel));
+}
+
+static void test_corrupt()
+{
+    RecordFrameHeader header;
+    std::vector<uint8_t> coded;
+    const int width = 207;
+    const int height = 30;
+    std::vector<uint16_t> decoded(width * height);
+
+    /* one byte short */
+    const std::vector<uint16_t> smooth = smooth_frame(width, height);
+    CHECK(round_trip(smooth, width, height, header, coded));
+    header.data_size--;
+    CHECK(!decode_record_frame(header, coded.data(), width, height, decoded.data()));
+    header.data_size++;
+
+    const std::vector<uint16_t> noise = noise_frame(width, height, 14);
+    RecordFrameHeader packed;
+    std::vector<uint8_t> packed_coded;
+    CHECK(round_trip(noise, width, height, packed, packed_coded) && packed.codec == RecordCodec::PACKED);
+    packed.data_size--;
+    CHECK(!decode_record_frame(packed, packed_coded.data(), width, height, decoded.data()));
+    packed.data_size++;
+
+    /* a zeroed run is a quotient beyond the escape code wherever it starts */
+    std::vector<uint8_t> zeroed = coded;
+    std::memset(&zeroed[zeroed.size() / 2], 0, 8);
+    CHECK(!decode_record_frame(header, zeroed.data(), width, height, decoded.data()));
+
+    /* an unknown codec, packed samples of no or too many bits */
+    RecordFrameHeader bad = header;
+    bad.codec = 7;
+    CHECK(!decode_record_frame(bad, coded.data(), width, height, decoded.data()));
+    bad = packed;
+    bad.bits = 0;
+    CHECK(!decode_record_frame(bad, packed_coded.data(), width, height, decoded.data()));
+    bad.bits = 17;
+    CHECK(!decode_record_frame(bad, packed_coded.data(), width, height, decoded.data()));
+}
+
+static const int raw_width = 23;
+static const int raw_height = 7;
+static const int frame_count = 12;
+static const char* closed_name = "test_recording_closed.skr";
+static const char* unclosed_name = "test_recording_unclosed.skr";
+
+/* pixel p of frame i */
+static uint16_t pixel(int i, int p)
+{
+    return static_cast<uint16_t>(1000 + i * 37 + p % 50);
+}
+
+static bool holds(const uint16_t* raw, int i)
+{
+    if (raw == nullptr)
+        return false;
+
+    for (int p = 0; p < raw_width * raw_height; p++) {
+        if (raw[p] != pixel(i, p))
+            return false;
+    }
+
+    return true;
+}
+
+/* a shutter frame at 1 and 6, 1 ms apart with a 50 ms pause after frame 8 */
+static int frame_id(int i)
+{
+    return i == 0 ? FrameType::FIRST : i == 1 || i == 6 ? FrameType::SHUTTER : FrameType::IMAGE;
+}
+
+static uint64_t timestamp(int i)
+{
+    return 1000000ULL * (i + 1) + (i > 8 ? 50000000ULL : 0);
+}
+
+/* writes the frames to filename and closes it, returns the size without the index */
+static uint64_t write_recording(const char* filename)
+{
+    SeekRecordingWriter writer;
+    std::vector<uint16_t> raw(raw_width * raw_height);
+    FrameMeta meta = FrameMeta();
+
+    if (!writer.open(filename, SeekThermalTraits::product_id, raw_width, raw_height))
+        return 0;
+
+    for (int i = 0; i < frame_count; i++) {
+        for (int p = 0; p < raw_width * raw_height; p++)
+            raw[p] = pixel(i, p);
+        meta.frame_id = frame_id(i);
+        meta.frame_counter = 100 + i;
+        meta.timestamp_ns = timestamp(i);
+        meta.sequence = i;
+        if (!writer.write(raw.data(), meta))
+            return 0;
+    }
+
+    const uint64_t frames_end = writer.bytes();
+    writer.close();
+
+    return writer.good() ? frames_end : 0;
+}
+
+static std::vector<uint8_t> read_file(const char* filename)
+{
+    std::vector<uint8_t> data;
+    FILE* file = fopen(filename, "rb");
+
+    if (file == nullptr)
+        return data;
+    for (int c; (c = fgetc(file)) != EOF; )
+        data.push_back(static_cast<uint8_t>(c));
+    fclose(file);
+
+    return data;
+}
+
+static bool write_file(const char* filename, const std::vector<uint8_t>& data, size_t size)
+{
+    FILE* file = fopen(filename, "wb");
+
+    if (file == nullptr)
+        return false;
+    const bool ok = fwrite(data.data(), 1, size, file) == size;
+
+    return fclose(file) == 0 && ok;
+}
+
+/* every frame decodes to its pixels and metadata, in order through read() too */
+static bool complete(SeekRecordingReader& reader, int frames)
+{
+    int i;
+    FrameMeta meta;
+    std::vector<uint16_t> raw(raw_width * raw_height);
+
+    if (reader.frames() != static_cast<size_t>(frames))
+        return false;
+
+    for (i = 0; i < frames; i++) {
+        if (!reader.frame_info(i, meta) || meta.frame_id != frame_id(i) || meta.frame_counter != 100 + i ||
+                meta.timestamp_ns != timestamp(i))
+            return false;
+    }
+
+    reader.seek(0);
+    for (i = 0; i < frames; i++) {
+        if (!reader.read(raw.data(), &meta) || !holds(raw.data(), i) || meta.sequence != static_cast<uint64_t>(i))
+            return false;
+    }
+
+    return !reader.read(raw.data(), &meta) && reader.position() == static_cast<size_t>(frames);
+}
+
+static void test_reader()
+{
+    SeekRecordingReader reader;
+    std::vector<uint16_t> raw(raw_width * raw_height);
+
+    const uint64_t frames_end = write_recording(closed_name);
+    if (!CHECK(frames_end > 0))
+        return;
+    const std::vector<uint8_t> file = read_file(closed_name);
+
+    /* closed: read through the index */
+    if (!CHECK(reader.open(closed_name)))
+        return;
+    CHECK(reader.raw_width() == raw_width && reader.raw_height() == raw_height);
+    CHECK(reader.product_id() == SeekThermalTraits::product_id);
+    CHECK(complete(reader, frame_count));
+    CHECK(!reader.decode(frame_count, raw.data()));
+    reader.close();
+
+    /* the index still finds the frames after a broken one, a rebuilt index would end there */
+    std::vector<uint8_t> broken = file;
+    FrameMeta meta;
+    size_t offset = sizeof(RecordFileHeader);
+    for (int i = 0; i < 5; i++) {
+        RecordFrameHeader header;
+        std::memcpy(&header, &broken[offset], sizeof(header));
+        offset += sizeof(header) + header.data_size;
+    }
+    std::memset(&broken[offset], 0, 4);
+    CHECK(write_file(unclosed_name, broken, broken.size()));
+    if (CHECK(reader.open(unclosed_name))) {
+        CHECK(reader.frames() == static_cast<size_t>(frame_count));
+        CHECK(!reader.decode(5, raw.data()));
+        CHECK(reader.decode(6, raw.data(), &meta) && holds(raw.data(), 6) && meta.frame_counter == 106);
+        reader.close();
+    }
+
+    /* not closed: the index is rebuilt */
+    CHECK(write_file(unclosed_name, file, frames_end));
+    if (CHECK(reader.open(unclosed_name))) {
+        CHECK(complete(reader, frame_count));
+        reader.close();
+    }
+
+    /* the recorder died within the last frame or its header, that frame is left out */
+    const size_t cuts[] = { 1, 10 };
+    size_t last = sizeof(RecordFileHeader);
+    for (int i = 0; i < frame_count - 1; i++) {
+        RecordFrameHeader header;
+        std::memcpy(&header, &file[last], sizeof(header));
+        last += sizeof(header) + header.data_size;
+    }
+    for (size_t c = 0; c < sizeof(cuts) / sizeof(cuts[0]); c++) {
+        CHECK(write_file(unclosed_name, file, frames_end - cuts[c]));
+        if (CHECK(reader.open(unclosed_name))) {
+            CHECK(complete(reader, frame_count - 1));
+            reader.close();
+        }
+    }
+    CHECK(write_file(unclosed_name, file, last + sizeof(RecordFrameHeader) / 2));
+    if (CHECK(reader.open(unclosed_name))) {
+        CHECK(complete(reader, frame_count - 1));
+        reader.close();
+    }
+
+    /* just the file header */
+    CHECK(write_file(unclosed_name, file, sizeof(RecordFileHeader)));
+    if (CHECK(reader.open(unclosed_name))) {
+        CHECK(reader.frames() == 0 && reader.find_time(0) == 0 && reader.frame(0) == nullptr);
+        reader.close();
+    }
+
+    /* not a recording */
+    CHECK(write_file(unclosed_name, file, sizeof(RecordFileHeader) - 1));
+    CHECK(!reader.open(unclosed_name));
+}
+
+static void test_find_time()
+{
+    SeekRecordingReader reader;
+
+    if (!CHECK(reader.open(closed_name)))
+        return;
+
+    /* before and at the first frame, at and after the last one */
+    CHECK(reader.find_time(0) == 0);
+    CHECK(reader.find_time(timestamp(0)) == 0);
+    CHECK(reader.find_time(timestamp(0) + 1) == 1);
+    CHECK(reader.find_time(timestamp(frame_count - 1)) == static_cast<size_t>(frame_count - 1));
+    CHECK(reader.find_time(timestamp(frame_count - 1) + 1) == static_cast<size_t>(frame_count));
+    CHECK(reader.find_time(UINT64_MAX) == static_cast<size_t>(frame_count));
+
+    /* every frame, between frames and within the pause */
+    for (int i = 1; i < frame_count; i++) {
+        if (!CHECK(reader.find_time(timestamp(i)) == static_cast<size_t>(i)) ||
+                !CHECK(reader.find_time(timestamp(i) - 1) == static_cast<size_t>(i)))
+            fprintf(stderr, "frame %d\n", i);
+    }
+    CHECK(reader.find_time(timestamp(8) + 20000000ULL) == 9);
+}
+
+static void test_pool()
+{
+    int i, j;
+    SeekRecordingReader reader;
+    const uint16_t* frames[frame_count];
+    FrameMeta meta;
+
+    if (!CHECK(reader.open(closed_name)))
+        return;
+    reader.setPoolSize(3);
+    CHECK(reader.pool_size() == 3);
+
+    /* a frame stays valid while fewer than pool_size() others were requested */
+    for (i = 0; i < frame_count; i++) {
+        frames[i] = reader.frame(i, &meta);
+        CHECK(holds(frames[i], i) && meta.frame_counter == 100 + i);
+        for (j = std::max(0, i - 2); j < i; j++)
+            CHECK(holds(frames[j], j));
+    }
+
+    /* in the pool: the same buffer without decoding, the least recently used one goes first */
+    CHECK(reader.frame(10) == frames[10]);
+    CHECK(holds(reader.frame(0), 0));
+    CHECK(reader.frame(10) == frames[10] && holds(frames[10], 10));
+    CHECK(reader.frame(frame_count) == nullptr);
+
+    /* backwards and in random order */
+    for (i = frame_count; i-- > 0; )
+        CHECK(holds(reader.frame(i), i));
+    for (i = 0; i < 50; i++) {
+        const int index = (i * 7) % frame_count;
+        CHECK(holds(reader.frame(index), index));
+    }
+}
+
+static void test_player()
+{
+    SeekRecordingReader reader;
+    std::vector<uint16_t> raw(raw_width * raw_height);
+    FrameMeta meta;
+
+    if (!CHECK(reader.open(closed_name)))
+        return;
+
+    /* the first frame, then from where it was seeked to with the shutter frame before it */
+    SeekRecordingPlayer player(reader);
+    player.setRealtime(false);
+    player.seek(4);
+    CHECK(player.next_raw_frame(raw.data(), meta) && meta.frame_counter == 100 && holds(raw.data(), 0));
+    CHECK(player.next_raw_frame(raw.data(), meta) && meta.frame_counter == 101 && holds(raw.data(), 1));
+    CHECK(player.next_raw_frame(raw.data(), meta) && meta.frame_counter == 104 && holds(raw.data(), 4));
+    CHECK(player.position() == 5);
+
+    /* the nearest shutter frame before, not the first one */
+    player.seek(9);
+    CHECK(player.next_raw_frame(raw.data(), meta) && meta.frame_counter == 106 && holds(raw.data(), 6));
+    for (int i = 9; i < frame_count; i++)
+        CHECK(player.next_raw_frame(raw.data(), meta) && meta.frame_counter == 100 + i && holds(raw.data(), i));
+    CHECK(!player.next_raw_frame(raw.data(), meta));
+
+    /* back to the start: no shutter frame before frame 1 besides the first frame */
+    player.seek(1);
+    CHECK(player.next_raw_frame(raw.data(), meta) && meta.frame_counter == 101);
+    CHECK(player.next_raw_frame(raw.data(), meta) && meta.frame_counter == 102);
+}
+
+int main()
+{
+    test_codec();
+    test_corrupt();
+    test_reader();
+    test_find_time();
+    test_pool();
+    test_player();
+
+    std::remove(closed_name);
+    std::remove(unclosed_name);
+
+    return test::result();
+}
@@ -0,0 +1,155 @@
+/*
+ *  Replay test
+ *  Synthetic raw frames of both models go through grab, retrieveInto and
+ *  the seek_viewer frame processing (normalize, 8-bit, upscale and
+ *  colorize) without usb. Checks the flat field and dead pixel correction
+ *  against the raw frames and, built with WITH_ALLOCATION_CHECK, that the
+ *  steady state doesn't allocate.
+ */
+#include "seek_core.h"
+#include <algorithm>
+#include <vector>
+#include "alloc_check.h"
+#include "bench.h"
+#include "test.h"
+
+using namespace LibSeek;
+
+/* gives the test access to the dead pixel list and the offset */
+template<class Traits>
+class ReplayCam: public SeekCamModel<Traits>
+{
+public:
+    bool is_dead(int x, int y) const
+    {
+        for (size_t i = 0; i < this->m_dead_pixel_list.size(); i++) {
+            if (this->m_dead_pixel_list[i].x == x && this->m_dead_pixel_list[i].y == y)
+                return true;
+        }
+        return false;
+    }
+
+    size_t dead_pixels() const
+    {
+        return this->m_dead_pixel_list.size();
+    }
+
+    int offset() const
+    {
+        return this->m_offset;
+    }
+};
+
+template<class Traits>
+static void replay(const char* model)
+{
+    int x, y;
+    size_t i, dead = 0, shutters = 0;
+    const int w = Traits::width, h = Traits::height, factor = 2;
+    const bench::FrameList frames = bench::synthetic_frames<Traits>(64);
+    bench::LoopSource source(frames);
+    ReplayCam<Traits> cam;
+    FrameMeta meta;
+    uint64_t sequence = 0;
+    uint16_t min, max;
+    std::vector<uint16_t> frame(w * h);
+    std::vector<uint8_t> grey(w * h);
+    std::vector<uint8_t> out(w * factor * h * factor * 3);
+    std::vector<uint8_t> palette(256 * 3);
+
+    fprintf(stderr, "%s\n", model);
+
+    for (i = 0; i < 256; i++) {
+        palette[3 * i] = i;
+        palette[3 * i + 1] = 255 - i;
+        palette[3 * i + 2] = i / 2;
+    }
+
+    cam.setRawFrameSource(&source);
+    if (!CHECK(cam.open()))
+        return;
+    CHECK(cam.width() == w && cam.height() == h);
+
+    /* every synthetic dead pixel of the image part is found, nothing else */
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            if (frames[0][(y + Traits::roi_y) * Traits::raw_width + x + Traits::roi_x] == 40)
+                dead++;
+        }
+    }
+    CHECK(dead > 0);
+    CHECK(cam.dead_pixels() == dead);
+
+    /* two passes over the frames, each wrap replays the shutter frame */
+    for (i = 0; i < 2 * frames.size(); i++) {
+#ifdef SEEK_ALLOCATION_CHECK
+        const size_t allocations = alloc_check::allocations();
+#endif
+
+        const bool ok = cam.grab() && cam.retrieveInto(frame.data(), w * sizeof(uint16_t),
+                                                       ProcessingLevel::FULLY_CORRECTED, &meta);
+        if (ok) {
+            min_max(frame.data(), w, w, h, &min, &max);
+            normalize_fixed(frame.data(), w, w, h, min, max);
+            convert_to_8bit(frame.data(), w, grey.data(), w, w, h);
+            upscale_nearest_colorize(grey.data(), w, w, h, palette.data(), factor, out.data(), 3 * w * factor);
+        }
+
+#ifdef SEEK_ALLOCATION_CHECK
+        CHECK(alloc_check::allocations() == allocations);
+#endif
+        if (!CHECK(ok))
+            return;
+
+        /* frames 1 and 51 are shutter frames, grab() skips them */
+        const int n = meta.frame_counter;
+        const int s = n > 51 ? 51 : 1;
+        CHECK(meta.frame_id == FrameType::IMAGE);
+        CHECK(meta.sequence > sequence);
+        CHECK(meta.shutter == (n == s + 1));
+        CHECK(meta.frames_skipped == (meta.shutter ? 1 : 0));
+        sequence = meta.sequence;
+        shutters += meta.shutter;
+
+        /* retrieve again without processing, the corrected frame against the raw frames */
+        cam.retrieveInto(frame.data(), w * sizeof(uint16_t));
+        for (y = 0; y < h; y++) {
+            for (x = 0; x < w; x++) {
+                const size_t raw = (y + Traits::roi_y) * Traits::raw_width + x + Traits::roi_x;
+                const int value = frame[y * w + x];
+
+                if (cam.is_dead(x, y)) {
+                    CHECK(value > cam.offset());
+                    continue;
+                }
+                if (!CHECK(value == frames[n][raw] + cam.offset() - frames[s][raw])) {
+                    fprintf(stderr, "frame %d, pixel %d, %d\n", n, x, y);
+                    return;
+                }
+            }
+        }
+
+        /* the processed frame spans all grey levels, every output block has the palette color */
+        CHECK(*std::min_element(grey.begin(), grey.end()) == 0);
+        CHECK(*std::max_element(grey.begin(), grey.end()) == 255);
+        for (y = 0; y < h * factor; y++) {
+            for (x = 0; x < w * factor; x++) {
+                const uint8_t* color = &palette[3 * grey[(y / factor) * w + x / factor]];
+                const uint8_t* pixel = &out[(y * w * factor + x) * 3];
+                if (!CHECK(pixel[0] == color[0] && pixel[1] == color[1] && pixel[2] == color[2]))
+                    return;
+            }
+        }
+    }
+
+    /* open() took the first shutter frame, then 51, 1, 51 and 1 again */
+    CHECK(shutters == 4);
+}
+
+int main()
+{
+    replay<SeekThermalTraits>("seek");
+    replay<SeekThermalProTraits>("seekpro");
+
+    return test::result();
+}
@@ -0,0 +1,388 @@
+/*
+ *  Network stream test
+ *  Servers on 127.0.0.1 with ports picked by the system: a tcp client that
+ *  keeps up gets every frame intact, a tcp client that stops reading skips
+ *  frames without holding up publish() or the other client, and a udp
+ *  subscriber gets its frames reassembled once it echoed the cookie, which
+ *  a bare "SUB" or a wrong cookie doesn't get past. Against fake servers:
+ *  a tcp frame cut off by a timeout is completed by the next receive, and
+ *  udp fragments that don't fit the frame or repeat a chunk are ignored.
+ */
+#include "SeekStream.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "test.h"
+
+using namespace LibSeek;
+
+/* every pixel of frame n holds n + 7 x pixel index, the metadata is derived from n */
+static bool publish(SeekStreamServer& server, int width, int height, int n)
+{
+    std::vector<uint16_t> frame(width * height);
+    FrameMeta meta = FrameMeta();
+
+    for (size_t i = 0; i < frame.size(); i++)
+        frame[i] = static_cast<uint16_t>(n + 7 * i);
+    meta.frame_id = FrameType::IMAGE;
+    meta.frame_counter = n;
+    meta.timestamp_ns = n * 1000ULL;
+    meta.sequence = n;
+    meta.shutter = n % 2 == 1;
+
+    return server.publish(frame.data(), width * sizeof(uint16_t), meta, ProcessingLevel::RAW);
+}
+
+/* the frame is n intact, with the metadata of frame n */
+static bool intact(const StreamHeader& header, const std::vector<uint16_t>& pixels, int width, int height, int n)
+{
+    if (header.width != static_cast<uint32_t>(width) || header.height != static_cast<uint32_t>(height) ||
+            pixels.size() != static_cast<size_t>(width * height))
+        return false;
+
+    for (size_t i = 0; i < pixels.size(); i++) {
+        if (pixels[i] != static_cast<uint16_t>(n + 7 * i))
+            return false;
+    }
+
+    return header.frame_counter == n && header.sequence == static_cast<uint64_t>(n) &&
+           header.timestamp_ns == n * 1000ULL && header.level == ProcessingLevel::RAW &&
+           header.flags == (n % 2 == 1 ? stream_flag_shutter : 0u);
+}
+
+/* the network thread works asynchronously, give it up to 2 s */
+template<class Condition>
+static bool eventually(Condition condition)
+{
+    for (int i = 0; i < 200 && !condition(); i++)
+        usleep(10000);
+
+    return condition();
+}
+
+static int udp_socket(int port)
+{
+    struct sockaddr_in addr;
+    const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (fd >= 0 && connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* next datagram within 500 ms, empty on timeout */
+static std::string udp_receive(int fd)
+{
+    char buf[2048];
+    struct pollfd pfd = { fd, POLLIN, 0 };
+
+    if (poll(&pfd, 1, 500) <= 0)
+        return std::string();
+
+    const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    return n > 0 ? std::string(buf, n) : std::string();
+}
+
+static void udp_send(int fd, const std::string& request)
+{
+    const ssize_t n = send(fd, request.data(), request.size(), 0);
+    (void)n;
+}
+
+static void test_tcp()
+{
+    int n;
+    const int width = 640;
+    const int height = 480;
+    SeekStreamServer server;
+    SeekStreamClient fast, slow;
+    StreamHeader header;
+    std::vector<uint16_t> pixels;
+
+    if (!CHECK(server.start(0, -1, width, height)) || !CHECK(server.tcp_port() > 0 && server.udp_port() == -1))
+        return;
+
+    /* a client that keeps up gets every frame */
+    CHECK(fast.connect("127.0.0.1", server.tcp_port()));
+    CHECK(eventually([&]() { return server.stats().tcp_clients == 1; }));
+    for (n = 0; n < 50; n++) {
+        CHECK(publish(server, width, height, n));
+        CHECK(fast.receive(header, pixels, 2000) && intact(header, pixels, width, height, n));
+    }
+    CHECK(server.stats().frames_dropped == 0 && server.stats().client_frames_dropped == 0);
+
+    /* 100 frames of 600 kB overflow the socket buffers of a client that doesn't read */
+    CHECK(slow.connect("127.0.0.1", server.tcp_port()));
+    CHECK(eventually([&]() { return server.stats().tcp_clients == 2; }));
+
+    double slowest_ms = 0;
+    for (n = 50; n < 150; n++) {
+        const auto start = std::chrono::steady_clock::now();
+        CHECK(publish(server, width, height, n));
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        slowest_ms = std::max(slowest_ms, elapsed.count());
+
+        /* the fast client doesn't notice */
+        CHECK(fast.receive(header, pixels, 2000) && intact(header, pixels, width, height, n));
+    }
+    CHECK(server.stats().client_frames_dropped > 0);
+    CHECK(server.stats().frames_published == 150);
+    /* copying one frame, never waiting for a socket */
+    CHECK(slowest_ms < 250);
+
+    /* what the slow client gets is intact and in order, with gaps */
+    int received = 0, last = -1;
+    while (slow.receive(header, pixels, 500)) {
+        CHECK(header.frame_counter > last && intact(header, pixels, width, height, header.frame_counter));
+        last = header.frame_counter;
+        received++;
+    }
+    CHECK(received > 0 && received < 150);
+    fprintf(stderr, "slow client: %d of 150 frames, %llu skipped, slowest publish %.2f ms\n", received,
+            static_cast<unsigned long long>(server.stats().client_frames_dropped), slowest_ms);
+
+    server.stop();
+    CHECK(!fast.receive(header, pixels, 2000));
+}
+
+static void test_udp()
+{
+    int n;
+    const int width = 206;
+    const int height = 156;
+    SeekStreamServer server;
+    SeekStreamClient subscriber;
+    StreamHeader header;
+    std::vector<uint16_t> pixels;
+
+    if (!CHECK(server.start(-1, 0, width, height)) || !CHECK(server.udp_port() > 0 && server.tcp_port() == -1))
+        return;
+
+    /* a bare subscription only gets a cookie, so does a wrong one */
+    const int raw = udp_socket(server.udp_port());
+    if (!CHECK(raw >= 0))
+        return;
+    udp_send(raw, "SUB");
+    const std::string cookie = udp_receive(raw);
+    CHECK(cookie.size() == 14 && cookie.compare(0, 6, "COOKIE") == 0);
+    udp_send(raw, "SUB" + std::string(8, 'x'));
+    CHECK(udp_receive(raw) == cookie);
+    usleep(100000);
+    CHECK(server.stats().udp_subscribers == 0);
+
+    /* the client echoes the cookie while waiting for its first frame */
+    CHECK(subscriber.subscribe("127.0.0.1", server.udp_port()));
+    CHECK(!subscriber.receive(header, pixels, 200));
+    CHECK(eventually([&]() { return server.stats().udp_subscribers == 1; }));
+
+    for (n = 0; n < 20; n++) {
+        CHECK(publish(server, width, height, n));
+        CHECK(subscriber.receive(header, pixels, 2000) && intact(header, pixels, width, height, n));
+    }
+    CHECK(subscriber.incomplete() == 0);
+    CHECK(server.stats().client_frames_dropped == 0);
+
+    /* nothing but cookies went to the address that didn't echo one */
+    CHECK(udp_receive(raw).empty());
+
+    /* the cookie is the one sent to the address, and ends the subscription too */
+    udp_send(raw, "SUB" + cookie.substr(6));
+    CHECK(eventually([&]() { return server.stats().udp_subscribers == 2; }));
+    udp_send(raw, "UNSUB" + std::string(8, 'x'));
+    usleep(100000);
+    CHECK(server.stats().udp_subscribers == 2);
+    udp_send(raw, "UNSUB" + cookie.substr(6));
+    CHECK(eventually([&]() { return server.stats().udp_subscribers == 1; }));
+    close(raw);
+
+    subscriber.close();
+    CHECK(eventually([&]() { return server.stats().udp_subscribers == 0; }));
+}
+
+/* the tcp encoding of frame n as publish() sends it */
+static std::string encode(int width, int height, int n)
+{
+    StreamHeader header;
+    std::string frame(sizeof(header) + width * height * sizeof(uint16_t), 0);
+
+    std::memset(&header, 0, sizeof(header));
+    header.magic = stream_magic;
+    header.version = stream_version;
+    header.header_size = sizeof(header);
+    header.width = width;
+    header.height = height;
+    header.level = ProcessingLevel::RAW;
+    header.payload_size = width * height * sizeof(uint16_t);
+    header.sequence = n;
+    header.timestamp_ns = n * 1000ULL;
+    header.frame_id = FrameType::IMAGE;
+    header.frame_counter = n;
+    header.flags = n % 2 == 1 ? stream_flag_shutter : 0;
+    std::memcpy(&frame[0], &header, sizeof(header));
+    for (int i = 0; i < width * height; i++) {
+        const uint16_t pixel = static_cast<uint16_t>(n + 7 * i);
+        std::memcpy(&frame[sizeof(header) + i * sizeof(pixel)], &pixel, sizeof(pixel));
+    }
+
+    return frame;
+}
+
+/* a loopback socket bound to a port picked by the system */
+static int bound_socket(int type, int& port)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    const int fd = socket(AF_INET, type, 0);
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &addr_len) != 0) {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    port = ntohs(addr.sin_port);
+
+    return fd;
+}
+
+static void send_all(int fd, const std::string& data)
+{
+    const ssize_t n = send(fd, data.data(), data.size(), 0);
+    (void)n;
+}
+
+/* a receive that times out in the middle of a frame goes on with it on the next call */
+static void test_tcp_timeout()
+{
+    int port;
+    const int width = 64;
+    const int height = 48;
+    SeekStreamClient client;
+    StreamHeader header;
+    std::vector<uint16_t> pixels;
+
+    const int listener = bound_socket(SOCK_STREAM, port);
+    if (!CHECK(listener >= 0) || !CHECK(listen(listener, 1) == 0))
+        return;
+    CHECK(client.connect("127.0.0.1", port));
+    const int fd = accept(listener, nullptr, nullptr);
+    close(listener);
+    if (!CHECK(fd >= 0))
+        return;
+
+    /* cut off within the header, then within the payload */
+    const std::string first = encode(width, height, 1);
+    send_all(fd, first.substr(0, 20));
+    CHECK(!client.receive(header, pixels, 100));
+    send_all(fd, first.substr(20, 1000));
+    CHECK(!client.receive(header, pixels, 100));
+    send_all(fd, first.substr(1020));
+    CHECK(client.receive(header, pixels, 2000) && intact(header, pixels, width, height, 1));
+
+    /* the next frame starts right after it */
+    send_all(fd, encode(width, height, 2));
+    CHECK(client.receive(header, pixels, 2000) && intact(header, pixels, width, height, 2));
+
+    /* a broken header closes the client instead of reading garbage forever */
+    send_all(fd, std::string(sizeof(StreamHeader), 'x'));
+    CHECK(!client.receive(header, pixels, 2000));
+    send_all(fd, encode(width, height, 3));
+    CHECK(!client.receive(header, pixels, 100));
+    close(fd);
+}
+
+/* a datagram from the server carrying bytes [offset, offset + size) of frame */
+static void send_fragment(int fd, const std::string& frame, uint32_t frame_size, uint64_t sequence,
+                          size_t offset, size_t size)
+{
+    StreamFragment fragment;
+    std::string datagram(sizeof(fragment), 0);
+
+    fragment.magic = stream_fragment_magic;
+    fragment.frame_size = frame_size;
+    fragment.stream_sequence = sequence;
+    fragment.offset = offset;
+    fragment.reserved = 0;
+    std::memcpy(&datagram[0], &fragment, sizeof(fragment));
+    datagram.append(frame, offset, size);
+    send_all(fd, datagram);
+}
+
+/* fragments that don't fit the frame being reassembled or arrive twice are ignored */
+static void test_udp_fragments()
+{
+    int port;
+    const int width = 40;
+    const int height = 40;          /* 3256 bytes, 3 chunks of 1400 */
+    const size_t chunk = 1400;
+    SeekStreamClient client;
+    StreamHeader header;
+    std::vector<uint16_t> pixels;
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    char request[64];
+
+    const int fd = bound_socket(SOCK_DGRAM, port);
+    if (!CHECK(fd >= 0))
+        return;
+    CHECK(client.subscribe("127.0.0.1", port));
+    if (!CHECK(recvfrom(fd, request, sizeof(request), 0, reinterpret_cast<struct sockaddr*>(&addr), &addr_len) == 3) ||
+            !CHECK(connect(fd, reinterpret_cast<struct sockaddr*>(&addr), addr_len) == 0)) {
+        close(fd);
+        return;
+    }
+
+    const std::string frame = encode(width, height, 1);
+    const std::string larger = encode(width, height * 4, 1);
+
+    /* same sequence, a larger frame: would land beyond the frame being reassembled */
+    send_fragment(fd, frame, frame.size(), 1, 0, chunk);
+    send_fragment(fd, larger, larger.size(), 1, 4 * chunk, chunk);
+    /* not on a chunk boundary, or longer than a chunk */
+    send_fragment(fd, frame, frame.size(), 1, 100, chunk);
+    send_fragment(fd, larger, frame.size(), 1, chunk, 2 * chunk);
+    /* chunk 0 again doesn't make up for the missing chunk 2 */
+    send_fragment(fd, frame, frame.size(), 1, 0, chunk);
+    send_fragment(fd, frame, frame.size(), 1, chunk, chunk);
+    CHECK(!client.receive(header, pixels, 200));
+
+    send_fragment(fd, frame, frame.size(), 1, 2 * chunk, frame.size() - 2 * chunk);
+    CHECK(client.receive(header, pixels, 2000) && intact(header, pixels, width, height, 1));
+    CHECK(client.incomplete() == 0);
+
+    /* the next frame in any order */
+    const std::string next = encode(width, height, 2);
+    send_fragment(fd, next, next.size(), 2, 2 * chunk, next.size() - 2 * chunk);
+    send_fragment(fd, next, next.size(), 2, 0, chunk);
+    send_fragment(fd, next, next.size(), 2, chunk, chunk);
+    CHECK(client.receive(header, pixels, 2000) && intact(header, pixels, width, height, 2));
+
+    client.close();
+    close(fd);
+}
+
+int main()
+{
+    test_tcp();
+    test_tcp_timeout();
+    test_udp();
+    test_udp_fragments();
+
+    return test::result();
+}
@@ -0,0 +1,320 @@
+/*
+ *  Trace test
+ *  Events of several threads end up in one Chrome trace that parses as
+ *  JSON, with the names of the events and threads. Threads that exited
+ *  hand their buffers to new threads once exported, never more than 32
+ *  buffers are kept, and exporting while another thread records gives a
+ *  whole trace every time. Only built with WITH_TRACING, meant to run
+ *  under ThreadSanitizer too.
+ */
+#include "SeekTrace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "test.h"
+
+using namespace LibSeek;
+
+static const char* filename = "test_trace.json";
+
+/* just enough JSON to read a trace back */
+struct Value {
+    enum Type { NONE, NUMBER, STRING, ARRAY, OBJECT } type;
+    double number;
+    std::string string;
+    std::vector<Value> items;
+    std::map<std::string, Value> members;
+
+    Value() : type(NONE), number(0) { }
+
+    const Value& operator[](const char* key) const
+    {
+        static const Value none;
+        std::map<std::string, Value>::const_iterator it = members.find(key);
+        return it == members.end() ? none : it->second;
+    }
+};
+
+class Parser
+{
+public:
+    explicit Parser(const std::string& text) : m_text(text), m_pos(0) { }
+
+    /* false when the whole text isn't one JSON value */
+    bool parse(Value& value)
+    {
+        return parse_value(value) && (skip_space(), m_pos == m_text.size());
+    }
+
+private:
+    void skip_space()
+    {
+        while (m_pos < m_text.size() && strchr(" \t\r\n", m_text[m_pos]) != nullptr)
+            m_pos++;
+    }
+
+    bool expect(char c)
+    {
+        skip_space();
+        if (m_pos == m_text.size() || m_text[m_pos] != c)
+            return false;
+        m_pos++;
+        return true;
+    }
+
+    bool parse_string(std::string& string)
+    {
+        if (!expect('"'))
+            return false;
+        while (m_pos < m_text.size() && m_text[m_pos] != '"') {
+            char c = m_text[m_pos++];
+            if (static_cast<unsigned char>(c) < 0x20)
+                return false;
+            if (c == '\\') {
+                if (m_pos == m_text.size() || strchr("\"\\/bfnrtu", m_text[m_pos]) == nullptr)
+                    return false;
+                c = m_text[m_pos++];
+                if (c == 'u') {
+                    if (m_pos + 4 > m_text.size())
+                        return false;
+                    c = static_cast<char>(strtol(m_text.substr(m_pos, 4).c_str(), nullptr, 16));
+                    m_pos += 4;
+                }
+            }
+            string += c;
+        }
+        return expect('"');
+    }
+
+    bool parse_value(Value& value)
+    {
+        skip_space();
+        if (m_pos == m_text.size())
+            return false;
+
+        const char c = m_text[m_pos];
+        if (c == '"') {
+            value.type = Value::STRING;
+            return parse_string(value.string);
+        }
+        if (c == '[') {
+            value.type = Value::ARRAY;
+            m_pos++;
+            if (expect(']'))
+                return true;
+            do {
+                value.items.push_back(Value());
+                if (!parse_value(value.items.back()))
+                    return false;
+            } while (expect(','));
+            return expect(']');
+        }
+        if (c == '{') {
+            value.type = Value::OBJECT;
+            m_pos++;
+            if (expect('}'))
+                return true;
+            do {
+                std::string key;
+                if (!parse_string(key) || !expect(':') || !parse_value(value.members[key]))
+                    return false;
+            } while (expect(','));
+            return expect('}');
+        }
+
+        const char* start = m_text.c_str() + m_pos;
+        char* end;
+        value.type = Value::NUMBER;
+        value.number = strtod(start, &end);
+        m_pos += end - start;
+        return end != start;
+    }
+
+    const std::string& m_text;
+    size_t m_pos;
+};
+
+/* what a trace holds */
+struct Trace {
+    bool valid;
+    std::map<int, std::string> threads;             /* tid to thread name */
+    std::map<std::string, int> scopes;              /* complete events by name */
+    std::map<std::string, int> instants;
+    std::map<std::string, std::map<int, int> > tids;    /* events by name and tid */
+};
+
+static Trace read_trace()
+{
+    Trace trace;
+    std::ifstream file(filename);
+    std::stringstream text;
+    Value root;
+
+    text << file.rdbuf();
+    trace.valid = Parser(text.str()).parse(root) && root.type == Value::OBJECT &&
+                  root["traceEvents"].type == Value::ARRAY;
+    if (!trace.valid)
+        return trace;
+
+    const std::vector<Value>& events = root["traceEvents"].items;
+    for (size_t i = 0; i < events.size(); i++) {
+        const Value& event = events[i];
+        const std::string& ph = event["ph"].string;
+        const std::string& name = event["name"].string;
+        const int tid = static_cast<int>(event["tid"].number);
+
+        if (ph == "M" && name == "thread_name")
+            trace.threads[tid] = event["args"]["name"].string;
+        else if (ph == "X" && event["dur"].type == Value::NUMBER && event["dur"].number >= 0)
+            trace.scopes[name]++;
+        else if (ph == "i")
+            trace.instants[name]++;
+        else
+            trace.valid = false;
+        trace.tids[name][tid]++;
+    }
+
+    return trace;
+}
+
+/* events of threads named name */
+static int events_of(const Trace& trace, const char* event, const char* name)
+{
+    int n = 0;
+    std::map<std::string, std::map<int, int> >::const_iterator it = trace.tids.find(event);
+
+    if (it == trace.tids.end())
+        return 0;
+    for (std::map<int, int>::const_iterator tid = it->second.begin(); tid != it->second.end(); ++tid) {
+        std::map<int, std::string>::const_iterator thread = trace.threads.find(tid->first);
+        if (thread != trace.threads.end() && thread->second == name)
+            n += tid->second;
+    }
+
+    return n;
+}
+
+static void run_thread(const char* name, const char* event, int events)
+{
+    std::thread thread([name, event, events]() {
+        trace_thread_name(name);
+        for (int i = 0; i < events; i++) {
+            SEEK_TRACE_SCOPE(event);
+        }
+        SEEK_TRACE_INSTANT("done");
+    });
+    thread.join();
+}
+
+static void test_threads()
+{
+    int i;
+
+    trace_thread_name("main");
+    {
+        SEEK_TRACE_SCOPE("main_scope");
+    }
+    for (i = 0; i < 3; i++)
+        run_thread("first", "first_event", 10);
+
+    CHECK(trace_export(filename));
+    Trace trace = read_trace();
+    CHECK(trace.valid);
+    CHECK(trace.scopes["main_scope"] == 1);
+    CHECK(events_of(trace, "main_scope", "main") == 1);
+    CHECK(trace.scopes["first_event"] == 30);
+    CHECK(events_of(trace, "first_event", "first") == 30);
+    CHECK(trace.instants["done"] == 3);
+    CHECK(trace.threads.size() == 4);
+
+    /* the exported buffers of the exited threads are taken over, their events go */
+    for (i = 0; i < 3; i++)
+        run_thread("second", "second_event", 10);
+    CHECK(trace_export(filename));
+    trace = read_trace();
+    CHECK(trace.valid);
+    CHECK(trace.scopes["first_event"] == 0);
+    CHECK(events_of(trace, "second_event", "second") == 30);
+    CHECK(trace.threads.size() == 4);
+
+    /*
+     *  3 threads take over the exported buffers, 28 get new ones, then with
+     *  32 buffers the other 9 take over one that wasn't exported
+     */
+    for (i = 0; i < 40; i++)
+        run_thread("third", "third_event", 10);
+    CHECK(trace_export(filename));
+    trace = read_trace();
+    CHECK(trace.valid);
+    CHECK(trace.threads.size() == 32);
+    CHECK(events_of(trace, "third_event", "third") == 31 * 10);
+    CHECK(trace.scopes["second_event"] == 0);
+    CHECK(trace.scopes["main_scope"] == 1);
+
+    /* only the last events of a thread are kept, less the one the thread may be writing */
+    run_thread("fourth", "fourth_event", 200);
+    CHECK(trace_export(filename));
+    trace = read_trace();
+    CHECK(trace.valid);
+    CHECK(events_of(trace, "fourth_event", "fourth") == 64 - 2);
+    CHECK(events_of(trace, "done", "fourth") == 1);
+    CHECK(trace.threads.size() == 32);
+}
+
+static void test_export_while_recording()
+{
+    std::atomic<bool> stop(false);
+    int valid = 0, busy = 0;
+
+    trace_clear();
+    std::thread recorder([&stop]() {
+        trace_thread_name("recorder");
+        while (!stop) {
+            SEEK_TRACE_SCOPE("busy");
+        }
+    });
+
+    for (int i = 0; i < 20; i++) {
+        CHECK(trace_export(filename));
+        const Trace trace = read_trace();
+        valid += trace.valid;
+        busy += events_of(trace, "busy", "recorder") > 0;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    stop = true;
+    recorder.join();
+
+    CHECK(valid == 20);
+    CHECK(busy > 0);
+
+    /* nothing left after stop and clear */
+    trace_stop();
+    {
+        SEEK_TRACE_SCOPE("stopped");
+    }
+    trace_clear();
+    CHECK(trace_export(filename));
+    const Trace trace = read_trace();
+    CHECK(trace.valid && trace.scopes.empty() && trace.instants.empty());
+}
+
+int main()
+{
+    if (!CHECK(trace_start(64)))
+        return test::result();
+
+    test_threads();
+    test_export_while_recording();
+
+    remove(filename);
+
+    return test::result();
+}
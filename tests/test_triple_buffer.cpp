@@ -0,0 +1,114 @@
+/*
+ *  Triple buffer test
+ *  The consumer only ever sees the newest value published, and with a
+ *  producer thread racing it every value it gets is whole and newer than
+ *  the one before, nothing published is overwritten while being read and
+ *  the last value always arrives. Meant to run under ThreadSanitizer too.
+ */
+#include "triple_buffer.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "test.h"
+
+static const int pixels = 4096;
+static const int frame_count = 20000;
+
+/* every pixel of frame n holds n */
+struct Frame {
+    int n;
+    std::vector<int> pixels;
+};
+
+static void fill(Frame& frame, int n)
+{
+    frame.n = n;
+    for (int i = 0; i < pixels; i++)
+        frame.pixels[i] = n;
+}
+
+static bool whole(const Frame& frame)
+{
+    for (int i = 0; i < pixels; i++) {
+        if (frame.pixels[i] != frame.n)
+            return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    int i;
+
+    /* one thread: only the newest value is seen */
+    {
+        TripleBuffer<Frame> buffer;
+        for (i = 0; i < 3; i++)
+            buffer.slot(i).pixels.resize(pixels);
+
+        CHECK(!buffer.update());
+        const auto start = std::chrono::steady_clock::now();
+        CHECK(!buffer.wait(std::chrono::milliseconds(20)));
+        CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+
+        for (i = 1; i <= 5; i++) {
+            fill(buffer.back(), i);
+            buffer.publish();
+        }
+        CHECK(buffer.update() && buffer.front().n == 5 && whole(buffer.front()));
+        CHECK(!buffer.update() && buffer.front().n == 5);
+
+        /* the producer can't write into the value being read */
+        fill(buffer.back(), 6);
+        buffer.publish();
+        fill(buffer.back(), 7);
+        buffer.publish();
+        CHECK(buffer.front().n == 5 && whole(buffer.front()));
+        CHECK(buffer.wait(std::chrono::milliseconds(0)) && buffer.front().n == 7);
+    }
+
+    /* a producer thread racing the consumer */
+    {
+        TripleBuffer<Frame> buffer;
+        std::atomic<bool> done(false);
+        int received = 0, last = 0, torn = 0, backwards = 0;
+
+        for (i = 0; i < 3; i++)
+            buffer.slot(i).pixels.resize(pixels);
+
+        std::thread producer([&]() {
+            for (int n = 1; n <= frame_count; n++) {
+                fill(buffer.back(), n);
+                buffer.publish();
+                if (n % 64 == 0)
+                    std::this_thread::yield();
+            }
+            done = true;
+        });
+
+        while (last < frame_count) {
+            const bool finished = done;
+            if (!buffer.wait(std::chrono::milliseconds(100))) {
+                /* everything was published before done, the last value can't be missing */
+                if (finished)
+                    break;
+                continue;
+            }
+            torn += !whole(buffer.front());
+            backwards += buffer.front().n <= last;
+            last = buffer.front().n;
+            received++;
+        }
+        producer.join();
+
+        CHECK(torn == 0);
+        CHECK(backwards == 0);
+        CHECK(last == frame_count);
+        CHECK(received > 0 && received <= frame_count);
+        fprintf(stderr, "received %d of %d frames\n", received, frame_count);
+    }
+
+    return test::result();
+}
@@ -0,0 +1,93 @@
+/*
+ *  Upscale test
+ *  upscale_nearest_colorize and upscale_bilinear_colorize against
+ *  cv::resize INTER_NEAREST / INTER_LINEAR followed by the palette lookup,
+ *  for factors on both sides of the vector code limits, odd widths (vector
+ *  tails) and padded rows. Nearest must match exactly, bilinear within one
+ *  grey level (cv::resize rounds its fixed point weights differently).
+ */
+#include <opencv2/imgproc/imgproc.hpp>
+#include "SeekProcessing.h"
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include "bench.h"
+#include "test.h"
+
+using namespace LibSeek;
+
+static void upscale(const cv::Mat& src, int factor, bool nearest)
+{
+    int x, y;
+    const int padding = 5;
+    std::vector<uint8_t> palette(256 * 3);
+    std::vector<int32_t> scratch(2 * src.cols * factor);
+    cv::Mat reference;
+    /* output rows with padding that must stay untouched */
+    cv::Mat buffer(src.rows * factor, src.cols * factor + padding, CV_8UC3, cv::Scalar(1, 2, 3));
+    cv::Mat out = buffer(cv::Rect(0, 0, src.cols * factor, src.rows * factor));
+
+    /* the first channel is the grey level, the others check the lookup */
+    for (x = 0; x < 256; x++) {
+        palette[3 * x] = x;
+        palette[3 * x + 1] = 255 - x;
+        palette[3 * x + 2] = x * 7;
+    }
+
+    if (nearest)
+        upscale_nearest_colorize(src.ptr<uint8_t>(0), src.step, src.cols, src.rows, palette.data(), factor,
+                                 out.ptr<uint8_t>(0), out.step);
+    else
+        upscale_bilinear_colorize(src.ptr<uint8_t>(0), src.step, src.cols, src.rows, palette.data(), factor,
+                                  out.ptr<uint8_t>(0), out.step, scratch.data());
+
+    cv::resize(src, reference, out.size(), 0, 0, nearest ? cv::INTER_NEAREST : cv::INTER_LINEAR);
+
+    for (y = 0; y < out.rows; y++) {
+        for (x = 0; x < out.cols; x++) {
+            const uint8_t* pixel = out.ptr<uint8_t>(y) + 3 * x;
+            const int grey = pixel[0];
+            const int diff = std::abs(grey - reference.at<uint8_t>(y, x));
+
+            if (!CHECK(diff <= (nearest ? 0 : 1)) ||
+                    !CHECK(pixel[1] == palette[3 * grey + 1] && pixel[2] == palette[3 * grey + 2])) {
+                fprintf(stderr, "%dx%d %s x%d, pixel %d, %d\n", src.cols, src.rows,
+                        nearest ? "nearest" : "bilinear", factor, x, y);
+                return;
+            }
+        }
+        for (x = out.cols; x < buffer.cols; x++) {
+            const uint8_t* pixel = buffer.ptr<uint8_t>(y) + 3 * x;
+            CHECK(pixel[0] == 1 && pixel[1] == 2 && pixel[2] == 3);
+        }
+    }
+}
+
+int main()
+{
+    int i, factor;
+    const cv::Size sizes[] = { cv::Size(207, 154), cv::Size(320, 240), cv::Size(31, 7), cv::Size(5, 3), cv::Size(1, 1) };
+
+    for (i = 0; i < static_cast<int>(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        /* noise, and a smooth ramp that shows up rounding differences, the noise inside a larger image */
+        cv::Mat noise_buffer(sizes[i].height + 2, sizes[i].width + 3, CV_8UC1);
+        for (int y = 0; y < noise_buffer.rows; y++)
+            for (int x = 0; x < noise_buffer.cols; x++)
+                noise_buffer.at<uint8_t>(y, x) = bench::hash(y * noise_buffer.cols + x) >> 24;
+        cv::Mat noise = noise_buffer(cv::Rect(1, 1, sizes[i].width, sizes[i].height));
+
+        cv::Mat ramp(sizes[i], CV_8UC1);
+        for (int y = 0; y < ramp.rows; y++)
+            for (int x = 0; x < ramp.cols; x++)
+                ramp.at<uint8_t>(y, x) = (x * 255 / std::max(ramp.cols - 1, 1) + y * 3) % 256;
+
+        for (factor = 1; factor <= 10; factor++) {
+            upscale(noise, factor, true);
+            upscale(noise, factor, false);
+            upscale(ramp, factor, true);
+            upscale(ramp, factor, false);
+        }
+    }
+
+    return test::result();
+}